@@ -45,6 +45,7 @@ class BaroPanel: virtual public PanelBase {
     void draw(void);
     void setBarometer(float baro);
     bool isClicked(uint16_t x, uint16_t y) override;
+    void newDay(void) override;
 
   private:
     Adafruit_RA8875 *tft;
@@ -54,18 +55,20 @@ class BaroPanel: virtual public PanelBase {
     uint8_t baroDir;
     float low;
     float high;
-    float average;
-    uint8_t averagePoll;
+    uint8_t refreshCount;
 
     enum Extremes highlow;
     bool baroDirty;
     bool borderDirty;
     bool extremeDirty;
+    bool stale;                     // Extremes shown are old, new ones asked for
 
     void drawExtremes(void);
+    void getExtremes(void);
     void getDailyExtremes(void);
     void getExtendedExtremes(uint16_t timeLen);
-    void getAveragePressure(void);
+    bool getTrend(void);
+    static void extremesReady(void *panel, int rc);
 };
 
 #endif /* INCLUDE_BAROPANEL_H_ */
\ No newline at end of file
@@ -42,6 +42,7 @@ class HumidityPanel: virtual public PanelBase {
     void draw(void);
     void setHumidity(uint8_t humidity);
     bool isClicked(uint16_t x, uint16_t y) override;
+    void newDay(void) override;
 
   private:
     Adafruit_RA8875 *tft;
@@ -56,10 +57,13 @@ class HumidityPanel: virtual public PanelBase {
 
     bool humDirty;
     bool extremeDirty;
+    bool stale;                     // Extremes shown are old, new ones asked for
     bool borderDirty;
 
     void drawExtremes(void);
+    void getExtremes(void);
     void getDailyExtremes(void);
     void getExtendedExtremes(uint16_t timeLen);
+    static void extremesReady(void *panel, int rc);
 };
 #endif /* INCLUDE_HUMIDITYPANEL_H_ */
\ No newline at end of file
@@ -22,7 +22,78 @@
  */
 
 #ifndef INCLUDE_INFLUXDBQUERIES_H_
-#define INCLUDE_INFLUXDBQUERIEs_H_
+#define INCLUDE_INFLUXDBQUERIES_H_
+
+#include <Arduino.h>
+
+/*
+ * Successful query results are cached by what was asked for, indoor or
+ * outdoor, and the period in days, 0 for today. Results are good for the
+ * TTL of their period, and none of them past local midnight.
+ *
+ * Extremes and rain totals the history store covers are answered from it,
+ * and never queried. The store's rain periods are calendar days, today's
+ * included, where InfluxDB's are the last 24 hours times the period.
+ *
+ * Whatever is not in memory is fetched through a plan: influxPlanAdd() for
+ * each thing wanted, then one request with all of the statements, whose
+ * answers go in the cache.
+ *
+ * The panels don't wait for it. influxPeek() gives them whatever is in
+ * memory, old or not, and influxRequest() asks for anything stale or missing
+ * with a callback. The display loop calls influxQueryLoop(), which sends what
+ * was asked for to the query task as one plan, and calls back on the display
+ * task once the answers are in the cache. influxPlanRun() sends the plan and
+ * waits, which the display does once at startup, so the panels are first
+ * drawn with current values. Called on their own, the influxGet* functions
+ * also wait, with a plan of one.
+ *
+ * When the display has nothing asked for or out, influxQueryLoop() also
+ * prefetches the weekly, monthly and yearly values of every panel that the
+ * history store does not cover, looking at most every QUERY_PREFETCH_MS. The
+ * TTLs set how often each is fetched again, so a tap on a panel to change its
+ * period is drawn from memory.
+ *
+ * The answers are read straight off the connection by InfluxResultReader,
+ * which keeps only the one value of each statement. Build with -DQUERY_CSV to
+ * have InfluxDB answer in CSV rather than JSON, which is about half the size.
+ */
+#define QUERY_TEMP 0
+#define QUERY_HUM 1
+#define QUERY_PRESS 2
+#define QUERY_RAIN 3
+
+#define QUERY_CACHE_SIZE 24             // Every period of every panel
+#define QUERY_TTL_DAILY_MS 300000       // 5 minutes
+#define QUERY_TTL_WEEKLY_MS 1800000     // 30 minutes
+#define QUERY_TTL_MONTHLY_MS 7200000    // 2 hours
+#define QUERY_TTL_YEARLY_MS 21600000    // 6 hours
+
+#define QUERY_PLAN_SIZE 12
+#define QUERY_PLAN_URL_LENGTH 4096
+#define QUERY_PLAN_STATEMENTS (QUERY_PLAN_SIZE * 2)
+#define QUERY_FAIL_HOLD_MS 10000        // No more requests this long after one fails
+#define QUERY_STATEMENT_ERROR (-100)    // HTTP 200, but InfluxDB failed a statement
+#define QUERY_WAITERS 8                 // Callbacks on one plan
+#define QUERY_PREFETCH_MS 60000         // Between looks for anything stale or missing
+
+#define QUERY_FRESH 0
+#define QUERY_STALE 1                   // Past its TTL, or from yesterday
+#define QUERY_MISSING 2
+
+typedef struct query_cache_stats_t {
+  uint32_t hits;
+  uint32_t misses;
+  uint32_t expired;                 // Misses on a result past its TTL
+  uint32_t midnight;                // Misses on a result from yesterday
+  uint32_t stale;                   // Misses answered with the old result meanwhile
+  uint32_t requests;                // Sent to InfluxDB
+  uint32_t statements;              // In those requests
+  uint32_t prefetched;              // Asked for with nothing waiting on them
+  uint8_t entries;
+} query_cache_stats_t;
+
+typedef void (*query_done_t)(void *context, int rc);
 
 uint8_t influxGetDailyHighLowTemp(bool indoor, float *high, float *low);
 uint8_t influxGetExtendedHighLowTemp(bool indoor, uint16_t timeLen, float *high, float *low);
@@ -32,6 +103,11 @@ uint8_t influxGetDailyHighLowHum(bool indoor,float *high, float *low);
 uint8_t influxGetExtendedHighLowHum(bool indoor, uint16_t timeLen, float *high, float *low);
 uint8_t influxGetDailyHighLowPress(float *high, float *low);
 uint8_t influxGetExtendedHighLowPress(uint16_t timeLen, float *high, float *low);
-uint8_t influxGetAveragePressure(float *ave);
+bool influxPlanAdd(uint8_t query, bool indoor, uint16_t period);
+int influxPlanRun(void);
+uint8_t influxPeek(uint8_t query, bool indoor, uint16_t period, float *high, float *low);
+bool influxRequest(uint8_t query, bool indoor, uint16_t period, query_done_t done, void *context);
+void influxQueryLoop(void);
+void getQueryCacheStats(query_cache_stats_t *stats);
 
-#endif /* INCLUDE_INFLUXDBQUERIEs_H_ */
\ No newline at end of file
+#endif /* INCLUDE_INFLUXDBQUERIES_H_ */
\ No newline at end of file
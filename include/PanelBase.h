@@ -30,6 +30,7 @@ enum Extremes {DAILY, WEEKLY, MONTHLY, YEARLY};
 class PanelBase {
   public:
    virtual bool isClicked(uint16_t x, uint16_t y) = 0;
+   virtual void newDay(void) {}    // Local midnight, for panels showing daily values
 };
 
 #endif /* INCLUDE_PANELBASE_H_ */
\ No newline at end of file
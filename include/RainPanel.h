@@ -41,6 +41,7 @@ class RainPanel: virtual public PanelBase {
     void draw(void);
     void setRain(float rain);
     bool isClicked(uint16_t x, uint16_t y) override;
+    void newDay(void) override;
 
   private:
     Adafruit_RA8875 *tft;
@@ -51,10 +52,11 @@ class RainPanel: virtual public PanelBase {
 
     enum Extremes rainPeriod;
     bool rainDirty;
+    bool stale;                     // Total shown is old, a new one asked for
     bool borderDirty;
 
-    void getDailyRain(void);
-    void getExtendedRain(uint16_t timeLen);
+    void getRain(void);
+    static void rainReady(void *panel, int rc);
 };
 
 #endif /* INCLUDE_RAINPANEL_H_ */
@@ -43,6 +43,7 @@ class TemperaturePanel: virtual public PanelBase {
     void draw(void);
     void setTemperature(int8_t temperature);
     bool isClicked(uint16_t x, uint16_t y) override;
+    void newDay(void) override;
 
   private:
     Adafruit_RA8875 *tft;
@@ -57,11 +58,14 @@ class TemperaturePanel: virtual public PanelBase {
 
     bool tempDirty;
     bool extremeDirty;
+    bool stale;                     // Extremes shown are old, new ones asked for
     bool borderDirty;
 
     void drawThermometer(uint16_t x0, uint16_t y0);
     void drawExtremes(void);
+    void getExtremes(void);
     void getDailyExtremes(void);
     void getExtendedExtremes(uint16_t timeLen);
+    static void extremesReady(void *panel, int rc);
 };
 #endif /* INCLUDE_TEMPERATUREPANEL_H_ */
\ No newline at end of file
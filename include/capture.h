@@ -0,0 +1,46 @@
+/**
+ *  @filename   :   capture.h
+ *  @brief      :   ESP32 Weather Base Station ESP-NOW Frame Capture
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef INCLUDE_CAPTURE_H_
+#define INCLUDE_CAPTURE_H_
+
+#include <Arduino.h>
+#include "ingestqueue.h"
+
+/*
+ * One frame per line, as received before any decoding
+ *
+ *   CAP <arrival, us since the epoch> <mac, 12 hex digits> <frame, hex>
+ *
+ * Building with -DCAPTURE_FRAMES prints every frame taken off the ingest
+ * queue to Serial in this format, so a capture is just the monitor output
+ * run through grep ^CAP. The native build can record and replay the same
+ * files, see lib/NativeShims/src/native_main.cpp.
+ */
+#define CAPTURE_PREFIX "CAP "
+#define CAPTURE_LINE_LENGTH (4 + 20 + 1 + 12 + 1 + INGEST_MAX_FRAME * 2 + 2)
+
+void captureWrite(Print &out, const ingest_frame_t *frame);
+bool captureRead(const char *line, ingest_frame_t *frame);
+
+#endif /* INCLUDE_CAPTURE_H_ */
@@ -58,5 +58,7 @@ void redrawBackgroundSection(uint16_t x, uint16_t y, uint16_t w, uint16_t h);
 void setError(const char *errStr);
 void log(const char *system, const char *message);
 void displayData(float temperature, int32_t pressure, float humidity, float battery_millivolts, uint16_t direction, float anemometer, float rain,float roomTemp, float roomHum);
+void displayMidnight(void);
+void displayStale(const char *mac);
 
 #endif /* INCLUDE_DISPLAY_H_ */
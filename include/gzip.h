@@ -0,0 +1,43 @@
+/**
+ *  @filename   :   gzip.h
+ *  @brief      :   ESP32 Weather Base Station Small Gzip Encoder
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef INCLUDE_GZIP_H_
+#define INCLUDE_GZIP_H_
+
+#include <Arduino.h>
+
+/*
+ * One shot gzip of a buffer already in memory, as a single deflate block
+ * with the fixed Huffman codes. The whole input is the window, so it must be
+ * no more than 32KB. A full deflate compressor wants well over 100KB of
+ * state; this gets most of the way on line protocol, where every line
+ * repeats the keys of the one before, with a 2KB hash table.
+ */
+#define GZIP_MAX_INPUT 32768
+#define GZIP_HASH_BITS 10
+#define GZIP_OVERHEAD 18            // Header and trailer
+
+uint32_t gzipCrc32(const uint8_t *data, size_t len);
+size_t gzipCompress(const uint8_t *in, size_t len, uint8_t *out, size_t outSize);
+
+#endif /* INCLUDE_GZIP_H_ */
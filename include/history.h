@@ -0,0 +1,138 @@
+/**
+ *  @filename   :   history.h
+ *  @brief      :   ESP32 Weather Base Station Hourly and Daily Extremes Store
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef INCLUDE_HISTORY_H_
+#define INCLUDE_HISTORY_H_
+
+#include <Arduino.h>
+#include <time.h>
+#include "weatherbase.h"
+
+/*
+ * Keeps the minimum, maximum and total of the metrics the panels show, for
+ * the primary station and the room sensor, in hourly buckets for the last
+ * HISTORY_HOURS hours and local day buckets for the last HISTORY_DAYS days.
+ * The daily and extended extremes on the panels come from here instead of
+ * InfluxDB. Values are kept in the units InfluxDB holds and the panels show:
+ * Fahrenheit, percent and inches of mercury.
+ *
+ * A period is only answered once every hour of it is covered. Until then
+ * the panels still query InfluxDB. On the first start the buckets are filled
+ * from InfluxDB newest first, one streamed query per step, on the query task
+ * when it has nothing else to do: the last HISTORY_RAW_HOURS from station,
+ * grouped by hour, and the rest from two_year.hourly_rollup
+ * HISTORY_FILL_DAYS at a time. The buckets are saved to SPIFFS every hour,
+ * so after a restart only the hours the base station was down are fetched.
+ *
+ * Every sample goes into the buckets as it arrives, so the panels read their
+ * extremes from here on each reading and today's bucket starts over at local
+ * midnight. InfluxDB is only asked again when the store is invalidated: a
+ * restart, or timekeeper reporting the wall clock stepped. A step drops the
+ * buckets ahead of the new time and fills again.
+ *
+ * The rain panel's totals come from here too: historyTotal() adds up the
+ * last HISTORY_TOTAL_HOURS hourly buckets, or whole local days for the week,
+ * month and year to date. Once rain has fallen the rain totals of the
+ * latest HISTORY_CHECKPOINT_BUCKETS hours and days are checkpointed to
+ * HISTORY_RAIN_FILE every HISTORY_RAIN_SAVE_SECS rather than waiting for the
+ * hour, so a restart in a storm loses little, and the fill fetches the rest.
+ */
+#define HISTORY_TEMP 0
+#define HISTORY_HUM 1
+#define HISTORY_PRESS 2
+#define HISTORY_RAIN 3
+#define HISTORY_ROOM_TEMP 4
+#define HISTORY_ROOM_HUM 5
+#define HISTORY_METRICS 6
+
+#define HISTORY_HOURS 48
+#define HISTORY_DAYS 366            // The last year and today
+#define HISTORY_RAW_HOURS 48        // Newer than this is fetched from station
+#define HISTORY_FILL_DAYS 31        // Of two_year.hourly_rollup per query
+#define HISTORY_CHUNK_ROWS 24       // Rows in each chunk of a streamed response
+#define HISTORY_CHUNK_DOC 6144      // JSON document for one chunk
+#define HISTORY_RETRY_MS 60000
+#define HISTORY_TOTAL_HOURS 24      // historyTotal() for 0 days, the hour under way and those before it
+#define HISTORY_RAIN_SAVE_SECS 600
+#define HISTORY_CHECKPOINT_BUCKETS 2 // The hour and day under way, and the ones before
+#define HISTORY_FILE "/history"
+#define HISTORY_RAIN_FILE "/rain"
+#define HISTORY_VERSION 1           // Change with history_bucket_t or history_rain_t
+
+// HISTORY_FILE is a history_header_t, then the hours and then the days
+typedef struct history_bucket_t {
+  uint32_t key;                     // Hours since the epoch, or local days
+  uint8_t present;                  // A bit for each metric with a value
+  float min[HISTORY_METRICS];
+  float max[HISTORY_METRICS];
+  float sum[HISTORY_METRICS];
+} history_bucket_t;
+
+typedef struct history_header_t {
+  uint32_t version;
+  uint32_t coveredSince;
+  uint32_t savedAt;
+} history_header_t;
+
+// One bucket's rain, for the checkpoint
+typedef struct history_rain_t {
+  uint32_t key;                     // 0 if unused
+  float max;
+  float min;
+  float sum;
+} history_rain_t;
+
+// HISTORY_RAIN_FILE, the hours and days rain can still fall in before the
+// next full save, on top of the history file saved at savedAt
+typedef struct history_checkpoint_t {
+  uint32_t version;
+  uint32_t savedAt;
+  history_rain_t hours[HISTORY_CHECKPOINT_BUCKETS];
+  history_rain_t days[HISTORY_CHECKPOINT_BUCKETS];
+} history_checkpoint_t;
+
+typedef struct history_stats_t {
+  uint32_t samples;
+  uint32_t hits;                    // Extremes answered from memory
+  uint32_t misses;                  // Left to InfluxDB
+  uint32_t fillQueries;
+  uint32_t fillRows;
+  uint32_t fillFailures;
+  uint32_t saves;                   // Of the history file
+  uint32_t rainSaves;               // Rain checkpoints
+  uint32_t clockSteps;              // Times the store was invalidated by a clock step
+  uint16_t coveredDays;
+} history_stats_t;
+
+void initHistory(void);
+void historyAddSample(const sensor_data_t *data, time_t sampleTime);
+void historyAddRoom(float roomTemp, float roomHum, time_t sampleTime);
+bool historyExtremes(uint8_t metric, uint16_t days, float *high, float *low);
+bool historyCovers(uint8_t metric, uint16_t days);
+bool historyTotal(uint8_t metric, uint16_t days, float *total);
+bool historyTotalCovers(uint8_t metric, uint16_t days);
+void historyLoop(void);
+void historyIdle(void);
+void getHistoryStats(history_stats_t *stats);
+
+#endif /* INCLUDE_HISTORY_H_ */
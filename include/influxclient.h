@@ -0,0 +1,60 @@
+/**
+ *  @filename   :   influxclient.h
+ *  @brief      :   ESP32 Weather Base Station InfluxDB Query Connection
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef INCLUDE_INFLUXCLIENT_H_
+#define INCLUDE_INFLUXCLIENT_H_
+
+#include <Arduino.h>
+#include <HTTPClient.h>
+
+/*
+ * One HTTPClient, and the WiFiClient under it, kept for every query to
+ * InfluxDB, so the TCP connection stays open between requests instead of
+ * being set up and torn down for each one. The server is the MQTT server;
+ * its address is resolved once and kept until a request fails to connect.
+ * Nothing is opened until a request needs it, and a connection the server
+ * closed is opened again on the next request.
+ *
+ * The queries and the history fill both run on the query task, which is the
+ * only task that may use this.
+ */
+#define INFLUX_QUERY_PORT 8086
+
+typedef struct influx_client_stats_t {
+  uint32_t requests;
+  uint32_t reused;                  // Sent on a connection that was already open
+  uint32_t connects;
+  uint32_t resolves;
+  uint32_t failures;                // No address, or no connection
+  uint32_t rttLastMs;               // From sending the request to the status line
+  uint32_t rttMinMs;
+  uint32_t rttMeanMs;
+  uint32_t rttMaxMs;
+} influx_client_stats_t;
+
+int influxClientGet(const char *uri, bool http10, const char *accept = NULL);
+HTTPClient &influxClient(void);
+void influxClientEnd(void);
+void getInfluxClientStats(influx_client_stats_t *stats);
+
+#endif /* INCLUDE_INFLUXCLIENT_H_ */
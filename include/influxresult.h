@@ -0,0 +1,104 @@
+/**
+ *  @filename   :   influxresult.h
+ *  @brief      :   ESP32 Weather Base Station InfluxDB Query Response Reader
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef INCLUDE_INFLUXRESULT_H_
+#define INCLUDE_INFLUXRESULT_H_
+
+#include <Arduino.h>
+
+/*
+ * Picks the one value each statement of an InfluxDB /query answers,
+ * results[n].series[0].values[0][1], out of the response as it is written
+ * to it, a byte at a time, by HTTPClient::writeToStream(). Nothing else in
+ * the response is kept, so a response of any size is read in the same few
+ * bytes and nothing is allocated. A statement that returns no series keeps
+ * the 0 it starts with. A statement that failed, or a whole request that
+ * did, is counted in errors() and keeps its 0 as well, so the caller has to
+ * check it before trusting the values.
+ *
+ * A CSV response (Accept: application/csv) leaves out the statements with
+ * no series, so the statements have to name their value r<n>, n being the
+ * statement's index, for their rows to be matched up.
+ */
+#define INFLUX_RESULT_TOKEN 24      // Longest key or number kept
+#define INFLUX_RESULT_DEPTH 8       // Nesting followed, values[0][1] is at 7
+#define INFLUX_RESULT_NONE 0xff
+
+typedef struct influx_level_t {
+  bool array;
+  bool expectKey;
+  uint8_t key;                      // Of the member being read, in an object
+  uint8_t index;                    // Of the element being read, in an array
+} influx_level_t;
+
+class InfluxResultReader : public Stream {
+  public:
+    InfluxResultReader(float *values, uint8_t count, bool csv);
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t *buffer, size_t size) override;
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    void flush() {}
+    using Print::write;
+
+    bool finish(void);
+    uint8_t found(void) { return valuesFound; }
+    uint8_t errors(void) { return errorCount; }
+
+  private:
+    void jsonChar(char c);
+    void csvChar(char c);
+    void addToken(char c);
+    void endString(void);
+    void endScalar(void);
+    void endLine(void);
+    void store(uint8_t statement);
+    influx_level_t *level(uint8_t n) { return &levels[n - 1]; }
+
+    float *values;
+    uint8_t count;
+    bool csv;
+    uint8_t valuesFound;
+    uint8_t errorCount;
+
+    char token[INFLUX_RESULT_TOKEN];
+    uint8_t tokenLen;
+    bool tokenLong;
+
+    // JSON
+    uint8_t state;
+    bool inKey;
+    uint8_t depth;
+    bool done;
+    bool broken;
+    influx_level_t levels[INFLUX_RESULT_DEPTH];
+
+    // CSV
+    uint8_t field;
+    bool header;
+    uint8_t statement;
+};
+
+#endif /* INCLUDE_INFLUXRESULT_H_ */
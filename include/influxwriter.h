@@ -0,0 +1,81 @@
+/**
+ *  @filename   :   influxwriter.h
+ *  @brief      :   ESP32 Weather Base Station InfluxDB Line Protocol Writer
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef INCLUDE_INFLUXWRITER_H_
+#define INCLUDE_INFLUXWRITER_H_
+
+#include <Arduino.h>
+#include <time.h>
+#include "weatherbase.h"
+
+/*
+ * Build with -DINFLUX_WRITER to send readings straight to InfluxDB instead of
+ * through MQTT and the bridge. Each reading becomes one line
+ *
+ *   station,topic=<station topic> wakeup_reason=4,temperature=64.4,... <secs>
+ *
+ * with the same field names as the MQTT payload, plus pressureHg, in the
+ * units the bridge stores and the queries read: Fahrenheit, inches of rain
+ * and inches of mercury alongside the pressure in Pascals. The queries read
+ * station without filtering on the topic, so only the primary station and the
+ * room sensor go there, any other station goes to INFLUX_OTHER_MEASUREMENT
+ * with the same fields. Lines are
+ * batched and written to /write on the MQTT server, gzipped when that makes
+ * the request smaller. A failed write keeps its batch and is retried with
+ * backoff; points that arrive while the batch is full are dropped.
+ *
+ * Everything here runs on the network task.
+ */
+#define INFLUX_PORT 8086
+#define INFLUX_DATABASE "weather"
+#define INFLUX_MEASUREMENT "station"
+#define INFLUX_OTHER_MEASUREMENT "other_station"
+#define INFLUX_BATCH_SIZE 8192      // Line protocol held for one write
+#define INFLUX_FLUSH_BYTES 2048     // Written once the batch is this big
+#define INFLUX_FLUSH_AGE_MS 60000   // or its oldest point is this old
+#define INFLUX_LINE_LENGTH 256
+#define INFLUX_TIMEOUT_MS 2000
+#define INFLUX_RETRY_MIN_MS 1000
+#define INFLUX_RETRY_MAX_MS 60000
+#define INFLUX_MIN_TIME 1577836800  // Before this the clock is not set, let the server stamp it
+
+typedef struct influx_stats_t {
+  uint32_t points;
+  uint32_t writes;
+  uint32_t failures;                // Writes that will be retried
+  uint32_t rejected;                // Points in batches the server refused, not retried
+  uint32_t dropped;                 // No room in the batch
+  uint32_t rawBytes;                // Line protocol written
+  uint32_t sentBytes;               // Request bodies, after gzip
+  uint16_t pendingPoints;
+  uint16_t pendingBytes;
+} influx_stats_t;
+
+uint16_t influxLineSample(char *line, const char *topic, bool primary, time_t sampleTime, const sensor_data_t *data);
+uint16_t influxLineRoom(char *line, const char *topic, time_t sampleTime, float roomTemp, float roomHum);
+void influxWriteSample(const char *topic, bool primary, time_t sampleTime, const sensor_data_t *data);
+void influxWriteRoom(const char *topic, time_t sampleTime, float roomTemp, float roomHum);
+void influxWriterLoop(void);
+void getInfluxWriterStats(influx_stats_t *stats);
+
+#endif /* INCLUDE_INFLUXWRITER_H_ */
@@ -0,0 +1,59 @@
+/**
+ *  @filename   :   ingestqueue.h
+ *  @brief      :   ESP32 Weather Base Station ESP-NOW Ingest Queue
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef INCLUDE_INGESTQUEUE_H_
+#define INCLUDE_INGESTQUEUE_H_
+
+#include <Arduino.h>
+
+// Single producer (the ESP-NOW receive callback in the WiFi task) and single
+// consumer (the main loop). Depth must be a power of two.
+#define INGEST_QUEUE_DEPTH 16
+#define INGEST_MAX_FRAME 250      // ESP_NOW_MAX_DATA_LEN
+#define INGEST_LATENCY_BUCKETS 124  // Four per power of two, up to 2^32 us
+
+typedef struct ingest_frame_t {
+  int64_t rxMicros;               // Arrival time, microseconds since the epoch
+  int64_t rxMonotonic;            // Arrival on timeMicros(), for the latency
+  uint8_t mac[6];
+  uint8_t len;
+  uint8_t data[INGEST_MAX_FRAME];
+} ingest_frame_t;
+
+typedef struct ingest_stats_t {
+  uint32_t received;
+  uint32_t dropped;
+  uint16_t depth;
+  uint16_t highWater;
+  uint32_t latencyP50;            // Arrival to ingestRelease(), in us
+  uint32_t latencyP90;
+  uint32_t latencyP99;
+  uint32_t latencyMax;
+} ingest_stats_t;
+
+bool ingestPush(const uint8_t *mac, const uint8_t *data, int len);
+ingest_frame_t *ingestPeek(void);
+void ingestRelease(void);
+void ingestGetStats(ingest_stats_t *stats);
+
+#endif /* INCLUDE_INGESTQUEUE_H_ */
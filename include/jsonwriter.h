@@ -0,0 +1,94 @@
+/**
+ *  @filename   :   jsonwriter.h
+ *  @brief      :   ESP32 Weather Base Station Fixed Schema JSON Writer
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef INCLUDE_JSONWRITER_H_
+#define INCLUDE_JSONWRITER_H_
+
+#include <Arduino.h>
+
+/*
+ * Flat JSON objects with a fixed list of fields, written without sprintf or
+ * the heap. The schema is a const table, so the quoted keys and their lengths
+ * are worked out by the compiler and live in flash:
+ *
+ *   static const json_field_t roomFields[] = {
+ *     JSON_FIXED(room_temp, 1),
+ *     JSON_FIXED(room_hum, 1)
+ *   };
+ *   static const json_schema_t roomSchema = JSON_SCHEMA(roomFields);
+ *
+ * and the values are passed as an array in the same order. jsonLength() gives
+ * the exact payload length up front, so it can be streamed straight into
+ * PubSubClient::beginPublish() with jsonWrite().
+ */
+#define JSON_INT 0
+#define JSON_UINT 1
+#define JSON_FIXED_POINT 2
+#define JSON_STRING 3
+
+#define JSON_MAX_DECIMALS 6
+#define JSON_NUMBER_LENGTH 24       // Longest formatted number
+#define JSON_MAX_SCALED 1e18        // Largest fixed point value, scaled by the decimals, that fits a uint64_t
+#define JSON_WRITE_CHUNK 64         // Bytes handed to the Print at a time
+
+#define JSON_KEY(name) "\"" #name "\":"
+#define JSON_FIELD(name, type, arg) {JSON_KEY(name), sizeof(JSON_KEY(name)) - 1, type, arg}
+
+#define JSON_INTEGER(name) JSON_FIELD(name, JSON_INT, 0)
+#define JSON_UNSIGNED(name) JSON_FIELD(name, JSON_UINT, 0)
+#define JSON_FIXED(name, decimals) JSON_FIELD(name, JSON_FIXED_POINT, decimals)
+#define JSON_TEXT(name, maxLength) JSON_FIELD(name, JSON_STRING, maxLength)
+
+#define JSON_SCHEMA(fields) {fields, sizeof(fields) / sizeof(fields[0])}
+
+typedef struct json_field_t {
+  const char *key;                  // Quoted, with the colon
+  uint8_t keyLength;
+  uint8_t type;
+  uint8_t arg;                      // Decimal places, or longest string before escaping
+} json_field_t;
+
+typedef struct json_schema_t {
+  const json_field_t *fields;
+  uint8_t count;
+} json_schema_t;
+
+typedef union json_value_t {
+  int32_t i;
+  uint32_t u;
+  float f;
+  const char *s;
+} json_value_t;
+
+inline json_value_t jsonInt(int32_t value) { json_value_t v; v.i = value; return v; }
+inline json_value_t jsonUint(uint32_t value) { json_value_t v; v.u = value; return v; }
+inline json_value_t jsonFloat(float value) { json_value_t v; v.f = value; return v; }
+inline json_value_t jsonString(const char *value) { json_value_t v; v.s = value; return v; }
+
+uint8_t jsonFormatInteger(char *buffer, int64_t value);
+uint8_t jsonFormatFixed(char *buffer, float value, uint8_t decimals);
+uint16_t jsonLength(const json_schema_t *schema, const json_value_t *values);
+void jsonWrite(Print &out, const json_schema_t *schema, const json_value_t *values);
+uint16_t jsonRender(char *buffer, uint16_t size, const json_schema_t *schema, const json_value_t *values);
+
+#endif /* INCLUDE_JSONWRITER_H_ */
@@ -0,0 +1,96 @@
+/**
+ *  @filename   :   logqueue.h
+ *  @brief      :   ESP32 Weather Base Station Log Queue
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef INCLUDE_LOGQUEUE_H_
+#define INCLUDE_LOGQUEUE_H_
+
+#include <Arduino.h>
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+// Set with -DLOG_LEVEL=LOG_LEVEL_DEBUG in build_flags. Anything above it is
+// compiled out, including the serial debug output.
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+#define LOG_QUEUE_DEPTH 16
+#define LOG_SYSTEM_LENGTH 20        // Same limits as the log topic payload
+#define LOG_MESSAGE_LENGTH 150
+#define LOG_DRAIN_PER_LOOP 2        // Messages published per logQueueLoop()
+
+// Per subsystem token bucket, a burst of LOG_RATE_BURST and then one message
+// every LOG_RATE_REFILL_MS. Repeats of a message already queued are folded
+// into it and never count against the limit.
+#define LOG_RATE_BURST 5
+#define LOG_RATE_REFILL_MS 10000
+#define LOG_MAX_SYSTEMS 16          // Systems past this share the last bucket
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(system, message) logEnqueue(LOG_LEVEL_ERROR, system, message)
+#else
+#define LOG_ERROR(system, message) do {} while(0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(system, message) logEnqueue(LOG_LEVEL_WARN, system, message)
+#else
+#define LOG_WARN(system, message) do {} while(0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(system, message) logEnqueue(LOG_LEVEL_INFO, system, message)
+#else
+#define LOG_INFO(system, message) do {} while(0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(system, message) logEnqueue(LOG_LEVEL_DEBUG, system, message)
+#define DEBUG_PRINTF(...) Serial.printf(__VA_ARGS__)
+#define DEBUG_PRINTLN(...) Serial.println(__VA_ARGS__)
+#else
+#define LOG_DEBUG(system, message) do {} while(0)
+#define DEBUG_PRINTF(...) do {} while(0)
+#define DEBUG_PRINTLN(...) do {} while(0)
+#endif
+
+typedef struct log_stats_t {
+  uint32_t queued;
+  uint32_t sent;
+  uint32_t coalesced;               // Folded into a message already queued
+  uint32_t rateLimited;
+  uint32_t dropped;                 // Queue full
+  uint8_t depth;
+  uint8_t highWater;
+} log_stats_t;
+
+void initLogQueue(void);
+bool logEnqueue(uint8_t level, const char *system, const char *message);
+void logQueueLoop(void);
+void getLogStats(log_stats_t *stats);
+
+#endif /* INCLUDE_LOGQUEUE_H_ */
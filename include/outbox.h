@@ -0,0 +1,72 @@
+/**
+ *  @filename   :   outbox.h
+ *  @brief      :   ESP32 Weather Base Station Store and Forward Outbox
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef INCLUDE_OUTBOX_H_
+#define INCLUDE_OUTBOX_H_
+
+#include <Arduino.h>
+#include <time.h>
+
+/*
+ * Readings that can't be published are appended to segment files on the
+ * spiffs partition, /ob<8 digit sequence>. Each record is
+ *
+ *   magic(1) topic length(1) payload length(2) time(4) topic payload
+ *
+ * Segments are only ever appended to and then removed whole, so SPIFFS never
+ * rewrites a page in place. When the outbox is full the oldest segment goes.
+ *
+ * The payload is kept in whatever format the topic is published in. Once MQTT
+ * is back, the OUTBOX_BATCH oldest samples in the oldest segment are replayed
+ * every OUTBOX_BATCH_INTERVAL_MS, in sample time order across the segment,
+ * with the original time added to the payload as "time" (seconds since the
+ * epoch, see packAddTime()), so the bridge can stamp the point when it was
+ * taken. Segments go in the order they were written. A segment is removed
+ * after the last of it is sent. A reboot part way through a segment repeats
+ * some of it, which lands on the same points in InfluxDB.
+ */
+#define OUTBOX_SEGMENT_SIZE 12288
+#define OUTBOX_MAX_SEGMENTS 8         // 96KB, half the spiffs partition in big_partition.csv
+#define OUTBOX_BATCH 10
+#define OUTBOX_BATCH_INTERVAL_MS 1000
+#define OUTBOX_MAGIC 0xA5
+#define OUTBOX_RECORD_HEADER 8
+#define OUTBOX_MIN_TIME 1577836800    // 2020-01-01, anything earlier is before SNTP
+
+typedef struct outbox_stats_t {
+  bool mounted;
+  uint32_t appended;
+  uint32_t replayed;
+  uint32_t segmentsDropped;         // Removed unsent because the outbox was full
+  uint32_t corrupt;                 // Segments cut short by a bad record
+  uint16_t segments;
+  uint32_t pendingBytes;
+} outbox_stats_t;
+
+bool initOutbox(void);
+bool outboxAppend(const char *topic, const uint8_t *payload, uint16_t len, time_t sampleTime);
+void outboxLoop(void);
+bool outboxPending(void);
+void getOutboxStats(outbox_stats_t *stats);
+
+#endif /* INCLUDE_OUTBOX_H_ */
@@ -0,0 +1,54 @@
+/**
+ *  @filename   :   packwriter.h
+ *  @brief      :   ESP32 Weather Base Station CBOR and MessagePack Writer
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef INCLUDE_PACKWRITER_H_
+#define INCLUDE_PACKWRITER_H_
+
+#include <Arduino.h>
+#include "jsonwriter.h"
+
+/*
+ * Writes the same schema and values as jsonwriter as a CBOR or MessagePack
+ * map. The keys are small integers, the position of the field in its schema,
+ * so a schema published this way must only ever be added to at the end.
+ * Integers take the shortest encoding, fixed point fields are sent as 32 bit
+ * floats and strings as they are, truncated but not escaped.
+ *
+ * A topic always carries the one format, so a consumer never has to guess.
+ * Only packAddTime() goes by the first byte: '{' for JSON, 0xa0-0xb8 for a
+ * CBOR map and 0x80-0x8f or 0xde for a MessagePack map. The time it adds is
+ * the one text key, "time", so it never clashes with a field.
+ */
+#define PAYLOAD_JSON 0
+#define PAYLOAD_CBOR 1
+#define PAYLOAD_MSGPACK 2
+
+#define PACK_TIME_LENGTH 20         // Most packAddTime() adds, ,"time":4294967295}
+
+uint16_t packLength(uint8_t format, const json_schema_t *schema, const json_value_t *values);
+void packWrite(Print &out, uint8_t format, const json_schema_t *schema, const json_value_t *values);
+uint16_t packRender(uint8_t *buffer, uint16_t size, uint8_t format, const json_schema_t *schema, const json_value_t *values);
+uint16_t packAddTime(uint8_t *payload, uint16_t len, uint16_t size, uint32_t time);
+int8_t packFormat(const char *name);
+
+#endif /* INCLUDE_PACKWRITER_H_ */
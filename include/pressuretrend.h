@@ -0,0 +1,58 @@
+/**
+ *  @filename   :   pressuretrend.h
+ *  @brief      :   ESP32 Weather Base Station Pressure Trend
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef INCLUDE_PRESSURETREND_H_
+#define INCLUDE_PRESSURETREND_H_
+
+#include <Arduino.h>
+#include "weatherbase.h"
+
+/*
+ * The primary station's pressure over the last TREND_WINDOW_SECS, kept in a
+ * ring as it comes in, for the barometer's rising and falling arrow. The
+ * sums of a least squares fit are kept as samples enter and leave the
+ * window, so the mean and the slope cost the same however many samples
+ * there are. Samples are timed on timeMicros(), so a clock step does not
+ * bend the line, back to when they were taken rather than when they came in,
+ * as a batched frame brings in up to WIRE_MAX_SAMPLES of different ages.
+ *
+ * The ring starts empty after a restart, and there is no trend until the
+ * samples span TREND_MIN_SECS.
+ */
+#define TREND_SAMPLES 256           // Three hours at one a minute, with room to spare
+#define TREND_WINDOW_SECS 10800     // 3 hours, the standard pressure tendency
+#define TREND_MIN_SECS 1800
+#define TREND_STEADY_INHG 0.015     // A slope under this, per 3 hours, is steady. About 0.5 hPa.
+#define TREND_REBASE_SECS 10800     // How often the sums are worked out again from the ring
+
+typedef struct pressure_trend_t {
+  uint16_t samples;
+  float mean;                       // Inches of mercury
+  float slope;                      // Inches of mercury per 3 hours
+} pressure_trend_t;
+
+void initPressureTrend(void);
+void pressureTrendAdd(const sensor_data_t *data, int64_t sampleMicros);
+bool pressureTrend(pressure_trend_t *trend);
+
+#endif /* INCLUDE_PRESSURETREND_H_ */
@@ -0,0 +1,85 @@
+/**
+ *  @filename   :   rollup.h
+ *  @brief      :   ESP32 Weather Base Station Per Station Rollups
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef INCLUDE_ROLLUP_H_
+#define INCLUDE_ROLLUP_H_
+
+#include <Arduino.h>
+#include <time.h>
+#include "weatherbase.h"
+#include "stations.h"
+
+/*
+ * Every sample is folded into a rollup for each window, per station. Windows
+ * line up with the clock (a 300 second window starts on the 5 minutes), and
+ * are published when a sample for the next window turns up, or
+ * ROLLUP_GRACE_SECS after they end if the station has gone quiet. Samples
+ * for a window already published are counted as late and left out.
+ *
+ * A rollup goes to <station topic>/rollup/<window secs> as
+ *
+ *   {"start":<secs>,"window":300,"count":5,"min_temperature":17.9,...}
+ *
+ * with <aggregate>_<field> for each aggregate the metric has switched on in
+ * rollup.cpp. Like the raw readings, rollups taken while the broker is down
+ * go to the outbox.
+ */
+#define ROLLUP_OFF 0
+#define ROLLUP_ALONGSIDE 1          // Raw readings and rollups
+#define ROLLUP_INSTEAD 2            // Rollups, and raw readings from the primary only
+
+// Alongside adds to the broker traffic rather than cutting it, while
+// consumers move over to the rollup topics. The queries and the history fill
+// read the primary's raw readings from station, and two_year.hourly_rollup is
+// made from them, so Instead still publishes those. The direct InfluxDB
+// writer always gets every raw reading. Only the other stations' raw
+// readings stop.
+#ifndef ROLLUP_MODE
+#define ROLLUP_MODE ROLLUP_ALONGSIDE
+#endif
+
+// A window no longer than the time between a station's readings holds one
+// sample, and costs as much as publishing it raw
+#define ROLLUP_WINDOWS {300}        // Seconds, each must divide a day
+#define ROLLUP_WINDOW_COUNT 1
+#define ROLLUP_GRACE_SECS 10        // Wait for samples from batched frames
+
+#define ROLLUP_MIN 0x01
+#define ROLLUP_MAX 0x02
+#define ROLLUP_MEAN 0x04
+#define ROLLUP_LAST 0x08
+#define ROLLUP_SUM 0x10
+#define ROLLUP_AGGREGATES 5
+
+typedef struct rollup_stats_t {
+  uint32_t samples;
+  uint32_t published;
+  uint32_t late;
+  uint32_t failed;                  // Thrown away by the publish
+} rollup_stats_t;
+
+void rollupAdd(const station_t *station, const sensor_data_t *data, time_t sampleTime);
+void rollupLoop(void);
+void getRollupStats(rollup_stats_t *stats);
+
+#endif /* INCLUDE_ROLLUP_H_ */
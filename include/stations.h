@@ -0,0 +1,87 @@
+/**
+ *  @filename   :   stations.h
+ *  @brief      :   ESP32 Weather Base Station Remote Station Registry
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef INCLUDE_STATIONS_H_
+#define INCLUDE_STATIONS_H_
+
+#include <Arduino.h>
+#include "weatherbase.h"
+#include "wifiwithmqtt.h"
+
+#define MAX_STATIONS 32
+#define STATION_HASH_SIZE 64        // Power of two, at least twice MAX_STATIONS
+#define STATION_STALE_MS 300000     // 5 minutes
+#define STATION_TOPIC_LENGTH (MQTT_TOPIC_LENGTH + 8)
+#define STATION_SEQ_WINDOW 64       // Bits in the duplicate window
+#define STATION_SEQ_MAX_GAP 1024    // Anything further away is a station restart
+
+#define SEQ_NEW 0
+#define SEQ_DUPLICATE 1
+#define SEQ_REORDERED 2
+
+// The primary station is the one whose MAC is in the config. It is the one
+// shown on the display and it keeps publishing on the configured topic, every
+// other station publishes on <topic>/<last 3 bytes of its MAC>. With none
+// configured, the first station heard, in any frame format, is made the
+// primary and saved in the config, so a restart does not hand the topic and
+// the display to another.
+
+typedef struct station_t {
+  uint8_t index;
+  uint8_t mac[6];
+  uint16_t stationId;               // From the frame header, 0 for legacy frames
+  bool primary;
+  char topic[STATION_TOPIC_LENGTH];
+  sensor_data_t latest;
+  bool stale;
+
+  int64_t lastRxMicros;
+  uint32_t lastRxMillis;
+  uint32_t frames;
+  float lastInterval;               // Seconds between the last two frames
+  float meanInterval;
+  float minInterval;
+  float maxInterval;
+
+  // Sequence tracking, only for frames that carry a header
+  bool seqValid;
+  uint16_t highestSeq;
+  uint64_t seqWindow;               // Bit n set if highestSeq - n has been seen
+  uint32_t seqReceived;
+  uint32_t seqLost;
+  uint32_t seqDuplicates;
+  uint32_t seqReordered;
+  uint32_t seqRestarts;
+} station_t;
+
+station_t *stationLookup(const uint8_t *mac, bool create);
+station_t *stationGet(uint8_t index);
+uint8_t stationCount(void);
+bool stationAdoptPrimary(station_t *station);
+uint8_t stationCheckSequence(station_t *station, uint16_t sequence, bool restart);
+float stationLossRate(const station_t *station);
+void stationUpdate(station_t *station, const sensor_data_t *data, int64_t rxMicros);
+void stationsCheckStale(void (*staleCallback)(const station_t *station));
+void stationMacString(const station_t *station, char *buffer);
+
+#endif /* INCLUDE_STATIONS_H_ */
@@ -0,0 +1,33 @@
+/**
+ *  @filename   :   stats.h
+ *  @brief      :   ESP32 Weather Base Station Runtime Statistics
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef INCLUDE_STATS_H_
+#define INCLUDE_STATS_H_
+
+#define STATS_INTERVAL_MS 300000   // 5 minutes
+
+void initStats(void);
+void statsLoop(void);
+void publishAllStats(void);
+
+#endif /* INCLUDE_STATS_H_ */
@@ -0,0 +1,94 @@
+/**
+ *  @filename   :   tasks.h
+ *  @brief      :   ESP32 Weather Base Station FreeRTOS Tasks
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef INCLUDE_TASKS_H_
+#define INCLUDE_TASKS_H_
+
+#include <Arduino.h>
+#include "weatherbase.h"
+
+// Network and queries share core 0 with the WiFi stack, the display gets core 1
+#define NETWORK_CORE 0
+#define QUERY_CORE 0
+#define DISPLAY_CORE 1
+
+#define NETWORK_STACK 8192
+#define QUERY_STACK 8192
+#define DISPLAY_STACK 8192
+
+#define NETWORK_PRIORITY 2
+#define QUERY_PRIORITY 1
+#define DISPLAY_PRIORITY 1
+
+#define DISPLAY_QUEUE_DEPTH 8
+#define QUERY_QUEUE_DEPTH 4
+#define QUERY_IDLE_MS 1000          // Quiet time before the query task does idle work
+
+#define TASK_NETWORK 0
+#define TASK_QUERY 1
+#define TASK_DISPLAY 2
+#define TASK_COUNT 3
+
+#define DISPLAY_MSG_DATA 0
+#define DISPLAY_MSG_ERROR 1
+#define DISPLAY_MSG_MIDNIGHT 2
+#define DISPLAY_MSG_STALE 3         // error holds the MAC, blank for the primary station
+
+#define DISPLAY_ERROR_LENGTH 70
+
+typedef struct display_msg_t {
+  uint8_t type;
+  sensor_data_t data;
+  float roomTemp;
+  float roomHum;
+  char error[DISPLAY_ERROR_LENGTH];
+} display_msg_t;
+
+typedef int (*query_fn_t)(void *arg);
+
+typedef struct task_stats_t {
+  const char *name;
+  uint32_t loops;
+  uint32_t stackFree;               // Bytes never used since the task started
+  uint32_t maxLatencyUs;            // Longest single pass through the task loop
+  uint32_t meanLatencyUs;
+  uint32_t queueDropped;
+  uint16_t queueHighWater;
+} task_stats_t;
+
+void initTasks(void);
+void startTasks(void);
+bool onDisplayTask(void);
+bool postDisplayData(const sensor_data_t *data, float roomTemp, float roomHum);
+bool postDisplayError(const char *errStr);
+bool postDisplayMidnight(void);
+bool postDisplayStale(const char *mac);
+int queryRun(query_fn_t fn, void *arg);
+bool queryPost(query_fn_t fn, void *arg);
+void getTaskStats(uint8_t task, task_stats_t *stats);
+
+#ifdef NATIVE_BUILD
+void runTasksOnce(void);
+#endif
+
+#endif /* INCLUDE_TASKS_H_ */
@@ -0,0 +1,73 @@
+/**
+ *  @filename   :   timekeeper.h
+ *  @brief      :   ESP32 Weather Base Station Time Service
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef INCLUDE_TIMEKEEPER_H_
+#define INCLUDE_TIMEKEEPER_H_
+
+#include <Arduino.h>
+#include <time.h>
+
+/*
+ * The one place the rest of the base station gets the time from. initTime()
+ * starts SNTP, and nothing waits for it after that: until SNTP has set the
+ * clock timeValid() is false, timeNow() is 0 and timeLocal() fails straight
+ * away, where getLocalTime() would wait. Once the clock is set that is
+ * remembered. Local time uses the fixed GMT_OFFSET_SECS and
+ * DAYLIGHT_OFFSET_SECS, so every module agrees on when a local day starts.
+ *
+ * timeMicros() counts from boot and never steps, for intervals and
+ * latencies. timeEpochMicros() is the wall clock, for stamping samples.
+ *
+ * timeLoop() runs on the network task. It calls the timeOnMidnight()
+ * handlers when the local day changes, and the timeOnStep() handlers when
+ * the wall clock moves more than TIME_STEP_SECS away from timeMicros(), from
+ * SNTP correcting it or by hand. Handlers run on the network task.
+ */
+#define TIME_MIN_EPOCH 1577836800   // 2020-01-01, anything earlier is before SNTP
+#define TIME_STEP_SECS 120
+#define TIME_HANDLERS 4             // Of each kind
+#define TIME_NTP_SERVER "pool.ntp.org"
+
+typedef void (*time_handler_t)(uint32_t now);
+
+typedef struct time_stats_t {
+  uint32_t syncMs;                  // millis() when SNTP first set the clock, 0 if not yet
+  uint32_t steps;
+  uint32_t midnights;
+} time_stats_t;
+
+void initTime(void);
+bool timeValid(void);
+uint32_t timeNow(void);
+int64_t timeMicros(void);
+int64_t timeEpochMicros(void);
+bool timeLocal(struct tm *dt);
+uint32_t timeLocalDay(uint32_t t);
+uint32_t timeDayStart(uint32_t day);
+uint16_t timeMinutesToday(void);
+bool timeOnMidnight(time_handler_t handler);
+bool timeOnStep(time_handler_t handler);
+void timeLoop(void);
+void getTimeStats(time_stats_t *stats);
+
+#endif /* INCLUDE_TIMEKEEPER_H_ */
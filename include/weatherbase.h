@@ -24,12 +24,17 @@
 #ifndef INCLUDE_WEATHERBASE_H_
 #define INCLUDE_WEATHERBASE_H_
 
+#include <math.h>
+
 //#define DEV_MODE true
 #define STATION_NAME "WeatherBase"
 
 #define GMT_OFFSET_SECS -18000
 #define DAYLIGHT_OFFSET_SECS 3600
 
+#define STATION_ALTITUDE 138.0      // Metres, for the sea level pressure
+#define RAIN_INCHES_PER_COUNT 0.011 // Rain gauge bucket tip, as the bridge converts it
+
 #define ARDUINOJSON_USE_DOUBLE 1
 
 typedef struct __attribute__((packed)) sensor_data_t {
@@ -43,5 +48,21 @@ typedef struct __attribute__((packed)) sensor_data_t {
     float rain;
 } sensor_data_t;
 
+// Station pressure in Pascals to sea level inches of mercury
+inline float seaLevelInHg(int32_t pressure) {
+  return pressure / pow(1 - STATION_ALTITUDE / 44330.0, 5.255) / 3386.39;
+}
+
+// The station and room sensor report Celsius and rain gauge counts, InfluxDB
+// holds Fahrenheit and inches
+inline float fahrenheit(float celsius) {
+  return 9.0 / 5.0 * celsius + 32.0;
+}
+
+inline float rainInches(float count) {
+  return count * RAIN_INCHES_PER_COUNT;
+}
+
 void otaSetup(void);
+void networkLoop(void);
 #endif /* INCLUDE_WEATHERBASE_H_ */
\ No newline at end of file
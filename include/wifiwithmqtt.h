@@ -24,30 +24,76 @@
 #ifndef INCLUDE_WIFIWITHMQTT_H_
 #define INCLUDE_WIFIWITHMQTT_H_
 
+#include "jsonwriter.h"
+#include "packwriter.h"
+
 #define MQTT_SERVER_LENGTH 30
 #define MQTT_TOPIC_LENGTH 40
+#define MQTT_MAC_LENGTH 18          // aa:bb:cc:dd:ee:ff
+#define MQTT_FORMAT_LENGTH 8        // json, cbor or msgpack
 
 
 #define CONFIG_BUTTON GPIO_NUM_0
 #define LOG_TOPIC "log"
+#define STATS_TOPIC "stats"
+
+#define MQTT_BUFFER_SIZE 512        // Largest message, topic and header included
+#define MQTT_CONNECT_TIMEOUT_MS 1000 // TCP connect to the broker
+#define MQTT_SOCKET_TIMEOUT 2       // Seconds to wait for CONNACK
+#define MQTT_BACKOFF_MIN_MS 1000
+#define MQTT_BACKOFF_MAX_MS 60000
+#define MQTT_QUEUE_SIZE 4096        // Bytes held while the broker is unreachable
+#define MQTT_DRAIN_PER_LOOP 8       // Queued messages sent per mqttLoop()
+
+// Readings and room data can go out as CBOR or MessagePack, see packwriter.h.
+// The format configured applies to everything under the MQTT topic, and a
+// topic keeps its format when the reading is queued or sent from the outbox.
+#ifndef MQTT_PAYLOAD_FORMAT
+#define MQTT_PAYLOAD_FORMAT PAYLOAD_JSON
+#endif
+#define MQTT_PAYLOAD_RULES 4        // Per topic overrides
+#define MQTT_PAYLOAD_PREFIX_LENGTH (MQTT_TOPIC_LENGTH + 8)
 
 struct mqttConfig {
   uint32_t valid;
   char server[MQTT_SERVER_LENGTH];
   uint16_t port;
   char topic[MQTT_TOPIC_LENGTH]; 
+  char primary[MQTT_MAC_LENGTH];    // MAC of the primary station, blank for the first one heard
+  char format[MQTT_FORMAT_LENGTH];  // Of the readings, blank for MQTT_PAYLOAD_FORMAT
 };
 
+typedef struct mqtt_stats_t {
+  bool connected;
+  uint32_t connectAttempts;
+  uint32_t connectFailures;
+  uint32_t disconnects;
+  uint32_t disconnectedMs;          // Total, including the current outage
+  uint32_t backoffMs;               // Wait before the next attempt
+  uint16_t queuedMessages;
+  uint16_t queuedBytes;
+  uint16_t queueHighWater;          // Bytes
+  uint32_t queueDropped;            // Oldest messages pushed out by a full queue
+  uint32_t publishFailed;           // Rejected by a connected client, not retried
+} mqtt_stats_t;
+
 ICACHE_RAM_ATTR void longPress(void);
 void callWFM(bool);
 void readEEPROM(void);
+void savePrimaryStation(const char *mac);
 void initializeWifiWithMQTT(void);
-boolean publishData(uint8_t reason, float temperature, int32_t pressure, float humidity, float battery_millivolts, uint16_t direction, float anemometer, float rain);
+boolean publishData(const char *topic, time_t sampleTime, uint8_t reason, float temperature, int32_t pressure, float humidity, float battery_millivolts, uint16_t direction, float anemometer, float rain);
 void initMQTT();
 void disconnectMQTT();
 void publishRoomStats(float temp, float hum);
 void mqttLoop(void);
-void logMessage(const char *system, const char* message);
+boolean logMessage(uint8_t level, const char *system, const char* message, uint16_t repeated, uint16_t suppressed);
+void publishStats(const char *payload);
+boolean publishNow(const char *topic, const uint8_t *payload, uint16_t len);
+boolean publishReadingValues(const char *topic, const json_schema_t *schema, const json_value_t *values, time_t sampleTime);
+boolean mqttConnected(void);
+bool setPayloadFormat(const char *prefix, uint8_t format);
+void getMQTTStats(mqtt_stats_t *stats);
 
 
 #endif /* INCLUDE_WIFIWITHMQTT_H_ */
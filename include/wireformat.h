@@ -0,0 +1,93 @@
+/**
+ *  @filename   :   wireformat.h
+ *  @brief      :   ESP32 Weather Base Station ESP-NOW Wire Format
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef INCLUDE_WIREFORMAT_H_
+#define INCLUDE_WIREFORMAT_H_
+
+#include <Arduino.h>
+#include "weatherbase.h"
+
+/*
+ * Version 1 frame, all fields little endian
+ *
+ *   header   magic(1) version(1) station id(2) sequence(2) count(1) flags(1)
+ *   samples  count samples, oldest first
+ *
+ * A full sample is 17 bytes of fixed point values
+ *
+ *   age(2) reason(1) temperature(2) pressure(2) humidity(2) battery(2)
+ *   direction(2) wind(2) rain(2)
+ *
+ * If the top bit of age is set, the sample is delta encoded against the one
+ * before it, and every value after reason is a signed byte (10 bytes total).
+ * age is the number of seconds before transmission the sample was taken.
+ *
+ * Senders set WIRE_FLAG_RESTART on the first frame after a power up, so the
+ * sequence number restarting is not taken for a run of duplicates.
+ *
+ * Anything that is exactly sizeof(sensor_data_t) long and does not start with
+ * WIRE_MAGIC is treated as the original packed sensor_data_t struct.
+ */
+#define WIRE_MAGIC 0xB5
+#define WIRE_VERSION 1
+#define WIRE_MAX_FRAME 250
+
+#define WIRE_HEADER_LEN 8
+#define WIRE_SAMPLE_LEN 17
+#define WIRE_DELTA_SAMPLE_LEN 10
+#define WIRE_AGE_DELTA 0x8000
+#define WIRE_FLAG_RESTART 0x01
+#define WIRE_MAX_SAMPLES ((WIRE_MAX_FRAME - WIRE_HEADER_LEN) / WIRE_DELTA_SAMPLE_LEN)
+
+#define WIRE_TEMP_SCALE 100.0       // 0.01 C
+#define WIRE_PRESSURE_OFFSET 50000  // Pa
+#define WIRE_HUM_SCALE 100.0        // 0.01 %
+#define WIRE_WIND_SCALE 100.0
+#define WIRE_RAIN_SCALE 1000.0
+
+typedef struct __attribute__((packed)) wire_header_t {
+  uint8_t magic;
+  uint8_t version;
+  uint16_t stationId;
+  uint16_t sequence;
+  uint8_t count;
+  uint8_t flags;
+} wire_header_t;
+
+// Decodes straight out of the receive buffer, the frame must stay valid while
+// the reader is in use
+typedef struct wire_reader_t {
+  const uint8_t *data;
+  uint8_t len;
+  uint8_t offset;
+  uint8_t remaining;
+  bool legacy;
+  const wire_header_t *header;      // NULL for legacy frames
+  int32_t prev[7];                  // Fixed point values of the previous sample
+} wire_reader_t;
+
+bool wireReaderInit(wire_reader_t *reader, const uint8_t *data, uint8_t len);
+bool wireNextSample(wire_reader_t *reader, sensor_data_t *sample, uint16_t *age);
+uint8_t wireEncode(uint8_t *buffer, uint16_t stationId, uint16_t sequence, const sensor_data_t *samples, const uint16_t *ages, uint8_t count, uint8_t flags, bool delta);
+
+#endif /* INCLUDE_WIREFORMAT_H_ */
@@ -0,0 +1,40 @@
+/**
+ *  @filename   :   Adafruit_GFX.h
+ *  @brief      :   ESP32 Weather Base Station native build, Adafruit GFX shim
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef NATIVE_ADAFRUIT_GFX_H_
+#define NATIVE_ADAFRUIT_GFX_H_
+
+#include <Arduino.h>
+
+class Adafruit_GFX : public Print {
+  public:
+    Adafruit_GFX(int16_t w, int16_t h) : width(w), height(h) {}
+    size_t write(uint8_t c) override { simCounters.displayOps++; simChargeNanos(SIM_DISPLAY_OP_NS); return 1; }
+    using Print::write;
+
+  protected:
+    int16_t width;
+    int16_t height;
+};
+
+#endif /* NATIVE_ADAFRUIT_GFX_H_ */
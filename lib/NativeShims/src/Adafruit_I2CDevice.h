@@ -0,0 +1,30 @@
+/**
+ *  @filename   :   Adafruit_I2CDevice.h
+ *  @brief      :   ESP32 Weather Base Station native build, Adafruit I2C device shim
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef NATIVE_ADAFRUIT_I2CDEVICE_H_
+#define NATIVE_ADAFRUIT_I2CDEVICE_H_
+
+class Adafruit_I2CDevice {
+};
+
+#endif /* NATIVE_ADAFRUIT_I2CDEVICE_H_ */
@@ -0,0 +1,92 @@
+/**
+ *  @filename   :   Adafruit_RA8875.h
+ *  @brief      :   ESP32 Weather Base Station native build, RA8875 display shim
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef NATIVE_ADAFRUIT_RA8875_H_
+#define NATIVE_ADAFRUIT_RA8875_H_
+
+#include <Arduino.h>
+#include "Adafruit_GFX.h"
+
+#define RA8875_800x480 3
+
+#define RA8875_DATAWRITE 0x00
+#define RA8875_DATAREAD 0x40
+#define RA8875_CMDWRITE 0x80
+#define RA8875_CMDREAD 0xC0
+#define RA8875_MRWC 0x02
+#define RA8875_PWM_CLK_DIV1024 0x0A
+
+#define RA8875_BLACK 0x0000
+#define RA8875_BLUE 0x001F
+#define RA8875_RED 0xF800
+#define RA8875_GREEN 0x07E0
+#define RA8875_CYAN 0x07FF
+#define RA8875_MAGENTA 0xF81F
+#define RA8875_YELLOW 0xFFE0
+#define RA8875_WHITE 0xFFFF
+
+// Every call is counted in simCounters.displayOps and charged as one register
+// access, so the render cost of a change shows up without a panel attached
+class Adafruit_RA8875 : public Adafruit_GFX {
+  public:
+    Adafruit_RA8875(uint8_t cs, uint8_t rst) : Adafruit_GFX(800, 480) {}
+
+    bool begin(uint8_t size) { return true; }
+    void displayOn(bool on) { op(); }
+    void GPIOX(bool on) { op(); }
+    void PWM1config(bool on, uint8_t clock) { op(); }
+    void PWM1out(uint8_t p) { op(); }
+
+    void graphicsMode() { op(); }
+    void textMode() { op(); }
+    void textSetCursor(uint16_t x, uint16_t y) { op(); }
+    void textColor(uint16_t foreColor, uint16_t bgColor) { op(); }
+    void textTransparent(uint16_t foreColor) { op(); }
+    void textEnlarge(uint8_t scale) { op(); }
+    void textWrite(const char *buffer, uint16_t len = 0) { op(); }
+
+    void fillScreen(uint16_t color) { op(); }
+    void drawPixel(int16_t x, int16_t y, uint16_t color) { op(); }
+    void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) { op(); }
+    void drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) { op(); }
+    void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) { op(); }
+    void drawCircle(int16_t x, int16_t y, int16_t r, uint16_t color) { op(); }
+    void fillCircle(int16_t x, int16_t y, int16_t r, uint16_t color) { op(); }
+    void drawTriangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint16_t color) { op(); }
+    void fillTriangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint16_t color) { op(); }
+    void drawRoundRect(int16_t x, int16_t y, int16_t w, int16_t h, int16_t r, uint16_t color) { op(); }
+    void fillRoundRect(int16_t x, int16_t y, int16_t w, int16_t h, int16_t r, uint16_t color) { op(); }
+    void drawCurve(int16_t xCenter, int16_t yCenter, int16_t longAxis, int16_t shortAxis, uint8_t curvePart, uint16_t color) { op(); }
+    void fillCurve(int16_t xCenter, int16_t yCenter, int16_t longAxis, int16_t shortAxis, uint8_t curvePart, uint16_t color) { op(); }
+
+    void writeReg(uint8_t reg, uint8_t val) { op(); }
+    uint8_t readReg(uint8_t reg) { op(); return 0; }
+    void writeData(uint8_t d) { op(); }
+    uint8_t readData() { op(); return 0; }
+    void writeCommand(uint8_t d) { op(); }
+
+  private:
+    void op() { simCounters.displayOps++; simChargeNanos(SIM_DISPLAY_OP_NS); }
+};
+
+#endif /* NATIVE_ADAFRUIT_RA8875_H_ */
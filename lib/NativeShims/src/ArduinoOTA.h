@@ -0,0 +1,60 @@
+/**
+ *  @filename   :   ArduinoOTA.h
+ *  @brief      :   ESP32 Weather Base Station native build, OTA shim
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef NATIVE_ARDUINOOTA_H_
+#define NATIVE_ARDUINOOTA_H_
+
+#include <Arduino.h>
+#include <functional>
+
+#define U_FLASH 0
+#define U_SPIFFS 100
+
+typedef enum {
+  OTA_AUTH_ERROR,
+  OTA_BEGIN_ERROR,
+  OTA_CONNECT_ERROR,
+  OTA_RECEIVE_ERROR,
+  OTA_END_ERROR
+} ota_error_t;
+
+class ArduinoOTAClass {
+  public:
+    typedef std::function<void(void)> THandlerFunction;
+    typedef std::function<void(ota_error_t)> THandlerFunction_Error;
+    typedef std::function<void(unsigned int, unsigned int)> THandlerFunction_Progress;
+
+    ArduinoOTAClass &setPort(uint16_t port) { return *this; }
+    ArduinoOTAClass &setHostname(const char *hostname) { return *this; }
+    ArduinoOTAClass &onStart(THandlerFunction fn) { return *this; }
+    ArduinoOTAClass &onEnd(THandlerFunction fn) { return *this; }
+    ArduinoOTAClass &onError(THandlerFunction_Error fn) { return *this; }
+    ArduinoOTAClass &onProgress(THandlerFunction_Progress fn) { return *this; }
+    void begin() {}
+    void handle() {}
+    int getCommand() { return U_FLASH; }
+};
+
+extern ArduinoOTAClass ArduinoOTA;
+
+#endif /* NATIVE_ARDUINOOTA_H_ */
@@ -0,0 +1,46 @@
+/**
+ *  @filename   :   EEPROM.h
+ *  @brief      :   ESP32 Weather Base Station native build, EEPROM shim
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef NATIVE_EEPROM_H_
+#define NATIVE_EEPROM_H_
+
+#include <Arduino.h>
+
+#define NATIVE_EEPROM_SIZE 4096
+
+// Starts out holding a valid MQTT configuration for localhost, see native_main.cpp
+class EEPROMClass {
+  public:
+    bool begin(size_t size) { return size <= NATIVE_EEPROM_SIZE; }
+    bool commit() { return true; }
+    uint8_t read(int address) { return data[address]; }
+    void write(int address, uint8_t value) { data[address] = value; }
+    template<typename T> T &get(int address, T &t) { memcpy(&t, &data[address], sizeof(T)); return t; }
+    template<typename T> const T &put(int address, const T &t) { memcpy(&data[address], &t, sizeof(T)); return t; }
+
+    uint8_t data[NATIVE_EEPROM_SIZE];
+};
+
+extern EEPROMClass EEPROM;
+
+#endif /* NATIVE_EEPROM_H_ */
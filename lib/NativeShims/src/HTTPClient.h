@@ -0,0 +1,100 @@
+/**
+ *  @filename   :   HTTPClient.h
+ *  @brief      :   ESP32 Weather Base Station native build, HTTPClient shim
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef NATIVE_HTTPCLIENT_H_
+#define NATIVE_HTTPCLIENT_H_
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <string>
+
+#define HTTP_CODE_OK 200
+#define HTTP_CODE_NO_CONTENT 204
+#define HTTP_CODE_BAD_REQUEST 400
+
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+#define HTTPC_ERROR_SEND_HEADER_FAILED (-2)
+#define HTTPC_ERROR_SEND_PAYLOAD_FAILED (-3)
+#define HTTPC_ERROR_NOT_CONNECTED (-4)
+#define HTTPC_ERROR_CONNECTION_LOST (-5)
+#define HTTPC_ERROR_NO_STREAM (-6)
+#define HTTPC_ERROR_NO_HTTP_SERVER (-7)
+#define HTTPC_ERROR_TOO_LESS_RAM (-8)
+#define HTTPC_ERROR_ENCODING (-9)
+#define HTTPC_ERROR_STREAM_WRITE (-10)
+#define HTTPC_ERROR_READ_TIMEOUT (-11)
+
+// Stands in for InfluxDB on port 8086. A /query answers every statement in
+// the q parameter with one value, in CSV if it was asked for, or with an hourly series, one document per
+// chunk, when it asks for chunked=true. A /write is accepted with 204. Each
+// request costs simHttpLatencyMs() of simulated time, and one that has to
+// open a connection first costs that again. As on the ESP32, a connection is
+// kept after end() when reuse is on and the response was HTTP/1.1, and closed
+// when the HTTPClient goes away.
+class HTTPClient {
+  public:
+    ~HTTPClient() { connection()->stop(); }
+
+    bool begin(const char *url) { this->url = url; return true; }
+    bool begin(const String &url) { return begin(url.c_str()); }
+    bool begin(WiFiClient &client, const char *url) { this->client = &client; return begin(url); }
+    bool begin(WiFiClient &client, const String &url) { return begin(client, url.c_str()); }
+    bool begin(WiFiClient &client, const String &host, uint16_t port, const String &uri) {
+      return begin(client, (String("http://") + host + ":" + String(port) + uri).c_str());
+    }
+    void end();
+
+    void setReuse(bool reuse) { this->reuse = reuse; }
+    void useHTTP10(bool http10) { this->http10 = http10; }
+    void setTimeout(uint16_t timeout) {}
+    void setConnectTimeout(int32_t timeout) {}
+    void addHeader(const String &name, const String &value) {
+      headers += std::string(name.c_str()) + ": " + value.c_str() + "\r\n";
+    }
+    bool connected() { return connection()->connected(); }
+
+    int GET();
+    int POST(const uint8_t *payload, size_t size);
+    int POST(const String &payload) { return POST((const uint8_t *)payload.c_str(), payload.length()); }
+
+    int getSize() { return response.size(); }
+    String getString() { return String(response); }
+    WiFiClient &getStream();
+    WiFiClient *getStreamPtr() { return &getStream(); }
+    int writeToStream(Stream *stream) { return stream->write((const uint8_t *)response.data(), response.size()); }
+    static String errorToString(int error);
+
+  private:
+    int request(bool post, size_t size);
+    WiFiClient *connection() { return (client != NULL) ? client : &ownClient; }
+
+    std::string url;
+    std::string headers;
+    std::string response;
+    WiFiClient ownClient;
+    WiFiClient *client = NULL;
+    bool reuse = true;
+    bool http10 = false;
+};
+
+#endif /* NATIVE_HTTPCLIENT_H_ */
@@ -0,0 +1,41 @@
+/**
+ *  @filename   :   HTU21D.h
+ *  @brief      :   ESP32 Weather Base Station native build, HTU21D room sensor shim
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef NATIVE_HTU21D_H_
+#define NATIVE_HTU21D_H_
+
+#include <Arduino.h>
+#include <Wire.h>
+
+#define HTU21D_RES_RH12_TEMP14 0x02
+
+// Reads back a slow daily cycle on the simulated clock
+class HTU21D {
+  public:
+    HTU21D(uint8_t resolution = HTU21D_RES_RH12_TEMP14) {}
+    bool begin() { return true; }
+    float readTemperature();
+    float readCompensatedHumidity();
+};
+
+#endif /* NATIVE_HTU21D_H_ */
@@ -0,0 +1,87 @@
+/**
+ *  @filename   :   PubSubClient.h
+ *  @brief      :   ESP32 Weather Base Station native build, PubSubClient shim
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef NATIVE_PUBSUBCLIENT_H_
+#define NATIVE_PUBSUBCLIENT_H_
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <functional>
+
+#define MQTT_MAX_PACKET_SIZE 256
+
+#define MQTT_CONNECTION_TIMEOUT -4
+#define MQTT_CONNECTION_LOST -3
+#define MQTT_CONNECT_FAILED -2
+#define MQTT_DISCONNECTED -1
+#define MQTT_CONNECTED 0
+
+#define MQTT_CALLBACK_SIGNATURE std::function<void(char *, uint8_t *, unsigned int)> callback
+
+// Connects whenever simNetworkUp() is true. Published messages are counted in
+// simCounters and passed to simMqttPublishHook if one is set.
+class PubSubClient : public Print {
+  public:
+    PubSubClient() {}
+    PubSubClient(Client &client) {}
+
+    PubSubClient &setServer(const char *domain, uint16_t port) { return *this; }
+    PubSubClient &setServer(IPAddress ip, uint16_t port) { return *this; }
+    PubSubClient &setCallback(MQTT_CALLBACK_SIGNATURE) { this->callback = callback; return *this; }
+    PubSubClient &setClient(Client &client) { return *this; }
+    PubSubClient &setKeepAlive(uint16_t keepAlive) { return *this; }
+    PubSubClient &setSocketTimeout(uint16_t timeout) { return *this; }
+    bool setBufferSize(uint16_t size) { bufferSize = size; return true; }
+    uint16_t getBufferSize() { return bufferSize; }
+
+    bool connect(const char *id);
+    void disconnect();
+    bool connected();
+    int state() { return mqttState; }
+    bool loop() { return connected(); }
+
+    bool publish(const char *topic, const char *payload) { return publish(topic, (const uint8_t *)payload, strlen(payload), false); }
+    bool publish(const char *topic, const char *payload, bool retained) { return publish(topic, (const uint8_t *)payload, strlen(payload), retained); }
+    bool publish(const char *topic, const uint8_t *payload, unsigned int length) { return publish(topic, payload, length, false); }
+    bool publish(const char *topic, const uint8_t *payload, unsigned int length, bool retained);
+
+    bool beginPublish(const char *topic, unsigned int length, bool retained);
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t *buffer, size_t size) override;
+    using Print::write;
+    int endPublish();
+
+    bool subscribe(const char *topic) { return connected(); }
+    bool unsubscribe(const char *topic) { return connected(); }
+
+  private:
+    MQTT_CALLBACK_SIGNATURE;
+    int mqttState = MQTT_DISCONNECTED;
+    uint16_t bufferSize = MQTT_MAX_PACKET_SIZE;
+
+    std::string pendingTopic;
+    std::string pendingPayload;
+    unsigned int pendingLength = 0;
+};
+
+#endif /* NATIVE_PUBSUBCLIENT_H_ */
@@ -0,0 +1,51 @@
+/**
+ *  @filename   :   SPI.h
+ *  @brief      :   ESP32 Weather Base Station native build, SPI shim
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef NATIVE_SPI_H_
+#define NATIVE_SPI_H_
+
+#include <Arduino.h>
+
+#define MSBFIRST 1
+#define LSBFIRST 0
+#define SPI_MODE0 0x00
+#define SPI_MODE3 0x03
+
+class SPISettings {
+  public:
+    SPISettings() {}
+    SPISettings(uint32_t clock, uint8_t bitOrder, uint8_t dataMode) {}
+};
+
+class SPIClass {
+  public:
+    void begin() {}
+    void beginTransaction(SPISettings settings) {}
+    void endTransaction() {}
+    uint8_t transfer(uint8_t data) { simCounters.displayBytes++; simChargeNanos(SIM_SPI_NS_PER_BYTE); return 0; }
+    void writeBytes(const uint8_t *data, uint32_t size) { simCounters.displayBytes += size; simChargeNanos(SIM_SPI_NS_PER_BYTE * size); }
+};
+
+extern SPIClass SPI;
+
+#endif /* NATIVE_SPI_H_ */
@@ -0,0 +1,44 @@
+/**
+ *  @filename   :   SPIFFS.h
+ *  @brief      :   ESP32 Weather Base Station native build, SPIFFS shim
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef NATIVE_SPIFFS_H_
+#define NATIVE_SPIFFS_H_
+
+#include "FS.h"
+
+namespace fs {
+
+class SPIFFSFS : public FS {
+  public:
+    bool begin(bool formatOnFail = false, const char *basePath = "/spiffs", uint8_t maxOpenFiles = 10, const char *partitionLabel = NULL) { return true; }
+    bool format();
+    size_t totalBytes() { return 0x30000; }
+    size_t usedBytes();
+    void end() {}
+};
+
+}
+
+extern fs::SPIFFSFS SPIFFS;
+
+#endif /* NATIVE_SPIFFS_H_ */
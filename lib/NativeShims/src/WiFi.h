@@ -0,0 +1,93 @@
+/**
+ *  @filename   :   WiFi.h
+ *  @brief      :   ESP32 Weather Base Station native build, WiFi shim
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef NATIVE_WIFI_H_
+#define NATIVE_WIFI_H_
+
+#include <Arduino.h>
+#include <string>
+
+#define WL_IDLE_STATUS 0
+#define WL_NO_SSID_AVAIL 1
+#define WL_CONNECTED 3
+#define WL_CONNECT_FAILED 4
+#define WL_CONNECTION_LOST 5
+#define WL_DISCONNECTED 6
+
+typedef enum {
+  WIFI_OFF = 0,
+  WIFI_STA,
+  WIFI_AP,
+  WIFI_AP_STA
+} wifi_mode_t;
+
+typedef int wl_status_t;
+
+// The link state follows simSetNetworkUp(), so the reconnect paths can be run
+class WiFiClass {
+  public:
+    bool mode(wifi_mode_t mode) { return true; }
+    wl_status_t begin() { return status(); }
+    wl_status_t begin(const char *ssid, const char *password = NULL) { return status(); }
+    bool disconnect(bool wifiOff = false) { return true; }
+    wl_status_t status() { return simNetworkUp() ? WL_CONNECTED : WL_DISCONNECTED; }
+    bool softAP(const char *ssid, const char *password = NULL, int channel = 1, int hidden = 0) { return true; }
+    IPAddress softAPIP() { return IPAddress(192, 168, 4, 1); }
+    IPAddress localIP() { return IPAddress(127, 0, 0, 1); }
+    String macAddress() { return String("24:0A:C4:00:00:01"); }
+    uint8_t channel() { return 3; }
+    void printDiag(Print &out) {}
+    int hostByName(const char *host, IPAddress &result);
+};
+
+extern WiFiClass WiFi;
+
+// Loopback client. Whatever is loaded with simLoad() is read back out, and
+// writes are counted and discarded.
+class WiFiClient : public Client {
+  public:
+    int connect(const char *host, uint16_t port);
+    int connect(IPAddress ip, uint16_t port);
+    int connect(const char *host, uint16_t port, int32_t timeout);
+    uint8_t connected() { return isConnected && simNetworkUp(); }
+    void stop() { isConnected = false; rx.clear(); rxPos = 0; }
+    operator bool() { return connected(); }
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t *buffer, size_t size) override;
+    int available() override { return rx.size() - rxPos; }
+    int read() override { return (rxPos < rx.size()) ? (uint8_t)rx[rxPos++] : -1; }
+    int peek() override { return (rxPos < rx.size()) ? (uint8_t)rx[rxPos] : -1; }
+    int read(uint8_t *buffer, size_t size);
+    void flush() {}
+    using Print::write;
+
+    void simLoad(const std::string &data) { rx = data; rxPos = 0; }
+
+  private:
+    bool isConnected = false;
+    std::string rx;
+    size_t rxPos = 0;
+};
+
+#endif /* NATIVE_WIFI_H_ */
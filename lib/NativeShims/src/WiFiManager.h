@@ -0,0 +1,53 @@
+/**
+ *  @filename   :   WiFiManager.h
+ *  @brief      :   ESP32 Weather Base Station native build, WiFiManager shim
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef NATIVE_WIFIMANAGER_H_
+#define NATIVE_WIFIMANAGER_H_
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+// There is no portal on the host, parameters keep the values they were given
+class WiFiManagerParameter {
+  public:
+    WiFiManagerParameter(const char *id, const char *label, const char *defaultValue, int length);
+    const char *getID() const { return id; }
+    const char *getValue() const { return value; }
+
+  private:
+    const char *id;
+    char value[64];
+};
+
+class WiFiManager {
+  public:
+    void setAPCallback(void (*callback)(WiFiManager *)) {}
+    void setShowPassword(bool show) {}
+    bool addParameter(WiFiManagerParameter *parameter) { return true; }
+    bool autoConnect() { return true; }
+    bool autoConnect(const char *ssid, const char *password = NULL) { return true; }
+    bool startConfigPortal() { return true; }
+    String getConfigPortalSSID() { return String("WeatherBase"); }
+};
+
+#endif /* NATIVE_WIFIMANAGER_H_ */
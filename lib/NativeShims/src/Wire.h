@@ -0,0 +1,44 @@
+/**
+ *  @filename   :   Wire.h
+ *  @brief      :   ESP32 Weather Base Station native build, I2C shim
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef NATIVE_WIRE_H_
+#define NATIVE_WIRE_H_
+
+#include <Arduino.h>
+
+// Nothing answers on the bus, so the touch controller never reports a touch
+class TwoWire {
+  public:
+    bool begin() { return true; }
+    void setClock(uint32_t frequency) {}
+    void beginTransmission(uint8_t address) {}
+    uint8_t endTransmission(bool sendStop = true) { return 0; }
+    uint8_t requestFrom(uint8_t address, int quantity) { return 0; }
+    size_t write(uint8_t data) { return 1; }
+    int available() { return 0; }
+    int read() { return -1; }
+};
+
+extern TwoWire Wire;
+
+#endif /* NATIVE_WIRE_H_ */
@@ -0,0 +1,49 @@
+/**
+ *  @filename   :   esp_wifi.h
+ *  @brief      :   ESP32 Weather Base Station native build, esp_wifi shim
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef NATIVE_ESP_WIFI_H_
+#define NATIVE_ESP_WIFI_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef int esp_err_t;
+
+#define ESP_OK 0
+#define ESP_FAIL -1
+
+typedef enum {
+  ESP_IF_WIFI_STA = 0,
+  ESP_IF_WIFI_AP
+} wifi_interface_t;
+
+typedef enum {
+  WIFI_SECOND_CHAN_NONE = 0,
+  WIFI_SECOND_CHAN_ABOVE,
+  WIFI_SECOND_CHAN_BELOW
+} wifi_second_chan_t;
+
+inline esp_err_t esp_wifi_set_promiscuous(bool enable) { return ESP_OK; }
+inline esp_err_t esp_wifi_set_channel(uint8_t primary, wifi_second_chan_t second) { return ESP_OK; }
+
+#endif /* NATIVE_ESP_WIFI_H_ */
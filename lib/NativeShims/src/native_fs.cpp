@@ -0,0 +1,189 @@
+/**
+ *  @filename   :   native_fs.cpp
+ *  @brief      :   ESP32 Weather Base Station native build, in-memory SPIFFS
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <Arduino.h>
+#include <FS.h>
+#include <SPIFFS.h>
+#include <map>
+
+#define SIM_FS_OPEN_NS 500000         // SPIFFS walks the object index on open
+#define SIM_FLASH_NS_PER_BYTE 200
+
+namespace fs {
+
+struct FileImpl {
+  std::string path;
+  bool append;
+  bool directory;
+  size_t pos;
+  std::vector<std::string> entries;   // Directory listing, taken at open
+  size_t next;
+};
+
+}
+
+fs::SPIFFSFS SPIFFS;
+
+static std::map<std::string, std::string> files;
+
+using fs::FileImpl;
+
+size_t fs::File::write(const uint8_t *buffer, size_t size) {
+  if(!impl || impl->directory)
+    return 0;
+
+  std::string &data = files[impl->path];
+  if(impl->append)
+    impl->pos = data.size();
+
+  if(impl->pos + size > data.size())
+    data.resize(impl->pos + size);
+  memcpy(&data[impl->pos], buffer, size);
+  impl->pos += size;
+
+  simChargeNanos(SIM_FLASH_NS_PER_BYTE * size);
+  return size;
+}
+
+int fs::File::available() {
+  if(!impl || impl->directory)
+    return 0;
+
+  return files[impl->path].size() - impl->pos;
+}
+
+int fs::File::read() {
+  uint8_t c;
+  return (read(&c, 1) == 1) ? c : -1;
+}
+
+int fs::File::peek() {
+  if(available() <= 0)
+    return -1;
+
+  return (uint8_t)files[impl->path][impl->pos];
+}
+
+size_t fs::File::read(uint8_t *buffer, size_t size) {
+  size_t n = std::min(size, (size_t)std::max(available(), 0));
+  if(n > 0) {
+    memcpy(buffer, files[impl->path].data() + impl->pos, n);
+    impl->pos += n;
+  }
+  return n;
+}
+
+bool fs::File::seek(uint32_t pos) {
+  if(!impl || (pos > size()))
+    return false;
+
+  impl->pos = pos;
+  return true;
+}
+
+size_t fs::File::position() const {
+  return impl ? impl->pos : 0;
+}
+
+size_t fs::File::size() const {
+  if(!impl || impl->directory)
+    return 0;
+
+  auto it = files.find(impl->path);
+  return (it == files.end()) ? 0 : it->second.size();
+}
+
+const char *fs::File::name() const {
+  return impl ? impl->path.c_str() : "";
+}
+
+bool fs::File::isDirectory() const {
+  return impl && impl->directory;
+}
+
+fs::File fs::File::openNextFile(const char *mode) {
+  if(!impl || !impl->directory || (impl->next >= impl->entries.size()))
+    return File();
+
+  return SPIFFS.open(impl->entries[impl->next++].c_str(), mode);
+}
+
+// SPIFFS is flat, "/" is the only directory
+fs::File fs::FS::open(const char *path, const char *mode) {
+  simChargeNanos(SIM_FS_OPEN_NS);
+
+  std::shared_ptr<FileImpl> impl = std::make_shared<FileImpl>();
+  impl->path = path;
+  impl->append = (mode[0] == 'a');
+  impl->directory = (strcmp(path, "/") == 0);
+  impl->pos = 0;
+  impl->next = 0;
+
+  if(impl->directory) {
+    for(auto &file : files)
+      impl->entries.push_back(file.first);
+    return File(impl);
+  }
+
+  if(mode[0] == 'r') {
+    if(files.find(path) == files.end())
+      return File();
+  } else if(mode[0] == 'w') {
+    files[path].clear();
+  } else {
+    files[path];
+  }
+
+  return File(impl);
+}
+
+bool fs::FS::exists(const char *path) {
+  return files.find(path) != files.end();
+}
+
+bool fs::FS::remove(const char *path) {
+  simChargeNanos(SIM_FS_OPEN_NS);
+  return files.erase(path) == 1;
+}
+
+bool fs::FS::rename(const char *from, const char *to) {
+  auto it = files.find(from);
+  if(it == files.end())
+    return false;
+
+  files[to] = it->second;
+  files.erase(from);
+  return true;
+}
+
+bool fs::SPIFFSFS::format() {
+  files.clear();
+  return true;
+}
+
+size_t fs::SPIFFSFS::usedBytes() {
+  size_t used = 0;
+  for(auto &file : files)
+    used += file.second.size();
+  return used;
+}
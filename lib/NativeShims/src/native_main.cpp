@@ -0,0 +1,478 @@
+/**
+ *  @filename   :   native_main.cpp
+ *  @brief      :   ESP32 Weather Base Station native build, host harness
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <esp_now.h>
+#include <chrono>
+#include <vector>
+#include "weatherbase.h"
+#include "wifiwithmqtt.h"
+#include "wireformat.h"
+#include "ingestqueue.h"
+#include "capture.h"
+#include "outbox.h"
+#include "logqueue.h"
+#include "influxwriter.h"
+#include "rollup.h"
+#include "history.h"
+#include "InfluxDbQueries.h"
+#include "influxclient.h"
+#include "timekeeper.h"
+#include "pressuretrend.h"
+#include "tasks.h"
+#include "packwriter.h"
+
+#define SIM_TICK_US 10000           // One pass of loop() per 10ms of simulated time
+
+void setup(void);
+void loop(void);
+
+// The full screen background is kept out of the repository, so link a blank
+// one unless the real bitmap is there
+extern const uint8_t background_bmp[800*480*2] __attribute__((weak)) = {0};
+
+// pio test -e native brings its own main(), and only needs the firmware and
+// the shims
+#ifndef PIO_UNIT_TESTING
+
+typedef struct sim_options_t {
+  float hours;
+  uint32_t interval;                // Seconds between frames from each station
+  uint8_t stations;
+  uint32_t outageAt;                // Minutes after boot the network goes down, 0 for never
+  uint32_t outageFor;               // Minutes
+  uint32_t stepAt;                  // Minutes after boot the wall clock steps, 0 for never
+  long step;                        // Seconds, either way
+  const char *record;               // Capture file to write the generated frames to
+  const char *replay;               // Capture file to play back instead of generating
+  float speed;                      // Replay speed, 0 for as fast as possible
+  const char *payload;               // Payload format saved in the config, json, cbor or msgpack
+  uint32_t bench;                   // Encode this many readings in each format and exit
+} sim_options_t;
+
+typedef struct sim_station_t {
+  uint8_t mac[6];
+  uint16_t sequence;
+  uint64_t nextMicros;
+  uint32_t sent;
+} sim_station_t;
+
+// Lets captureWrite() go to a file
+class FilePrint : public Print {
+  public:
+    FilePrint(FILE *file) : file(file) {}
+    size_t write(uint8_t c) override { return fputc(c, file) == EOF ? 0 : 1; }
+    size_t write(const uint8_t *buffer, size_t size) override { return fwrite(buffer, 1, size, file); }
+    using Print::write;
+
+  private:
+    FILE *file;
+};
+
+static FILE *recordFile = NULL;
+
+static void usage(const char *name) {
+  fprintf(stderr, "usage: %s [--hours h] [--interval s] [--stations n] [--http-latency-ms ms]\n", name);
+  fprintf(stderr, "          [--outage-at min] [--outage-for min] [--epoch secs] [--quiet]\n");
+  fprintf(stderr, "          [--clock-step-at min] [--clock-step secs]\n");
+  fprintf(stderr, "          [--record file] [--replay file [--speed 1|100|max]]\n");
+  fprintf(stderr, "          [--payload json|cbor|msgpack] [--bench-payload n]\n");
+  exit(2);
+}
+
+static void parseOptions(int argc, char **argv, sim_options_t *options) {
+  options->hours = 1.0;
+  options->interval = 60;
+  options->stations = 1;
+  options->outageAt = 0;
+  options->outageFor = 5;
+  options->stepAt = 0;
+  options->step = 3600;
+  options->record = NULL;
+  options->replay = NULL;
+  options->speed = 1.0;
+  options->payload = "";
+  options->bench = 0;
+
+  for(int n=1;n<argc;n++) {
+    const char *arg = argv[n];
+
+    if(strcmp(arg, "--quiet") == 0) {
+      simSetQuiet(1);
+      continue;
+    }
+
+    if(n + 1 >= argc)
+      usage(argv[0]);
+    const char *value = argv[++n];
+
+    if(strcmp(arg, "--hours") == 0)
+      options->hours = atof(value);
+    else if(strcmp(arg, "--interval") == 0)
+      options->interval = strtoul(value, NULL, 10);
+    else if(strcmp(arg, "--stations") == 0)
+      options->stations = strtoul(value, NULL, 10);
+    else if(strcmp(arg, "--http-latency-ms") == 0)
+      simSetHttpLatencyMs(strtoul(value, NULL, 10));
+    else if(strcmp(arg, "--outage-at") == 0)
+      options->outageAt = strtoul(value, NULL, 10);
+    else if(strcmp(arg, "--outage-for") == 0)
+      options->outageFor = strtoul(value, NULL, 10);
+    else if(strcmp(arg, "--clock-step-at") == 0)
+      options->stepAt = strtoul(value, NULL, 10);
+    else if(strcmp(arg, "--clock-step") == 0)
+      options->step = strtol(value, NULL, 10);
+    else if(strcmp(arg, "--epoch") == 0)
+      simSetEpoch(strtoul(value, NULL, 10));
+    else if(strcmp(arg, "--record") == 0)
+      options->record = value;
+    else if(strcmp(arg, "--replay") == 0)
+      options->replay = value;
+    else if(strcmp(arg, "--speed") == 0)
+      options->speed = (strcmp(value, "max") == 0) ? 0.0 : atof(value);
+    else if(strcmp(arg, "--payload") == 0)
+      options->payload = value;
+    else if(strcmp(arg, "--bench-payload") == 0)
+      options->bench = strtoul(value, NULL, 10);
+    else
+      usage(argv[0]);
+  }
+
+  if((options->interval == 0) || (options->stations == 0) || (options->stations > 200) || (options->speed < 0.0) ||
+      ((options->payload[0] != '\0') && (packFormat(options->payload) < 0)))
+    usage(argv[0]);
+}
+
+// Saved configuration pointing at a broker and InfluxDB on localhost, with
+// the first simulated station as the primary
+static void loadConfig(const sim_options_t *options) {
+  mqttConfig conf;
+  memset(&conf, 0, sizeof(conf));
+  conf.valid = 0xDEADBEEF;
+  strcpy(conf.server, "localhost");
+  strcpy(conf.topic, "weather");
+  strcpy(conf.primary, "24:0a:c4:00:10:00");    // The first simulated station
+  strncpy(conf.format, options->payload, MQTT_FORMAT_LENGTH - 1);
+  conf.port = 1883;
+
+  EEPROM.put(0, conf);
+}
+
+static void deliver(const uint8_t *mac, const uint8_t *data, uint8_t len) {
+  if(recordFile != NULL) {
+    ingest_frame_t frame;
+    frame.rxMicros = simEpochMicros();
+    memcpy(frame.mac, mac, 6);
+    frame.len = len;
+    memcpy(frame.data, data, len);
+
+    FilePrint out(recordFile);
+    captureWrite(out, &frame);
+  }
+
+  simEspNowDeliver(mac, data, len);
+}
+
+static void sampleAt(uint8_t station, time_t epoch, sensor_data_t *sample) {
+  double day = 2 * M_PI * (epoch % 86400) / 86400.0;
+
+  sample->wakeup_reason = 4;
+  sample->temperature = 18.0 + station + 6.0 * sin(day);
+  sample->pressure = 101325 + (int32_t)(300.0 * sin(day / 3));
+  sample->humidity = 60.0 - 15.0 * sin(day);
+  sample->battery_millivolts = 4100.0;
+  sample->direction = (epoch / 600) % 16;
+  sample->wind_speed = 2.5 + 2.0 * sin(day * 7);
+  sample->rain = ((epoch / 3600) % 12 == 0) ? 0.01 : 0.0;
+}
+
+static void sendFrame(sim_station_t *sim, uint8_t index) {
+  sensor_data_t sample;
+  uint16_t age = 0;
+  uint8_t frame[WIRE_MAX_FRAME];
+
+  sampleAt(index, simEpoch(), &sample);
+  uint8_t flags = (sim->sent == 0) ? WIRE_FLAG_RESTART : 0;
+  uint8_t len = wireEncode(frame, index + 1, sim->sequence++, &sample, &age, 1, flags, false);
+
+  deliver(sim->mac, frame, len);
+  sim->sent++;
+}
+
+// One pass of loop(), then the rest of the tick if nothing blocked for longer
+static void step(bool advance) {
+  uint64_t before = simMicros();
+  loop();
+
+  if(advance && (simMicros() - before < SIM_TICK_US))
+    simAdvance(SIM_TICK_US - (simMicros() - before));
+}
+
+static uint32_t generate(const sim_options_t *options) {
+  sim_station_t *stations = new sim_station_t[options->stations];
+  for(uint8_t n=0;n<options->stations;n++) {
+    uint8_t mac[6] = {0x24, 0x0a, 0xc4, 0x00, 0x10, n};
+    memcpy(stations[n].mac, mac, 6);
+    stations[n].sequence = esp_random() & 0xffff;
+    stations[n].sent = 0;
+    // Spread the stations out over the interval
+    stations[n].nextMicros = simMicros() + (uint64_t)options->interval * 1000000ULL * n / options->stations;
+  }
+
+  uint64_t endMicros = simMicros() + (uint64_t)(options->hours * 3600.0 * 1E06);
+  uint64_t outageStart = (uint64_t)options->outageAt * 60000000ULL;
+  uint64_t outageEnd = outageStart + (uint64_t)options->outageFor * 60000000ULL;
+  uint64_t stepAt = (uint64_t)options->stepAt * 60000000ULL;
+  bool stepped = (options->stepAt == 0);
+  uint32_t sent = 0;
+
+  while(simMicros() < endMicros) {
+    uint64_t now = simMicros();
+
+    if(options->outageAt != 0)
+      simSetNetworkUp((now < outageStart) || (now >= outageEnd));
+
+    if(!stepped && (now >= stepAt)) {
+      simStepClock(options->step);
+      stepped = true;
+    }
+
+    for(uint8_t n=0;n<options->stations;n++) {
+      if(now >= stations[n].nextMicros) {
+        sendFrame(&stations[n], n);
+        stations[n].nextMicros += (uint64_t)options->interval * 1000000ULL;
+        sent++;
+      }
+    }
+
+    step(true);
+  }
+
+  delete[] stations;
+  return sent;
+}
+
+static bool loadCapture(const char *name, std::vector<ingest_frame_t> *frames) {
+  FILE *file = fopen(name, "r");
+  if(file == NULL) {
+    perror(name);
+    return false;
+  }
+
+  char line[CAPTURE_LINE_LENGTH + 2];
+  ingest_frame_t frame;
+  uint32_t skipped = 0;
+  while(fgets(line, sizeof(line), file) != NULL) {
+    if(captureRead(line, &frame))
+      frames->push_back(frame);
+    else
+      skipped++;
+  }
+  fclose(file);
+
+  if(skipped > 0)
+    fprintf(stderr, "%s: skipped %u lines that are not frames\n", name, skipped);
+
+  return true;
+}
+
+// Keeps the original spacing between frames, scaled by speed. At max speed a
+// frame goes in on every pass of loop() and the clock is left alone, so the
+// only time that passes is what the code itself spends blocked.
+static uint32_t replay(const sim_options_t *options, const std::vector<ingest_frame_t> &frames) {
+  uint64_t start = simMicros();
+  size_t next = 0;
+
+  while(next < frames.size()) {
+    if(options->speed == 0.0) {
+      deliver(frames[next].mac, frames[next].data, frames[next].len);
+      next++;
+    } else {
+      uint64_t offset = (frames[next].rxMicros - frames[0].rxMicros) / options->speed;
+      while((next < frames.size()) && (simMicros() >= start + offset)) {
+        deliver(frames[next].mac, frames[next].data, frames[next].len);
+        if(++next < frames.size())
+          offset = (frames[next].rxMicros - frames[0].rxMicros) / options->speed;
+      }
+    }
+
+    step(options->speed != 0.0);
+  }
+
+  // Let the queue drain
+  ingest_stats_t ingest;
+  do {
+    step(options->speed != 0.0);
+    ingestGetStats(&ingest);
+  } while(ingest.depth > 0);
+
+  return frames.size();
+}
+
+// Counts what would have been sent
+class NullPrint : public Print {
+  public:
+    size_t write(uint8_t c) override { bytes++; return 1; }
+    size_t write(const uint8_t *buffer, size_t size) override { bytes += size; return size; }
+    using Print::write;
+    size_t bytes = 0;
+};
+
+// Same fields as stateFields in mqtt.cpp
+static const json_field_t benchFields[] = {
+  JSON_INTEGER(wakeup_reason),
+  JSON_FIXED(temperature, 1),
+  JSON_INTEGER(pressure),
+  JSON_FIXED(humidity, 1),
+  JSON_FIXED(battery, 1),
+  JSON_INTEGER(direction),
+  JSON_FIXED(anemometer, 6),
+  JSON_FIXED(rain, 6)
+};
+static const json_schema_t benchSchema = JSON_SCHEMA(benchFields);
+
+// Host timings, so only the ratios mean anything for the ESP32. The sprintf
+// row is the payload as it was built before jsonwriter.
+static void benchPayloads(uint32_t iterations) {
+  const char *names[] = {"json", "cbor", "msgpack"};
+  volatile float jitter = 0.0;
+
+  printf("format   bytes  ns/encode\n");
+
+  char legacy[200];
+  size_t legacyBytes = 0;
+  auto start = std::chrono::steady_clock::now();
+  for(uint32_t n=0;n<iterations;n++) {
+    legacyBytes = sprintf(legacy, "{\"wakeup_reason\":%d,\"temperature\":%.1f,\"pressure\":%d,\"humidity\":%.1f,\"battery\":%.1f,\"direction\":%d,\"anemometer\":%f,\"rain\":%f}",
+      4, 18.3 + jitter, 101584, 61.2, 4100.0, 8, 2.48, 0.01);
+  }
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / iterations;
+  printf("%-8s %5zu  %9.0f\n", "sprintf", legacyBytes, ns);
+
+  for(uint8_t format=PAYLOAD_JSON;format<=PAYLOAD_MSGPACK;format++) {
+    NullPrint out;
+    start = std::chrono::steady_clock::now();
+    for(uint32_t n=0;n<iterations;n++) {
+      json_value_t values[] = {jsonInt(4), jsonFloat(18.3 + jitter), jsonInt(101584), jsonFloat(61.2), jsonFloat(4100.0),
+        jsonInt(8), jsonFloat(2.48), jsonFloat(0.01)};
+      packLength(format, &benchSchema, values);
+      packWrite(out, format, &benchSchema, values);
+    }
+    ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / iterations;
+    printf("%-8s %5zu  %9.0f\n", names[format], out.bytes / iterations, ns);
+  }
+}
+
+int main(int argc, char **argv) {
+  sim_options_t options;
+  parseOptions(argc, argv, &options);
+
+  if(options.bench > 0) {
+    benchPayloads(options.bench);
+    return 0;
+  }
+
+  std::vector<ingest_frame_t> frames;
+  if((options.replay != NULL) && !loadCapture(options.replay, &frames))
+    return 1;
+
+  if(options.record != NULL) {
+    recordFile = fopen(options.record, "w");
+    if(recordFile == NULL) {
+      perror(options.record);
+      return 1;
+    }
+  }
+
+  loadConfig(&options);
+
+  auto wallStart = std::chrono::steady_clock::now();
+
+  setup();
+  uint64_t setupMicros = simMicros();
+  auto runStart = std::chrono::steady_clock::now();
+
+  uint32_t sent = (options.replay != NULL) ? replay(&options, frames) : generate(&options);
+
+  auto wallEnd = std::chrono::steady_clock::now();
+  double wallSecs = std::chrono::duration<double>(wallEnd - wallStart).count();
+  double runWallSecs = std::chrono::duration<double>(wallEnd - runStart).count();
+  double runSimSecs = (simMicros() - setupMicros) / 1E06;
+
+  if(recordFile != NULL)
+    fclose(recordFile);
+
+  ingest_stats_t ingest;
+  ingestGetStats(&ingest);
+
+  printf("\n--- simulated %.2f h (setup %.3f s) in %.3f s wall\n", runSimSecs / 3600.0, setupMicros / 1E06, wallSecs);
+  printf("frames   sent %u received %u dropped %u queue high water %u\n", sent, ingest.received, ingest.dropped, ingest.highWater);
+  printf("rate     %.2f frames/s simulated, %.0f frames/s wall\n", (runSimSecs > 0.0) ? sent / runSimSecs : 0.0, (runWallSecs > 0.0) ? sent / runWallSecs : 0.0);
+  printf("latency  p50 %u us p90 %u us p99 %u us max %u us\n", ingest.latencyP50, ingest.latencyP90, ingest.latencyP99, ingest.latencyMax);
+  printf("mqtt     connects %u failed %u messages %u bytes %llu\n", simCounters.mqttConnects, simCounters.mqttConnectFailures, simCounters.mqttMessages, (unsigned long long)simCounters.mqttBytes);
+  mqtt_stats_t mqtt;
+  getMQTTStats(&mqtt);
+  printf("mqttq    attempts %u disconnected %u ms queued %u (%u bytes) high water %u dropped %u failed %u\n", mqtt.connectAttempts, mqtt.disconnectedMs, mqtt.queuedMessages, mqtt.queuedBytes, mqtt.queueHighWater, mqtt.queueDropped, mqtt.publishFailed);
+  outbox_stats_t outbox;
+  getOutboxStats(&outbox);
+  printf("spiffs   appended %u replayed %u segments %u pending %u bytes dropped segments %u corrupt %u\n", outbox.appended, outbox.replayed, outbox.segments, outbox.pendingBytes, outbox.segmentsDropped, outbox.corrupt);
+  log_stats_t logq;
+  getLogStats(&logq);
+  printf("logq     queued %u sent %u coalesced %u rate limited %u dropped %u high water %u\n", logq.queued, logq.sent, logq.coalesced, logq.rateLimited, logq.dropped, logq.highWater);
+  rollup_stats_t rollup;
+  getRollupStats(&rollup);
+  printf("rollup   samples %u published %u late %u failed %u\n", rollup.samples, rollup.published, rollup.late, rollup.failed);
+  history_stats_t history;
+  getHistoryStats(&history);
+  printf("history  samples %u hits %u misses %u fill queries %u rows %u failed %u saves %u rain saves %u steps %u covered %u days\n", history.samples, history.hits, history.misses, history.fillQueries, history.fillRows, history.fillFailures, history.saves, history.rainSaves, history.clockSteps, history.coveredDays);
+  query_cache_stats_t qcache;
+  getQueryCacheStats(&qcache);
+  printf("qcache   hits %u misses %u expired %u midnight %u stale %u entries %u requests %u statements %u prefetched %u\n", qcache.hits, qcache.misses, qcache.expired, qcache.midnight, qcache.stale, qcache.entries, qcache.requests, qcache.statements, qcache.prefetched);
+  influx_client_stats_t iclient;
+  getInfluxClientStats(&iclient);
+  printf("iclient  requests %u reused %u connects %u resolves %u failed %u rtt %u/%u/%u ms\n", iclient.requests, iclient.reused, iclient.connects, iclient.resolves, iclient.failures, iclient.rttMinMs, iclient.rttMeanMs, iclient.rttMaxMs);
+  time_stats_t times;
+  getTimeStats(&times);
+  pressure_trend_t trend;
+  bool trendValid = pressureTrend(&trend);
+  printf("trend    samples %u mean %.3f slope %.4f inHg/3h%s\n", trend.samples, trend.mean, trend.slope, trendValid ? "" : " (too few)");
+  printf("time     synced at %u ms steps %u midnights %u\n", times.syncMs, times.steps, times.midnights);
+#ifdef INFLUX_WRITER
+  influx_stats_t influx;
+  getInfluxWriterStats(&influx);
+  printf("influx   points %u writes %u failed %u rejected %u dropped %u bytes %u -> %u pending %u\n", influx.points, influx.writes, influx.failures, influx.rejected, influx.dropped, influx.rawBytes, influx.sentBytes, influx.pendingPoints);
+#endif
+  printf("http     requests %u connects %u failed %u bytes %llu\n", simCounters.httpRequests, simCounters.httpConnects, simCounters.httpFailures, (unsigned long long)simCounters.httpBytes);
+  printf("display  ops %u spi bytes %llu\n", simCounters.displayOps, (unsigned long long)simCounters.displayBytes);
+
+  for(uint8_t n=0;n<TASK_COUNT;n++) {
+    task_stats_t stats;
+    getTaskStats(n, &stats);
+    printf("task     %-8s loops %u mean %u us max %u us dropped %u\n", stats.name, stats.loops, stats.meanLatencyUs, stats.maxLatencyUs, stats.queueDropped);
+  }
+
+  return 0;
+}
+
+#endif /* PIO_UNIT_TESTING */
@@ -0,0 +1,732 @@
+/**
+ *  @filename   :   native_sim.cpp
+ *  @brief      :   ESP32 Weather Base Station native build, simulated clock and shim implementations
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <Wire.h>
+#include <EEPROM.h>
+#include <ArduinoOTA.h>
+#include <WiFi.h>
+#include <WiFiManager.h>
+#include <HTTPClient.h>
+#include <PubSubClient.h>
+#include <HTU21D.h>
+#include <esp_now.h>
+#include <vector>
+
+#define SIM_SNTP_DELAY_US 2000000     // Time from configTime() to a usable clock
+#define SIM_CONNECT_FAIL_US 3000000   // TCP connect timeout with the network down
+
+static uint64_t simNow = 0;
+static time_t simStartEpoch = 1622548800;  // 2021-06-01 12:00 UTC
+static int quietSerial = 0;
+static int networkUp = 1;
+static uint32_t httpLatencyMs = 20;
+
+static long timeOffset = 0;
+static bool timeConfigured = false;
+static uint64_t timeConfiguredAt = 0;
+
+sim_counters_t simCounters;
+void (*simMqttPublishHook)(const char *topic, const uint8_t *payload, unsigned int length) = NULL;
+
+HardwareSerial Serial;
+EspClass ESP;
+WiFiClass WiFi;
+SPIClass SPI;
+TwoWire Wire;
+EEPROMClass EEPROM;
+ArduinoOTAClass ArduinoOTA;
+
+extern "C" {
+
+uint64_t simMicros() {
+  return simNow;
+}
+
+void simAdvance(uint64_t micros) {
+  simNow += micros;
+}
+
+void simChargeNanos(uint64_t nanos) {
+  static uint64_t remainder = 0;
+
+  remainder += nanos;
+  simNow += remainder / 1000;
+  remainder %= 1000;
+}
+
+void simSetEpoch(time_t epoch) {
+  simStartEpoch = epoch;
+}
+
+// The wall clock jumps and millis() does not, like SNTP correcting it
+void simStepClock(long secs) {
+  simStartEpoch += secs;
+}
+
+time_t simEpoch() {
+  return simStartEpoch + simNow / 1000000;
+}
+
+int64_t simEpochMicros() {
+  return (int64_t)simStartEpoch * 1000000LL + simNow;
+}
+
+void simSetQuiet(int quiet) {
+  quietSerial = quiet;
+}
+
+int simQuiet() {
+  return quietSerial;
+}
+
+void simSetNetworkUp(int up) {
+  networkUp = up;
+}
+
+int simNetworkUp() {
+  return networkUp;
+}
+
+void simSetHttpLatencyMs(uint32_t ms) {
+  httpLatencyMs = ms;
+}
+
+uint32_t simHttpLatencyMs() {
+  return httpLatencyMs;
+}
+
+}
+
+/*
+ * Arduino core
+ */
+
+void pinMode(uint8_t pin, uint8_t mode) {}
+void digitalWrite(uint8_t pin, uint8_t value) {}
+void attachInterrupt(uint8_t interrupt, void (*handler)(void), int mode) {}
+
+// Reads high, so the config button is never pressed and the RA8875 is never busy
+int digitalRead(uint8_t pin) {
+  return HIGH;
+}
+
+char *itoa(int value, char *str, int base) {
+  if(base == 16)
+    sprintf(str, "%x", value);
+  else
+    sprintf(str, "%d", value);
+  return str;
+}
+
+uint32_t esp_random() {
+  static uint32_t state = 0x12345678;
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+void EspClass::restart() {
+  fprintf(stderr, "ESP.restart() called at %.3f s\n", simNow / 1E06);
+  exit(1);
+}
+
+void configTime(long gmtOffset_sec, int daylightOffset_sec, const char *server1, const char *server2, const char *server3) {
+  timeOffset = gmtOffset_sec + daylightOffset_sec;
+  if(!timeConfigured)
+    timeConfiguredAt = simNow;
+  timeConfigured = true;
+}
+
+// Like the real one, waits out the timeout if SNTP has not set the clock yet
+bool getLocalTime(struct tm *info, uint32_t ms) {
+  if(!timeConfigured || (simNow < timeConfiguredAt + SIM_SNTP_DELAY_US)) {
+    simAdvance((uint64_t)ms * 1000);
+    if(!timeConfigured || (simNow < timeConfiguredAt + SIM_SNTP_DELAY_US))
+      return false;
+  }
+
+  time_t now = simEpoch() + timeOffset;
+  gmtime_r(&now, info);
+  return true;
+}
+
+String IPAddress::toString() const {
+  char buffer[16];
+  sprintf(buffer, "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+  return String(buffer);
+}
+
+bool IPAddress::fromString(const char *address) {
+  unsigned int a, b, c, d;
+  if(sscanf(address, "%u.%u.%u.%u", &a, &b, &c, &d) != 4)
+    return false;
+
+  *this = IPAddress(a, b, c, d);
+  return true;
+}
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+  size_t n = 0;
+  while(size--)
+    n += write(*buffer++);
+  return n;
+}
+
+size_t Print::printf(const char *format, ...) {
+  char buffer[512];
+  va_list args;
+  va_start(args, format);
+  int len = vsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+
+  if(len < 0)
+    return 0;
+
+  return write((const uint8_t *)buffer, std::min((size_t)len, sizeof(buffer) - 1));
+}
+
+size_t Print::print(long value, int base) {
+  char buffer[24];
+  sprintf(buffer, (base == HEX) ? "%lx" : "%ld", value);
+  return write(buffer);
+}
+
+size_t Print::print(unsigned long value, int base) {
+  char buffer[24];
+  sprintf(buffer, (base == HEX) ? "%lx" : "%lu", value);
+  return write(buffer);
+}
+
+size_t Print::print(int value, int base) {
+  return print((long)value, base);
+}
+
+size_t Print::print(unsigned int value, int base) {
+  return print((unsigned long)value, base);
+}
+
+size_t Print::print(double value, int digits) {
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%.*f", digits, value);
+  return write(buffer);
+}
+
+size_t Stream::readBytes(char *buffer, size_t length) {
+  size_t n = 0;
+  int c;
+  while((n < length) && ((c = read()) >= 0))
+    buffer[n++] = c;
+  return n;
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  simChargeNanos(SIM_SERIAL_NS_PER_BYTE);
+  if(!quietSerial)
+    fputc(c, stdout);
+  return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size) {
+  simChargeNanos(SIM_SERIAL_NS_PER_BYTE * size);
+  if(!quietSerial)
+    fwrite(buffer, 1, size, stdout);
+  return size;
+}
+
+/*
+ * FreeRTOS, single threaded
+ */
+
+struct native_queue_t {
+  std::vector<uint8_t> items;
+  UBaseType_t length;
+  UBaseType_t itemSize;
+  UBaseType_t head;
+  UBaseType_t count;
+};
+
+struct native_semaphore_t {
+  int held;
+};
+
+static int mainTask;
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+  return &mainTask;
+}
+
+void vTaskDelay(TickType_t ticks) {
+  simAdvance((uint64_t)ticks * portTICK_PERIOD_MS * 1000);
+}
+
+void vTaskDelete(TaskHandle_t task) {}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+  return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait) {
+  return 1;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+  return 0;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+  native_queue_t *queue = new native_queue_t;
+  queue->items.resize(length * itemSize);
+  queue->length = length;
+  queue->itemSize = itemSize;
+  queue->head = 0;
+  queue->count = 0;
+  return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t wait) {
+  if(queue->count == queue->length)
+    return pdFALSE;
+
+  UBaseType_t slot = (queue->head + queue->count) % queue->length;
+  memcpy(&queue->items[slot * queue->itemSize], item, queue->itemSize);
+  queue->count++;
+  return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t wait) {
+  if(queue->count == 0)
+    return pdFALSE;
+
+  memcpy(item, &queue->items[queue->head * queue->itemSize], queue->itemSize);
+  queue->head = (queue->head + 1) % queue->length;
+  queue->count--;
+  return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+  return queue->count;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+  return new native_semaphore_t{0};
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex() {
+  return new native_semaphore_t{0};
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t wait) {
+  sem->held++;
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+  sem->held--;
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t sem, TickType_t wait) {
+  return xSemaphoreTake(sem, wait);
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t sem) {
+  return xSemaphoreGive(sem);
+}
+
+/*
+ * ESP-NOW
+ */
+
+static esp_now_recv_cb_t recvCallback = NULL;
+
+esp_err_t esp_now_init() {
+  return ESP_OK;
+}
+
+esp_err_t esp_now_register_recv_cb(esp_now_recv_cb_t cb) {
+  recvCallback = cb;
+  return ESP_OK;
+}
+
+esp_err_t esp_now_register_send_cb(esp_now_send_cb_t cb) {
+  return ESP_OK;
+}
+
+esp_err_t esp_now_add_peer(const esp_now_peer_info_t *peer) {
+  return ESP_OK;
+}
+
+esp_err_t esp_now_send(const uint8_t *mac, const uint8_t *data, size_t len) {
+  return ESP_OK;
+}
+
+bool simEspNowDeliver(const uint8_t *mac, const uint8_t *data, int len) {
+  if(recvCallback == NULL)
+    return false;
+
+  recvCallback(mac, data, len);
+  return true;
+}
+
+/*
+ * WiFi and WiFiManager
+ */
+
+int WiFiClass::hostByName(const char *host, IPAddress &result) {
+  if(!simNetworkUp())
+    return 0;
+
+  if(!result.fromString(host))
+    result = IPAddress(127, 0, 0, 1);
+  return 1;
+}
+
+int WiFiClient::connect(const char *host, uint16_t port) {
+  if(!simNetworkUp()) {
+    simAdvance(SIM_CONNECT_FAIL_US);
+    return 0;
+  }
+
+  isConnected = true;
+  return 1;
+}
+
+int WiFiClient::connect(IPAddress ip, uint16_t port) {
+  return connect(ip.toString().c_str(), port);
+}
+
+// timeout is in milliseconds, as on the ESP32
+int WiFiClient::connect(const char *host, uint16_t port, int32_t timeout) {
+  if(!simNetworkUp()) {
+    simAdvance(std::min((uint64_t)timeout * 1000, (uint64_t)SIM_CONNECT_FAIL_US));
+    return 0;
+  }
+
+  isConnected = true;
+  return 1;
+}
+
+size_t WiFiClient::write(const uint8_t *buffer, size_t size) {
+  return connected() ? size : 0;
+}
+
+int WiFiClient::read(uint8_t *buffer, size_t size) {
+  size_t n = std::min(size, rx.size() - rxPos);
+  memcpy(buffer, rx.data() + rxPos, n);
+  rxPos += n;
+  return n;
+}
+
+WiFiManagerParameter::WiFiManagerParameter(const char *id, const char *label, const char *defaultValue, int length) {
+  this->id = id;
+  strncpy(value, defaultValue ? defaultValue : "", sizeof(value) - 1);
+  value[sizeof(value) - 1] = '\0';
+}
+
+/*
+ * Room sensor
+ */
+
+float HTU21D::readTemperature() {
+  return 21.0 + 1.5 * sin(2 * M_PI * simEpoch() / 86400.0);
+}
+
+float HTU21D::readCompensatedHumidity() {
+  return 45.0 + 5.0 * cos(2 * M_PI * simEpoch() / 86400.0);
+}
+
+/*
+ * InfluxDB
+ */
+
+// Plausible answers for the columns the panels ask about
+static float influxValue(const std::string &statement) {
+  bool max = statement.find("max") != std::string::npos;
+  bool min = statement.find("min") != std::string::npos;
+
+  if(statement.find("sum") != std::string::npos)
+    return 0.12;
+  if(statement.find("pressure") != std::string::npos)
+    return max ? 30.12 : (min ? 29.71 : 29.92);
+  if(statement.find("hum") != std::string::npos)
+    return max ? 81.0 : 34.0;
+  return max ? 28.5 : 12.5;
+}
+
+static std::string influxResponse(const std::string &url, bool csv) {
+  size_t q = url.find("q=");
+  std::string query = (q == std::string::npos) ? "" : url.substr(q + 2);
+
+  std::vector<std::string> statements;
+  size_t start = 0;
+  for(;;) {
+    size_t end = query.find("%3B", start);
+    if(end == std::string::npos)
+      end = query.find(';', start);
+    statements.push_back(query.substr(start, end - start));
+    if(end == std::string::npos)
+      break;
+    start = end + ((query[end] == ';') ? 1 : 3);
+  }
+
+  std::string response = csv ? "" : "{\"results\":[";
+  for(size_t n=0;n<statements.size();n++) {
+    size_t as = statements[n].find("AS%20");
+    std::string column = "value";
+    if(as != std::string::npos)
+      column = statements[n].substr(as + 5, statements[n].find("%20", as + 5) - as - 5);
+
+    char result[200];
+    if(csv)
+      snprintf(result, sizeof(result), "%sname,tags,time,%s\nstation,,1622505600000000000,%.2f\n",
+        (n == 0) ? "" : "\n", column.c_str(), influxValue(statements[n]));
+    else
+      snprintf(result, sizeof(result), "%s{\"statement_id\":%u,\"series\":[{\"name\":\"station\",\"columns\":[\"time\",\"%s\"],\"values\":[[\"2021-06-01T00:00:00Z\",%.2f]]}]}",
+        (n == 0) ? "" : ",", (unsigned int)n, column.c_str(), influxValue(statements[n]));
+    response += result;
+  }
+  if(!csv)
+    response += "]}";
+
+  return response;
+}
+
+static uint32_t queryNumber(const std::string &query, const char *after, size_t from = 0) {
+  size_t pos = query.find(after, from);
+  return (pos == std::string::npos) ? 0 : strtoul(query.c_str() + pos + strlen(after), NULL, 10);
+}
+
+// An hourly series over the WHERE time range, with a column for each item in
+// the SELECT and a seasonal swing on the temperatures
+static std::string influxSeries(const std::string &url) {
+  size_t q = url.find("q=");
+  std::string query = (q == std::string::npos) ? "" : url.substr(q + 2);
+  uint32_t chunkSize = queryNumber(url, "chunk_size=");
+  if(chunkSize == 0)
+    chunkSize = 10000;
+
+  size_t select = query.find("SELECT%20");
+  size_t from = query.find("%20FROM");
+  std::vector<std::string> columns;
+  if((select != std::string::npos) && (from != std::string::npos)) {
+    std::string list = query.substr(select + 9, from - select - 9);
+    size_t start = 0;
+    for(;;) {
+      size_t end = list.find("%2C", start);
+      std::string item = list.substr(start, (end == std::string::npos) ? std::string::npos : end - start);
+      size_t as = item.find("AS%20");
+      columns.push_back((as == std::string::npos) ? item : item.substr(as + 5));
+      if(end == std::string::npos)
+        break;
+      start = end + 3;
+    }
+  }
+
+  size_t where = query.find("%3E%3D%20");
+  uint32_t start = queryNumber(query, "%3E%3D%20");
+  uint32_t end = queryNumber(query, "%3C%20", where);
+  start -= start % 3600;
+
+  std::string names = "\"time\"";
+  for(size_t n=0;n<columns.size();n++)
+    names += ",\"" + columns[n] + "\"";
+
+  std::string response;
+  uint32_t rows = 0;
+  for(uint32_t t=start;t<end;t+=3600) {
+    if(rows % chunkSize == 0) {
+      if(rows > 0)
+        response += "]}],\"partial\":true}]}\n";
+      response += "{\"results\":[{\"statement_id\":0,\"series\":[{\"name\":\"station\",\"columns\":[" + names + "],\"values\":[";
+    } else {
+      response += ",";
+    }
+
+    char row[40];
+    snprintf(row, sizeof(row), "[%u", t);
+    response += row;
+    for(size_t n=0;n<columns.size();n++) {
+      float value = (columns[n] == "rain") ? 0.01 : influxValue(columns[n]);
+      if(columns[n].find("temp") != std::string::npos)
+        value += 10.0 * sin(2 * M_PI * t / (365.0 * 86400.0));
+      snprintf(row, sizeof(row), ",%.2f", value);
+      response += row;
+    }
+    response += "]";
+    rows++;
+  }
+
+  if(rows == 0)
+    response = "{\"results\":[{\"statement_id\":0}]}\n";
+  else
+    response += "]}]}]}\n";
+
+  return response;
+}
+
+int HTTPClient::request(bool post, size_t size) {
+  simCounters.httpRequests++;
+  simCounters.httpBytes += url.size() + headers.size() + size;
+  response.clear();
+
+  // A new connection costs a round trip for the handshake
+  WiFiClient *conn = connection();
+  if(!conn->connected()) {
+    if(!conn->connect(url.c_str(), 8086)) {
+      simCounters.httpFailures++;
+      return HTTPC_ERROR_CONNECTION_REFUSED;
+    }
+    simCounters.httpConnects++;
+    simAdvance((uint64_t)httpLatencyMs * 1000);
+  }
+
+  simAdvance((uint64_t)httpLatencyMs * 1000);
+
+  if(url.find("/write") != std::string::npos)
+    return post ? HTTP_CODE_NO_CONTENT : HTTP_CODE_BAD_REQUEST;
+
+  if(post || (url.find("/query") == std::string::npos))
+    return HTTP_CODE_BAD_REQUEST;
+
+  if(url.find("chunked=true") != std::string::npos)
+    response = influxSeries(url);
+  else
+    response = influxResponse(url, headers.find("application/csv") != std::string::npos);
+  simCounters.httpBytes += response.size();
+  return HTTP_CODE_OK;
+}
+
+int HTTPClient::GET() {
+  return request(false, 0);
+}
+
+int HTTPClient::POST(const uint8_t *payload, size_t size) {
+  return request(true, size);
+}
+
+void HTTPClient::end() {
+  if(!reuse || http10)
+    connection()->stop();
+  url.clear();
+  headers.clear();
+}
+
+WiFiClient &HTTPClient::getStream() {
+  WiFiClient *stream = connection();
+  stream->simLoad(response);
+  return *stream;
+}
+
+String HTTPClient::errorToString(int error) {
+  switch(error) {
+    case HTTPC_ERROR_CONNECTION_REFUSED:
+      return String("connection refused");
+    case HTTPC_ERROR_NOT_CONNECTED:
+      return String("not connected");
+    case HTTPC_ERROR_CONNECTION_LOST:
+      return String("connection lost");
+    case HTTPC_ERROR_READ_TIMEOUT:
+      return String("read Timeout");
+    default:
+      return String();
+  }
+}
+
+/*
+ * MQTT
+ */
+
+bool PubSubClient::connect(const char *id) {
+  if(!simNetworkUp()) {
+    simCounters.mqttConnectFailures++;
+    simAdvance(SIM_CONNECT_FAIL_US);
+    mqttState = MQTT_CONNECT_FAILED;
+    return false;
+  }
+
+  simCounters.mqttConnects++;
+  mqttState = MQTT_CONNECTED;
+  return true;
+}
+
+void PubSubClient::disconnect() {
+  mqttState = MQTT_DISCONNECTED;
+}
+
+bool PubSubClient::connected() {
+  if((mqttState == MQTT_CONNECTED) && !simNetworkUp())
+    mqttState = MQTT_CONNECTION_LOST;
+
+  return mqttState == MQTT_CONNECTED;
+}
+
+bool PubSubClient::publish(const char *topic, const uint8_t *payload, unsigned int length, bool retained) {
+  if(!connected())
+    return false;
+
+  // Same limit as the real client, header and topic share the buffer
+  if(length + strlen(topic) + 7 > bufferSize)
+    return false;
+
+  simCounters.mqttMessages++;
+  simCounters.mqttBytes += length;
+  simChargeNanos(SIM_MQTT_PUBLISH_NS + SIM_MQTT_NS_PER_BYTE * length);
+  if(simMqttPublishHook != NULL)
+    simMqttPublishHook(topic, payload, length);
+
+  return true;
+}
+
+bool PubSubClient::beginPublish(const char *topic, unsigned int length, bool retained) {
+  if(!connected())
+    return false;
+
+  pendingTopic = topic;
+  pendingPayload.clear();
+  pendingLength = length;
+  return true;
+}
+
+size_t PubSubClient::write(const uint8_t *buffer, size_t size) {
+  if(!connected())
+    return 0;
+
+  pendingPayload.append((const char *)buffer, size);
+  return size;
+}
+
+int PubSubClient::endPublish() {
+  if(!connected() || (pendingPayload.size() != pendingLength))
+    return 0;
+
+  simCounters.mqttMessages++;
+  simCounters.mqttBytes += pendingLength;
+  simChargeNanos(SIM_MQTT_PUBLISH_NS + SIM_MQTT_NS_PER_BYTE * pendingLength);
+  if(simMqttPublishHook != NULL)
+    simMqttPublishHook(pendingTopic.c_str(), (const uint8_t *)pendingPayload.data(), pendingLength);
+
+  return 1;
+}
@@ -0,0 +1,84 @@
+/**
+ *  @filename   :   native_sim.h
+ *  @brief      :   ESP32 Weather Base Station native build, simulated clock and harness state
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef NATIVE_SIM_H_
+#define NATIVE_SIM_H_
+
+#include <stdint.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Everything that reads the time on the host build (millis, esp_timer,
+// gettimeofday, getLocalTime) reads this clock. It only moves when the
+// harness or a delay moves it.
+uint64_t simMicros(void);
+void simAdvance(uint64_t micros);
+void simChargeNanos(uint64_t nanos);
+void simSetEpoch(time_t epoch);
+void simStepClock(long secs);
+time_t simEpoch(void);
+int64_t simEpochMicros(void);
+
+void simSetQuiet(int quiet);
+int simQuiet(void);
+
+// Rough cost of the slow I/O on the real board, charged to the clock so
+// latencies in the harness mean something
+#define SIM_SERIAL_NS_PER_BYTE 86806      // 115200 baud, 10 bits a byte
+#define SIM_SPI_NS_PER_BYTE 400           // 20MHz bitmap writes
+#define SIM_DISPLAY_OP_NS 10000           // One RA8875 register access
+#define SIM_MQTT_PUBLISH_NS 1000000       // TCP write of a small message
+#define SIM_MQTT_NS_PER_BYTE 1000
+
+// WiFi, MQTT and HTTP all fail while the network is down
+void simSetNetworkUp(int up);
+int simNetworkUp(void);
+void simSetHttpLatencyMs(uint32_t ms);
+uint32_t simHttpLatencyMs(void);
+
+typedef struct sim_counters_t {
+  uint32_t mqttConnects;
+  uint32_t mqttConnectFailures;
+  uint32_t mqttMessages;
+  uint64_t mqttBytes;
+  uint32_t httpRequests;
+  uint32_t httpConnects;
+  uint32_t httpFailures;
+  uint64_t httpBytes;
+  uint32_t displayOps;
+  uint64_t displayBytes;
+} sim_counters_t;
+
+extern sim_counters_t simCounters;
+
+// Called for every message the MQTT shim accepts
+extern void (*simMqttPublishHook)(const char *topic, const uint8_t *payload, unsigned int length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NATIVE_SIM_H_ */
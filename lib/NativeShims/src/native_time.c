@@ -0,0 +1,48 @@
+/**
+ *  @filename   :   native_time.c
+ *  @brief      :   ESP32 Weather Base Station native build, gettimeofday on the simulated clock
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <sys/time.h>
+#include <time.h>
+#include "native_sim.h"
+
+// These replace the C library versions, so code that timestamps with
+// gettimeofday or time, like the ingest queue, runs on the simulated clock
+int gettimeofday(struct timeval *__restrict tv, void *__restrict tz) {
+  int64_t now = simEpochMicros();
+
+  if(tv != 0) {
+    tv->tv_sec = now / 1000000;
+    tv->tv_usec = now % 1000000;
+  }
+
+  return 0;
+}
+
+time_t time(time_t *t) {
+  time_t now = simEpochMicros() / 1000000;
+
+  if(t != 0)
+    *t = now;
+
+  return now;
+}
@@ -26,6 +26,7 @@
 #include "Adafruit_RA8875.h"
 #include "display.h"
 #include "InfluxDbQueries.h"
+#include "pressuretrend.h"
 
 BaroPanel::BaroPanel(Adafruit_RA8875 *_tft, uint16_t _x, uint16_t _y) {
   tft = _tft;
@@ -36,11 +37,12 @@ BaroPanel::BaroPanel(Adafruit_RA8875 *_tft, uint16_t _x, uint16_t _y) {
   high = current;
 
   baroDir = BARO_STEADY;
-  getDailyExtremes();
-  getAveragePressure();
-  averagePoll=0;
+  getTrend();
+  stale = false;
+  refreshCount=0;
 
   highlow=DAILY;
+  getExtremes();
 
   baroDirty = true;
   borderDirty = true;
@@ -62,14 +64,6 @@ void BaroPanel::draw() {
   }
 
   if(baroDirty) {
-    if(abs(current-average) < 0.005) {
-      baroDir=BARO_STEADY;
-    } else if(current > average) {
-      baroDir=BARO_RISING;
-    } else {
-      baroDir=BARO_FALLING;
-    }
-
     char buffer[6];
     sprintf(buffer,"%4.2f", current);
 
@@ -104,36 +98,44 @@ void BaroPanel::draw() {
 }
 
 void BaroPanel::setBarometer(float baro) {
-  if(averagePoll>9) {             // Refresh average pressure for Rise Fall indicator
-      getAveragePressure();
-      extremeDirty=true;
-      baroDirty=true;
-      averagePoll=0;
-      highlow=DAILY;
-  } else if (baro == current) {
-    if(baroDirty)
-      draw();
-    return;
+  float oldHigh = high;
+  float oldLow = low;
+
+  // Back to the daily extremes ten readings after a touch
+  if(refreshCount++ > 9) {
+    refreshCount = 0;
+    if(highlow != DAILY) {
+      highlow = DAILY;
+      extremeDirty = true;
+    }
   }
 
   if (baro < 0.0)
     baro = 0.0;
 
+  // Read again every time, the history store already has this reading
+  getExtremes();
+
+  if(baro < low)
+    low = baro;
+
+  if(baro > high)
+    high = baro;
+
+  if((high != oldHigh) || (low != oldLow))
+    extremeDirty = true;
+
   if (baro != current) {
     current = baro;
     baroDirty = true;
+  }
 
-    if(current < low) {
-      extremeDirty = true;
-      low = current;
-    }
+  // The trend has this reading too
+  if(getTrend())
+    baroDirty = true;
 
-    if(current > high) {
-      extremeDirty = true;
-      high = current;
-    }
+  if(baroDirty || extremeDirty)
     draw();
-  }
 
 }
 
@@ -154,22 +156,18 @@ void BaroPanel::drawExtremes() {
   tft->textEnlarge(0);
   switch(highlow) {
     case DAILY:
-      getDailyExtremes();
       tft->textSetCursor(x_org+(BARO_WIDTH/2)-24,y_org+BARO_XTREME_YOFFSET+15);
       printString("Daily");
       break;
     case WEEKLY:
-      getExtendedExtremes(7);
       tft->textSetCursor(x_org+(BARO_WIDTH/2)-29,y_org+BARO_XTREME_YOFFSET+15);
       printString("Weekly");
       break;
     case MONTHLY:
-      getExtendedExtremes(30);
       tft->textSetCursor(x_org+(BARO_WIDTH/2)-34,y_org+BARO_XTREME_YOFFSET+15);
       printString("Monthly");
       break;
     case YEARLY:
-      getExtendedExtremes(365);
       tft->textSetCursor(x_org+(BARO_WIDTH/2)-29,y_org+BARO_XTREME_YOFFSET+15);
       printString("Yearly");
       break;      
@@ -177,6 +175,10 @@ void BaroPanel::drawExtremes() {
       break;
   }
 
+  // Right after the period, until the callback redraws with the new values
+  if(stale)
+    printString("*");
+
   char buffer[6];
   setArialFont();
   sprintf(buffer,"%4.2f",low);
@@ -209,7 +211,8 @@ bool BaroPanel::isClicked(uint16_t x, uint16_t y) {
     }
 
     extremeDirty = true;
-    averagePoll=0;
+    refreshCount=0;
+    getExtremes();
     draw();
     return true;
   }
@@ -217,12 +220,53 @@ bool BaroPanel::isClicked(uint16_t x, uint16_t y) {
   return false;
 }
 
+// Today's extremes start over, and the longer periods move on a day
+void BaroPanel::newDay() {
+  float oldHigh = high;
+  float oldLow = low;
+
+  getExtremes();
+  if((high != oldHigh) || (low != oldLow))
+    extremeDirty = true;
+
+  if(extremeDirty)
+    draw();
+}
+
+// For the period showing, from memory where it can be
+void BaroPanel::getExtremes() {
+  stale = false;
+  switch(highlow) {
+    case DAILY:
+      getDailyExtremes();
+      break;
+    case WEEKLY:
+      getExtendedExtremes(7);
+      break;
+    case MONTHLY:
+      getExtendedExtremes(30);
+      break;
+    case YEARLY:
+      getExtendedExtremes(365);
+      break;
+    default:
+      break;
+  }
+}
+
 void BaroPanel::getDailyExtremes() {
 
   float newHigh,newLow;
 
-  if(influxGetDailyHighLowPress(&newHigh, &newLow))
-    return;       //Some error occured
+  // Whatever is in memory now, and extremesReady() once the rest is in
+  uint8_t state = influxPeek(QUERY_PRESS, false, 0, &newHigh, &newLow);
+  if(state != QUERY_FRESH) {
+    influxRequest(QUERY_PRESS, false, 0, extremesReady, this);
+    stale = true;
+  }
+
+  if(state == QUERY_MISSING)
+    return;
 
   // Round Up
   newHigh += 0.005;
@@ -230,15 +274,21 @@ void BaroPanel::getDailyExtremes() {
 
   high = newHigh;
   low = newLow;
-
-  extremeDirty = true;
 }
 
 void BaroPanel::getExtendedExtremes(uint16_t timeLen) {
   float newHigh, newLow;
+
+  // Both periods go out in the same request
   getDailyExtremes();
 
-  if(influxGetExtendedHighLowPress(timeLen, &newHigh, &newLow))
+  uint8_t state = influxPeek(QUERY_PRESS, false, timeLen, &newHigh, &newLow);
+  if(state != QUERY_FRESH) {
+    influxRequest(QUERY_PRESS, false, timeLen, extremesReady, this);
+    stale = true;
+  }
+
+  if(state == QUERY_MISSING)
     return;
   
   if(high > newHigh)
@@ -249,14 +299,30 @@ void BaroPanel::getExtendedExtremes(uint16_t timeLen) {
 
   high = newHigh;
   low = newLow;
+}
 
-  extremeDirty = true;
+// Rising or falling by the slope of the last three hours. True if that
+// changed the arrow.
+bool BaroPanel::getTrend() {
+  pressure_trend_t trend;
+  uint8_t dir = BARO_STEADY;
+
+  if(pressureTrend(&trend) && (fabs(trend.slope) >= TREND_STEADY_INHG))
+    dir = (trend.slope > 0.0) ? BARO_RISING : BARO_FALLING;
+
+  if(dir == baroDir)
+    return false;
+
+  baroDir = dir;
+  return true;
 }
 
-void BaroPanel::getAveragePressure(){
-  float avgPress;
-  if(influxGetAveragePressure(&avgPress))
-    return;     // An error has occured
+void BaroPanel::extremesReady(void *panel, int rc) {
+  if(rc != 200)
+    return;
 
-  average=avgPress;
-}
\ No newline at end of file
+  BaroPanel *p = (BaroPanel *)panel;
+  p->getExtremes();
+  p->extremeDirty = true;
+  p->draw();
+}
@@ -26,12 +26,11 @@
 #include "HeaderPanel.h"
 #include "Adafruit_RA8875.h"
 #include "display.h"
-#include "time.h"
+#include "timekeeper.h"
 
 HeaderPanel::HeaderPanel(Adafruit_RA8875 *_tft) {
   tft = _tft;
 
-  configTime(GMT_OFFSET_SECS, DAYLIGHT_OFFSET_SECS, "pool.ntp.org");
   strcpy(timeBuffer,"00:00");
   strcpy(dateBuffer, "00/00/00");
   battery_level = 4.2;
@@ -91,7 +90,7 @@ void HeaderPanel::setBatteryLevel(float level) {
 void HeaderPanel::fillDateTimeBuffers() {
   struct tm dt;
 
-  if(getLocalTime(&dt)) {
+  if(timeLocal(&dt)) {
     strftime(timeBuffer,6,"%I:%M",&dt);
     strftime(dateBuffer,9,"%D",&dt);
   } else {
@@ -37,7 +37,8 @@ HumidityPanel::HumidityPanel(Adafruit_RA8875 *_tft, uint16_t _x, uint16_t _y, in
   indoor = _indoor;
 
   highlow=DAILY;
-  getDailyExtremes();
+  stale = false;
+  getExtremes();
 
   refreshCount=0;
   humDirty = true;
@@ -119,28 +120,28 @@ void HumidityPanel::drawExtremes() {
   setSmallArialFont();
   switch(highlow) {
     case DAILY:
-      getDailyExtremes();
       tft->textSetCursor(x_org+(HUM_WIDTH/2)-24,y_org+HUM_XTREME_YOFFSET+15);
       printString("Daily");
       break;
     case WEEKLY:
-      getExtendedExtremes(7);
       tft->textSetCursor(x_org+(HUM_WIDTH/2)-29,y_org+HUM_XTREME_YOFFSET+15);
       printString("Weekly");
       break;
     case MONTHLY:
-      getExtendedExtremes(30);
       tft->textSetCursor(x_org+(HUM_WIDTH/2)-34,y_org+HUM_XTREME_YOFFSET+15);
       printString("Monthly");
       break;
     case YEARLY:
-      getExtendedExtremes(365);
       tft->textSetCursor(x_org+(HUM_WIDTH/2)-29,y_org+HUM_XTREME_YOFFSET+15);
       printString("Yearly");
       break;      
     default:
       break;
   }
+
+  // Right after the period, until the callback redraws with the new values
+  if(stale)
+    printString("*");
   
   drawCenteredArial((3*8)/2+25+x_org,y_org+HUM_XTREME_YOFFSET+15,low);
   drawCenteredArial(x_org+(HUM_WIDTH -27 -(4*8)/2),y_org+HUM_XTREME_YOFFSET+15,high);
@@ -167,6 +168,7 @@ bool HumidityPanel::isClicked(uint16_t x, uint16_t y) {
     }
 
     refreshCount = 0;
+    getExtremes();
     draw();
     return true;
   }
@@ -176,42 +178,90 @@ bool HumidityPanel::isClicked(uint16_t x, uint16_t y) {
 
 void HumidityPanel::setHumidity(uint8_t humidity) {
 
+  int8_t oldHigh = high;
+  int8_t oldLow = low;
+
+  // Back to the daily extremes ten readings after a touch
   if(refreshCount++ > 9) {
     refreshCount = 0;
-    extremeDirty = true;
-    highlow=DAILY;
-  } else if (humidity == current) {
-    if(extremeDirty)
-      draw();
-    return;
+    if(highlow != DAILY) {
+      highlow = DAILY;
+      extremeDirty = true;
+    }
   }
 
-  current= humidity;
-  if(current > 99) {
-    current = 99;
-  }
+  if(humidity > 99)
+    humidity = 99;
 
-  humDirty = true;
-  if(current < low) {
+  // Read again every time, the history store already has this reading
+  getExtremes();
+
+  if((int8_t)humidity < low)
+    low = humidity;
+
+  if((int8_t)humidity > high)
+    high = humidity;
+
+  if((high != oldHigh) || (low != oldLow))
     extremeDirty = true;
-    low = current;
+
+  if(humidity != current) {
+    current = humidity;
+    humDirty = true;
   }
 
-  if(current > high) {
+  if(humDirty || extremeDirty)
+    draw();
+
+}
+
+// Today's extremes start over, and the longer periods move on a day
+void HumidityPanel::newDay() {
+  int8_t oldHigh = high;
+  int8_t oldLow = low;
+
+  getExtremes();
+  if((high != oldHigh) || (low != oldLow))
     extremeDirty = true;
-    high = current;
-  }
 
-  draw();
+  if(extremeDirty)
+    draw();
+}
 
+// For the period showing, from memory where it can be
+void HumidityPanel::getExtremes() {
+  stale = false;
+  switch(highlow) {
+    case DAILY:
+      getDailyExtremes();
+      break;
+    case WEEKLY:
+      getExtendedExtremes(7);
+      break;
+    case MONTHLY:
+      getExtendedExtremes(30);
+      break;
+    case YEARLY:
+      getExtendedExtremes(365);
+      break;
+    default:
+      break;
+  }
 }
 
 void HumidityPanel::getDailyExtremes() {
 
   float newHigh,newLow;
 
-  if(influxGetDailyHighLowHum(indoor, &newHigh, &newLow))
-    return;       //Some error occured
+  // Whatever is in memory now, and extremesReady() once the rest is in
+  uint8_t state = influxPeek(QUERY_HUM, indoor, 0, &newHigh, &newLow);
+  if(state != QUERY_FRESH) {
+    influxRequest(QUERY_HUM, indoor, 0, extremesReady, this);
+    stale = true;
+  }
+
+  if(state == QUERY_MISSING)
+    return;
 
   // Round Up
   newHigh += 0.5;
@@ -219,15 +269,21 @@ void HumidityPanel::getDailyExtremes() {
 
   high = newHigh;
   low = newLow;
-
-  extremeDirty = true;
 }
 
 void HumidityPanel::getExtendedExtremes(uint16_t timeLen) {
   float newHigh, newLow;
+
+  // Both periods go out in the same request
   getDailyExtremes();
 
-  if(influxGetExtendedHighLowHum(indoor, timeLen, &newHigh, &newLow))
+  uint8_t state = influxPeek(QUERY_HUM, indoor, timeLen, &newHigh, &newLow);
+  if(state != QUERY_FRESH) {
+    influxRequest(QUERY_HUM, indoor, timeLen, extremesReady, this);
+    stale = true;
+  }
+
+  if(state == QUERY_MISSING)
     return;
   
   Serial.printf("newHigh %f newLow %f\n",newHigh,newLow);
@@ -239,6 +295,14 @@ void HumidityPanel::getExtendedExtremes(uint16_t timeLen) {
 
   high = newHigh;
   low = newLow;
+}
 
-  extremeDirty = true;
-}
\ No newline at end of file
+void HumidityPanel::extremesReady(void *panel, int rc) {
+  if(rc != 200)
+    return;
+
+  HumidityPanel *p = (HumidityPanel *)panel;
+  p->getExtremes();
+  p->extremeDirty = true;
+  p->draw();
+}
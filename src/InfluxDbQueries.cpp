@@ -22,89 +22,613 @@
  */
 
 #include <Arduino.h>
-#include <ArduinoJson.h>
-#include <HTTPClient.h>
 #include "InfluxDbQueries.h"
+#include "influxclient.h"
+#include "influxresult.h"
 #include "display.h"
 #include "wifiwithmqtt.h"
 #include "time.h"
+#include "tasks.h"
+#include "logqueue.h"
+#include "history.h"
+#include "timekeeper.h"
+
+// Statements only, so a plan can send several in one request separated by
+// %3B. Each names its value r<n>, n being its index in the request, which is
+// how a CSV response tells them apart.
+const char *dailyExtremeQuery="SELECT%%20%s%%28%%22%s%%22%%29%%20AS%%20r%u%%20from%%20%%22station%%22%%20WHERE%%20time%%3E%%3Dnow%%28%%29-%dm";
+const char *extendedExtremeQuery="SELECT%%20%s%%28%s%%29%%20AS%%20r%u%%20from%%20two_year.hourly_rollup%%20WHERE%%20time%%3E%%3Dnow%%28%%29-%dd";
+const char *dailyRainQuery="SELECT%%20sum%%28%%22rain%%22%%29%%20AS%%20r%u%%20from%%20%%22station%%22%%20WHERE%%20time%%3E%%3Dnow%%28%%29-24h";
+const char *extendedRainQuery="SELECT%%20sum%%28rain%%29%%20AS%%20r%u%%20from%%20two_year.hourly_rollup%%20WHERE%%20time%%3E%%3Dnow%%28%%29-%dd%%20AND%%20time%%20%%3C%%20now%%28%%29-24h";
+
+typedef struct query_columns_t {
+  const char *daily;                // In station
+  const char *extendedMax;          // In two_year.hourly_rollup
+  const char *extendedMin;
+} query_columns_t;
+
+// Outdoor then indoor, for QUERY_TEMP, QUERY_HUM and QUERY_PRESS
+static const query_columns_t extremeColumns[3][2] = {
+  {{"temperature", "max_temp", "min_temp"}, {"room_temp", "max_room_temp", "min_room_temp"}},
+  {{"humidity", "max_humidity", "min_humidity"}, {"room_hum", "max_room_hum", "min_room_hum"}},
+  {{"pressureHg", "max_pressureHg", "min_pressureHg"}, {"pressureHg", "max_pressureHg", "min_pressureHg"}}
+};
+
+typedef struct query_cache_entry_t {
+  bool valid;
+  uint8_t query;
+  bool indoor;
+  uint16_t period;                  // Days, 0 for today
+  uint32_t storedAt;
+  uint32_t day;                     // Local day it was stored on
+  bool stale;                       // Past its TTL or its day, kept to show until replaced
+  float high;
+  float low;
+} query_cache_entry_t;
+
+typedef struct query_plan_item_t {
+  uint8_t query;
+  bool indoor;
+  uint16_t period;
+  uint8_t result;                   // Index of its first statement's result
+} query_plan_item_t;
+
+typedef struct query_waiter_t {
+  query_done_t done;
+  void *context;
+} query_waiter_t;
+
+// The query task fills in values, then sets done
+typedef struct query_plan_t {
+  query_plan_item_t items[QUERY_PLAN_SIZE];
+  uint8_t count;
+  uint8_t results;                  // Statements
+  query_waiter_t waiters[QUERY_WAITERS];
+  uint8_t waiterCount;
+  float values[QUERY_PLAN_STATEMENTS];
+  volatile int rc;
+  volatile bool done;
+} query_plan_t;
+
+// Only the display task queries, so the cache and the plans need no lock.
+// One plan collects what is asked for while the other is out on the query
+// task, which is the only one to use planUrl.
+static query_cache_entry_t cache[QUERY_CACHE_SIZE];
+static query_cache_stats_t cacheStats;
+
+static query_plan_t plans[2];
+static query_plan_t *pending = &plans[0];
+static query_plan_t *sent = NULL;
+static char planUrl[QUERY_PLAN_URL_LENGTH];
+
+static int failedRc = 0;
+static uint32_t failedAt = 0;
+
+static uint32_t prefetchAt = 0;
+static bool prefetched = false;
+
+#ifdef QUERY_CSV
+#define QUERY_ACCEPT "application/csv"
+#else
+#define QUERY_ACCEPT NULL
+#endif
+
+typedef struct http_query_t {
+  const char *url;
+  InfluxResultReader *reader;
+} http_query_t;
+
+// Runs on the query task, over the connection influxclient keeps open. The
+// response goes through writeToStream() so a chunked one is put back together
+// before the reader sees it. One that stops short, or has a statement that
+// failed, is a failure, not zeros.
+static int doHttpQuery(void *arg) {
+  http_query_t *query = (http_query_t *)arg;
+
+  int rc=influxClientGet(query->url, false, QUERY_ACCEPT);
 
-const char *dailyMinMaxQuery="/query?db=weather&q=SELECT%%20max%%28%%22%s%%22%%29%%20from%%20%%22station%%22%%20WHERE%%20time%%3E%%3Dnow%%28%%29-%dm%%3BSELECT%%20min%%28%%22%s%%22%%29%%20from%%20%%22station%%22%%20%%20WHERE%%20time%%3E%%3Dnow%%28%%29-%dm";
-const char *extendedMinMaxQuery = "/query?db=weather&q=SELECT%%20max%%28%s%%29%%20from%%20two_year.hourly_rollup%%20WHERE%%20time%%3E%%3Dnow%%28%%29-%dd%%3BSELECT%%20min%%28%s%%29%%20from%%20two_year.hourly_rollup%%20WHERE%%20time%%3E%%3Dnow%%28%%29-%dd";
-const char *dailyRainQuery="/query?db=weather&q=SELECT%20sum%28%22rain%22%29%20from%20%22station%22%20WHERE%20time%3E%3Dnow%28%29-24h";
-const char *extendedRainQuery="/query?db=weather&q=SELECT%%20sum%%28rain%%29%%20from%%20two_year.hourly_rollup%%20WHERE%%20time%%3E%%3Dnow%%28%%29-%dd%%20AND%%20time%%20%%3C%%20now%%28%%29-24h";
-const char *avePressureQuery="/query?db=weather&q=SELECT%20mean%28pressureHg%29%20from%20station%20WHERE%20time%3E%3Dnow%28%29-2h";
+  if(rc == 200) {
+    int written = influxClient().writeToStream(query->reader);
+    if(written < 0)
+      rc = written;
+    else if(!query->reader->finish())
+      rc = HTTPC_ERROR_CONNECTION_LOST;
+    else if(query->reader->errors() > 0)
+      rc = QUERY_STATEMENT_ERROR;
+  }
 
-extern char mqttServer[MQTT_SERVER_LENGTH];
+  influxClientEnd();
 
-uint16_t doMaxMinHttpQuery(const char *url, float *high, float *low) {
-  HTTPClient hc;
+  return rc;
+}
 
-  hc.begin(url);
+static uint8_t historyMetric(uint8_t query, bool indoor) {
+  switch(query) {
+    case QUERY_TEMP:
+      return indoor ? HISTORY_ROOM_TEMP : HISTORY_TEMP;
+    case QUERY_HUM:
+      return indoor ? HISTORY_ROOM_HUM : HISTORY_HUM;
+    case QUERY_RAIN:
+      return HISTORY_RAIN;
+    default:
+      return HISTORY_PRESS;
+  }
+}
 
-  int rc=hc.GET();
+static uint32_t localDay() {
+  uint32_t now = timeNow();
+  return (now == 0) ? 0 : timeLocalDay(now);
+}
 
-  if(rc == 200) {
+static uint32_t cacheTtl(uint8_t query, uint16_t period) {
+  if(period <= 1)
+    return QUERY_TTL_DAILY_MS;
+  if(period <= 7)
+    return QUERY_TTL_WEEKLY_MS;
+  if(period <= 31)
+    return QUERY_TTL_MONTHLY_MS;
+  return QUERY_TTL_YEARLY_MS;
+}
 
-    String payload=hc.getString();
-    StaticJsonDocument<768> doc;
-    deserializeJson(doc, payload);
+static query_cache_entry_t *cacheFind(uint8_t query, bool indoor, uint16_t period) {
+  for(uint8_t n=0;n<QUERY_CACHE_SIZE;n++) {
+    query_cache_entry_t *entry = &cache[n];
+    if(entry->valid && (entry->query == query) && (entry->indoor == indoor) && (entry->period == period))
+      return entry;
+  }
+  return NULL;
+}
 
-    float min=doc["results"][1]["series"][0]["values"][0][1];
-    float max=doc["results"][0]["series"][0]["values"][0][1];
-    
-    *low =min;
-    *high=max;
-  
+// Every period ends at midnight, so nothing from yesterday is current. A
+// stale entry is kept, to be shown until its replacement comes in.
+static query_cache_entry_t *cacheFresh(uint8_t query, bool indoor, uint16_t period, bool count) {
+  query_cache_entry_t *entry = cacheFind(query, indoor, period);
+  if((entry == NULL) || entry->stale)
+    return NULL;
+
+  if(entry->day != localDay()) {
+    entry->stale = true;
+    if(count)
+      cacheStats.midnight++;
+    return NULL;
   }
 
-  hc.end();
+  if(millis() - entry->storedAt >= cacheTtl(query, period)) {
+    entry->stale = true;
+    if(count)
+      cacheStats.expired++;
+    return NULL;
+  }
 
-  return rc;
+  return entry;
+}
+
+// Takes the oldest slot when the cache is full
+static void cachePut(uint8_t query, bool indoor, uint16_t period, float high, float low) {
+  query_cache_entry_t *entry = cacheFind(query, indoor, period);
+
+  for(uint8_t n=0;(entry == NULL) && (n<QUERY_CACHE_SIZE);n++) {
+    if(!cache[n].valid)
+      entry = &cache[n];
+  }
+
+  if(entry == NULL) {
+    entry = &cache[0];
+    for(uint8_t n=1;n<QUERY_CACHE_SIZE;n++) {
+      if(millis() - cache[n].storedAt > millis() - entry->storedAt)
+        entry = &cache[n];
+    }
+  }
+
+  entry->valid = true;
+  entry->query = query;
+  entry->indoor = indoor;
+  entry->period = period;
+  entry->storedAt = millis();
+  entry->day = localDay();
+  entry->stale = false;
+  entry->high = high;
+  entry->low = low;
+}
+
+// The rain periods count days, today's included, so to InfluxDB 0 and 1
+// both mean the last 24 hours. Rain has no indoor version.
+static uint16_t planPeriod(uint8_t query, uint16_t period) {
+  return ((query == QUERY_RAIN) && (period < 2)) ? 0 : period;
+}
+
+static bool planIndoor(uint8_t query, bool indoor) {
+  return (query == QUERY_RAIN) ? false : indoor;
+}
+
+// Rain totals are by calendar day in the history store, so it is asked
+// before the period is planned
+static bool historyHas(uint8_t query, bool indoor, uint16_t period) {
+  if(query == QUERY_RAIN)
+    return historyTotalCovers(HISTORY_RAIN, period);
+  return historyCovers(historyMetric(query, indoor), period);
+}
+
+// Never waits. A stale answer is still given, for the caller to show until
+// the one it asks for with influxRequest() comes in.
+uint8_t influxPeek(uint8_t query, bool indoor, uint16_t period, float *high, float *low) {
+  if((query <= QUERY_PRESS) && historyExtremes(historyMetric(query, indoor), period, high, low))
+    return QUERY_FRESH;
+
+  if((query == QUERY_RAIN) && historyTotal(HISTORY_RAIN, period, high)) {
+    if(low != NULL)
+      *low = *high;
+    return QUERY_FRESH;
+  }
+
+  period = planPeriod(query, period);
+  indoor = planIndoor(query, indoor);
+  query_cache_entry_t *entry = cacheFind(query, indoor, period);
+  if(entry == NULL) {
+    cacheStats.misses++;
+    return QUERY_MISSING;
+  }
+
+  *high = entry->high;
+  if(low != NULL)
+    *low = entry->low;
+
+  if(cacheFresh(query, indoor, period, true) == NULL) {
+    cacheStats.misses++;
+    cacheStats.stale++;
+    return QUERY_STALE;
+  }
+
+  cacheStats.hits++;
+  return QUERY_FRESH;
+}
+
+void getQueryCacheStats(query_cache_stats_t *stats) {
+  memcpy(stats, &cacheStats, sizeof(query_cache_stats_t));
+  stats->entries = 0;
+  for(uint8_t n=0;n<QUERY_CACHE_SIZE;n++) {
+    if(cache[n].valid)
+      stats->entries++;
+  }
+}
+
+/*
+ * The plan
+ */
+
+// Extended rain is the last 24 hours plus the days before it
+static uint8_t planStatements(uint8_t query, uint16_t period) {
+  if(query == QUERY_RAIN)
+    return (period == 0) ? 1 : 2;
+  return 2;
+}
+
+static bool planHas(const query_plan_t *plan, uint8_t query, bool indoor, uint16_t period) {
+  for(uint8_t n=0;n<plan->count;n++) {
+    if((plan->items[n].query == query) && (plan->items[n].indoor == indoor) && (plan->items[n].period == period))
+      return true;
+  }
+  return false;
+}
+
+// Something already in memory, or on its way, is left out
+bool influxPlanAdd(uint8_t query, bool indoor, uint16_t period) {
+  if(historyHas(query, indoor, period))
+    return true;
+
+  period = planPeriod(query, period);
+  indoor = planIndoor(query, indoor);
+
+  if(cacheFresh(query, indoor, period, false) != NULL)
+    return true;
+
+  if(planHas(pending, query, indoor, period) || ((sent != NULL) && planHas(sent, query, indoor, period)))
+    return true;
+
+  if(pending->count == QUERY_PLAN_SIZE)
+    return false;
+
+  query_plan_item_t *item = &pending->items[pending->count++];
+  item->query = query;
+  item->indoor = indoor;
+  item->period = period;
+  item->result = pending->results;
+  pending->results += planStatements(query, period);
+
+  return true;
+}
+
+static bool planWait(query_plan_t *plan, query_done_t done, void *context) {
+  for(uint8_t n=0;n<plan->waiterCount;n++) {
+    if((plan->waiters[n].done == done) && (plan->waiters[n].context == context))
+      return true;
+  }
+
+  if(plan->waiterCount == QUERY_WAITERS)
+    return false;
+
+  plan->waiters[plan->waiterCount].done = done;
+  plan->waiters[plan->waiterCount].context = context;
+  plan->waiterCount++;
+  return true;
+}
+
+// done is called on the display task, from influxQueryLoop(), once the
+// answer is in the cache or the query failed. A caller asking for several
+// things with the same done and context is called once for each request
+// they go out in.
+bool influxRequest(uint8_t query, bool indoor, uint16_t period, query_done_t done, void *context) {
+  uint16_t planned = planPeriod(query, period);
+  bool plannedIndoor = planIndoor(query, indoor);
+
+  if((sent != NULL) && planHas(sent, query, plannedIndoor, planned))
+    return planWait(sent, done, context);
+
+  if(!influxPlanAdd(query, indoor, period))
+    return false;
+
+  // Nothing to wait for if it is already in memory
+  if(!planHas(pending, query, plannedIndoor, planned))
+    return true;
+
+  return planWait(pending, done, context);
+}
+
+static void planAppend(const char *format, ...) {
+  size_t len = strlen(planUrl);
+  va_list args;
+  va_start(args, format);
+  vsnprintf(&planUrl[len], QUERY_PLAN_URL_LENGTH - len, format, args);
+  va_end(args);
+}
+
+static void buildPlanUrl() {
+  uint16_t minutes = 0;
+
+  snprintf(planUrl, QUERY_PLAN_URL_LENGTH, "/query?db=weather&q=");
+
+  for(uint8_t n=0;n<sent->count;n++) {
+    const query_plan_item_t *item = &sent->items[n];
+    uint8_t result = item->result;
+    if(n > 0)
+      planAppend("%%3B");
+
+    switch(item->query) {
+      case QUERY_RAIN:
+        planAppend(dailyRainQuery, result);
+        if(item->period != 0) {
+          planAppend("%%3B");
+          planAppend(extendedRainQuery, result + 1, item->period);
+        }
+        break;
+      default: {
+        const query_columns_t *columns = &extremeColumns[item->query][item->indoor ? 1 : 0];
+        if(item->period == 0) {
+          if(minutes == 0)
+            minutes = timeMinutesToday();
+          planAppend(dailyExtremeQuery, "max", columns->daily, result, minutes);
+          planAppend("%%3B");
+          planAppend(dailyExtremeQuery, "min", columns->daily, result + 1, minutes);
+        } else {
+          planAppend(extendedExtremeQuery, "max", columns->extendedMax, result, item->period);
+          planAppend("%%3B");
+          planAppend(extendedExtremeQuery, "min", columns->extendedMin, result + 1, item->period);
+        }
+        break;
+      }
+    }
+  }
+}
+
+// Runs on the query task
+static int doPlanQuery(void *arg) {
+  query_plan_t *plan = (query_plan_t *)arg;
+
+#ifdef QUERY_CSV
+  InfluxResultReader reader(plan->values, plan->results, true);
+#else
+  InfluxResultReader reader(plan->values, plan->results, false);
+#endif
+  http_query_t query;
+  query.url = planUrl;
+  query.reader = &reader;
+
+  plan->rc = doHttpQuery(&query);
+  plan->done = true;
+
+  return plan->rc;
+}
+
+// Returns once everything queued on the query task before it has run
+static int queryBarrier(void *arg) {
+  return 0;
+}
+
+// After a failure nothing more is sent for QUERY_FAIL_HOLD_MS, so the panels
+// asking one after another don't each wait out a timeout
+static bool planHeld() {
+  return (failedRc != 0) && (millis() - failedAt < QUERY_FAIL_HOLD_MS);
+}
+
+static void planClear(query_plan_t *plan) {
+  plan->count = 0;
+  plan->results = 0;
+  plan->waiterCount = 0;
+}
 
+static void planNotify(query_plan_t *plan, int rc) {
+  query_waiter_t waiters[QUERY_WAITERS];
+  uint8_t count = plan->waiterCount;
+
+  // The callbacks may ask for more, so the plan is free before they run
+  memcpy(waiters, plan->waiters, count * sizeof(query_waiter_t));
+  planClear(plan);
+
+  for(uint8_t n=0;n<count;n++)
+    waiters[n].done(waiters[n].context, rc);
 }
 
-uint16_t influxGetDailyMaxMin(const char *column, float *high, float *low) {
-  char url[256];
-  char uri[256];
+// Every statement of the pending plan in one request, sent by whoever calls
+// queryRun() or queryPost() on it next
+static void planSend() {
+  sent = pending;
+  pending = (sent == &plans[0]) ? &plans[1] : &plans[0];
+  planClear(pending);
+
+  sent->done = false;
+  sent->rc = -1;
+  buildPlanUrl();
 
-  struct  tm dt;
-  uint16_t minutes=0;
+  cacheStats.requests++;
+  cacheStats.statements += sent->results;
+}
+
+static int planComplete() {
+  query_plan_t *plan = sent;
+  int rc = plan->rc;
 
-  // Issue: when starting from a power up or reset, getLocalTime always times out
-  // on each panel as it is built. Even putting displayInit in the main loop, does
-  // not solve the problem
-  if(getLocalTime(&dt,1000)) {
-    minutes = dt.tm_hour * 60 + dt.tm_min;
+  if(rc == 200) {
+    failedRc = 0;
+    for(uint8_t n=0;n<plan->count;n++) {
+      const query_plan_item_t *item = &plan->items[n];
+      float first = plan->values[item->result];
+
+      if(item->query == QUERY_RAIN) {
+        cachePut(QUERY_RAIN, false, 0, first, first);
+        if(item->period != 0) {
+          float total = first + plan->values[item->result + 1];
+          cachePut(QUERY_RAIN, false, item->period, total, total);
+        }
+      } else {
+        float low = plan->values[item->result + 1];
+        cachePut(item->query, item->indoor, item->period, first, low);
+      }
+    }
   } else {
-    minutes = 1440;
+    failedRc = rc;
+    failedAt = millis();
   }
 
-  sprintf(uri,dailyMinMaxQuery,column,minutes,column,minutes);
-  sprintf(url,"http://%s:8086%s",mqttServer,uri);
-  
-  return doMaxMinHttpQuery(url, high, low);
+  sent = NULL;
+  planNotify(plan, rc);
 
+  return rc;
 }
 
-uint16_t influxGetExtendedMaxMin(const char *maxCol, const char *minCol, uint16_t timeLen, float *high, float *low) {
-  char url[256];
-  char uri[256];
-  
-  sprintf(uri,extendedMinMaxQuery,maxCol,timeLen,minCol,timeLen);
-  sprintf(url,"http://%s:8086%s",mqttServer,uri);
+// Sends the pending plan and waits for it, after the one already out
+int influxPlanRun() {
+  if(sent != NULL) {
+    queryRun(queryBarrier, NULL);
+    planComplete();
+  }
+
+  if(pending->count == 0)
+    return 200;
+
+  if(planHeld()) {
+    planNotify(pending, failedRc);
+    return failedRc;
+  }
+
+  planSend();
+  queryRun(doPlanQuery, sent);
+
+  return planComplete();
+}
+
+// The periods the panels can be switched to. Today's values are showing, so
+// the panels keep those fresh themselves. The rain periods run from the start
+// of the month and the year, like the rain panel's, and are only fetched
+// until the history store covers them.
+static bool prefetchAdd() {
+  static const uint16_t extremePeriods[] = {7, 30, 365};
+  bool all = true;
+
+  for(uint8_t p=0;p<sizeof(extremePeriods)/sizeof(extremePeriods[0]);p++) {
+    all &= influxPlanAdd(QUERY_TEMP, false, extremePeriods[p]);
+    all &= influxPlanAdd(QUERY_TEMP, true, extremePeriods[p]);
+    all &= influxPlanAdd(QUERY_HUM, false, extremePeriods[p]);
+    all &= influxPlanAdd(QUERY_HUM, true, extremePeriods[p]);
+    all &= influxPlanAdd(QUERY_PRESS, false, extremePeriods[p]);
+  }
+
+  struct tm dt;
+  timeLocal(&dt);
+
+  const uint16_t rainPeriods[] = {7, (uint16_t)dt.tm_mday, (uint16_t)(dt.tm_yday + 1)};
+  for(uint8_t p=0;p<sizeof(rainPeriods)/sizeof(rainPeriods[0]);p++) {
+    // Early in the month or year that is only the last 24 hours
+    if(planPeriod(QUERY_RAIN, rainPeriods[p]) != 0)
+      all &= influxPlanAdd(QUERY_RAIN, false, rainPeriods[p]);
+  }
 
-  return doMaxMinHttpQuery(url,high,low);
+  return all;
+}
+
+// Only runs with nothing pending, so it never holds up what a panel asked
+// for. A sweep that did not fit in one plan carries on when that one is back.
+static void prefetch() {
+  if(prefetched && (millis() - prefetchAt < QUERY_PREFETCH_MS))
+    return;
+
+  if(!timeValid())
+    return;
+
+  prefetched = prefetchAdd();
+  prefetchAt = millis();
+  cacheStats.prefetched += pending->count;
+}
+
+// Called from the display loop. Hands back the answers to the plan that was
+// out, and sends whatever has been asked for since, or prefetches.
+void influxQueryLoop() {
+  if(sent != NULL) {
+    if(!sent->done)
+      return;
+
+    int rc = planComplete();
+    if(rc != 200) {
+      char error[70];
+      snprintf(error, sizeof(error), "Background Query returned %d", rc);
+      setError(error);
+    }
+  }
+
+  if(planHeld())
+    return;
+
+  if(pending->count == 0)
+    prefetch();
+
+  if(pending->count == 0)
+    return;
+
+  planSend();
+  if(!queryPost(doPlanQuery, sent))
+    sent->done = true;
+}
+
+// Memory first: the history store, then the cache, and InfluxDB last
+static int fetch(uint8_t query, bool indoor, uint16_t period, float *high, float *low) {
+  if(influxPeek(query, indoor, period, high, low) == QUERY_FRESH)
+    return 200;
+
+  influxPlanAdd(query, indoor, period);
+  int rc = influxPlanRun();
+
+  query_cache_entry_t *entry = cacheFresh(query, planIndoor(query, indoor), planPeriod(query, period), false);
+  if((rc == 200) && (entry != NULL)) {
+    *high = entry->high;
+    if(low != NULL)
+      *low = entry->low;
+  }
+
+  return rc;
 }
 
 uint8_t influxGetExtendedHighLowTemp(bool indoor, uint16_t timeLen, float *high, float *low)
 {
-  uint16_t rc=0;
-  if(indoor) {
-    rc=influxGetExtendedMaxMin("max_room_temp","min_room_temp",timeLen,high,low);
-  } else {
-    rc=influxGetExtendedMaxMin("max_temp","min_temp",timeLen,high,low);
-  }
+  int rc=fetch(QUERY_TEMP, indoor, timeLen, high, low);
 
   uint8_t retval=0;
   if(rc!=200) {
@@ -119,12 +643,7 @@ uint8_t influxGetExtendedHighLowTemp(bool indoor, uint16_t timeLen, float *high,
 
 uint8_t influxGetDailyHighLowTemp(bool indoor, float *high, float *low) {
 
-  uint16_t rc=0;
-
-  if(indoor)
-    rc = influxGetDailyMaxMin("room_temp",high,low);
-  else  
-    rc = influxGetDailyMaxMin("temperature",high,low);
+  int rc=fetch(QUERY_TEMP, indoor, 0, high, low);
   
   uint8_t retval=0;
   if(rc!=200) {
@@ -138,12 +657,7 @@ uint8_t influxGetDailyHighLowTemp(bool indoor, float *high, float *low) {
 }
 
 uint8_t influxGetDailyHighLowHum(bool indoor,float *high, float *low) {
-  uint16_t rc=0;
-
-  if(indoor)
-    rc = influxGetDailyMaxMin("room_hum",high,low);
-  else  
-    rc = influxGetDailyMaxMin("humidity",high,low);
+  int rc=fetch(QUERY_HUM, indoor, 0, high, low);
 
   uint8_t retval=0;
   if(rc!=200) {
@@ -157,12 +671,7 @@ uint8_t influxGetDailyHighLowHum(bool indoor,float *high, float *low) {
 }
 
 uint8_t influxGetExtendedHighLowHum(bool indoor, uint16_t timeLen, float *high, float *low) {
-  uint16_t rc=0;
-  if(indoor) {
-    rc=influxGetExtendedMaxMin("max_room_hum","min_room_hum",timeLen,high,low);
-  } else {
-    rc=influxGetExtendedMaxMin("max_humidity","min_humidity",timeLen,high,low);
-  }
+  int rc=fetch(QUERY_HUM, indoor, timeLen, high, low);
 
   uint8_t retval=0;
   if(rc!=200) {
@@ -176,7 +685,7 @@ uint8_t influxGetExtendedHighLowHum(bool indoor, uint16_t timeLen, float *high,
 }
 
 uint8_t influxGetDailyHighLowPress(float *high, float *low) {
-  uint16_t rc=influxGetDailyMaxMin("pressureHg", high, low);
+  int rc=fetch(QUERY_PRESS, false, 0, high, low);
   uint8_t retval =0;
   if(rc != 200) {
     retval =1;
@@ -190,7 +699,7 @@ uint8_t influxGetDailyHighLowPress(float *high, float *low) {
 }
 
 uint8_t influxGetExtendedHighLowPress(uint16_t timeLen, float *high, float *low) {
-  uint16_t rc=influxGetExtendedMaxMin("max_pressureHg","min_pressureHg", timeLen, high, low);
+  int rc=fetch(QUERY_PRESS, false, timeLen, high, low);
 
   uint8_t retval=0;
   if(rc != 200) {
@@ -202,61 +711,13 @@ uint8_t influxGetExtendedHighLowPress(uint16_t timeLen, float *high, float *low)
   return retval;
 }
 
-uint8_t influxGetAveragePressure(float *ave) {
-  char url[256];
-
-  sprintf(url,"http://%s:8086%s",mqttServer,avePressureQuery);
-  
-  HTTPClient hc;
-
-  hc.begin(url);
-
-  uint8_t retval = 0;
-  int rc=hc.GET();
-
-  if(rc == 200) {
-
-    String payload=hc.getString();
-    StaticJsonDocument<768> doc;
-    deserializeJson(doc, payload);
-
-    *ave=doc["results"][0]["series"][0]["values"][0][1];
-    
-    Serial.printf("Ave Pressure %f\n",*ave);
-
-  } else {
-    retval = 1;
-    char error[70];
-    sprintf(error,"Average Pressure Query returned %d", rc);
-    setError(error);
-  }
-
-
-  hc.end();
-  return retval;
-
-}
-
 uint8_t influxGetDailyRain(float *rain) {
-  char url[256];
-  sprintf(url,"http://%s:8086%s",mqttServer,dailyRainQuery);
-
-  HTTPClient hc;
-
-  hc.begin(url);
-
   uint8_t retval = 0;
-  int rc=hc.GET();
+  int rc=fetch(QUERY_RAIN, false, 0, rain, NULL);
 
   if(rc == 200) {
 
-    String payload=hc.getString();
-    StaticJsonDocument<768> doc;
-    deserializeJson(doc, payload);
-
-    *rain=doc["results"][0]["series"][0]["values"][0][1];
-    
-    Serial.printf("Rain %f\n",*rain);
+    DEBUG_PRINTF("Rain %f\n",*rain);
 
   } else {
     retval = 1;
@@ -265,52 +726,24 @@ uint8_t influxGetDailyRain(float *rain) {
     setError(error);
   }
 
-
-  hc.end();
-
   return retval;
 }
 
+// The last 24 hours from station, and the days before that from the rollup
 uint8_t influxGetExtendedRain(uint16_t timeLen,float *rain) {
-  char url[256];
-  char uri[256];
-
-  uint8_t retval = influxGetDailyRain(rain);
-  if(timeLen <2)
-    return retval;
-
-  if(retval !=0)
-    return retval;
-
-  sprintf(uri,extendedRainQuery,timeLen);
-  sprintf(url,"http://%s:8086%s",mqttServer,uri);
-  
-  HTTPClient hc;
-
-  hc.begin(url);
-  int rc=hc.GET();
-  float newRain=0.0;
+  uint8_t retval = 0;
+  int rc=fetch(QUERY_RAIN, false, timeLen, rain, NULL);
 
   if(rc == 200) {
 
-    String payload=hc.getString();
-    StaticJsonDocument<768> doc;
-    deserializeJson(doc, payload);
-
-    newRain=doc["results"][0]["series"][0]["values"][0][1];
-    
-    Serial.printf("newRain %f\n",newRain);
-    *rain+=newRain;
+    DEBUG_PRINTF("Rain %f\n",*rain);
 
   } else {
     retval = 1;
     char error[70];
-    sprintf(error,"Daily Rain Query returned %d", rc);
+    sprintf(error,"%s Rain Query returned %d", (timeLen < 2) ? "Daily" : "Extended", rc);
     setError(error);
   }
 
-
-  hc.end();
-
   return retval;
-}
\ No newline at end of file
+}
@@ -27,16 +27,17 @@
 #include "Adafruit_RA8875.h"
 #include "display.h"
 #include "InfluxDbQueries.h"
-#include "time.h"
+#include "timekeeper.h"
 
 RainPanel::RainPanel(Adafruit_RA8875 *_tft, uint16_t _x, uint16_t _y) {
   tft = _tft;
   x_org = _x;
   y_org = _y;
   current = 0.0;
-  getDailyRain();
+  stale = false;
   refreshCount=0;
   rainPeriod=DAILY;
+  getRain();
 
   rainDirty = true;
   borderDirty = true;
@@ -64,7 +65,6 @@ void RainPanel::draw() {
   }
 
   if(rainDirty) {
-    struct tm dt;
     redrawBackgroundSection(x_org+ 10, y_org+40, RAIN_WIDTH-90, RAIN_HEIGTH - 42);
 
     tft->textMode();
@@ -75,24 +75,18 @@ void RainPanel::draw() {
 
     switch(rainPeriod) {
       case DAILY:
-        getDailyRain();
         tft->textSetCursor(x_org+(RAIN_WIDTH/2)-(7*8/2),y_org+100);
         printString("24 Hour");
         break;
       case WEEKLY:
-        getExtendedRain(7);
         tft->textSetCursor(x_org+(RAIN_WIDTH/2)-(6*8/2),y_org+100);
         printString("7 Days");
         break;
       case MONTHLY:
-        getLocalTime(&dt);
-        getExtendedRain(dt.tm_mday);
         tft->textSetCursor(x_org+(RAIN_WIDTH/2)-(13*8/2),y_org+100);
         printString("Month to Date");
         break;
       case YEARLY:
-        getLocalTime(&dt);
-        getExtendedRain(dt.tm_yday);
         tft->textSetCursor(x_org+(RAIN_WIDTH/2)-(12*8/2),y_org+100);
         printString("Year to Date");
         break;      
@@ -100,6 +94,11 @@ void RainPanel::draw() {
         break;
     }
 
+    // Right after the period, until the history store covers it or the
+    // callback redraws with the new total
+    if(stale)
+      printString("*");
+
     setArialFont();
     tft->textEnlarge(1);
     tft->textSetCursor(x_org+30,y_org+30);
@@ -119,17 +118,36 @@ void RainPanel::draw() {
 
 }
 
+// The month and year to date start from the new day
+void RainPanel::newDay() {
+  getRain();
+  rainDirty = true;
+  draw();
+}
+
+// The history store already has the reading, so the total is read again from
+// memory every time, and only drawn when it changed. Until the store covers
+// the period it comes from the cache, which may not have the reading yet.
 void RainPanel::setRain(float rain) {
-  if(rain!=0.0) {
-    rainDirty=true;
-    draw();
-  } else if(++refreshCount>9) {
-    refreshCount=0;
-    rainPeriod=DAILY;
-    rainDirty=true;
-    draw();
+  float oldTotal = current;
+  bool wasStale = stale;
+
+  // Back to the last 24 hours ten readings after a touch
+  if(refreshCount++ > 9) {
+    refreshCount = 0;
+    if(rainPeriod != DAILY) {
+      rainPeriod = DAILY;
+      rainDirty = true;
+    }
   }
 
+  getRain();
+
+  if((current != oldTotal) || (stale != wasStale))
+    rainDirty = true;
+
+  if(rainDirty)
+    draw();
 }
 
 bool RainPanel::isClicked(uint16_t x, uint16_t y) {
@@ -154,6 +172,7 @@ bool RainPanel::isClicked(uint16_t x, uint16_t y) {
     rainDirty = true;
     
     refreshCount = 0;
+    getRain();
     draw();
     return true;
   }
@@ -161,14 +180,46 @@ bool RainPanel::isClicked(uint16_t x, uint16_t y) {
   return false;
 }
 
-void RainPanel::getDailyRain() {
-  influxGetDailyRain(&current);
+// Whatever is in memory now, and rainReady() once the rest is in. The
+// periods are days, today's included, and 0 for the last 24 hours.
+void RainPanel::getRain() {
+  struct tm dt;
+  uint16_t days = 0;
+  float total;
 
-  rainDirty = true;
+  switch(rainPeriod) {
+    case WEEKLY:
+      days = 7;
+      break;
+    case MONTHLY:
+      timeLocal(&dt);
+      days = dt.tm_mday;
+      break;
+    case YEARLY:
+      timeLocal(&dt);
+      days = dt.tm_yday + 1;
+      break;
+    default:
+      break;
+  }
+
+  stale = false;
+  uint8_t state = influxPeek(QUERY_RAIN, false, days, &total, NULL);
+  if(state != QUERY_FRESH) {
+    influxRequest(QUERY_RAIN, false, days, rainReady, this);
+    stale = true;
+  }
+
+  if(state != QUERY_MISSING)
+    current = total;
 }
 
-void RainPanel::getExtendedRain(uint16_t timeLen) {
-  influxGetExtendedRain(timeLen,&current);
+void RainPanel::rainReady(void *panel, int rc) {
+  if(rc != 200)
+    return;
 
-  rainDirty=true;
+  RainPanel *p = (RainPanel *)panel;
+  p->getRain();
+  p->rainDirty = true;
+  p->draw();
 }
\ No newline at end of file
@@ -40,10 +40,11 @@ TemperaturePanel::TemperaturePanel(Adafruit_RA8875 *_tft, uint16_t _x, uint16_t
 
   indoor = _indoor;  
   
-  getDailyExtremes();
+  stale = false;
   refreshCount=0;
 
   highlow=DAILY;
+  getExtremes();
 
   tempDirty = true;
   borderDirty = true;
@@ -53,34 +54,42 @@ TemperaturePanel::TemperaturePanel(Adafruit_RA8875 *_tft, uint16_t _x, uint16_t
 
 void TemperaturePanel::setTemperature(int8_t temperature) {
 
+  int8_t oldHigh = high;
+  int8_t oldLow = low;
+
+  // Back to the daily extremes ten readings after a touch
   if(refreshCount++ > 9) {
     refreshCount = 0;
-    highlow=DAILY;
-    extremeDirty = true;
-  } else if(temperature == current) {
-    if(extremeDirty)
-      draw();
-    return;
+    if(highlow != DAILY) {
+      highlow = DAILY;
+      extremeDirty = true;
+    }
   }
 
-  tempDirty = true;
-
   if (temperature < -99)
     temperature = -99;
 
-  current = temperature;
+  // The history store already has this reading and starts the day over at
+  // midnight, so the extremes are read again every time. Until it covers the
+  // period they come from the cache, which may not have the reading yet.
+  getExtremes();
 
-  if(temperature < low) {
-    extremeDirty = true;
+  if(temperature < low)
     low = temperature;
-  }
 
-  if(temperature > high) {
-    extremeDirty = true;
+  if(temperature > high)
     high = temperature;
+
+  if((high != oldHigh) || (low != oldLow))
+    extremeDirty = true;
+
+  if(temperature != current) {
+    current = temperature;
+    tempDirty = true;
   }
 
-  draw();
+  if(tempDirty || extremeDirty)
+    draw();
 
 }
 
@@ -188,39 +197,80 @@ void TemperaturePanel::drawExtremes() {
   setSmallArialFont();
   switch(highlow) {
     case DAILY:
-      getDailyExtremes();
       tft->textSetCursor(x_org+(TEMP_WIDTH/2)-24,y_org+TEMP_XTREME_YOFFSET+15);
       printString("Daily");
       break;
     case WEEKLY:
-      getExtendedExtremes(7);
       tft->textSetCursor(x_org+(TEMP_WIDTH/2)-29,y_org+TEMP_XTREME_YOFFSET+15);
       printString("Weekly");
       break;
     case MONTHLY:
-      getExtendedExtremes(30);
       tft->textSetCursor(x_org+(TEMP_WIDTH/2)-34,y_org+TEMP_XTREME_YOFFSET+15);
       printString("Monthly");
       break;
     case YEARLY:
-      getExtendedExtremes(365);
       tft->textSetCursor(x_org+(TEMP_WIDTH/2)-29,y_org+TEMP_XTREME_YOFFSET+15);
       printString("Yearly");
       break;      
     default:
       break;
   }
+
+  // Right after the period, until the callback redraws with the new values
+  if(stale)
+    printString("*");
   
   drawCenteredArial((3*8)/2+25+x_org,y_org+TEMP_XTREME_YOFFSET+15,low);
   drawCenteredArial(x_org+(TEMP_WIDTH -27 -(4*8)/2),y_org+TEMP_XTREME_YOFFSET+15,high);
 }
 
+// Today's extremes start over, and the longer periods move on a day
+void TemperaturePanel::newDay() {
+  int8_t oldHigh = high;
+  int8_t oldLow = low;
+
+  getExtremes();
+  if((high != oldHigh) || (low != oldLow))
+    extremeDirty = true;
+
+  if(extremeDirty)
+    draw();
+}
+
+// For the period showing, from memory where it can be
+void TemperaturePanel::getExtremes() {
+  stale = false;
+  switch(highlow) {
+    case DAILY:
+      getDailyExtremes();
+      break;
+    case WEEKLY:
+      getExtendedExtremes(7);
+      break;
+    case MONTHLY:
+      getExtendedExtremes(30);
+      break;
+    case YEARLY:
+      getExtendedExtremes(365);
+      break;
+    default:
+      break;
+  }
+}
+
 void TemperaturePanel::getDailyExtremes() {
 
   float newHigh,newLow;
 
-  if(influxGetDailyHighLowTemp(indoor, &newHigh, &newLow))
-    return;       //Some error occured
+  // Whatever is in memory now, and extremesReady() once the rest is in
+  uint8_t state = influxPeek(QUERY_TEMP, indoor, 0, &newHigh, &newLow);
+  if(state != QUERY_FRESH) {
+    influxRequest(QUERY_TEMP, indoor, 0, extremesReady, this);
+    stale = true;
+  }
+
+  if(state == QUERY_MISSING)
+    return;
 
   // Round Up
   newHigh += 0.5;
@@ -228,15 +278,21 @@ void TemperaturePanel::getDailyExtremes() {
 
   high = newHigh;
   low = newLow;
-
-  extremeDirty = true;
 }
 
 void TemperaturePanel::getExtendedExtremes(uint16_t timeLen) {
   float newHigh, newLow;
+
+  // Both periods go out in the same request
   getDailyExtremes();
 
-  if(influxGetExtendedHighLowTemp(indoor, timeLen, &newHigh, &newLow))
+  uint8_t state = influxPeek(QUERY_TEMP, indoor, timeLen, &newHigh, &newLow);
+  if(state != QUERY_FRESH) {
+    influxRequest(QUERY_TEMP, indoor, timeLen, extremesReady, this);
+    stale = true;
+  }
+
+  if(state == QUERY_MISSING)
     return;
   
   Serial.printf("newHigh %f newLow %f\n",newHigh,newLow);
@@ -248,9 +304,8 @@ void TemperaturePanel::getExtendedExtremes(uint16_t timeLen) {
 
   high = newHigh;
   low = newLow;
-
-  extremeDirty = true;
 }
+
 bool TemperaturePanel::isClicked(uint16_t x, uint16_t y) {
 
   if((x>(x_org+TEMP_CLICK_MIN_X))&&(y>(y_org+TEMP_CLICK_MIN_Y))&&(x<(x_org+TEMP_CLICK_MAX_X))&&(y<(y_org+TEMP_XTREME_YOFFSET+TEMP_CLICK_MAX_Y))) {
@@ -271,6 +326,7 @@ bool TemperaturePanel::isClicked(uint16_t x, uint16_t y) {
     }
     
     refreshCount = 0;
+    getExtremes();
     draw();
     return true;
   }
@@ -278,4 +334,12 @@ bool TemperaturePanel::isClicked(uint16_t x, uint16_t y) {
   return false;
 }
 
+void TemperaturePanel::extremesReady(void *panel, int rc) {
+  if(rc != 200)
+    return;
 
+  TemperaturePanel *p = (TemperaturePanel *)panel;
+  p->getExtremes();
+  p->extremeDirty = true;
+  p->draw();
+}
@@ -0,0 +1,99 @@
+/**
+ *  @filename   :   capture.cpp
+ *  @brief      :   ESP32 Weather Base Station ESP-NOW Frame Capture
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <Arduino.h>
+#include "ingestqueue.h"
+#include "capture.h"
+
+static const char hexDigits[] = "0123456789abcdef";
+
+static int hexValue(char c) {
+  if((c >= '0') && (c <= '9'))
+    return c - '0';
+  if((c >= 'a') && (c <= 'f'))
+    return c - 'a' + 10;
+  if((c >= 'A') && (c <= 'F'))
+    return c - 'A' + 10;
+  return -1;
+}
+
+static char *writeHex(char *p, const uint8_t *data, uint8_t len) {
+  for(uint8_t n=0;n<len;n++) {
+    *p++ = hexDigits[data[n] >> 4];
+    *p++ = hexDigits[data[n] & 0x0f];
+  }
+  return p;
+}
+
+// Returns the number of bytes read, stopping at the first non hex character
+static int readHex(const char *p, uint8_t *data, int max) {
+  int n = 0;
+  while(n < max) {
+    int high = hexValue(p[0]);
+    if(high < 0)
+      break;
+    int low = hexValue(p[1]);
+    if(low < 0)
+      return -1;
+
+    data[n++] = (high << 4) | low;
+    p += 2;
+  }
+  return n;
+}
+
+// Built in one buffer, so a line is never split by other output
+void captureWrite(Print &out, const ingest_frame_t *frame) {
+  char line[CAPTURE_LINE_LENGTH];
+
+  char *p = line + sprintf(line, CAPTURE_PREFIX "%lld ", (long long)frame->rxMicros);
+  p = writeHex(p, frame->mac, 6);
+  *p++ = ' ';
+  p = writeHex(p, frame->data, frame->len);
+  *p++ = '\n';
+
+  out.write((const uint8_t *)line, p - line);
+}
+
+bool captureRead(const char *line, ingest_frame_t *frame) {
+  if(strncmp(line, CAPTURE_PREFIX, strlen(CAPTURE_PREFIX)) != 0)
+    return false;
+
+  char *p;
+  frame->rxMicros = strtoll(line + strlen(CAPTURE_PREFIX), &p, 10);
+  if(*p++ != ' ')
+    return false;
+
+  if(readHex(p, frame->mac, 6) != 6)
+    return false;
+  p += 12;
+  if(*p++ != ' ')
+    return false;
+
+  int len = readHex(p, frame->data, INGEST_MAX_FRAME);
+  if(len <= 0)
+    return false;
+
+  frame->len = len;
+  return true;
+}
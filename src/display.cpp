@@ -24,10 +24,10 @@
 #include <Arduino.h>
 #include <SPI.h>
 #include <time.h>
-#include "Ticker.h"
 #include "Adafruit_GFX.h"
 #include "Adafruit_RA8875.h"
 #include "Adafruit_I2CDevice.h"
+#include "weatherbase.h"
 #include "display.h"
 #include "wifiwithmqtt.h"
 #include "PanelBase.h"
@@ -39,6 +39,10 @@
 #include "BaroPanel.h"
 #include "WindPanel.h"
 #include "FT5206.h"
+#include "tasks.h"
+#include "logqueue.h"
+#include "InfluxDbQueries.h"
+#include "timekeeper.h"
 
 Adafruit_RA8875 tft = Adafruit_RA8875(CS, RST);
 
@@ -51,12 +55,6 @@ RainPanel *rp;
 BaroPanel *bp;
 WindPanel *wp;
 
-void resetTickerCallback(void);
-void dataTickerCallback(void);
-
-Ticker dataTimer(dataTickerCallback,300000); // 5 minutes
-
-
 static void waitForSignal(){
   uint16_t count=0;
   while(digitalRead(WAIT_PIN)!=1) {
@@ -184,19 +182,28 @@ void display_panels() {
   ep = new ErrorPanel(&tft);
   ep->draw();
 
+  // Everything the panel constructors ask for, in one request
+  influxPlanAdd(QUERY_TEMP, false, 0);
+  influxPlanAdd(QUERY_TEMP, true, 0);
+  influxPlanAdd(QUERY_HUM, false, 0);
+  influxPlanAdd(QUERY_HUM, true, 0);
+  influxPlanAdd(QUERY_RAIN, false, 0);
+  influxPlanAdd(QUERY_PRESS, false, 0);
+  influxPlanRun();
+
   if(first==NULL) {
     first = (PanelList *)malloc(sizeof(PanelList));
   }
 
-  log("temperature","Temp 1 Create");
+  LOG_DEBUG("temperature","Temp 1 Create");
   tp1 = new TemperaturePanel(&tft, 0, 30, 75,false);
   tp1->draw();
 
-  log("temperature","Temp 2 Create");
+  LOG_DEBUG("temperature","Temp 2 Create");
   tp2 = new TemperaturePanel(&tft, 549, 30, 75,true);
   tp2->draw();
 
-  log("temperature","Hum 1 Create");
+  LOG_DEBUG("temperature","Hum 1 Create");
   hp1 = new HumidityPanel(&tft,0,261,50,false);
   hp1->draw();
 
@@ -265,16 +272,12 @@ void tftCTPTouch(uint16_t x, uint16_t y) {
 void displayData(float temperature, int32_t pressure, float humidity, float battery_millivolts, uint16_t direction, float anemometer, float rain, float roomTemp, float roomHum) {
 
   ep->clearMessage();
-  
-  dataTimer.stop();  //Reset the error timer
-  dataTimer.start();
 
-  
-  tp1->setTemperature((int8_t)((9.0/5.0 * temperature) + 32.0 + 0.5));
+  tp1->setTemperature((int8_t)(fahrenheit(temperature) + 0.5));
   hp1->setHumidity((uint8_t)(humidity+0.5));
 
   if(roomHum != 101.0) {
-    tp2->setTemperature((int8_t)((9.0/5.0 * roomTemp) + 32.0 + 0.5));
+    tp2->setTemperature((int8_t)(fahrenheit(roomTemp) + 0.5));
     hp2->setHumidity((uint8_t)(roomHum +0.5));
   }
 
@@ -282,38 +285,62 @@ void displayData(float temperature, int32_t pressure, float humidity, float batt
 
   rp->setRain(rain);
 
-  float altitude=138.0;
-  float altPressure=(float)(pressure)/(pow((1-altitude/44330.0),5.255));
-  float hgPressure = altPressure/3386.39;
-
-  bp->setBarometer(hgPressure);
+  bp->setBarometer(seaLevelInHg(pressure));
 
   wp->setWind(anemometer,direction);
 }
 
+// The date and every daily value start over
+void displayMidnight() {
+  if(headp != NULL)
+    headp->draw();
+
+  PanelList *p = first;
+  while(p!=NULL) {
+    p->p->newDay();
+    p = p->next;
+  }
+}
+
+// From timekeeper, on the network task
+static void midnight(uint32_t now) {
+  postDisplayMidnight();
+}
+
 void setError(const char *errStr) {
+  // Only the display task may touch the screen
+  if(!onDisplayTask()) {
+    postDisplayError(errStr);
+    return;
+  }
+
   if(ep == NULL)
     return;
 
   ep->setMessage(errStr);
-  log("errorpanel", errStr);
+  LOG_ERROR("errorpanel", errStr);
 }
 
 void displayLoop(void) {
 
   checkTouch();
 
-  dataTimer.update();
-}
-
-void resetTickerCallback() {
-  Serial.println("!!!!!Reset Timer!!!!!!!");
-
+  // Whatever the panels asked for since the last time goes out as one request
+  influxQueryLoop();
 }
 
-void dataTickerCallback() {
+// The network task checks the stations and posts this, so the station table
+// is only touched there. mac is blank for the primary station.
+void displayStale(const char *mac) {
   Serial.println("!!!!!!!!Data Timeout!!!!!!!!!!");
-  ep->setMessage("Error: No Data from station in 5 Minutes");
+
+  if(mac[0] == '\0') {
+    ep->setMessage("Error: No Data from station in 5 Minutes");
+  } else {
+    char errStr[70];
+    sprintf(errStr, "Error: No Data from %s in 5 Minutes", mac);
+    setError(errStr);
+  }
 }
 
 void initDisplay() {
@@ -336,9 +363,10 @@ void initDisplay() {
 
   background_panel();
   display_panels();
-  dataTimer.start();
+  timeOnMidnight(midnight);
 }
 
+// Queued for the network task, see logqueue.cpp
 void log(const char *system, const char *message) {
-  logMessage(system, message);
+  LOG_INFO(system, message);
 }
\ No newline at end of file
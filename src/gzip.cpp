@@ -0,0 +1,188 @@
+/**
+ *  @filename   :   gzip.cpp
+ *  @brief      :   ESP32 Weather Base Station Small Gzip Encoder
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <Arduino.h>
+#include "gzip.h"
+
+#define MIN_MATCH 3
+#define MAX_MATCH 258
+#define HASH_SIZE (1 << GZIP_HASH_BITS)
+
+static const uint16_t lengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+  35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uint8_t lengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+  3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const uint16_t distBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+  257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const uint8_t distExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+  7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+static const uint32_t crcNibble[16] = {
+  0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+  0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c
+};
+
+typedef struct bit_writer_t {
+  uint8_t *out;
+  size_t size;
+  size_t pos;
+  uint32_t bits;
+  uint8_t count;
+  bool overflow;
+} bit_writer_t;
+
+static void putByte(bit_writer_t *w, uint8_t b) {
+  if(w->pos < w->size)
+    w->out[w->pos++] = b;
+  else
+    w->overflow = true;
+}
+
+// Deflate packs everything least significant bit first
+static void putBits(bit_writer_t *w, uint32_t value, uint8_t n) {
+  w->bits |= value << w->count;
+  w->count += n;
+  while(w->count >= 8) {
+    putByte(w, w->bits & 0xff);
+    w->bits >>= 8;
+    w->count -= 8;
+  }
+}
+
+// except Huffman codes, which go most significant bit first
+static void putCode(bit_writer_t *w, uint16_t code, uint8_t n) {
+  uint16_t reversed = 0;
+  for(uint8_t i=0;i<n;i++) {
+    reversed = (reversed << 1) | (code & 1);
+    code >>= 1;
+  }
+  putBits(w, reversed, n);
+}
+
+static void putSymbol(bit_writer_t *w, uint16_t symbol) {
+  if(symbol < 144)
+    putCode(w, 0x30 + symbol, 8);
+  else if(symbol < 256)
+    putCode(w, 0x190 + symbol - 144, 9);
+  else if(symbol < 280)
+    putCode(w, symbol - 256, 7);
+  else
+    putCode(w, 0xc0 + symbol - 280, 8);
+}
+
+static void putMatch(bit_writer_t *w, uint16_t length, uint16_t distance) {
+  uint8_t n = 28;
+  while(lengthBase[n] > length)
+    n--;
+  putSymbol(w, 257 + n);
+  putBits(w, length - lengthBase[n], lengthExtra[n]);
+
+  n = 29;
+  while(distBase[n] > distance)
+    n--;
+  putCode(w, n, 5);
+  putBits(w, distance - distBase[n], distExtra[n]);
+}
+
+static uint16_t hash3(const uint8_t *p) {
+  uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16);
+  return (uint32_t)(v * 2654435761UL) >> (32 - GZIP_HASH_BITS);
+}
+
+uint32_t gzipCrc32(const uint8_t *data, size_t len) {
+  uint32_t crc = 0xffffffff;
+  for(size_t n=0;n<len;n++) {
+    crc ^= data[n];
+    crc = (crc >> 4) ^ crcNibble[crc & 0x0f];
+    crc = (crc >> 4) ^ crcNibble[crc & 0x0f];
+  }
+
+  return ~crc;
+}
+
+// Returns the compressed length, or 0 if the input is too big or the output
+// does not fit, in which case send it as it is
+size_t gzipCompress(const uint8_t *in, size_t len, uint8_t *out, size_t outSize) {
+  static uint16_t head[HASH_SIZE];  // Position + 1 of the last string with each hash
+
+  if(len > GZIP_MAX_INPUT)
+    return 0;
+
+  bit_writer_t w = {out, outSize, 0, 0, 0, false};
+
+  static const uint8_t header[10] = {0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 0xff};
+  for(uint8_t n=0;n<sizeof(header);n++)
+    putByte(&w, header[n]);
+
+  putBits(&w, 1, 1);                // Last block
+  putBits(&w, 1, 2);                // Fixed Huffman codes
+
+  memset(head, 0, sizeof(head));
+
+  size_t pos = 0;
+  while(pos < len) {
+    uint16_t matchLength = 0;
+    size_t candidate = 0;
+
+    if(pos + MIN_MATCH <= len) {
+      uint16_t h = hash3(&in[pos]);
+      candidate = head[h];
+      head[h] = pos + 1;
+
+      if(candidate > 0) {
+        candidate--;
+        size_t limit = (len - pos < MAX_MATCH) ? len - pos : MAX_MATCH;
+        while((matchLength < limit) && (in[candidate + matchLength] == in[pos + matchLength]))
+          matchLength++;
+      }
+    }
+
+    if(matchLength < MIN_MATCH) {
+      putSymbol(&w, in[pos]);
+      pos++;
+      continue;
+    }
+
+    putMatch(&w, matchLength, pos - candidate);
+
+    // Keep the table current through the match, so the next line can find it
+    for(size_t n=pos+1;(n<pos+matchLength) && (n+MIN_MATCH<=len);n++)
+      head[hash3(&in[n])] = n + 1;
+    pos += matchLength;
+
+    if(w.overflow)
+      return 0;
+  }
+
+  putSymbol(&w, 256);
+  if(w.count > 0)
+    putBits(&w, 0, 8 - w.count);
+
+  uint32_t crc = gzipCrc32(in, len);
+  for(uint8_t n=0;n<4;n++)
+    putByte(&w, crc >> (n * 8));
+  for(uint8_t n=0;n<4;n++)
+    putByte(&w, len >> (n * 8));
+
+  return w.overflow ? 0 : w.pos;
+}
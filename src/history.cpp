@@ -0,0 +1,726 @@
+/**
+ *  @filename   :   history.cpp
+ *  @brief      :   ESP32 Weather Base Station Hourly and Daily Extremes Store
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <SPIFFS.h>
+#include <WiFi.h>
+#include <math.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "weatherbase.h"
+#include "wifiwithmqtt.h"
+#include "logqueue.h"
+#include "history.h"
+#include "influxclient.h"
+#include "timekeeper.h"
+
+#define HOUR_SECS 3600
+#define DAY_SECS 86400
+#define HISTORY_URL_LENGTH 800
+
+// Where each metric lives in InfluxDB. Rain only has a total.
+typedef struct history_column_t {
+  const char *field;                // In station
+  const char *maxColumn;            // In two_year.hourly_rollup
+  const char *minColumn;
+} history_column_t;
+
+static const history_column_t columns[HISTORY_METRICS] = {
+  {"temperature", "max_temp", "min_temp"},
+  {"humidity", "max_humidity", "min_humidity"},
+  {"pressureHg", "max_pressureHg", "min_pressureHg"},
+  {"rain", NULL, NULL},
+  {"room_temp", "max_room_temp", "min_room_temp"},
+  {"room_hum", "max_room_hum", "min_room_hum"}
+};
+
+// Samples come in on the network task, the fill runs on the query task and
+// the panels read on the display task
+static SemaphoreHandle_t historyMutex = NULL;
+
+static history_bucket_t hours[HISTORY_HOURS];
+static history_bucket_t days[HISTORY_DAYS];
+
+static uint32_t liveSince = 0;                // First sample since the restart
+static float liveSums[HISTORY_METRICS];       // In the hour liveSince is in
+static uint32_t coveredSince = UINT32_MAX;    // Every hour from here on is in the buckets
+static uint32_t fillEnd = 0;                  // Where the next fill query stops
+static uint32_t savedSince = 0;               // Covered by the buckets loaded from SPIFFS
+static uint32_t savedUntil = 0;
+static history_bucket_t savedPart;            // The hour savedUntil is in, as loaded
+static bool filled = false;
+static bool fillWaiting = false;
+static uint32_t nextFill = 0;
+static bool dirty = false;
+static uint32_t savedHour = 0;
+static uint32_t lastSave = 0;
+static uint32_t fullSaveAt = 0;               // savedAt of the history file
+static bool rained = false;                   // Rain in the buckets since the last save
+static uint32_t fillGeneration = 0;           // Bumped when a clock step throws the coverage away
+
+static history_stats_t historyStats;
+
+static void clockStepped(uint32_t now);
+
+static void lockHistory() {
+  if(historyMutex != NULL)
+    xSemaphoreTake(historyMutex, portMAX_DELAY);
+}
+
+static void unlockHistory() {
+  if(historyMutex != NULL)
+    xSemaphoreGive(historyMutex);
+}
+
+// The slot for key, emptied if it held an older one. NULL if the slot has
+// moved on to something newer, so key is too old for the ring.
+static history_bucket_t *bucketFor(history_bucket_t *ring, uint16_t size, uint32_t key) {
+  history_bucket_t *bucket = &ring[key % size];
+  if(bucket->key == key)
+    return bucket;
+  if(bucket->key > key)
+    return NULL;
+
+  bucket->key = key;
+  bucket->present = 0;
+  return bucket;
+}
+
+static void bucketAdd(history_bucket_t *bucket, uint8_t metric, float high, float low, float sum) {
+  uint8_t bit = 1 << metric;
+  if(!(bucket->present & bit)) {
+    bucket->present |= bit;
+    bucket->max[metric] = high;
+    bucket->min[metric] = low;
+    bucket->sum[metric] = sum;
+    return;
+  }
+
+  if(high > bucket->max[metric])
+    bucket->max[metric] = high;
+  if(low < bucket->min[metric])
+    bucket->min[metric] = low;
+  bucket->sum[metric] += sum;
+}
+
+static void addValue(uint32_t t, uint8_t metric, float value) {
+  history_bucket_t *hour = bucketFor(hours, HISTORY_HOURS, t / HOUR_SECS);
+  if(hour != NULL)
+    bucketAdd(hour, metric, value, value, value);
+  if(t / HOUR_SECS == liveSince / HOUR_SECS)
+    liveSums[metric] += value;
+
+  history_bucket_t *day = bucketFor(days, HISTORY_DAYS, timeLocalDay(t));
+  if(day != NULL)
+    bucketAdd(day, metric, value, value, value);
+}
+
+// The live samples or the saved buckets may already have part of the hour.
+// Extremes merge either way. The fill stops at liveSince, so the total it
+// brings back has the saved part of the hour in it but never the live part,
+// and only the saved part is taken off. After a long outage the saved hour
+// can have left the ring before the fill gets to it, but its day still has
+// the saved part, so that comes off as loaded.
+static void fillValue(uint32_t t, uint8_t metric, float high, float low, float sum) {
+  uint8_t bit = 1 << metric;
+  history_bucket_t *hour = bucketFor(hours, HISTORY_HOURS, t / HOUR_SECS);
+  if(hour != NULL) {
+    if(hour->present & bit)
+      sum -= hour->sum[metric];
+    if(hour->key == liveSince / HOUR_SECS)
+      sum += liveSums[metric];
+  } else if((savedPart.key == t / HOUR_SECS) && (savedPart.present & bit)) {
+    sum -= savedPart.sum[metric];
+  }
+  if(sum < 0.0)
+    sum = 0.0;
+
+  if(hour != NULL)
+    bucketAdd(hour, metric, high, low, sum);
+
+  history_bucket_t *day = bucketFor(days, HISTORY_DAYS, timeLocalDay(t));
+  if(day != NULL)
+    bucketAdd(day, metric, high, low, sum);
+}
+
+static void restoreRain(history_bucket_t *ring, uint16_t size, const history_rain_t *rain) {
+  if(rain->key == 0)
+    return;
+
+  history_bucket_t *bucket = bucketFor(ring, size, rain->key);
+  if(bucket == NULL)
+    return;
+
+  bucket->present |= 1 << HISTORY_RAIN;
+  bucket->max[HISTORY_RAIN] = rain->max;
+  bucket->min[HISTORY_RAIN] = rain->min;
+  bucket->sum[HISTORY_RAIN] = rain->sum;
+}
+
+// The rain totals saved since the history file. They already hold what the
+// file has, so they replace it.
+static void loadCheckpoint() {
+  File file = SPIFFS.open(HISTORY_RAIN_FILE, FILE_READ);
+  if(!file)
+    return;
+
+  history_checkpoint_t checkpoint;
+  bool ok = (file.size() == sizeof(checkpoint)) &&
+    (file.read((uint8_t *)&checkpoint, sizeof(checkpoint)) == sizeof(checkpoint));
+  file.close();
+
+  if(!ok || (checkpoint.version != HISTORY_VERSION) || (checkpoint.savedAt != fullSaveAt))
+    return;
+
+  for(uint8_t n=0;n<HISTORY_CHECKPOINT_BUCKETS;n++) {
+    restoreRain(hours, HISTORY_HOURS, &checkpoint.hours[n]);
+    restoreRain(days, HISTORY_DAYS, &checkpoint.days[n]);
+  }
+  Serial.println("Restored the rain checkpoint");
+}
+
+// Starts from what is on SPIFFS, as after a restart
+void initHistory() {
+  if(historyMutex == NULL) {
+    historyMutex = xSemaphoreCreateMutex();
+    timeOnStep(clockStepped);
+  }
+
+  lockHistory();
+  memset(hours, 0, sizeof(hours));
+  memset(days, 0, sizeof(days));
+  memset(liveSums, 0, sizeof(liveSums));
+  memset(&savedPart, 0, sizeof(savedPart));
+  memset(&historyStats, 0, sizeof(historyStats));
+  liveSince = 0;
+  coveredSince = UINT32_MAX;
+  fillEnd = 0;
+  savedSince = 0;
+  savedUntil = 0;
+  filled = false;
+  fillWaiting = false;
+  dirty = false;
+  savedHour = 0;
+  lastSave = 0;
+  fullSaveAt = 0;
+  rained = false;
+  unlockHistory();
+
+  // SPIFFS is mounted by initOutbox()
+  File file = SPIFFS.open(HISTORY_FILE, FILE_READ);
+  if(!file)
+    return;
+
+  history_header_t header;
+  bool ok = (file.size() == sizeof(header) + sizeof(hours) + sizeof(days)) &&
+    (file.read((uint8_t *)&header, sizeof(header)) == sizeof(header)) && (header.version == HISTORY_VERSION) &&
+    (file.read((uint8_t *)hours, sizeof(hours)) == sizeof(hours)) &&
+    (file.read((uint8_t *)days, sizeof(days)) == sizeof(days));
+  file.close();
+
+  if(!ok) {
+    memset(hours, 0, sizeof(hours));
+    memset(days, 0, sizeof(days));
+    Serial.println("History file unreadable, starting again");
+    return;
+  }
+
+  savedSince = header.coveredSince;
+  savedUntil = header.savedAt;
+  fullSaveAt = header.savedAt;
+  Serial.printf("History covers %u to %u\n", savedSince, savedUntil);
+
+  loadCheckpoint();
+
+  const history_bucket_t *last = &hours[(savedUntil / HOUR_SECS) % HISTORY_HOURS];
+  if(last->key == savedUntil / HOUR_SECS)
+    memcpy(&savedPart, last, sizeof(history_bucket_t));
+}
+
+void historyAddSample(const sensor_data_t *data, time_t sampleTime) {
+  if(sampleTime < TIME_MIN_EPOCH)
+    return;
+
+  lockHistory();
+  if(liveSince == 0)
+    liveSince = sampleTime;
+  addValue(sampleTime, HISTORY_TEMP, fahrenheit(data->temperature));
+  addValue(sampleTime, HISTORY_HUM, data->humidity);
+  addValue(sampleTime, HISTORY_PRESS, seaLevelInHg(data->pressure));
+  addValue(sampleTime, HISTORY_RAIN, rainInches(data->rain));
+  if(data->rain > 0.0)
+    rained = true;
+  dirty = true;
+  historyStats.samples++;
+  unlockHistory();
+}
+
+void historyAddRoom(float roomTemp, float roomHum, time_t sampleTime) {
+  if(sampleTime < TIME_MIN_EPOCH)
+    return;
+
+  lockHistory();
+  if(liveSince == 0)
+    liveSince = sampleTime;
+  addValue(sampleTime, HISTORY_ROOM_TEMP, fahrenheit(roomTemp));
+  addValue(sampleTime, HISTORY_ROOM_HUM, roomHum);
+  dirty = true;
+  unlockHistory();
+}
+
+// days is 0 for today, otherwise today and the days before it. False if the
+// store does not cover the whole period, or has nothing for it.
+static bool findExtremes(uint8_t metric, uint16_t numDays, float *high, float *low) {
+  uint32_t now = timeNow();
+  uint32_t today = timeLocalDay(now);
+  uint32_t first = (numDays > 1) ? today - (numDays - 1) : today;
+  bool found = false;
+
+  if((now == 0) || (numDays > HISTORY_DAYS) || (coveredSince > timeDayStart(first)))
+    return false;
+
+  for(uint32_t day=first;day<=today;day++) {
+    const history_bucket_t *bucket = &days[day % HISTORY_DAYS];
+    if((bucket->key != day) || !(bucket->present & (1 << metric)))
+      continue;
+
+    if(!found || (bucket->max[metric] > *high))
+      *high = bucket->max[metric];
+    if(!found || (bucket->min[metric] < *low))
+      *low = bucket->min[metric];
+    found = true;
+  }
+
+  return found;
+}
+
+bool historyExtremes(uint8_t metric, uint16_t numDays, float *high, float *low) {
+  lockHistory();
+  bool found = findExtremes(metric, numDays, high, low);
+  if(found)
+    historyStats.hits++;
+  else
+    historyStats.misses++;
+  unlockHistory();
+
+  return found;
+}
+
+// Whether historyExtremes() would answer, without counting it
+bool historyCovers(uint8_t metric, uint16_t numDays) {
+  float high, low;
+
+  lockHistory();
+  bool found = findExtremes(metric, numDays, &high, &low);
+  unlockHistory();
+
+  return found;
+}
+
+// days is 0 for the last HISTORY_TOTAL_HOURS hours, otherwise today and the
+// days before it. An hour or day without samples adds nothing, so any period
+// the store covers has a total.
+static bool findTotal(uint8_t metric, uint16_t numDays, float *total) {
+  uint32_t now = timeNow();
+  uint8_t bit = 1 << metric;
+  float sum = 0.0;
+
+  if(now == 0)
+    return false;
+
+  if(numDays == 0) {
+    uint32_t hour = now / HOUR_SECS;
+    uint32_t first = hour - (HISTORY_TOTAL_HOURS - 1);
+    if(coveredSince > first * HOUR_SECS)
+      return false;
+
+    for(uint32_t h=first;h<=hour;h++) {
+      const history_bucket_t *bucket = &hours[h % HISTORY_HOURS];
+      if((bucket->key == h) && (bucket->present & bit))
+        sum += bucket->sum[metric];
+    }
+  } else {
+    uint32_t today = timeLocalDay(now);
+    uint32_t first = today - (numDays - 1);
+    if((numDays > HISTORY_DAYS) || (coveredSince > timeDayStart(first)))
+      return false;
+
+    for(uint32_t day=first;day<=today;day++) {
+      const history_bucket_t *bucket = &days[day % HISTORY_DAYS];
+      if((bucket->key == day) && (bucket->present & bit))
+        sum += bucket->sum[metric];
+    }
+  }
+
+  *total = sum;
+  return true;
+}
+
+bool historyTotal(uint8_t metric, uint16_t numDays, float *total) {
+  lockHistory();
+  bool found = findTotal(metric, numDays, total);
+  if(found)
+    historyStats.hits++;
+  else
+    historyStats.misses++;
+  unlockHistory();
+
+  return found;
+}
+
+// Whether historyTotal() would answer, without counting it
+bool historyTotalCovers(uint8_t metric, uint16_t numDays) {
+  float total;
+
+  lockHistory();
+  bool found = findTotal(metric, numDays, &total);
+  unlockHistory();
+
+  return found;
+}
+
+static void saveHistory(uint32_t now) {
+  File file = SPIFFS.open(HISTORY_FILE ".new", FILE_WRITE);
+  if(!file)
+    return;
+
+  lockHistory();
+  history_header_t header;
+  header.version = HISTORY_VERSION;
+  header.coveredSince = (coveredSince != UINT32_MAX) ? coveredSince : liveSince;
+  header.savedAt = now;
+
+  size_t written = file.write((const uint8_t *)&header, sizeof(header));
+  written += file.write((const uint8_t *)hours, sizeof(hours));
+  written += file.write((const uint8_t *)days, sizeof(days));
+  dirty = false;
+  rained = false;
+  unlockHistory();
+  file.close();
+
+  if(written != sizeof(header) + sizeof(hours) + sizeof(days)) {
+    LOG_ERROR("history", "History save failed");
+    SPIFFS.remove(HISTORY_FILE ".new");
+    return;
+  }
+
+  SPIFFS.remove(HISTORY_FILE);
+  SPIFFS.rename(HISTORY_FILE ".new", HISTORY_FILE);
+  lastSave = now;
+  fullSaveAt = now;
+  historyStats.saves++;
+}
+
+static void copyRain(const history_bucket_t *ring, uint16_t size, uint32_t key, history_rain_t *rain) {
+  const history_bucket_t *bucket = &ring[key % size];
+  if((bucket->key != key) || !(bucket->present & (1 << HISTORY_RAIN)))
+    return;
+
+  rain->key = key;
+  rain->max = bucket->max[HISTORY_RAIN];
+  rain->min = bucket->min[HISTORY_RAIN];
+  rain->sum = bucket->sum[HISTORY_RAIN];
+}
+
+// Between full saves rain only reaches the hour and day under way, or the
+// ones before them for a late batch. Those totals are copied under the lock
+// and written after it is released.
+static void saveCheckpoint(uint32_t now) {
+  history_checkpoint_t checkpoint;
+  memset(&checkpoint, 0, sizeof(checkpoint));
+  checkpoint.version = HISTORY_VERSION;
+
+  lockHistory();
+  checkpoint.savedAt = fullSaveAt;
+  uint32_t hour = now / HOUR_SECS;
+  uint32_t today = timeLocalDay(now);
+  for(uint8_t n=0;n<HISTORY_CHECKPOINT_BUCKETS;n++) {
+    copyRain(hours, HISTORY_HOURS, hour - n, &checkpoint.hours[n]);
+    copyRain(days, HISTORY_DAYS, today - n, &checkpoint.days[n]);
+  }
+  rained = false;
+  unlockHistory();
+
+  File file = SPIFFS.open(HISTORY_RAIN_FILE ".new", FILE_WRITE);
+  if(!file)
+    return;
+
+  size_t written = file.write((const uint8_t *)&checkpoint, sizeof(checkpoint));
+  file.close();
+
+  if(written != sizeof(checkpoint)) {
+    LOG_ERROR("history", "Rain checkpoint failed");
+    SPIFFS.remove(HISTORY_RAIN_FILE ".new");
+    return;
+  }
+
+  SPIFFS.remove(HISTORY_RAIN_FILE);
+  SPIFFS.rename(HISTORY_RAIN_FILE ".new", HISTORY_RAIN_FILE);
+  lastSave = now;
+  historyStats.rainSaves++;
+}
+
+
+
+// The wall clock was stepped. Buckets ahead of the new time were written
+// under the wrong clock, and nothing says which hours the rest really cover,
+// so the fill starts over from now. Runs on the network task.
+static void clockStepped(uint32_t now) {
+  uint32_t hour = now / HOUR_SECS;
+  uint32_t today = timeLocalDay(now);
+
+  lockHistory();
+  for(uint16_t n=0;n<HISTORY_HOURS;n++)
+    if(hours[n].key > hour)
+      memset(&hours[n], 0, sizeof(history_bucket_t));
+  for(uint16_t n=0;n<HISTORY_DAYS;n++)
+    if(days[n].key > today)
+      memset(&days[n], 0, sizeof(history_bucket_t));
+
+  liveSince = now;
+  memset(liveSums, 0, sizeof(liveSums));
+  coveredSince = UINT32_MAX;
+  fillEnd = 0;
+  savedUntil = 0;
+  savedPart.key = 0;
+  filled = false;
+  fillWaiting = false;
+  fillGeneration++;
+  dirty = true;
+  savedHour = 0;
+  historyStats.clockSteps++;
+  unlockHistory();
+
+  LOG_WARN("history", "Refilling history after a clock step");
+}
+
+// Runs on the network task. Saves once an hour and straight after the fill
+// finishes, and checkpoints the rain every HISTORY_RAIN_SAVE_SECS while it
+// rains.
+void historyLoop() {
+  uint32_t now = timeNow();
+  if(now == 0)
+    return;
+
+  lockHistory();
+  bool due = dirty && (now / HOUR_SECS != savedHour);
+  bool rainDue = !due && rained && (now - lastSave >= HISTORY_RAIN_SAVE_SECS);
+  unlockHistory();
+
+  if(due) {
+    savedHour = now / HOUR_SECS;
+    saveHistory(now);
+  } else if(rainDue) {
+    saveCheckpoint(now);
+  }
+}
+
+/*
+ * The fill
+ */
+
+typedef struct history_fill_t {
+  char url[HISTORY_URL_LENGTH];
+  uint32_t rows;
+  bool error;
+} history_fill_t;
+
+static history_fill_t fillQuery;
+
+static void urlAppend(char *url, const char *format, const char *a, const char *b = "", const char *c = "") {
+  size_t len = strlen(url);
+  snprintf(&url[len], HISTORY_URL_LENGTH - len, format, a, b, c);
+}
+
+// The columns come back in the order of columns[]: the maximum and minimum,
+// or the total
+static void buildFillUrl(char *url, uint32_t start, uint32_t end, bool raw) {
+  snprintf(url, HISTORY_URL_LENGTH, "/query?db=weather&epoch=s&chunked=true&chunk_size=%u&q=SELECT%%20",
+    HISTORY_CHUNK_ROWS);
+
+  for(uint8_t m=0;m<HISTORY_METRICS;m++) {
+    const history_column_t *column = &columns[m];
+    if(m > 0)
+      urlAppend(url, "%s", "%2C");
+
+    if(column->maxColumn == NULL) {
+      if(raw)
+        urlAppend(url, "sum%%28%%22%s%%22%%29%%20AS%%20%s", column->field, column->field);
+      else
+        urlAppend(url, "%s", column->field);
+    } else if(raw) {
+      urlAppend(url, "max%%28%%22%s%%22%%29%%20AS%%20%s%%2C", column->field, column->maxColumn);
+      urlAppend(url, "min%%28%%22%s%%22%%29%%20AS%%20%s", column->field, column->minColumn);
+    } else {
+      urlAppend(url, "%s%%2C%s", column->maxColumn, column->minColumn);
+    }
+  }
+
+  char where[100];
+  snprintf(where, sizeof(where), "%%20WHERE%%20time%%20%%3E%%3D%%20%us%%20AND%%20time%%20%%3C%%20%us", start, end);
+  urlAppend(url, "%%20FROM%%20%s%s%s", raw ? "station" : "two_year.hourly_rollup", where,
+    raw ? "%20GROUP%20BY%20time%281h%29" : "");
+}
+
+static void fillRow(JsonArray row) {
+  uint32_t t = row[0].as<uint32_t>();
+  uint8_t col = 1;
+
+  for(uint8_t m=0;m<HISTORY_METRICS;m++) {
+    if(columns[m].maxColumn == NULL) {
+      JsonVariant total = row[col++];
+      if(!total.isNull())
+        fillValue(t, m, total.as<float>(), total.as<float>(), total.as<float>());
+    } else {
+      JsonVariant high = row[col++];
+      JsonVariant low = row[col++];
+      if(!high.isNull() && !low.isNull())
+        fillValue(t, m, high.as<float>(), low.as<float>(), 0.0);
+    }
+  }
+}
+
+// InfluxDB sends a chunked response as one JSON document per chunk. HTTP/1.0
+// keeps the chunked transfer encoding out of the stream, so ArduinoJson can
+// read the documents off it one at a time.
+static int doFill(void *arg) {
+  history_fill_t *fill = (history_fill_t *)arg;
+
+  fill->rows = 0;
+  fill->error = false;
+
+  int rc = influxClientGet(fill->url, true);
+
+  if(rc == 200) {
+    DynamicJsonDocument doc(HISTORY_CHUNK_DOC);
+    Stream &stream = influxClient().getStream();
+
+    while(!deserializeJson(doc, stream)) {
+      JsonVariant result = doc["results"][0];
+      if(!result["error"].isNull()) {
+        fill->error = true;
+        break;
+      }
+
+      JsonArray values = result["series"][0]["values"];
+      lockHistory();
+      for(JsonArray row : values) {
+        fillRow(row);
+        fill->rows++;
+      }
+      unlockHistory();
+    }
+  }
+
+  influxClientEnd();
+
+  return rc;
+}
+
+// Runs on the query task when no query is waiting. Each call runs at most one
+// fill query, newest hours first.
+void historyIdle() {
+  if(filled)
+    return;
+
+  uint32_t now = timeNow();
+  if(now == 0)
+    return;
+
+  if(fillWaiting && ((int32_t)(millis() - nextFill) < 0))
+    return;
+
+  if(WiFi.status() != WL_CONNECTED)
+    return;
+
+  lockHistory();
+  // Every live sample from here on is already in the buckets
+  if(fillEnd == 0) {
+    fillEnd = (liveSince != 0) ? liveSince : now;
+    coveredSince = fillEnd;
+  }
+
+  uint32_t target = timeDayStart(timeLocalDay(now) - (HISTORY_DAYS - 1));
+  uint32_t rawLimit = now - now % HOUR_SECS - HISTORY_RAW_HOURS * HOUR_SECS;
+  uint32_t savedHourStart = savedUntil - savedUntil % HOUR_SECS;
+  bool raw = (fillEnd > rawLimit);
+
+  uint32_t end = fillEnd;
+  uint32_t start = raw ? rawLimit : end - HISTORY_FILL_DAYS * DAY_SECS;
+  if((savedUntil != 0) && (end > savedHourStart) && (start < savedHourStart))
+    start = savedHourStart;
+  if(start < target)
+    start = target;
+  uint32_t generation = fillGeneration;
+  unlockHistory();
+
+  buildFillUrl(fillQuery.url, start, end, raw);
+  int rc = doFill(&fillQuery);
+  historyStats.fillQueries++;
+  historyStats.fillRows += fillQuery.rows;
+
+  if((rc != 200) || fillQuery.error) {
+    char error[70];
+    snprintf(error, sizeof(error), "History fill returned %d", fillQuery.error ? -1 : rc);
+    LOG_WARN("history", error);
+    historyStats.fillFailures++;
+    fillWaiting = true;
+    nextFill = millis() + HISTORY_RETRY_MS;
+    return;
+  }
+
+  lockHistory();
+  // The clock stepped while the query ran
+  if(generation != fillGeneration) {
+    unlockHistory();
+    return;
+  }
+
+  fillWaiting = false;
+  fillEnd = start;
+  coveredSince = start;
+
+  // Older than this came back from SPIFFS
+  if((savedUntil != 0) && (start <= savedUntil)) {
+    fillEnd = savedSince;
+    coveredSince = savedSince;
+    savedUntil = 0;
+  }
+
+  if(fillEnd <= target) {
+    filled = true;
+    savedHour = 0;
+  }
+  dirty = true;
+  unlockHistory();
+}
+
+void getHistoryStats(history_stats_t *stats) {
+  uint32_t now = timeNow();
+
+  lockHistory();
+  memcpy(stats, &historyStats, sizeof(history_stats_t));
+  stats->coveredDays = ((coveredSince != UINT32_MAX) && (now > coveredSince)) ? (now - coveredSince) / DAY_SECS : 0;
+  unlockHistory();
+}
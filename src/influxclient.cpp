@@ -0,0 +1,132 @@
+/**
+ *  @filename   :   influxclient.cpp
+ *  @brief      :   ESP32 Weather Base Station InfluxDB Query Connection
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <HTTPClient.h>
+#include "influxclient.h"
+#include "wifiwithmqtt.h"
+
+extern char mqttServer[MQTT_SERVER_LENGTH];
+
+static WiFiClient client;
+static HTTPClient hc;
+
+static IPAddress serverAddress;
+static char resolvedServer[MQTT_SERVER_LENGTH];
+static bool resolved = false;
+static bool closeAfter = false;
+
+static influx_client_stats_t clientStats;
+static uint64_t rttTotalMs = 0;
+
+// The name is looked up again if it changes, or after a failed connect in
+// case the server moved
+static bool resolveServer() {
+  if(resolved && (strncmp(resolvedServer, mqttServer, MQTT_SERVER_LENGTH) == 0))
+    return true;
+
+  client.stop();
+  resolved = false;
+  clientStats.resolves++;
+  if(!WiFi.hostByName(mqttServer, serverAddress))
+    return false;
+
+  strncpy(resolvedServer, mqttServer, MQTT_SERVER_LENGTH);
+  resolved = true;
+  return true;
+}
+
+static void recordRtt(uint32_t rtt) {
+  rttTotalMs += rtt;
+  clientStats.rttLastMs = rtt;
+  if((clientStats.rttMinMs == 0) || (rtt < clientStats.rttMinMs))
+    clientStats.rttMinMs = rtt;
+  if(rtt > clientStats.rttMaxMs)
+    clientStats.rttMaxMs = rtt;
+}
+
+// Sends a GET for uri, with an Accept header if accept is set, and reads the status line and headers. The body is
+// left for the caller to read from influxClient(), and influxClientEnd()
+// must be called once it has. A connection the server closed while it sat
+// idle only shows up when the request fails, so that is tried once more on
+// a new one. An HTTP/1.0 response ends when the server closes, so its
+// connection is not kept.
+int influxClientGet(const char *uri, bool http10, const char *accept) {
+  clientStats.requests++;
+
+  if(!resolveServer()) {
+    clientStats.failures++;
+    return HTTPC_ERROR_CONNECTION_REFUSED;
+  }
+
+  hc.begin(client, serverAddress.toString(), INFLUX_QUERY_PORT, uri);
+  hc.setReuse(true);
+  hc.useHTTP10(http10);
+  if(accept != NULL)
+    hc.addHeader("Accept", accept);
+  closeAfter = http10;
+
+  bool reused = hc.connected();
+  uint32_t sent = millis();
+  int rc = hc.GET();
+
+  if((rc < 0) && reused) {
+    client.stop();
+    reused = false;
+    sent = millis();
+    rc = hc.GET();
+  }
+
+  if(rc < 0) {
+    clientStats.failures++;
+    if(rc == HTTPC_ERROR_CONNECTION_REFUSED)
+      resolved = false;
+    client.stop();
+    return rc;
+  }
+
+  if(reused)
+    clientStats.reused++;
+  else
+    clientStats.connects++;
+  recordRtt(millis() - sent);
+
+  return rc;
+}
+
+HTTPClient &influxClient() {
+  return hc;
+}
+
+void influxClientEnd() {
+  hc.end();
+  if(closeAfter)
+    client.stop();
+}
+
+void getInfluxClientStats(influx_client_stats_t *stats) {
+  *stats = clientStats;
+  uint32_t answered = clientStats.reused + clientStats.connects;
+  stats->rttMeanMs = (answered == 0) ? 0 : rttTotalMs / answered;
+}
@@ -0,0 +1,286 @@
+/**
+ *  @filename   :   influxresult.cpp
+ *  @brief      :   ESP32 Weather Base Station InfluxDB Query Response Reader
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include "influxresult.h"
+
+#define JSON_VALUE 0                // Between tokens
+#define JSON_STRING 1
+#define JSON_ESCAPE 2
+#define JSON_SCALAR 3               // A number, true, false or null
+
+#define KEY_OTHER 0
+#define KEY_RESULTS 1
+#define KEY_SERIES 2
+#define KEY_VALUES 3
+#define KEY_ERROR 4
+
+InfluxResultReader::InfluxResultReader(float *values, uint8_t count, bool csv) {
+  this->values = values;
+  this->count = count;
+  this->csv = csv;
+  for(uint8_t n=0;n<count;n++)
+    values[n] = 0.0;
+
+  valuesFound = 0;
+  errorCount = 0;
+  tokenLen = 0;
+  tokenLong = false;
+  token[0] = '\0';
+  state = JSON_VALUE;
+  inKey = false;
+  depth = 0;
+  done = false;
+  broken = false;
+  field = 0;
+  header = false;
+  statement = INFLUX_RESULT_NONE;
+}
+
+size_t InfluxResultReader::write(uint8_t c) {
+  if(csv)
+    csvChar(c);
+  else
+    jsonChar(c);
+  return 1;
+}
+
+size_t InfluxResultReader::write(const uint8_t *buffer, size_t size) {
+  for(size_t n=0;n<size;n++)
+    write(buffer[n]);
+  return size;
+}
+
+// Whether the whole response was read. A CSV response has nothing to check
+// it against, so only its last line is taken care of.
+bool InfluxResultReader::finish() {
+  if(csv) {
+    if((field != 0) || (tokenLen != 0))
+      endLine();
+    return true;
+  }
+
+  if(state == JSON_SCALAR)
+    jsonChar(' ');
+  return done && !broken;
+}
+
+void InfluxResultReader::addToken(char c) {
+  if(tokenLen < INFLUX_RESULT_TOKEN - 1)
+    token[tokenLen++] = c;
+  else
+    tokenLong = true;
+  token[tokenLen] = '\0';
+}
+
+void InfluxResultReader::store(uint8_t statement) {
+  if((statement >= count) || tokenLong || (tokenLen == 0))
+    return;
+
+  // null, true or false
+  if(isalpha(token[0]))
+    return;
+
+  values[statement] = strtof(token, NULL);
+  valuesFound++;
+}
+
+/*
+ * JSON
+ */
+
+void InfluxResultReader::jsonChar(char c) {
+  if(done || broken)
+    return;
+
+  switch(state) {
+    case JSON_STRING:
+      if(c == '\\')
+        state = JSON_ESCAPE;
+      else if(c == '"') {
+        state = JSON_VALUE;
+        endString();
+      } else
+        addToken(c);
+      return;
+    case JSON_ESCAPE:
+      addToken(c);
+      state = JSON_STRING;
+      return;
+    case JSON_SCALAR:
+      if(isalnum(c) || (c == '-') || (c == '+') || (c == '.')) {
+        addToken(c);
+        return;
+      }
+      state = JSON_VALUE;
+      endScalar();
+      break;
+  }
+
+  influx_level_t *current = (depth > 0) && (depth <= INFLUX_RESULT_DEPTH) ? level(depth) : NULL;
+
+  switch(c) {
+    case ' ':
+    case '\t':
+    case '\r':
+    case '\n':
+      break;
+    case '{':
+    case '[':
+      if(depth == 255) {
+        broken = true;
+        break;
+      }
+      depth++;
+      if(depth <= INFLUX_RESULT_DEPTH) {
+        current = level(depth);
+        current->array = (c == '[');
+        current->expectKey = !current->array;
+        current->key = KEY_OTHER;
+        current->index = 0;
+      }
+      break;
+    case '}':
+    case ']':
+      if((depth == 0) || ((current != NULL) && (current->array != (c == ']')))) {
+        broken = true;
+        break;
+      }
+      depth--;
+      if(depth == 0)
+        done = true;
+      break;
+    case ',':
+      if(current != NULL) {
+        if(current->index < 255)
+          current->index++;
+        current->expectKey = !current->array;
+        current->key = KEY_OTHER;
+      }
+      break;
+    case ':':
+      if(current != NULL)
+        current->expectKey = false;
+      break;
+    case '"':
+      inKey = (current != NULL) && !current->array && current->expectKey;
+      tokenLen = 0;
+      tokenLong = false;
+      token[0] = '\0';
+      state = JSON_STRING;
+      break;
+    default:
+      tokenLen = 0;
+      tokenLong = false;
+      addToken(c);
+      state = JSON_SCALAR;
+      break;
+  }
+}
+
+void InfluxResultReader::endString() {
+  if(depth == 0 || depth > INFLUX_RESULT_DEPTH)
+    return;
+
+  influx_level_t *current = level(depth);
+  if(inKey) {
+    current->key = KEY_OTHER;
+    if(tokenLong)
+      return;
+    if(strcmp(token, "results") == 0)
+      current->key = KEY_RESULTS;
+    else if(strcmp(token, "series") == 0)
+      current->key = KEY_SERIES;
+    else if(strcmp(token, "values") == 0)
+      current->key = KEY_VALUES;
+    else if(strcmp(token, "error") == 0)
+      current->key = KEY_ERROR;
+    return;
+  }
+
+  // {"error":...} for the whole request, or results[n].error for a statement
+  if((current->key == KEY_ERROR) && ((depth == 1) || ((depth == 3) && (level(1)->key == KEY_RESULTS))))
+    errorCount++;
+}
+
+// Only results[n].series[0].values[0][1] is kept
+void InfluxResultReader::endScalar() {
+  if(depth != 7)
+    return;
+
+  if((level(1)->key == KEY_RESULTS) && (level(3)->key == KEY_SERIES) && (level(4)->index == 0) &&
+      (level(5)->key == KEY_VALUES) && (level(6)->index == 0) && (level(7)->index == 1))
+    store(level(2)->index);
+}
+
+/*
+ * CSV
+ */
+
+// name,tags,time,r<n> then the rows, with a blank line before each statement
+// after the first. Only the last field of a line, the value, is kept. A
+// statement that failed is a line of just error, then the message.
+void InfluxResultReader::csvChar(char c) {
+  switch(c) {
+    case '\r':
+      break;
+    case ',':
+      if(field == 0)
+        header = (strcmp(token, "name") == 0);
+      if(field < 255)
+        field++;
+      tokenLen = 0;
+      tokenLong = false;
+      token[0] = '\0';
+      break;
+    case '\n':
+      endLine();
+      break;
+    default:
+      addToken(c);
+      break;
+  }
+}
+
+void InfluxResultReader::endLine() {
+  if((field == 0) && (tokenLen == 0)) {
+    statement = INFLUX_RESULT_NONE;
+  } else if((field == 0) && (strcmp(token, "error") == 0)) {
+    errorCount++;
+    statement = INFLUX_RESULT_NONE;
+  } else if(header) {
+    int n = ((token[0] == 'r') && isdigit(token[1])) ? atoi(&token[1]) : INFLUX_RESULT_NONE;
+    statement = (n < INFLUX_RESULT_NONE) ? n : INFLUX_RESULT_NONE;
+  } else if(statement != INFLUX_RESULT_NONE) {
+    store(statement);
+    statement = INFLUX_RESULT_NONE;
+  }
+
+  field = 0;
+  header = false;
+  tokenLen = 0;
+  tokenLong = false;
+  token[0] = '\0';
+}
@@ -0,0 +1,248 @@
+/**
+ *  @filename   :   influxwriter.cpp
+ *  @brief      :   ESP32 Weather Base Station InfluxDB Line Protocol Writer
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <Arduino.h>
+#include <HTTPClient.h>
+#include <WiFi.h>
+#include <math.h>
+#include "weatherbase.h"
+#include "wifiwithmqtt.h"
+#include "jsonwriter.h"
+#include "gzip.h"
+#include "logqueue.h"
+#include "influxwriter.h"
+
+extern char mqttServer[MQTT_SERVER_LENGTH];
+
+static char batch[INFLUX_BATCH_SIZE];
+static uint8_t compressed[INFLUX_BATCH_SIZE];
+static uint16_t batchBytes = 0;
+static uint16_t batchPoints = 0;
+static uint32_t batchStarted = 0;
+
+static uint32_t nextAttempt = 0;
+static uint32_t backoff = 0;
+
+static influx_stats_t influxStats;
+
+typedef struct line_builder_t {
+  char *line;
+  uint16_t len;
+  bool firstField;
+} line_builder_t;
+
+static void lineAppend(line_builder_t *b, const char *s, uint16_t len) {
+  if(b->len + len >= INFLUX_LINE_LENGTH)
+    len = INFLUX_LINE_LENGTH - 1 - b->len;
+  memcpy(&b->line[b->len], s, len);
+  b->len += len;
+}
+
+// Tag values escape commas, spaces and equals signs
+static void lineTag(line_builder_t *b, const char *key, const char *value) {
+  lineAppend(b, ",", 1);
+  lineAppend(b, key, strlen(key));
+  lineAppend(b, "=", 1);
+  for(const char *p=value;*p!='\0';p++) {
+    if((*p == ',') || (*p == ' ') || (*p == '='))
+      lineAppend(b, "\\", 1);
+    lineAppend(b, p, 1);
+  }
+}
+
+static void lineFieldKey(line_builder_t *b, const char *key) {
+  lineAppend(b, b->firstField ? " " : ",", 1);
+  lineAppend(b, key, strlen(key));
+  lineAppend(b, "=", 1);
+  b->firstField = false;
+}
+
+// Line protocol has no null, so a field that is not a number is left out.
+// Every field is a float, whole numbers too, as that is how the MQTT to
+// InfluxDB path already stores them and a field can only have one type.
+static void lineFloat(line_builder_t *b, const char *key, float value, uint8_t decimals) {
+  if(isnan(value) || isinf(value))
+    return;
+
+  char number[JSON_NUMBER_LENGTH];
+  lineFieldKey(b, key);
+  lineAppend(b, number, jsonFormatFixed(number, value, decimals));
+}
+
+static void lineStart(line_builder_t *b, char *line, const char *measurement, const char *topic) {
+  b->line = line;
+  b->len = 0;
+  b->firstField = true;
+  lineAppend(b, measurement, strlen(measurement));
+  lineTag(b, "topic", topic);
+}
+
+static void lineEnd(line_builder_t *b, time_t sampleTime) {
+  if(sampleTime >= INFLUX_MIN_TIME) {
+    char number[JSON_NUMBER_LENGTH];
+    lineAppend(b, " ", 1);
+    lineAppend(b, number, jsonFormatInteger(number, sampleTime));
+  }
+  lineAppend(b, "\n", 1);
+}
+
+static void batchAdd(const char *line, uint16_t len) {
+  if(batchBytes + len > INFLUX_BATCH_SIZE) {
+    influxStats.dropped++;
+    return;
+  }
+
+  if(batchPoints == 0)
+    batchStarted = millis();
+
+  memcpy(&batch[batchBytes], line, len);
+  batchBytes += len;
+  batchPoints++;
+  influxStats.points++;
+}
+
+uint16_t influxLineSample(char *line, const char *topic, bool primary, time_t sampleTime, const sensor_data_t *data) {
+  line_builder_t b;
+
+  lineStart(&b, line, primary ? INFLUX_MEASUREMENT : INFLUX_OTHER_MEASUREMENT, topic);
+  lineFloat(&b, "wakeup_reason", data->wakeup_reason, 0);
+  lineFloat(&b, "temperature", fahrenheit(data->temperature), 1);
+  lineFloat(&b, "pressure", data->pressure, 0);
+  lineFloat(&b, "pressureHg", seaLevelInHg(data->pressure), 3);
+  lineFloat(&b, "humidity", data->humidity, 1);
+  lineFloat(&b, "battery", data->battery_millivolts, 1);
+  lineFloat(&b, "direction", data->direction, 0);
+  lineFloat(&b, "anemometer", data->wind_speed, 2);
+  lineFloat(&b, "rain", rainInches(data->rain), 3);
+  lineEnd(&b, sampleTime);
+
+  return b.len;
+}
+
+// Zero if the reading is not worth keeping
+uint16_t influxLineRoom(char *line, const char *topic, time_t sampleTime, float roomTemp, float roomHum) {
+  if((roomTemp <= 0.0) || (roomTemp >= 65.0))
+    return 0;
+
+  line_builder_t b;
+
+  lineStart(&b, line, INFLUX_MEASUREMENT, topic);
+  lineFloat(&b, "room_temp", fahrenheit(roomTemp), 1);
+  lineFloat(&b, "room_hum", roomHum, 1);
+  lineEnd(&b, sampleTime);
+
+  return b.len;
+}
+
+void influxWriteSample(const char *topic, bool primary, time_t sampleTime, const sensor_data_t *data) {
+  char line[INFLUX_LINE_LENGTH];
+  batchAdd(line, influxLineSample(line, topic, primary, sampleTime, data));
+}
+
+void influxWriteRoom(const char *topic, time_t sampleTime, float roomTemp, float roomHum) {
+  char line[INFLUX_LINE_LENGTH];
+  uint16_t len = influxLineRoom(line, topic, sampleTime, roomTemp, roomHum);
+  if(len > 0)
+    batchAdd(line, len);
+}
+
+static void batchSent() {
+  batchBytes = 0;
+  batchPoints = 0;
+  backoff = 0;
+}
+
+static void scheduleRetry() {
+  backoff = (backoff == 0) ? INFLUX_RETRY_MIN_MS : backoff * 2;
+  if(backoff > INFLUX_RETRY_MAX_MS)
+    backoff = INFLUX_RETRY_MAX_MS;
+
+  nextAttempt = millis() + backoff;
+}
+
+static void flushBatch() {
+  char url[100];
+  snprintf(url, sizeof(url), "http://%s:%u/write?db=%s&precision=s", mqttServer, INFLUX_PORT, INFLUX_DATABASE);
+
+  // Usually about a quarter of the size, but a batch of one short line can
+  // come out bigger
+  size_t gzLen = gzipCompress((const uint8_t *)batch, batchBytes, compressed, sizeof(compressed));
+  bool gzipped = (gzLen > 0) && (gzLen < batchBytes);
+
+  HTTPClient hc;
+  hc.begin(url);
+  hc.setTimeout(INFLUX_TIMEOUT_MS);
+  hc.addHeader("Content-Type", "text/plain; charset=utf-8");
+  if(gzipped)
+    hc.addHeader("Content-Encoding", "gzip");
+
+  int rc = gzipped ? hc.POST(compressed, gzLen) : hc.POST((uint8_t *)batch, batchBytes);
+  hc.end();
+
+  influxStats.writes++;
+
+  if((rc >= 200) && (rc < 300)) {
+    influxStats.rawBytes += batchBytes;
+    influxStats.sentBytes += gzipped ? gzLen : batchBytes;
+    batchSent();
+    return;
+  }
+
+  // A 4xx other than too many requests is the data, and will never go
+  if((rc >= 400) && (rc < 500) && (rc != 429)) {
+    char error[70];
+    snprintf(error, sizeof(error), "InfluxDB write of %u points returned %d", batchPoints, rc);
+    LOG_ERROR("influx", error);
+    influxStats.rejected += batchPoints;
+    batchSent();
+    return;
+  }
+
+  influxStats.failures++;
+  scheduleRetry();
+}
+
+void influxWriterLoop() {
+  if(batchPoints == 0)
+    return;
+
+  uint32_t now = millis();
+  if((backoff != 0) && ((int32_t)(now - nextAttempt) < 0))
+    return;
+
+  if((batchBytes < INFLUX_FLUSH_BYTES) && (now - batchStarted < INFLUX_FLUSH_AGE_MS) && (backoff == 0))
+    return;
+
+  if(WiFi.status() != WL_CONNECTED) {
+    scheduleRetry();
+    return;
+  }
+
+  flushBatch();
+}
+
+void getInfluxWriterStats(influx_stats_t *stats) {
+  memcpy(stats, &influxStats, sizeof(influx_stats_t));
+  stats->pendingPoints = batchPoints;
+  stats->pendingBytes = batchBytes;
+}
@@ -0,0 +1,159 @@
+/**
+ *  @filename   :   ingestqueue.cpp
+ *  @brief      :   ESP32 Weather Base Station ESP-NOW Ingest Queue
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <Arduino.h>
+#include <atomic>
+#include "ingestqueue.h"
+#include "timekeeper.h"
+
+#if (INGEST_QUEUE_DEPTH & (INGEST_QUEUE_DEPTH - 1)) != 0
+#error "INGEST_QUEUE_DEPTH must be a power of two"
+#endif
+
+static ingest_frame_t slots[INGEST_QUEUE_DEPTH];
+
+// Free running counters, the slot is the counter masked by the depth. head is
+// only written by the producer and tail only by the consumer.
+static std::atomic<uint16_t> head(0);
+static std::atomic<uint16_t> tail(0);
+
+static std::atomic<uint32_t> received(0);
+static std::atomic<uint32_t> dropped(0);
+static std::atomic<uint16_t> highWater(0);
+
+// Only touched by the consumer, which is also where the stats are published from
+static uint32_t latencyBuckets[INGEST_LATENCY_BUCKETS];
+static uint32_t latencyMax = 0;
+
+// Log scale with four linear steps per power of two, so a percentile is
+// within 25% of the true value
+static uint8_t latencyBucket(uint32_t us) {
+  if(us < 4)
+    return us;
+
+  uint8_t octave = 31 - __builtin_clz(us);
+  return octave * 4 + ((us >> (octave - 2)) & 3) - 4;
+}
+
+// Largest latency that falls in the bucket
+static uint32_t bucketLimit(uint8_t bucket) {
+  if(bucket < 3)
+    return bucket;
+  if(bucket >= INGEST_LATENCY_BUCKETS - 1)
+    return UINT32_MAX;
+
+  uint8_t next = bucket + 1;
+  uint8_t octave = (next + 4) / 4;
+  return ((uint32_t)(4 + (next + 4) % 4) << (octave - 2)) - 1;
+}
+
+static uint32_t latencyPercentile(uint32_t count, uint8_t percent) {
+  if(count == 0)
+    return 0;
+
+  uint32_t target = ((uint64_t)count * percent + 99) / 100;
+  uint32_t seen = 0;
+  for(uint8_t n=0;n<INGEST_LATENCY_BUCKETS;n++) {
+    seen += latencyBuckets[n];
+    if(seen >= target)
+      return (bucketLimit(n) < latencyMax) ? bucketLimit(n) : latencyMax;
+  }
+
+  return latencyMax;
+}
+
+bool ingestPush(const uint8_t *mac, const uint8_t *data, int len) {
+  received.fetch_add(1, std::memory_order_relaxed);
+
+  if((len <= 0) || (len > INGEST_MAX_FRAME)) {
+    dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  uint16_t h = head.load(std::memory_order_relaxed);
+  uint16_t depth = h - tail.load(std::memory_order_acquire);
+  if(depth >= INGEST_QUEUE_DEPTH) {
+    dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  ingest_frame_t *frame = &slots[h & (INGEST_QUEUE_DEPTH - 1)];
+
+  frame->rxMicros = timeEpochMicros();
+  frame->rxMonotonic = timeMicros();
+  memcpy(frame->mac, mac, 6);
+  frame->len = len;
+  memcpy(frame->data, data, len);
+
+  head.store(h + 1, std::memory_order_release);
+
+  if(depth + 1 > highWater.load(std::memory_order_relaxed))
+    highWater.store(depth + 1, std::memory_order_relaxed);
+
+  return true;
+}
+
+// Returns the oldest frame in place, or NULL when empty. The slot stays owned
+// by the consumer until ingestRelease() is called.
+ingest_frame_t *ingestPeek() {
+  uint16_t t = tail.load(std::memory_order_relaxed);
+  if(t == head.load(std::memory_order_acquire))
+    return NULL;
+
+  return &slots[t & (INGEST_QUEUE_DEPTH - 1)];
+}
+
+// Also records how long the frame took from arrival to being fully handled
+void ingestRelease() {
+  uint16_t t = tail.load(std::memory_order_relaxed);
+  if(t == head.load(std::memory_order_acquire))
+    return;
+
+  int64_t latency = timeMicros() - slots[t & (INGEST_QUEUE_DEPTH - 1)].rxMonotonic;
+  if(latency < 0)
+    latency = 0;
+  if(latency > UINT32_MAX)
+    latency = UINT32_MAX;
+
+  latencyBuckets[latencyBucket(latency)]++;
+  if(latency > latencyMax)
+    latencyMax = latency;
+
+  tail.store(t + 1, std::memory_order_release);
+}
+
+void ingestGetStats(ingest_stats_t *stats) {
+  stats->received = received.load(std::memory_order_relaxed);
+  stats->dropped = dropped.load(std::memory_order_relaxed);
+  stats->depth = head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+  stats->highWater = highWater.load(std::memory_order_relaxed);
+
+  uint32_t count = 0;
+  for(uint8_t n=0;n<INGEST_LATENCY_BUCKETS;n++)
+    count += latencyBuckets[n];
+
+  stats->latencyP50 = latencyPercentile(count, 50);
+  stats->latencyP90 = latencyPercentile(count, 90);
+  stats->latencyP99 = latencyPercentile(count, 99);
+  stats->latencyMax = latencyMax;
+}
@@ -0,0 +1,232 @@
+/**
+ *  @filename   :   jsonwriter.cpp
+ *  @brief      :   ESP32 Weather Base Station Fixed Schema JSON Writer
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <Arduino.h>
+#include <math.h>
+#include "jsonwriter.h"
+
+static const double decimalScale[JSON_MAX_DECIMALS + 1] = {1.0, 10.0, 100.0, 1000.0, 10000.0, 100000.0, 1000000.0};
+static const char hexDigits[] = "0123456789abcdef";
+
+// Counting and writing share the same code, so the length given to
+// beginPublish() can never disagree with what is sent. With no Print attached
+// the bytes are only counted.
+typedef struct json_sink_t {
+  Print *out;
+  uint16_t length;
+  uint8_t used;
+  uint8_t chunk[JSON_WRITE_CHUNK];
+} json_sink_t;
+
+static void sinkFlush(json_sink_t *sink) {
+  if((sink->out != NULL) && (sink->used > 0))
+    sink->out->write(sink->chunk, sink->used);
+  sink->used = 0;
+}
+
+static void sinkWrite(json_sink_t *sink, const char *data, uint8_t len) {
+  sink->length += len;
+  if(sink->out == NULL)
+    return;
+
+  for(uint8_t n=0;n<len;n++) {
+    if(sink->used == JSON_WRITE_CHUNK)
+      sinkFlush(sink);
+    sink->chunk[sink->used++] = data[n];
+  }
+}
+
+static void sinkChar(json_sink_t *sink, char c) {
+  sinkWrite(sink, &c, 1);
+}
+
+// Digits are generated backwards from the end of buffer. Returns the start.
+static char *formatUnsigned(char *end, uint64_t value) {
+  do {
+    *--end = '0' + (value % 10);
+    value /= 10;
+  } while(value != 0);
+
+  return end;
+}
+
+// Both write at most JSON_NUMBER_LENGTH characters, unterminated, and return
+// the count. Also used for line protocol.
+uint8_t jsonFormatInteger(char *buffer, int64_t value) {
+  char digits[JSON_NUMBER_LENGTH];
+  char *end = &digits[JSON_NUMBER_LENGTH];
+  char *p = formatUnsigned(end, (value < 0) ? -(uint64_t)value : (uint64_t)value);
+  if(value < 0)
+    *--p = '-';
+
+  memcpy(buffer, p, end - p);
+  return end - p;
+}
+
+// Rounded once to a scaled integer, then printed as digits with the decimal
+// point dropped in. Same output as %.<n>f apart from exact halves, which
+// round away from zero. NaN and infinity have no JSON form, so are null.
+// Anything too big to scale to an integer goes out in exponent form instead,
+// with the nine digits a float can hold.
+uint8_t jsonFormatFixed(char *buffer, float value, uint8_t decimals) {
+  if(isnan(value) || isinf(value)) {
+    memcpy(buffer, "null", 4);
+    return 4;
+  }
+
+  if(decimals > JSON_MAX_DECIMALS)
+    decimals = JSON_MAX_DECIMALS;
+
+  double scaled = round((double)value * decimalScale[decimals]);
+  if(fabs(scaled) >= JSON_MAX_SCALED)
+    return snprintf(buffer, JSON_NUMBER_LENGTH, "%.8e", (double)value);
+
+  bool negative = scaled < 0;
+  uint64_t whole = (uint64_t)(negative ? -scaled : scaled);
+
+  char digits[JSON_NUMBER_LENGTH];
+  char *end = &digits[JSON_NUMBER_LENGTH];
+  char *p = end;
+
+  for(uint8_t n=0;n<decimals;n++) {
+    *--p = '0' + (whole % 10);
+    whole /= 10;
+  }
+  if(decimals > 0)
+    *--p = '.';
+
+  p = formatUnsigned(p, whole);
+  if(negative)
+    *--p = '-';
+
+  memcpy(buffer, p, end - p);
+  return end - p;
+}
+
+static void writeInteger(json_sink_t *sink, int64_t value) {
+  char buffer[JSON_NUMBER_LENGTH];
+  sinkWrite(sink, buffer, jsonFormatInteger(buffer, value));
+}
+
+static void writeFixed(json_sink_t *sink, float value, uint8_t decimals) {
+  char buffer[JSON_NUMBER_LENGTH];
+  sinkWrite(sink, buffer, jsonFormatFixed(buffer, value, decimals));
+}
+
+static void writeString(json_sink_t *sink, const char *value, uint8_t maxLength) {
+  sinkChar(sink, '"');
+
+  for(uint8_t n=0;(n<maxLength) && (value[n] != '\0');n++) {
+    char c = value[n];
+    if((c == '"') || (c == '\\')) {
+      char escaped[2] = {'\\', c};
+      sinkWrite(sink, escaped, 2);
+    } else if((uint8_t)c < 0x20) {
+      char escaped[6] = {'\\', 'u', '0', '0', hexDigits[(c >> 4) & 0x0f], hexDigits[c & 0x0f]};
+      sinkWrite(sink, escaped, 6);
+    } else {
+      sinkChar(sink, c);
+    }
+  }
+
+  sinkChar(sink, '"');
+}
+
+static void writeObject(json_sink_t *sink, const json_schema_t *schema, const json_value_t *values) {
+  sinkChar(sink, '{');
+
+  for(uint8_t n=0;n<schema->count;n++) {
+    const json_field_t *field = &schema->fields[n];
+    if(n > 0)
+      sinkChar(sink, ',');
+
+    sinkWrite(sink, field->key, field->keyLength);
+
+    switch(field->type) {
+      case JSON_INT:
+        writeInteger(sink, values[n].i);
+        break;
+      case JSON_UINT:
+        writeInteger(sink, values[n].u);
+        break;
+      case JSON_FIXED_POINT:
+        writeFixed(sink, values[n].f, field->arg);
+        break;
+      case JSON_STRING:
+        writeString(sink, (values[n].s != NULL) ? values[n].s : "", field->arg);
+        break;
+    }
+  }
+
+  sinkChar(sink, '}');
+}
+
+uint16_t jsonLength(const json_schema_t *schema, const json_value_t *values) {
+  json_sink_t sink;
+  sink.out = NULL;
+  sink.length = 0;
+  sink.used = 0;
+
+  writeObject(&sink, schema, values);
+  return sink.length;
+}
+
+void jsonWrite(Print &out, const json_schema_t *schema, const json_value_t *values) {
+  json_sink_t sink;
+  sink.out = &out;
+  sink.length = 0;
+  sink.used = 0;
+
+  writeObject(&sink, schema, values);
+  sinkFlush(&sink);
+}
+
+class BufferPrint : public Print {
+  public:
+    BufferPrint(char *buffer) : buffer(buffer), used(0) {}
+
+    size_t write(uint8_t c) { buffer[used++] = c; return 1; }
+    size_t write(const uint8_t *data, size_t size) {
+      memcpy(&buffer[used], data, size);
+      used += size;
+      return size;
+    }
+
+  private:
+    char *buffer;
+    size_t used;
+};
+
+// For the paths that have to hold on to the payload (the queue and the
+// outbox). Returns the length, or 0 if it does not fit with its terminator.
+uint16_t jsonRender(char *buffer, uint16_t size, const json_schema_t *schema, const json_value_t *values) {
+  uint16_t len = jsonLength(schema, values);
+  if(len >= size)
+    return 0;
+
+  BufferPrint out(buffer);
+  jsonWrite(out, schema, values);
+  buffer[len] = '\0';
+
+  return len;
+}
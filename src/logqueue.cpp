@@ -0,0 +1,209 @@
+/**
+ *  @filename   :   logqueue.cpp
+ *  @brief      :   ESP32 Weather Base Station Log Queue
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "wifiwithmqtt.h"
+#include "logqueue.h"
+
+typedef struct log_entry_t {
+  uint8_t level;
+  uint16_t repeated;                // Copies folded into this one
+  uint16_t suppressed;              // Rate limited from the same system before it
+  char system[LOG_SYSTEM_LENGTH + 1];
+  char message[LOG_MESSAGE_LENGTH + 1];
+} log_entry_t;
+
+typedef struct log_limit_t {
+  char system[LOG_SYSTEM_LENGTH + 1];
+  uint8_t tokens;
+  uint32_t lastRefill;
+  uint16_t suppressed;              // Since the last message that got through
+} log_limit_t;
+
+// Any task can log, only the network task sends
+static SemaphoreHandle_t logMutex = NULL;
+
+static log_entry_t entries[LOG_QUEUE_DEPTH];
+static uint8_t head = 0;
+static uint8_t depth = 0;
+
+static log_limit_t limits[LOG_MAX_SYSTEMS];
+static uint8_t numLimits = 0;
+
+static log_stats_t logStats;
+
+static void lockLog() {
+  if(logMutex != NULL)
+    xSemaphoreTake(logMutex, portMAX_DELAY);
+}
+
+static void unlockLog() {
+  if(logMutex != NULL)
+    xSemaphoreGive(logMutex);
+}
+
+static log_entry_t *entryAt(uint8_t n) {
+  return &entries[(head + n) % LOG_QUEUE_DEPTH];
+}
+
+static log_limit_t *findLimit(const char *system) {
+  for(uint8_t n=0;n<numLimits;n++) {
+    if(strncmp(limits[n].system, system, LOG_SYSTEM_LENGTH) == 0)
+      return &limits[n];
+  }
+
+  if(numLimits == LOG_MAX_SYSTEMS)
+    return &limits[LOG_MAX_SYSTEMS - 1];
+
+  log_limit_t *limit = &limits[numLimits++];
+  strncpy(limit->system, system, LOG_SYSTEM_LENGTH);
+  limit->system[LOG_SYSTEM_LENGTH] = '\0';
+  limit->tokens = LOG_RATE_BURST;
+  limit->lastRefill = millis();
+  limit->suppressed = 0;
+
+  return limit;
+}
+
+static bool takeToken(log_limit_t *limit) {
+  uint32_t now = millis();
+  uint32_t refill = (now - limit->lastRefill) / LOG_RATE_REFILL_MS;
+
+  if(refill > 0) {
+    limit->tokens = (limit->tokens + refill > LOG_RATE_BURST) ? LOG_RATE_BURST : limit->tokens + refill;
+    limit->lastRefill += refill * LOG_RATE_REFILL_MS;
+  }
+
+  // A full bucket has nothing to earn, so the clock starts from now
+  if(limit->tokens == LOG_RATE_BURST)
+    limit->lastRefill = now;
+
+  if(limit->tokens == 0)
+    return false;
+
+  limit->tokens--;
+  return true;
+}
+
+void initLogQueue() {
+  if(logMutex == NULL)
+    logMutex = xSemaphoreCreateMutex();
+}
+
+// Never blocks on the network. Returns false if the message was thrown away.
+bool logEnqueue(uint8_t level, const char *system, const char *message) {
+  lockLog();
+
+  for(uint8_t n=0;n<depth;n++) {
+    log_entry_t *entry = entryAt(n);
+    if((entry->level == level) && (strncmp(entry->system, system, LOG_SYSTEM_LENGTH) == 0) &&
+      (strncmp(entry->message, message, LOG_MESSAGE_LENGTH) == 0)) {
+      if(entry->repeated < UINT16_MAX)
+        entry->repeated++;
+      logStats.coalesced++;
+      unlockLog();
+      return true;
+    }
+  }
+
+  log_limit_t *limit = findLimit(system);
+  if(!takeToken(limit)) {
+    if(limit->suppressed < UINT16_MAX)
+      limit->suppressed++;
+    logStats.rateLimited++;
+    unlockLog();
+    return false;
+  }
+
+  if(depth == LOG_QUEUE_DEPTH) {
+    if(limit->suppressed < UINT16_MAX)
+      limit->suppressed++;
+    logStats.dropped++;
+    unlockLog();
+    return false;
+  }
+
+  log_entry_t *entry = entryAt(depth);
+  entry->level = level;
+  entry->repeated = 0;
+  entry->suppressed = limit->suppressed;
+  limit->suppressed = 0;
+  strncpy(entry->system, system, LOG_SYSTEM_LENGTH);
+  entry->system[LOG_SYSTEM_LENGTH] = '\0';
+  strncpy(entry->message, message, LOG_MESSAGE_LENGTH);
+  entry->message[LOG_MESSAGE_LENGTH] = '\0';
+
+  depth++;
+  logStats.queued++;
+  if(depth > logStats.highWater)
+    logStats.highWater = depth;
+
+  unlockLog();
+  return true;
+}
+
+// Called from the network task. Messages wait here until they are sent,
+// so repeats keep folding together instead of filling the MQTT queue.
+void logQueueLoop() {
+  if(!mqttConnected())
+    return;
+
+  for(uint8_t n=0;n<LOG_DRAIN_PER_LOOP;n++) {
+    log_entry_t entry;
+
+    lockLog();
+    if(depth == 0) {
+      unlockLog();
+      return;
+    }
+    memcpy(&entry, entryAt(0), sizeof(log_entry_t));
+    unlockLog();
+
+    // Left at the head until it is sent, the client may be busy
+    if(!logMessage(entry.level, entry.system, entry.message, entry.repeated, entry.suppressed))
+      return;
+
+    // Only this task takes entries off, so the head is still this one. Any
+    // repeats folded in while it was being sent go out next time.
+    lockLog();
+    log_entry_t *sent = entryAt(0);
+    if(sent->repeated == entry.repeated) {
+      head = (head + 1) % LOG_QUEUE_DEPTH;
+      depth--;
+    } else {
+      sent->repeated -= entry.repeated + 1;
+      sent->suppressed = 0;
+    }
+    logStats.sent++;
+    unlockLog();
+  }
+}
+
+void getLogStats(log_stats_t *stats) {
+  lockLog();
+  memcpy(stats, &logStats, sizeof(log_stats_t));
+  stats->depth = depth;
+  unlockLog();
+}
@@ -31,78 +31,147 @@
 #include "wifiwithmqtt.h"
 #include "espnow.h"
 #include "display.h"
+#include "ingestqueue.h"
+#include "stations.h"
+#include "wireformat.h"
+#include "stats.h"
+#include "tasks.h"
+#include "capture.h"
+#include "outbox.h"
+#include "logqueue.h"
+#include "influxwriter.h"
+#include "rollup.h"
+#include "history.h"
+#include "timekeeper.h"
+#include "pressuretrend.h"
 #include "HTU21D.h"
 
 extern bool buttonLongPress;
 uint16_t count=0;
-bool dataValid=false;
-sensor_data_t sensorData;
-float currentSecs;
-float prevSecs=0;
 long last_reconnect=30000;
 bool htd21Init = false;
 
+extern char mqttTopic[MQTT_TOPIC_LENGTH];
+
 HTU21D            myHTU21D(HTU21D_RES_RH12_TEMP14);
 
 void connectEspNow(void);
 void connectWiFi(void);
 
+// Runs in the WiFi task, so just queue the frame and let loop() do the work
 static void espnow_recv_cb(const uint8_t *mac_addr, const uint8_t *data, int len)
 {
-  
-  struct timeval tv;
-  gettimeofday(&tv,NULL);
-  currentSecs=tv.tv_sec + (tv.tv_usec / 1E06);
+  ingestPush(mac_addr, data, len);
+}
 
-  Serial.printf("Current Time %f\n", currentSecs);
+// sampleMicros is when it was taken on the wall clock, sampleMonotonic the
+// same on timeMicros()
+static void processSample(station_t *station, const sensor_data_t *sensorData, int64_t sampleMicros, int64_t sampleMonotonic) {
+  DEBUG_PRINTF("Station=%d\n", station->index);
+  DEBUG_PRINTF("Wakeup Reason=%d\n", sensorData->wakeup_reason);
+  DEBUG_PRINTF("Temperature=%f *C\n",sensorData->temperature);
+  DEBUG_PRINTF("Pressure=%d Pa\n",sensorData->pressure);
+  DEBUG_PRINTF("Humidity=%f\n",sensorData->humidity);
+  DEBUG_PRINTF("Battery Volts=%f mV\n",sensorData->battery_millivolts);
+  DEBUG_PRINTF("Direction=%d\n",sensorData->direction);
+  DEBUG_PRINTF("Rain Count=%f\n", sensorData->rain);
+  DEBUG_PRINTF("Anenomoeter Count=%f\n", sensorData->wind_speed);
+  DEBUG_PRINTF("Count=%d\n",count++);
+
+  stationUpdate(station, sensorData, sampleMicros);
+
+  DEBUG_PRINTF("Message Interval %f\n",station->lastInterval);
+
+  if(station->primary) {
+    historyAddSample(sensorData, sampleMicros / 1000000);
+    pressureTrendAdd(sensorData, sampleMonotonic);
+  }
 
-  for(int i=0;i<6;i++) {
-    Serial.printf("%x:",mac_addr[i]);
+#if ROLLUP_MODE != ROLLUP_OFF
+  rollupAdd(station, sensorData, sampleMicros / 1000000);
+#endif
+
+#ifdef INFLUX_WRITER
+  influxWriteSample(station->topic, station->primary, sampleMicros / 1000000, sensorData);
+#else
+#if ROLLUP_MODE == ROLLUP_INSTEAD
+  if(station->primary)
+#endif
+  publishData(station->topic, sampleMicros / 1000000, sensorData->wakeup_reason, sensorData->temperature, sensorData->pressure, sensorData->humidity, sensorData->battery_millivolts, sensorData->direction, sensorData->wind_speed, sensorData->rain);
+#endif
+}
 
+static void stationStale(const station_t *station) {
+  if((station == NULL) || station->primary) {
+    postDisplayStale(NULL);
+    return;
   }
-  Serial.println();
 
-  if (len == sizeof(sensor_data_t))
-  {
-    memcpy(&sensorData, data, len);
+  char mac[MQTT_MAC_LENGTH];
+  stationMacString(station, mac);
+  postDisplayStale(mac);
+}
 
-    Serial.printf("Wakeup Reason=%d\n", sensorData.wakeup_reason);
-    Serial.printf("Temperature=%f *C\n",sensorData.temperature);
-    Serial.printf("Pressure=%d Pa\n",sensorData.pressure);
-    Serial.printf("Humidity=%f\n",sensorData.humidity);
-    Serial.printf("Battery Volts=%f mV\n",sensorData.battery_millivolts);
-    Serial.printf("Direction=%d\n",sensorData.direction);
-    Serial.printf("Rain Count=%f\n", sensorData.rain);
-    Serial.printf("Anenomoeter Count=%f\n", sensorData.wind_speed);
-    Serial.printf("Count=%d\n",count++);
+void sendMQTTData(const ingest_frame_t *frame) {
 
-    dataValid=true;
+  for(int i=0;i<6;i++) {
+    DEBUG_PRINTF("%x:",frame->mac[i]);
 
+  }
+  DEBUG_PRINTLN();
 
-  } else {
-    Serial.println("Received something of wrong length");
+  wire_reader_t reader;
+  if(!wireReaderInit(&reader, frame->data, frame->len)) {
+    Serial.println("Received something of wrong length or version");
+    return;
   }
-}
 
-void sendMQTTData() {
-  float messageInterval;
-  if(prevSecs==0) {
-    messageInterval = currentSecs;
-  } else {
-    messageInterval = currentSecs - prevSecs;
+  station_t *station = stationLookup(frame->mac, true);
+  if(station == NULL) {
+    Serial.println("Station table full, frame dropped");
+    return;
   }
 
-  Serial.printf("Message Interval %f\n",messageInterval);
+  if(stationAdoptPrimary(station)) {
+    char mac[MQTT_MAC_LENGTH];
+    stationMacString(station, mac);
+    savePrimaryStation(mac);
 
-  publishData(sensorData.wakeup_reason, sensorData.temperature, sensorData.pressure, sensorData.humidity, sensorData.battery_millivolts, sensorData.direction, sensorData.wind_speed, sensorData.rain);
-  prevSecs = currentSecs;
+    char message[50];
+    snprintf(message, sizeof(message), "Primary station is now %s", mac);
+    LOG_INFO("stations", message);
+  }
+
+  // Legacy frames have no sequence number, so they can't be checked
+  if(reader.header != NULL) {
+    station->stationId = reader.header->stationId;
+    bool restart = reader.header->flags & WIRE_FLAG_RESTART;
+    if(stationCheckSequence(station, reader.header->sequence, restart) == SEQ_DUPLICATE) {
+      DEBUG_PRINTF("Duplicate frame %d from station %d\n", reader.header->sequence, station->index);
+      return;
+    }
+  }
+
+  // Batched frames carry the samples oldest first, each with its age at send time
+  sensor_data_t sensorData;
+  uint16_t age;
+  bool gotSample = false;
+  while(wireNextSample(&reader, &sensorData, &age)) {
+    int64_t ageMicros = (int64_t)age * 1000000LL;
+    processSample(station, &sensorData, frame->rxMicros - ageMicros, frame->rxMonotonic - ageMicros);
+    gotSample = true;
+  }
+
+  // Only the primary station drives the display and the room sensor
+  if(!gotSample || !station->primary)
+    return;
 
   if(!htd21Init){
     Wire.begin();
     Wire.setClock(100000);
     if(myHTU21D.begin() !=true) {
       Serial.println("HTU21 Failed");
-      log("htd21","HTD21D Failed to Initialize");
+      LOG_ERROR("htd21","HTD21D Failed to Initialize");
       setError("HTD21D Initialization Failure");
     } else {
       htd21Init = true;
@@ -115,16 +184,21 @@ void sendMQTTData() {
     roomC = myHTU21D.readTemperature();
     roomHum = myHTU21D.readCompensatedHumidity();
     if((roomC > 65.0) || (roomHum > 100.0)) {
-      log("htd21d","HTD21D Failure");
+      LOG_ERROR("htd21d","HTD21D Failure");
       htd21Init = false;
       setError("Temperature Sensor Failure");
       roomHum=101.0;
     } else {
+      historyAddRoom(roomC, roomHum, time(NULL));
+#ifdef INFLUX_WRITER
+      influxWriteRoom(mqttTopic, time(NULL), roomC, roomHum);
+#else
       publishRoomStats(roomC,roomHum);
+#endif
     }
   }
 
-  displayData(sensorData.temperature, sensorData.pressure, sensorData.humidity, sensorData.battery_millivolts, sensorData.direction, sensorData.wind_speed, sensorData.rain, roomC, roomHum);
+  postDisplayData(&sensorData, roomC, roomHum);
 
 }
 
@@ -167,6 +241,7 @@ void setup() {
   Serial.begin(115200);
   readEEPROM();
   connectWiFi();
+  initTime();
   connectEspNow();
   WiFi.printDiag(Serial);
   Serial.print("Station IP Address: ");
@@ -177,12 +252,20 @@ void setup() {
   pinMode(CONFIG_BUTTON,INPUT);
   attachInterrupt(digitalPinToInterrupt(CONFIG_BUTTON), longPress, CHANGE);
 
+  initOutbox();
+  initLogQueue();
+  initHistory();
+  initPressureTrend();
   log("main","Starting");
-  
+
+  initTasks();
   initDisplay();
+  initStats();
+  startTasks();
 }
 
-void loop() {
+// Runs forever on the network task, see tasks.cpp
+void networkLoop() {
 
   if((WiFi.status() != WL_CONNECTED) && (millis() > last_reconnect)) {
     Serial.println("Wifi Reconnect");
@@ -199,15 +282,40 @@ void loop() {
   }
 
   // Fails if I send data to MQTT in call back
-  if(dataValid) {
-    dataValid=false;
-    Serial.println("Sending Data");
-    sendMQTTData();
-    Serial.printf("WifiStatus %d\n",WiFi.status());
+  ingest_frame_t *frame;
+  while((frame = ingestPeek()) != NULL) {
+    DEBUG_PRINTLN("Sending Data");
+#ifdef CAPTURE_FRAMES
+    captureWrite(Serial, frame);
+#endif
+    sendMQTTData(frame);
+    ingestRelease();
+    DEBUG_PRINTF("WifiStatus %d\n",WiFi.status());
   }
 
+  stationsCheckStale(stationStale);
+
+  timeLoop();
   mqttLoop();
-  displayLoop();
+  outboxLoop();
+  logQueueLoop();
+  historyLoop();
+#if ROLLUP_MODE != ROLLUP_OFF
+  rollupLoop();
+#endif
+#ifdef INFLUX_WRITER
+  influxWriterLoop();
+#endif
+  statsLoop();
 
   ArduinoOTA.handle();
+}
+
+void loop() {
+#ifdef NATIVE_BUILD
+  runTasksOnce();
+#else
+  // Everything runs on the tasks started in setup()
+  vTaskDelete(NULL);
+#endif
 }
\ No newline at end of file
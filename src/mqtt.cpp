@@ -24,13 +24,16 @@
 #include "PubSubClient.h"
 #include "weatherbase.h"
 #include "wifiwithmqtt.h"
+#include "outbox.h"
+#include "jsonwriter.h"
+#include "packwriter.h"
+#include "logqueue.h"
 
 #ifdef DEV_MODE
 #include "display.h"
 #include <ArduinoJson.h>
 #include "HTU21D.h"
 
-static boolean publishMes(char *topic, char *payload);
 
 HTU21D            myHTU21D(HTU21D_RES_RH12_TEMP14);
 
@@ -40,16 +43,107 @@ WiFiClient espClient;
 PubSubClient mqttClient(espClient);
 char subName[25];
 
+// PubSubClient is not thread safe, and logs can come from any task. Only the
+// network task waits for the client, everyone else queues if it is busy.
+static SemaphoreHandle_t mqttMutex = NULL;
+static SemaphoreHandle_t queueMutex = NULL;
+
+static bool lockMQTT(TickType_t wait = portMAX_DELAY) {
+    if(mqttMutex == NULL)
+        return true;
+
+    return xSemaphoreTakeRecursive(mqttMutex, wait) == pdTRUE;
+}
+
+static void unlockMQTT() {
+    if(mqttMutex != NULL)
+        xSemaphoreGiveRecursive(mqttMutex);
+}
+
+static void lockQueue() {
+    if(queueMutex != NULL)
+        xSemaphoreTake(queueMutex, portMAX_DELAY);
+}
+
+static void unlockQueue() {
+    if(queueMutex != NULL)
+        xSemaphoreGive(queueMutex);
+}
+
+// Messages waiting for the broker, stored back to back as
+// topic length(1) payload length(2) topic payload, wrapping at the end
+static uint8_t queue[MQTT_QUEUE_SIZE];
+static uint16_t queueHead = 0;
+static uint16_t queueTail = 0;
+static uint16_t queueBytes = 0;
+static uint16_t queueMessages = 0;
+static uint32_t queueDrops = 0;               // Changes whenever the oldest is pushed out
+
+// Connection state machine, only run from mqttLoop() on the network task
+static bool wasConnected = false;
+static uint32_t nextAttempt = 0;
+static uint32_t backoff = 0;
+static uint32_t disconnectedSince = 0;
+
+static mqtt_stats_t mqttStats;
+
+typedef struct payload_rule_t {
+    char prefix[MQTT_PAYLOAD_PREFIX_LENGTH];
+    uint8_t format;
+} payload_rule_t;
+
+static payload_rule_t payloadRules[MQTT_PAYLOAD_RULES];
+static uint8_t numPayloadRules = 0;
+
 extern char mqttServer[MQTT_SERVER_LENGTH];
 extern char mqttTopic[MQTT_TOPIC_LENGTH];
+extern char mqttFormat[MQTT_FORMAT_LENGTH];
 extern uint16_t mqttPort;
 
-const char *stateJson = "{\"wakeup_reason\":%d,\"temperature\":%.1f,\"pressure\":%d,\"humidity\":%.1f,\"battery\":%.1f,\"direction\":%d,\"anemometer\":%f,\"rain\":%f}";
-const char *roomData="{\"room_temp\":%.1f,\"room_hum\":%.1f}";
-const char *logJson="{\"host\":\"%.32s\",\"system\":\"%.20s\",\"message\":\"%.150s\"}";
+// The CBOR and MessagePack keys are the position in these tables, so fields
+// may only be added at the end
+static const json_field_t stateFields[] = {
+    JSON_INTEGER(wakeup_reason),
+    JSON_FIXED(temperature, 1),
+    JSON_INTEGER(pressure),
+    JSON_FIXED(humidity, 1),
+    JSON_FIXED(battery, 1),
+    JSON_INTEGER(direction),
+    JSON_FIXED(anemometer, 6),
+    JSON_FIXED(rain, 6)
+};
+static const json_schema_t stateSchema = JSON_SCHEMA(stateFields);
+
+static const json_field_t roomFields[] = {
+    JSON_FIXED(room_temp, 1),
+    JSON_FIXED(room_hum, 1)
+};
+static const json_schema_t roomSchema = JSON_SCHEMA(roomFields);
+
+static const json_field_t logFields[] = {
+    JSON_TEXT(host, 32),
+    JSON_TEXT(level, 5),
+    JSON_TEXT(system, 20),
+    JSON_TEXT(message, 150)
+};
+static const json_schema_t logSchema = JSON_SCHEMA(logFields);
+
+// Only used when the log queue folded repeats in, or rate limited some away
+static const json_field_t logCountFields[] = {
+    JSON_TEXT(host, 32),
+    JSON_TEXT(level, 5),
+    JSON_TEXT(system, 20),
+    JSON_TEXT(message, 150),
+    JSON_UNSIGNED(repeated),
+    JSON_UNSIGNED(suppressed)
+};
+static const json_schema_t logCountSchema = JSON_SCHEMA(logCountFields);
+
+// Indexed by LOG_LEVEL_*
+static const char *logLevels[] = {"none", "error", "warn", "info", "debug"};
 
 void mqttCallback(char *topic, byte *payload, uint16_t length) {
-    Serial.printf("Message Received on topic %s\n", topic);
+    DEBUG_PRINTF("Message Received on topic %s\n", topic);
     if(length < 50) //stop it from acting own it's own messages
         return;
 
@@ -93,22 +187,28 @@ void mqttCallback(char *topic, byte *payload, uint16_t length) {
     float roomC = myHTU21D.readTemperature();
     float roomHum = myHTU21D.readCompensatedHumidity();
 
-    if((roomC>0.0)&&(roomC<65.0)) {
-        char jdata[200];
-        sprintf(jdata,roomData,roomC,roomHum);
-        Serial.println(jdata);
-        publishMes(mqttTopic,jdata);
-    }
+    publishRoomStats(roomC, roomHum);
 
     displayData(temperature, pressure, humidity, batt, dir, anem, rain, roomC, roomHum);
     #endif
     
 }
 
+// PubSubClient opens the socket with the default TCP timeout, which stalls
+// the network task for seconds when the broker is unreachable. The socket is
+// opened here with a short one instead, and connect() uses it as it is and
+// only waits MQTT_SOCKET_TIMEOUT for the CONNACK.
 static void reconnect() {
-    if(mqttClient.connect(subName)) {
+    mqttStats.connectAttempts++;
+
+    espClient.stop();
+    bool connected = espClient.connect(mqttServer, mqttPort, MQTT_CONNECT_TIMEOUT_MS) && mqttClient.connect(subName);
+
+    if(connected) {
         Serial.println("MQTT Connected");
     } else {
+        mqttStats.connectFailures++;
+        espClient.stop();
         char errorMes[50];
         sprintf(errorMes, "MQTT Connection failed, rc=%d",mqttClient.state());
         Serial.println(errorMes);
@@ -120,61 +220,331 @@ static void reconnect() {
 #endif
 }
 
-static boolean publishMes(const char *topic, const char *payload) {
-    if(!mqttClient.connected())
-        reconnect();
-        if(!mqttClient.connected())
-            return false;
+static void queueWrite(const uint8_t *data, uint16_t len) {
+    for(uint16_t n=0;n<len;n++) {
+        queue[queueHead] = data[n];
+        queueHead = (queueHead + 1) % MQTT_QUEUE_SIZE;
+    }
+}
 
+// Copies out from offset without taking anything off the queue
+static uint16_t queuePeek(uint16_t offset, uint8_t *data, uint16_t len) {
+    for(uint16_t n=0;n<len;n++) {
+        data[n] = queue[offset];
+        offset = (offset + 1) % MQTT_QUEUE_SIZE;
+    }
+    return offset;
+}
 
-    if(!mqttClient.publish(topic, payload)) {
-        char errorMes[50];
-        sprintf(errorMes, "MQTT Publish failed, rc=%d",mqttClient.state());
-        Serial.println(errorMes);
+static bool queueEmpty() {
+    lockQueue();
+    bool empty = (queueMessages == 0);
+    unlockQueue();
+
+    return empty;
+}
+
+static uint16_t queuePeekPayloadLength() {
+    uint16_t offset = (queueTail + 1) % MQTT_QUEUE_SIZE;
+    return queue[offset] | (queue[(offset + 1) % MQTT_QUEUE_SIZE] << 8);
+}
+
+static void queueDropOldest() {
+    uint16_t len = 3 + queue[queueTail] + queuePeekPayloadLength();
+
+    queueTail = (queueTail + len) % MQTT_QUEUE_SIZE;
+    queueBytes -= len;
+    queueMessages--;
+    queueDrops++;
+    mqttStats.queueDropped++;
+}
+
+// Keeps the newest messages if the outage outlasts the queue
+static bool enqueue(const char *topic, const uint8_t *payload, uint16_t payloadLen) {
+    size_t topicLen = strlen(topic);
+    size_t len = 3 + topicLen + payloadLen;
+
+    if((topicLen > UINT8_MAX) || (len > MQTT_QUEUE_SIZE)) {
+        mqttStats.queueDropped++;
+        return false;
+    }
+
+    lockQueue();
+
+    while(queueBytes + len > MQTT_QUEUE_SIZE)
+        queueDropOldest();
+
+    uint8_t header[3] = {(uint8_t)topicLen, (uint8_t)(payloadLen & 0xff), (uint8_t)(payloadLen >> 8)};
+    queueWrite(header, 3);
+    queueWrite((const uint8_t *)topic, topicLen);
+    queueWrite(payload, payloadLen);
+
+    queueBytes += len;
+    queueMessages++;
+    if(queueBytes > mqttStats.queueHighWater)
+        mqttStats.queueHighWater = queueBytes;
+
+    unlockQueue();
+    return true;
+}
+
+static bool sendNow(const char *topic, const uint8_t *payload, uint16_t len) {
+    if(mqttClient.publish(topic, payload, len))
+        return true;
+
+    char errorMes[50];
+    sprintf(errorMes, "MQTT Publish failed, rc=%d",mqttClient.state());
+    Serial.println(errorMes);
+
+    return false;
+}
+
+// Called with the client locked and connected. The oldest message is copied
+// out and only taken off once it is sent, so if the connection goes away it
+// is the first to go when it comes back. Anyone queueing meanwhile may have
+// pushed it out already, which queueDrops tells.
+static void drainQueue() {
+    static char topic[UINT8_MAX + 1];
+    static uint8_t payload[MQTT_QUEUE_SIZE];
+
+    for(uint8_t n=0;n<MQTT_DRAIN_PER_LOOP;n++) {
+        lockQueue();
+        if(queueMessages == 0) {
+            unlockQueue();
+            return;
+        }
+
+        uint8_t header[3];
+        uint16_t offset = queuePeek(queueTail, header, 3);
+        uint16_t payloadLen = header[1] | (header[2] << 8);
+        offset = queuePeek(offset, (uint8_t *)topic, header[0]);
+        queuePeek(offset, payload, payloadLen);
+        topic[header[0]] = '\0';
+        uint32_t drops = queueDrops;
+        unlockQueue();
+
+        bool sent = sendNow(topic, payload, payloadLen);
+        if(!sent && mqttClient.connected())
+            mqttStats.publishFailed++;      // Rejected, so retrying won't help
+
+        lockQueue();
+        if((sent || mqttClient.connected()) && (drops == queueDrops)) {
+            uint16_t len = 3 + header[0] + payloadLen;
+            queueTail = (queueTail + len) % MQTT_QUEUE_SIZE;
+            queueBytes -= len;
+            queueMessages--;
+        }
+        unlockQueue();
+
+        if(!sent)
+            return;
+    }
+}
+
+// Never connects and never waits on the client. If the client is busy,
+// down, or there is already a backlog (to keep the order), the message is
+// queued for mqttLoop(). Returns false only if the message was thrown away.
+static boolean publishMes(const char *topic, const uint8_t *payload, uint16_t len) {
+    if(queueEmpty() && lockMQTT(0)) {
+        if(mqttClient.connected()) {
+            bool sent = sendNow(topic, payload, len);
+            bool stillConnected = mqttClient.connected();
+            unlockMQTT();
+
+            if(sent)
+                return true;
+
+            if(stillConnected) {
+                mqttStats.publishFailed++;
+                return false;
+            }
+        } else {
+            unlockMQTT();
+        }
+    }
+
+    return enqueue(topic, payload, len);
+}
+
+// For replaying the outbox. Sends only if the client is up with nothing
+// queued ahead of it, and never queues.
+boolean publishNow(const char *topic, const uint8_t *payload, uint16_t len) {
+    if(!queueEmpty() || !lockMQTT(0))
         return false;
+
+    bool sent = mqttClient.connected() && sendNow(topic, payload, len);
+    unlockMQTT();
+
+    return sent;
+}
+
+// Readings taken while the broker is down go to the outbox, which keeps them
+// across a reboot, rather than the in memory queue. Only called from the
+// network task, the same task that runs the connection.
+static boolean publishReading(const char *topic, const uint8_t *payload, uint16_t len, time_t sampleTime) {
+    if(!wasConnected && outboxAppend(topic, payload, len, sampleTime))
+        return true;
+
+    return publishMes(topic, payload, len);
+}
+
+// Readings on topics starting with prefix go out in format. The longest
+// matching prefix wins, and an empty prefix matches everything.
+bool setPayloadFormat(const char *prefix, uint8_t format) {
+    if(strlen(prefix) >= MQTT_PAYLOAD_PREFIX_LENGTH)
+        return false;
+
+    payload_rule_t *rule = NULL;
+    for(uint8_t n=0;n<numPayloadRules;n++) {
+        if(strcmp(payloadRules[n].prefix, prefix) == 0)
+            rule = &payloadRules[n];
+    }
+
+    if(rule == NULL) {
+        if(numPayloadRules == MQTT_PAYLOAD_RULES)
+            return false;
+        rule = &payloadRules[numPayloadRules++];
+        strcpy(rule->prefix, prefix);
     }
 
+    rule->format = format;
     return true;
 }
 
-boolean publishData(uint8_t reason, float temperature, int32_t pressure, float humidity, float battery_millivolts, uint16_t direction, float anemometer, float rain) {
+static uint8_t payloadFormat(const char *topic) {
+    uint8_t format = MQTT_PAYLOAD_FORMAT;
+    size_t longest = 0;
 
-    char payload[200];
-    sprintf(payload,stateJson,reason,temperature,pressure,humidity,battery_millivolts,direction,anemometer,rain);
-    Serial.println(payload);
+    for(uint8_t n=0;n<numPayloadRules;n++) {
+        size_t len = strlen(payloadRules[n].prefix);
+        if((len >= longest) && (strncmp(topic, payloadRules[n].prefix, len) == 0)) {
+            format = payloadRules[n].format;
+            longest = len;
+        }
+    }
 
+    return format;
+}
 
-    return publishMes(mqttTopic,payload);
+// Streams the payload straight into the client, the length is known before
+// the first byte goes out so there is no payload buffer. Only taken when
+// publishMes() would have sent directly.
+static bool streamPayload(const char *topic, uint8_t format, const json_schema_t *schema, const json_value_t *values) {
+    if(!queueEmpty() || !lockMQTT(0))
+        return false;
+
+    bool sent = false;
+    if(mqttClient.connected()) {
+        uint16_t len = packLength(format, schema, values);
+        if(mqttClient.beginPublish(topic, len, false)) {
+            packWrite(mqttClient, format, schema, values);
+            sent = mqttClient.endPublish() == 1;
+        }
+    }
+    unlockMQTT();
+
+    return sent;
+}
+
+// Anything that has to be kept for later is rendered into a buffer first, in
+// the same format, as the queue and the outbox keep the length
+static boolean publishValues(const char *topic, const json_schema_t *schema, const json_value_t *values, time_t sampleTime, uint8_t format) {
+    if(wasConnected && streamPayload(topic, format, schema, values))
+        return true;
+
+    uint8_t payload[MQTT_BUFFER_SIZE];
+    uint16_t len = packRender(payload, sizeof(payload), format, schema, values);
+    if(len == 0) {
+        mqttStats.publishFailed++;
+        return false;
+    }
+
+    return publishReading(topic, payload, len, sampleTime);
+}
+
+boolean publishReadingValues(const char *topic, const json_schema_t *schema, const json_value_t *values, time_t sampleTime) {
+    return publishValues(topic, schema, values, sampleTime, payloadFormat(topic));
+}
+
+boolean publishData(const char *topic, time_t sampleTime, uint8_t reason, float temperature, int32_t pressure, float humidity, float battery_millivolts, uint16_t direction, float anemometer, float rain) {
+    json_value_t values[] = {
+        jsonInt(reason),
+        jsonFloat(temperature),
+        jsonInt(pressure),
+        jsonFloat(humidity),
+        jsonFloat(battery_millivolts),
+        jsonInt(direction),
+        jsonFloat(anemometer),
+        jsonFloat(rain)
+    };
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+    jsonWrite(Serial, &stateSchema, values);
+    Serial.println();
+#endif
+
+    return publishValues(topic, &stateSchema, values, sampleTime, payloadFormat(topic));
 }
 
 void disconnectMQTT() {
+    lockMQTT();
     mqttClient.disconnect();
+    unlockMQTT();
 }
 
 void publishRoomStats(float roomC, float roomHum) {
 
     if((roomC>0.0)&&(roomC<65.0)) {
-      char jdata[200];
-      sprintf(jdata,roomData,roomC,roomHum);
-      Serial.println(jdata);
-      publishMes(mqttTopic,jdata);
+      json_value_t values[] = {jsonFloat(roomC), jsonFloat(roomHum)};
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+      jsonWrite(Serial, &roomSchema, values);
+      Serial.println();
+#endif
+      publishValues(mqttTopic, &roomSchema, values, time(NULL), payloadFormat(mqttTopic));
     }
 }
 
-void logMessage(const char*system, const char*message) {
-    char payload[250];
+// Sends now or not at all, the log queue holds on to it until it goes out
+boolean logMessage(uint8_t level, const char*system, const char*message, uint16_t repeated, uint16_t suppressed) {
+    const char *levelName = (level <= LOG_LEVEL_DEBUG) ? logLevels[level] : logLevels[LOG_LEVEL_NONE];
+    json_value_t values[] = {jsonString(STATION_NAME), jsonString(levelName), jsonString(system), jsonString(message), jsonUint(repeated), jsonUint(suppressed)};
+
+    if((repeated == 0) && (suppressed == 0))
+        return streamPayload(LOG_TOPIC, PAYLOAD_JSON, &logSchema, values);
 
-    sprintf(payload,logJson,STATION_NAME, system, message);
-    publishMes(LOG_TOPIC,payload);
+    return streamPayload(LOG_TOPIC, PAYLOAD_JSON, &logCountSchema, values);
+}
+
+void publishStats(const char *payload) {
+    publishMes(STATS_TOPIC, (const uint8_t *)payload, strlen(payload));
 }
 
 void initMQTT() {
+    if(mqttMutex == NULL)
+        mqttMutex = xSemaphoreCreateRecursiveMutex();
+    if(queueMutex == NULL)
+        queueMutex = xSemaphoreCreateMutex();
+
+    // Every station's topic, and their rollups, start with the MQTT topic
+    int8_t format = packFormat(mqttFormat);
+    if(format >= 0)
+        setPayloadFormat(mqttTopic, format);
+    else if(mqttFormat[0] != '\0')
+        Serial.printf("Unknown payload format %s\n", mqttFormat);
+
     mqttClient.setServer(mqttServer, mqttPort);
     mqttClient.setCallback(mqttCallback);
+    mqttClient.setBufferSize(MQTT_BUFFER_SIZE);
+    mqttClient.setSocketTimeout(MQTT_SOCKET_TIMEOUT);
 
     sprintf(subName, "weathertest-%s", &(WiFi.macAddress().c_str())[9]);
     Serial.println(subName);
 
+    // The first attempt happens on the next mqttLoop()
+    disconnectedSince = millis();
+    nextAttempt = disconnectedSince;
+
     #ifdef DEV_MODE
     reconnect();
 
@@ -184,9 +554,74 @@ void initMQTT() {
 
 }
 
+// Exponential backoff with equal jitter, half the delay is fixed and half random
+static void scheduleAttempt() {
+    backoff = (backoff == 0) ? MQTT_BACKOFF_MIN_MS : backoff * 2;
+    if(backoff > MQTT_BACKOFF_MAX_MS)
+        backoff = MQTT_BACKOFF_MAX_MS;
+
+    nextAttempt = millis() + backoff / 2 + esp_random() % (backoff / 2 + 1);
+}
+
+static void connectionUp() {
+    wasConnected = true;
+    backoff = 0;
+    mqttStats.disconnectedMs += millis() - disconnectedSince;
+}
+
 void mqttLoop(void) {
-    if(!mqttClient.connected())
+    lockMQTT();
+
+    if(mqttClient.connected()) {
+        if(!wasConnected)
+            connectionUp();
+
+        mqttClient.loop();
+        drainQueue();
+        unlockMQTT();
+        return;
+    }
+
+    uint32_t now = millis();
+    if(wasConnected) {
+        wasConnected = false;
+        disconnectedSince = now;
+        mqttStats.disconnects++;
+        backoff = 0;
+        nextAttempt = now;
+    }
+
+    // A connect attempt still blocks this task for up to
+    // MQTT_CONNECT_TIMEOUT_MS and MQTT_SOCKET_TIMEOUT, so only make one when
+    // it has a chance and the backoff has run out
+    if((WiFi.status() == WL_CONNECTED) && ((int32_t)(now - nextAttempt) >= 0)) {
         reconnect();
-    
-    mqttClient.loop();
+
+        if(mqttClient.connected()) {
+            connectionUp();
+            drainQueue();
+        } else {
+            scheduleAttempt();
+        }
+    }
+
+    unlockMQTT();
+}
+
+// As of the last mqttLoop(), only meaningful on the network task
+boolean mqttConnected() {
+    return wasConnected;
+}
+
+void getMQTTStats(mqtt_stats_t *stats) {
+    lockQueue();
+    memcpy(stats, &mqttStats, sizeof(mqtt_stats_t));
+    stats->queuedMessages = queueMessages;
+    stats->queuedBytes = queueBytes;
+    unlockQueue();
+
+    stats->connected = wasConnected;
+    stats->backoffMs = wasConnected ? 0 : backoff;
+    if(!wasConnected)
+        stats->disconnectedMs += millis() - disconnectedSince;
 }
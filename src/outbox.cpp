@@ -0,0 +1,329 @@
+/**
+ *  @filename   :   outbox.cpp
+ *  @brief      :   ESP32 Weather Base Station Store and Forward Outbox
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <Arduino.h>
+#include <FS.h>
+#include <SPIFFS.h>
+#include "weatherbase.h"
+#include "wifiwithmqtt.h"
+#include "stations.h"
+#include "outbox.h"
+
+#define OUTBOX_MAX_PAYLOAD 256
+#define OUTBOX_MAX_RECORDS (OUTBOX_SEGMENT_SIZE / (OUTBOX_RECORD_HEADER + 2))   // The smallest record
+
+typedef struct outbox_record_t {
+  uint32_t time;
+  uint16_t len;
+  char topic[STATION_TOPIC_LENGTH];
+  uint8_t payload[OUTBOX_MAX_PAYLOAD];
+} outbox_record_t;
+
+typedef struct outbox_pick_t {
+  uint32_t time;
+  uint32_t offset;
+  uint16_t number;                  // Position in the segment
+} outbox_pick_t;
+
+static bool mounted = false;
+static uint32_t firstSegment = 0;
+static uint32_t lastSegment = 0;
+static uint16_t segments = 0;
+static uint32_t lastSize = 0;       // Of the segment being appended to
+static uint32_t readOffset = 0;     // Into the first segment, everything before it is sent
+static uint16_t readNumber = 0;     // Position of the record at readOffset
+static uint32_t sentAhead = 0;      // Bytes sent from after readOffset
+static uint32_t nextBatch = 0;
+
+// Records of the first segment sent out of turn, by position
+static uint8_t sent[(OUTBOX_MAX_RECORDS + 7) / 8];
+
+static outbox_stats_t outboxStats;
+
+static outbox_record_t record;
+static outbox_pick_t picks[OUTBOX_BATCH];
+
+static void segmentName(uint32_t sequence, char *name) {
+  sprintf(name, "/ob%08u", sequence);
+}
+
+// Depending on the core version, names come back with or without the slash
+static bool segmentSequence(const char *name, uint32_t *sequence) {
+  if(*name == '/')
+    name++;
+
+  if(strncmp(name, "ob", 2) != 0)
+    return false;
+
+  char *end;
+  *sequence = strtoul(name + 2, &end, 10);
+  return (end != name + 2) && (*end == '\0');
+}
+
+bool initOutbox() {
+  if(!SPIFFS.begin(true)) {
+    Serial.println("SPIFFS Mount Failed");
+    return false;
+  }
+
+  File root = SPIFFS.open("/");
+  File file = root.openNextFile();
+  while(file) {
+    uint32_t sequence;
+    if(segmentSequence(file.name(), &sequence)) {
+      if((segments == 0) || (sequence < firstSegment))
+        firstSegment = sequence;
+      if((segments == 0) || (sequence > lastSegment)) {
+        lastSegment = sequence;
+        lastSize = file.size();
+      }
+      segments++;
+      outboxStats.pendingBytes += file.size();
+    }
+    file = root.openNextFile();
+  }
+
+  mounted = true;
+  outboxStats.mounted = true;
+  Serial.printf("Outbox %u segments, %u bytes\n", segments, outboxStats.pendingBytes);
+
+  return true;
+}
+
+static void removeFirstSegment() {
+  char name[16];
+  segmentName(firstSegment, name);
+
+  File file = SPIFFS.open(name, FILE_READ);
+  if(file) {
+    outboxStats.pendingBytes -= file.size() - readOffset - sentAhead;
+    file.close();
+  }
+  SPIFFS.remove(name);
+
+  readOffset = 0;
+  readNumber = 0;
+  sentAhead = 0;
+  memset(sent, 0, sizeof(sent));
+  segments--;
+  firstSegment++;
+}
+
+bool outboxAppend(const char *topic, const uint8_t *payload, uint16_t payloadLen, time_t sampleTime) {
+  if(!mounted)
+    return false;
+
+  size_t topicLen = strlen(topic);
+  if((topicLen >= STATION_TOPIC_LENGTH) || (payloadLen >= OUTBOX_MAX_PAYLOAD))
+    return false;
+
+  uint32_t len = OUTBOX_RECORD_HEADER + topicLen + payloadLen;
+
+  if((segments == 0) || (lastSize + len > OUTBOX_SEGMENT_SIZE)) {
+    lastSegment++;
+    if(segments == 0) {
+      firstSegment = lastSegment;
+      readOffset = 0;
+    }
+    segments++;
+    lastSize = 0;
+
+    while(segments > OUTBOX_MAX_SEGMENTS) {
+      removeFirstSegment();
+      outboxStats.segmentsDropped++;
+    }
+  }
+
+  char name[16];
+  segmentName(lastSegment, name);
+  File file = SPIFFS.open(name, FILE_APPEND);
+  if(!file)
+    return false;
+
+  uint32_t time = (sampleTime >= OUTBOX_MIN_TIME) ? sampleTime : 0;
+  uint8_t header[OUTBOX_RECORD_HEADER] = {OUTBOX_MAGIC, (uint8_t)topicLen, (uint8_t)(payloadLen & 0xff), (uint8_t)(payloadLen >> 8),
+    (uint8_t)(time & 0xff), (uint8_t)((time >> 8) & 0xff), (uint8_t)((time >> 16) & 0xff), (uint8_t)(time >> 24)};
+
+  size_t written = file.write(header, OUTBOX_RECORD_HEADER);
+  written += file.write((const uint8_t *)topic, topicLen);
+  written += file.write(payload, payloadLen);
+  file.close();
+
+  // A short write leaves a torn record, which ends the segment on replay
+  lastSize += written;
+  outboxStats.pendingBytes += written;
+  if(written != len)
+    return false;
+
+  outboxStats.appended++;
+  return true;
+}
+
+// Returns false at the end of the segment or on a bad record
+static bool readHeader(File &file, uint8_t *topicLen, uint16_t *payloadLen, uint32_t *time) {
+  uint8_t header[OUTBOX_RECORD_HEADER];
+  if(file.read(header, OUTBOX_RECORD_HEADER) != OUTBOX_RECORD_HEADER)
+    return false;
+
+  *topicLen = header[1];
+  *payloadLen = header[2] | (header[3] << 8);
+  *time = header[4] | (header[5] << 8) | (header[6] << 16) | ((uint32_t)header[7] << 24);
+  if((header[0] != OUTBOX_MAGIC) || (*topicLen >= STATION_TOPIC_LENGTH) || (*payloadLen >= OUTBOX_MAX_PAYLOAD)) {
+    outboxStats.corrupt++;
+    return false;
+  }
+
+  return true;
+}
+
+// Leaves the file at the next record
+static bool skipRecord(File &file, uint32_t *time) {
+  uint8_t topicLen;
+  uint16_t payloadLen;
+  if(!readHeader(file, &topicLen, &payloadLen, time))
+    return false;
+
+  uint32_t next = file.position() + topicLen + payloadLen;
+  if(next > file.size()) {
+    outboxStats.corrupt++;
+    return false;
+  }
+
+  return file.seek(next);
+}
+
+static bool readRecord(File &file, outbox_record_t *record) {
+  uint8_t topicLen;
+  uint16_t payloadLen;
+  if(!readHeader(file, &topicLen, &payloadLen, &record->time))
+    return false;
+
+  if((file.read((uint8_t *)record->topic, topicLen) != topicLen) || (file.read(record->payload, payloadLen) != payloadLen)) {
+    outboxStats.corrupt++;
+    return false;
+  }
+
+  record->topic[topicLen] = '\0';
+  record->len = payloadLen;
+  return true;
+}
+
+static bool replayRecord(const outbox_record_t *record) {
+  uint8_t payload[OUTBOX_MAX_PAYLOAD + PACK_TIME_LENGTH];
+  memcpy(payload, record->payload, record->len);
+
+  uint16_t len = (record->time != 0) ? packAddTime(payload, record->len, sizeof(payload), record->time) : 0;
+  if(len == 0)
+    len = record->len;
+
+  return publishNow(record->topic, payload, len);
+}
+
+static bool isSent(uint16_t number) {
+  return sent[number / 8] & (1 << (number % 8));
+}
+
+// Keeps the OUTBOX_BATCH oldest, by time and then position
+static void pickRecord(uint8_t *count, uint32_t time, uint32_t offset, uint16_t number) {
+  if((*count == OUTBOX_BATCH) && (picks[OUTBOX_BATCH - 1].time <= time))
+    return;
+
+  uint8_t m = (*count < OUTBOX_BATCH) ? (*count)++ : OUTBOX_BATCH - 1;
+  while((m > 0) && (picks[m - 1].time > time)) {
+    picks[m] = picks[m - 1];
+    m--;
+  }
+  picks[m] = {time, offset, number};
+}
+
+// Replays the oldest unsent samples in the oldest segment, by sample time
+// across the whole segment rather than in the order they were appended.
+// Segments still go out in the order they were written. Only runs while MQTT
+// is up, so an outage doesn't keep the flash busy.
+void outboxLoop() {
+  if(!mounted || (segments == 0) || ((int32_t)(millis() - nextBatch) < 0))
+    return;
+
+  nextBatch = millis() + OUTBOX_BATCH_INTERVAL_MS;
+  if(!mqttConnected())
+    return;
+
+  char name[16];
+  segmentName(firstSegment, name);
+  File file = SPIFFS.open(name, FILE_READ);
+  if(!file) {
+    removeFirstSegment();
+    return;
+  }
+
+  // A bad record ends the segment, as if it were the end of the file
+  file.seek(readOffset);
+  uint8_t count = 0;
+  uint16_t records = readNumber;
+  while((file.available() > 0) && (records < OUTBOX_MAX_RECORDS)) {
+    uint32_t offset = file.position();
+    uint32_t time;
+    if(!skipRecord(file, &time))
+      break;
+
+    if(!isSent(records))
+      pickRecord(&count, time, offset, records);
+    records++;
+  }
+
+  for(uint8_t n=0;n<count;n++) {
+    file.seek(picks[n].offset);
+    if(!readRecord(file, &record) || !replayRecord(&record))
+      break;
+
+    uint32_t size = OUTBOX_RECORD_HEADER + strlen(record.topic) + record.len;
+    sent[picks[n].number / 8] |= 1 << (picks[n].number % 8);
+    sentAhead += size;
+    outboxStats.pendingBytes -= size;
+    outboxStats.replayed++;
+  }
+
+  // Move past whatever has gone out at the front
+  file.seek(readOffset);
+  uint32_t time;
+  while((readNumber < records) && isSent(readNumber) && skipRecord(file, &time)) {
+    sentAhead -= file.position() - readOffset;
+    readOffset = file.position();
+    readNumber++;
+  }
+  file.close();
+
+  // The last segment may still be appended to, but once it has all been sent
+  // it can go, the next append starts a new one
+  if(readNumber == records)
+    removeFirstSegment();
+}
+
+bool outboxPending() {
+  return segments > 0;
+}
+
+void getOutboxStats(outbox_stats_t *stats) {
+  memcpy(stats, &outboxStats, sizeof(outbox_stats_t));
+  stats->segments = segments;
+}
@@ -0,0 +1,296 @@
+/**
+ *  @filename   :   packwriter.cpp
+ *  @brief      :   ESP32 Weather Base Station CBOR and MessagePack Writer
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <Arduino.h>
+#include "jsonwriter.h"
+#include "packwriter.h"
+
+// As in jsonwriter.cpp, counting and writing go through the same code
+typedef struct pack_sink_t {
+  Print *out;
+  uint8_t *buffer;                  // Or straight into here, sized beforehand
+  uint16_t length;
+  uint8_t used;
+  uint8_t chunk[JSON_WRITE_CHUNK];
+} pack_sink_t;
+
+static void sinkStart(pack_sink_t *sink, Print *out, uint8_t *buffer, uint16_t length) {
+  sink->out = out;
+  sink->buffer = buffer;
+  sink->length = length;
+  sink->used = 0;
+}
+
+static void sinkFlush(pack_sink_t *sink) {
+  if((sink->out != NULL) && (sink->used > 0))
+    sink->out->write(sink->chunk, sink->used);
+  sink->used = 0;
+}
+
+static void sinkWrite(pack_sink_t *sink, const uint8_t *data, uint8_t len) {
+  if(sink->buffer != NULL)
+    memcpy(&sink->buffer[sink->length], data, len);
+  sink->length += len;
+  if(sink->out == NULL)
+    return;
+
+  for(uint8_t n=0;n<len;n++) {
+    if(sink->used == JSON_WRITE_CHUNK)
+      sinkFlush(sink);
+    sink->chunk[sink->used++] = data[n];
+  }
+}
+
+static void sinkByte(pack_sink_t *sink, uint8_t b) {
+  sinkWrite(sink, &b, 1);
+}
+
+// Both formats are big endian
+static void sinkBigEndian(pack_sink_t *sink, uint8_t lead, uint32_t value, uint8_t bytes) {
+  uint8_t buffer[5];
+  buffer[0] = lead;
+  for(uint8_t n=0;n<bytes;n++)
+    buffer[1 + n] = value >> (8 * (bytes - 1 - n));
+  sinkWrite(sink, buffer, bytes + 1);
+}
+
+static uint32_t floatBits(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+static uint8_t stringLength(const char *value, uint8_t maxLength) {
+  uint8_t len = 0;
+  while((len < maxLength) && (value[len] != '\0'))
+    len++;
+  return len;
+}
+
+// CBOR major type in the top 3 bits, the argument inline if it is under 24
+static void cborHead(pack_sink_t *sink, uint8_t major, uint32_t value) {
+  major <<= 5;
+  if(value < 24)
+    sinkByte(sink, major | value);
+  else if(value <= UINT8_MAX)
+    sinkBigEndian(sink, major | 24, value, 1);
+  else if(value <= UINT16_MAX)
+    sinkBigEndian(sink, major | 25, value, 2);
+  else
+    sinkBigEndian(sink, major | 26, value, 4);
+}
+
+static void cborValue(pack_sink_t *sink, const json_field_t *field, const json_value_t *value) {
+  switch(field->type) {
+    case JSON_INT:
+      if(value->i < 0)
+        cborHead(sink, 1, -1 - value->i);
+      else
+        cborHead(sink, 0, value->i);
+      break;
+    case JSON_UINT:
+      cborHead(sink, 0, value->u);
+      break;
+    case JSON_FIXED_POINT:
+      sinkBigEndian(sink, 0xfa, floatBits(value->f), 4);
+      break;
+    case JSON_STRING: {
+      const char *s = (value->s != NULL) ? value->s : "";
+      uint8_t len = stringLength(s, field->arg);
+      cborHead(sink, 3, len);
+      sinkWrite(sink, (const uint8_t *)s, len);
+      break;
+    }
+  }
+}
+
+static void msgpackInt(pack_sink_t *sink, int64_t value) {
+  if((value >= 0) && (value < 128))
+    sinkByte(sink, value);
+  else if((value < 0) && (value >= -32))
+    sinkByte(sink, (uint8_t)(int8_t)value);
+  else if(value > UINT16_MAX)
+    sinkBigEndian(sink, 0xce, value, 4);
+  else if(value > UINT8_MAX)
+    sinkBigEndian(sink, 0xcd, value, 2);
+  else if(value > 0)
+    sinkBigEndian(sink, 0xcc, value, 1);
+  else if(value < INT16_MIN)
+    sinkBigEndian(sink, 0xd2, (uint32_t)value, 4);
+  else if(value < INT8_MIN)
+    sinkBigEndian(sink, 0xd1, (uint16_t)value, 2);
+  else
+    sinkBigEndian(sink, 0xd0, (uint8_t)value, 1);
+}
+
+static void msgpackValue(pack_sink_t *sink, const json_field_t *field, const json_value_t *value) {
+  switch(field->type) {
+    case JSON_INT:
+      msgpackInt(sink, value->i);
+      break;
+    case JSON_UINT:
+      msgpackInt(sink, value->u);
+      break;
+    case JSON_FIXED_POINT:
+      sinkBigEndian(sink, 0xca, floatBits(value->f), 4);
+      break;
+    case JSON_STRING: {
+      const char *s = (value->s != NULL) ? value->s : "";
+      uint8_t len = stringLength(s, field->arg);
+      if(len < 32)
+        sinkByte(sink, 0xa0 | len);
+      else
+        sinkBigEndian(sink, 0xd9, len, 1);
+      sinkWrite(sink, (const uint8_t *)s, len);
+      break;
+    }
+  }
+}
+
+static void writeMap(pack_sink_t *sink, uint8_t format, const json_schema_t *schema, const json_value_t *values) {
+  if(format == PAYLOAD_CBOR)
+    cborHead(sink, 5, schema->count);
+  else if(schema->count < 16)
+    sinkByte(sink, 0x80 | schema->count);
+  else
+    sinkBigEndian(sink, 0xde, schema->count, 2);
+
+  for(uint8_t n=0;n<schema->count;n++) {
+    if(format == PAYLOAD_CBOR) {
+      cborHead(sink, 0, n);
+      cborValue(sink, &schema->fields[n], &values[n]);
+    } else {
+      msgpackInt(sink, n);
+      msgpackValue(sink, &schema->fields[n], &values[n]);
+    }
+  }
+}
+
+uint16_t packLength(uint8_t format, const json_schema_t *schema, const json_value_t *values) {
+  if(format == PAYLOAD_JSON)
+    return jsonLength(schema, values);
+
+  pack_sink_t sink;
+  sinkStart(&sink, NULL, NULL, 0);
+  writeMap(&sink, format, schema, values);
+  return sink.length;
+}
+
+void packWrite(Print &out, uint8_t format, const json_schema_t *schema, const json_value_t *values) {
+  if(format == PAYLOAD_JSON) {
+    jsonWrite(out, schema, values);
+    return;
+  }
+
+  pack_sink_t sink;
+  sinkStart(&sink, &out, NULL, 0);
+  writeMap(&sink, format, schema, values);
+  sinkFlush(&sink);
+}
+
+// JSON is terminated like jsonRender(), the others are not
+uint16_t packRender(uint8_t *buffer, uint16_t size, uint8_t format, const json_schema_t *schema, const json_value_t *values) {
+  if(format == PAYLOAD_JSON)
+    return jsonRender((char *)buffer, size, schema, values);
+
+  if(packLength(format, schema, values) > size)
+    return 0;
+
+  pack_sink_t sink;
+  sinkStart(&sink, NULL, buffer, 0);
+  writeMap(&sink, format, schema, values);
+  return sink.length;
+}
+
+// One more entry in the map header, which may take a byte or two more
+static uint8_t growMap(uint8_t *payload, uint16_t len) {
+  uint8_t lead = payload[0];
+
+  if(((lead >= 0xa0) && (lead < 0xb7)) || ((lead >= 0x80) && (lead < 0x8f))) {
+    payload[0]++;
+    return 0;
+  }
+  if((lead == 0xb8) && (len > 1) && (payload[1] < UINT8_MAX)) {
+    payload[1]++;
+    return 0;
+  }
+  if((lead == 0xde) && (len > 2) && (payload[2] < UINT8_MAX)) {
+    payload[2]++;
+    return 0;
+  }
+  if(lead == 0xb7) {
+    memmove(&payload[2], &payload[1], len - 1);
+    payload[0] = 0xb8;
+    payload[1] = 24;
+    return 1;
+  }
+  if(lead == 0x8f) {
+    memmove(&payload[3], &payload[1], len - 1);
+    payload[0] = 0xde;
+    payload[1] = 0;
+    payload[2] = 16;
+    return 2;
+  }
+
+  return UINT8_MAX;
+}
+
+uint16_t packAddTime(uint8_t *payload, uint16_t len, uint16_t size, uint32_t time) {
+  if((len == 0) || (size < len + PACK_TIME_LENGTH))
+    return 0;
+
+  if(payload[0] == '{') {
+    if(payload[len - 1] != '}')
+      return 0;
+    return len - 1 + sprintf((char *)&payload[len - 1], ",\"time\":%u}", time);
+  }
+
+  bool cbor = (payload[0] >= 0xa0) && (payload[0] <= 0xb8);
+  uint8_t grown = growMap(payload, len);
+  if(grown == UINT8_MAX)
+    return 0;
+
+  pack_sink_t sink;
+  sinkStart(&sink, NULL, payload, len + grown);
+  if(cbor) {
+    cborHead(&sink, 3, 4);
+    sinkWrite(&sink, (const uint8_t *)"time", 4);
+    cborHead(&sink, 0, time);
+  } else {
+    sinkByte(&sink, 0xa4);
+    sinkWrite(&sink, (const uint8_t *)"time", 4);
+    msgpackInt(&sink, time);
+  }
+  return sink.length;
+}
+
+int8_t packFormat(const char *name) {
+  if(strcmp(name, "json") == 0)
+    return PAYLOAD_JSON;
+  if(strcmp(name, "cbor") == 0)
+    return PAYLOAD_CBOR;
+  if(strcmp(name, "msgpack") == 0)
+    return PAYLOAD_MSGPACK;
+
+  return -1;
+}
@@ -0,0 +1,158 @@
+/**
+ *  @filename   :   pressuretrend.cpp
+ *  @brief      :   ESP32 Weather Base Station Pressure Trend
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <Arduino.h>
+#include <math.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "weatherbase.h"
+#include "timekeeper.h"
+#include "pressuretrend.h"
+
+typedef struct trend_sample_t {
+  int32_t t;                        // Seconds on timeMicros(), before boot is negative
+  float inHg;
+} trend_sample_t;
+
+// Samples come in on the network task and the barometer reads on the
+// display task
+static SemaphoreHandle_t trendMutex = NULL;
+
+static trend_sample_t ring[TREND_SAMPLES];
+static uint16_t head = 0;                     // Where the next sample goes
+static uint16_t count = 0;
+
+// Of the samples in the ring, with x in seconds from origin
+static int32_t origin = 0;
+static double sumX = 0.0;
+static double sumY = 0.0;
+static double sumXX = 0.0;
+static double sumXY = 0.0;
+
+static void lockTrend() {
+  if(trendMutex != NULL)
+    xSemaphoreTake(trendMutex, portMAX_DELAY);
+}
+
+static void unlockTrend() {
+  if(trendMutex != NULL)
+    xSemaphoreGive(trendMutex);
+}
+
+static int32_t nowSecs() {
+  return timeMicros() / 1000000;
+}
+
+static trend_sample_t *oldest() {
+  return &ring[(head + TREND_SAMPLES - count) % TREND_SAMPLES];
+}
+
+static trend_sample_t *newest() {
+  return &ring[(head + TREND_SAMPLES - 1) % TREND_SAMPLES];
+}
+
+static void sumSample(const trend_sample_t *sample, double sign) {
+  double x = sample->t - origin;
+  sumX += sign * x;
+  sumY += sign * sample->inHg;
+  sumXX += sign * x * x;
+  sumXY += sign * x * sample->inHg;
+}
+
+static void dropOldest() {
+  sumSample(oldest(), -1.0);
+  count--;
+}
+
+static void dropExpired(int32_t now) {
+  while((count > 0) && (now - oldest()->t > TREND_WINDOW_SECS))
+    dropOldest();
+}
+
+// Moves the origin up to now and adds the ring up again, which keeps x small
+// and clears what rounding the adding and taking away has left
+static void rebase(int32_t now) {
+  origin = now;
+  sumX = sumY = sumXX = sumXY = 0.0;
+  for(uint16_t n=0;n<count;n++)
+    sumSample(&ring[(head + TREND_SAMPLES - count + n) % TREND_SAMPLES], 1.0);
+}
+
+void initPressureTrend() {
+  if(trendMutex == NULL)
+    trendMutex = xSemaphoreCreateMutex();
+}
+
+// sampleMicros is when it was taken, on timeMicros()
+void pressureTrendAdd(const sensor_data_t *data, int64_t sampleMicros) {
+  int32_t now = sampleMicros / 1000000;
+
+  lockTrend();
+  // The ring is kept in time order. Only a frame that came in out of order
+  // goes back in time, and the fit hardly misses one sample.
+  if((count > 0) && (now < newest()->t)) {
+    unlockTrend();
+    return;
+  }
+
+  dropExpired(now);
+  if(count == TREND_SAMPLES)
+    dropOldest();
+
+  trend_sample_t *sample = &ring[head];
+  sample->t = now;
+  sample->inHg = seaLevelInHg(data->pressure);
+  head = (head + 1) % TREND_SAMPLES;
+  count++;
+
+  if((count == 1) || (now - origin >= TREND_REBASE_SECS))
+    rebase(now);
+  else
+    sumSample(sample, 1.0);
+  unlockTrend();
+}
+
+// False until there are samples over TREND_MIN_SECS. The mean is filled in
+// whenever there are any.
+bool pressureTrend(pressure_trend_t *trend) {
+  bool found = false;
+
+  lockTrend();
+  dropExpired(nowSecs());
+
+  trend->samples = count;
+  trend->mean = (count > 0) ? sumY / count : 0.0;
+  trend->slope = 0.0;
+
+  if((count > 2) && (newest()->t - oldest()->t >= TREND_MIN_SECS)) {
+    double n = count;
+    double denominator = n * sumXX - sumX * sumX;
+    if(denominator > 0.0) {
+      trend->slope = (n * sumXY - sumX * sumY) / denominator * TREND_WINDOW_SECS;
+      found = true;
+    }
+  }
+  unlockTrend();
+
+  return found;
+}
@@ -0,0 +1,193 @@
+/**
+ *  @filename   :   rollup.cpp
+ *  @brief      :   ESP32 Weather Base Station Per Station Rollups
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <Arduino.h>
+#include "weatherbase.h"
+#include "wifiwithmqtt.h"
+#include "stations.h"
+#include "jsonwriter.h"
+#include "rollup.h"
+
+enum RollupMetric {M_TEMP, M_PRESS, M_HUM, M_BATT, M_WIND, M_DIR, M_RAIN, M_COUNT};
+
+// One field per aggregate, in the order of the ROLLUP_ bits
+#define ROLLUP_FIELDS(name, decimals) \
+  JSON_FIXED(min_##name, decimals), JSON_FIXED(max_##name, decimals), JSON_FIXED(mean_##name, decimals), \
+  JSON_FIXED(last_##name, decimals), JSON_FIXED(sum_##name, decimals)
+
+static const json_field_t metricFields[M_COUNT * ROLLUP_AGGREGATES] = {
+  ROLLUP_FIELDS(temperature, 1),
+  ROLLUP_FIELDS(pressure, 0),
+  ROLLUP_FIELDS(humidity, 1),
+  ROLLUP_FIELDS(battery, 1),
+  ROLLUP_FIELDS(anemometer, 2),
+  ROLLUP_FIELDS(direction, 0),
+  ROLLUP_FIELDS(rain, 3)
+};
+
+// Which aggregates are published for each metric. A mean of a compass
+// point means nothing, and rain only makes sense as a total.
+static const uint8_t metricAggregates[M_COUNT] = {
+  ROLLUP_MIN | ROLLUP_MAX | ROLLUP_MEAN | ROLLUP_LAST,
+  ROLLUP_MIN | ROLLUP_MAX | ROLLUP_MEAN,
+  ROLLUP_MIN | ROLLUP_MAX | ROLLUP_MEAN,
+  ROLLUP_LAST,
+  ROLLUP_MAX | ROLLUP_MEAN,
+  ROLLUP_LAST,
+  ROLLUP_SUM
+};
+
+static const json_field_t headerFields[] = {
+  JSON_UNSIGNED(start),
+  JSON_UNSIGNED(window),
+  JSON_UNSIGNED(count)
+};
+
+#define HEADER_FIELDS (sizeof(headerFields) / sizeof(headerFields[0]))
+#define MAX_FIELDS (HEADER_FIELDS + M_COUNT * ROLLUP_AGGREGATES)
+
+typedef struct rollup_acc_t {
+  float min;
+  float max;
+  float sum;
+  float last;
+} rollup_acc_t;
+
+typedef struct rollup_window_t {
+  uint32_t start;
+  uint32_t published;               // Start of the last window sent
+  uint16_t count;
+  rollup_acc_t acc[M_COUNT];
+} rollup_window_t;
+
+static const uint16_t windowSecs[ROLLUP_WINDOW_COUNT] = ROLLUP_WINDOWS;
+static rollup_window_t windows[MAX_STATIONS][ROLLUP_WINDOW_COUNT];
+
+static rollup_stats_t rollupStats;
+
+static void publishWindow(const station_t *station, uint8_t w) {
+  rollup_window_t *window = &windows[station->index][w];
+
+  json_field_t fields[MAX_FIELDS];
+  json_value_t values[MAX_FIELDS];
+  uint8_t count = 0;
+
+  memcpy(fields, headerFields, sizeof(headerFields));
+  values[count++] = jsonUint(window->start);
+  values[count++] = jsonUint(windowSecs[w]);
+  values[count++] = jsonUint(window->count);
+
+  for(uint8_t m=0;m<M_COUNT;m++) {
+    const rollup_acc_t *acc = &window->acc[m];
+    float aggregate[ROLLUP_AGGREGATES] = {acc->min, acc->max, acc->sum / window->count, acc->last, acc->sum};
+
+    for(uint8_t a=0;a<ROLLUP_AGGREGATES;a++) {
+      if(metricAggregates[m] & (1 << a)) {
+        fields[count] = metricFields[m * ROLLUP_AGGREGATES + a];
+        values[count++] = jsonFloat(aggregate[a]);
+      }
+    }
+  }
+
+  json_schema_t schema = {fields, count};
+
+  char topic[STATION_TOPIC_LENGTH + 16];
+  snprintf(topic, sizeof(topic), "%s/rollup/%u", station->topic, windowSecs[w]);
+
+  if(publishReadingValues(topic, &schema, values, window->start))
+    rollupStats.published++;
+  else
+    rollupStats.failed++;
+
+  window->published = window->start;
+  window->count = 0;
+}
+
+static void addSample(rollup_window_t *window, const float *sample) {
+  for(uint8_t m=0;m<M_COUNT;m++) {
+    rollup_acc_t *acc = &window->acc[m];
+    if(window->count == 0) {
+      acc->min = sample[m];
+      acc->max = sample[m];
+      acc->sum = sample[m];
+    } else {
+      if(sample[m] < acc->min)
+        acc->min = sample[m];
+      if(sample[m] > acc->max)
+        acc->max = sample[m];
+      acc->sum += sample[m];
+    }
+    acc->last = sample[m];
+  }
+
+  window->count++;
+}
+
+// Called from the network task for every sample, oldest first
+void rollupAdd(const station_t *station, const sensor_data_t *data, time_t sampleTime) {
+  float sample[M_COUNT];
+  sample[M_TEMP] = data->temperature;
+  sample[M_PRESS] = data->pressure;
+  sample[M_HUM] = data->humidity;
+  sample[M_BATT] = data->battery_millivolts;
+  sample[M_WIND] = data->wind_speed;
+  sample[M_DIR] = data->direction;
+  sample[M_RAIN] = data->rain;
+
+  rollupStats.samples++;
+
+  for(uint8_t w=0;w<ROLLUP_WINDOW_COUNT;w++) {
+    rollup_window_t *window = &windows[station->index][w];
+    uint32_t start = sampleTime - sampleTime % windowSecs[w];
+
+    if(((window->count > 0) && (start < window->start)) || ((window->published != 0) && (start <= window->published))) {
+      rollupStats.late++;
+      continue;
+    }
+
+    if((window->count > 0) && (start > window->start))
+      publishWindow(station, w);
+
+    if(window->count == 0)
+      window->start = start;
+
+    addSample(window, sample);
+  }
+}
+
+// Publishes the windows of stations that have gone quiet
+void rollupLoop() {
+  uint32_t now = time(NULL);
+
+  for(uint8_t n=0;n<stationCount();n++) {
+    for(uint8_t w=0;w<ROLLUP_WINDOW_COUNT;w++) {
+      rollup_window_t *window = &windows[n][w];
+      if((window->count > 0) && (now >= window->start + windowSecs[w] + ROLLUP_GRACE_SECS))
+        publishWindow(stationGet(n), w);
+    }
+  }
+}
+
+void getRollupStats(rollup_stats_t *stats) {
+  memcpy(stats, &rollupStats, sizeof(rollup_stats_t));
+}
@@ -0,0 +1,273 @@
+/**
+ *  @filename   :   stations.cpp
+ *  @brief      :   ESP32 Weather Base Station Remote Station Registry
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <Arduino.h>
+#include "weatherbase.h"
+#include "wifiwithmqtt.h"
+#include "stations.h"
+
+#define EMPTY_BUCKET 0xff
+
+extern char mqttTopic[MQTT_TOPIC_LENGTH];
+extern char primaryStation[MQTT_MAC_LENGTH];
+
+static station_t stations[MAX_STATIONS];
+static uint8_t numStations = 0;
+
+// Open addressing with linear probing. Stations are never removed, so there
+// are no tombstones to deal with
+static uint8_t buckets[STATION_HASH_SIZE];
+static bool bucketsInit = false;
+
+// From the config, or the station adopted as the primary
+static uint8_t primaryMac[6];
+static bool primaryKnown = false;
+
+static uint32_t bootMillis = 0;
+static bool noStationReported = false;
+
+static uint8_t hashMac(const uint8_t *mac) {
+  // FNV-1a, the OUI bytes are mostly the same so all six are folded in
+  uint32_t hash = 2166136261UL;
+  for(uint8_t i=0;i<6;i++) {
+    hash ^= mac[i];
+    hash *= 16777619UL;
+  }
+
+  return hash & (STATION_HASH_SIZE - 1);
+}
+
+static bool parseMac(const char *text, uint8_t *mac) {
+  unsigned int bytes[6];
+  if(sscanf(text, "%x:%x:%x:%x:%x:%x", &bytes[0], &bytes[1], &bytes[2], &bytes[3], &bytes[4], &bytes[5]) != 6)
+    return false;
+
+  for(uint8_t i=0;i<6;i++) {
+    if(bytes[i] > 0xff)
+      return false;
+    mac[i] = bytes[i];
+  }
+
+  return true;
+}
+
+static void makePrimary(station_t *station) {
+  station->primary = true;
+  strncpy(station->topic, mqttTopic, STATION_TOPIC_LENGTH);
+}
+
+static station_t *addStation(const uint8_t *mac) {
+  if(numStations >= MAX_STATIONS)
+    return NULL;
+
+  station_t *station = &stations[numStations];
+  memset(station, 0, sizeof(station_t));
+  station->index = numStations;
+  memcpy(station->mac, mac, 6);
+
+  if(primaryKnown && (memcmp(mac, primaryMac, 6) == 0)) {
+    makePrimary(station);
+  } else {
+    snprintf(station->topic, STATION_TOPIC_LENGTH, "%s/%02x%02x%02x", mqttTopic, mac[3], mac[4], mac[5]);
+  }
+
+  numStations++;
+
+  return station;
+}
+
+station_t *stationLookup(const uint8_t *mac, bool create) {
+  if(!bucketsInit) {
+    memset(buckets, EMPTY_BUCKET, sizeof(buckets));
+    primaryKnown = parseMac(primaryStation, primaryMac);
+    bucketsInit = true;
+  }
+
+  uint8_t bucket = hashMac(mac);
+  for(uint8_t n=0;n<STATION_HASH_SIZE;n++) {
+    uint8_t index = buckets[bucket];
+
+    if(index == EMPTY_BUCKET) {
+      if(!create)
+        return NULL;
+
+      station_t *station = addStation(mac);
+      if(station != NULL)
+        buckets[bucket] = station->index;
+
+      return station;
+    }
+
+    if(memcmp(stations[index].mac, mac, 6) == 0)
+      return &stations[index];
+
+    bucket = (bucket + 1) & (STATION_HASH_SIZE - 1);
+  }
+
+  return NULL;
+}
+
+station_t *stationGet(uint8_t index) {
+  if(index >= numStations)
+    return NULL;
+
+  return &stations[index];
+}
+
+uint8_t stationCount() {
+  return numStations;
+}
+
+// Only when no primary station is configured or adopted yet. True if station
+// is now the primary, and its MAC should be saved in the config.
+bool stationAdoptPrimary(station_t *station) {
+  if(primaryKnown)
+    return false;
+
+  memcpy(primaryMac, station->mac, 6);
+  primaryKnown = true;
+  makePrimary(station);
+
+  return true;
+}
+
+void stationUpdate(station_t *station, const sensor_data_t *data, int64_t rxMicros) {
+  memcpy(&station->latest, data, sizeof(sensor_data_t));
+
+  if(station->frames > 0) {
+    float interval = (rxMicros - station->lastRxMicros) / 1E06;
+    station->lastInterval = interval;
+
+    if(station->frames == 1) {
+      station->meanInterval = interval;
+      station->minInterval = interval;
+      station->maxInterval = interval;
+    } else {
+      station->meanInterval += (interval - station->meanInterval) / 16.0;
+      if(interval < station->minInterval)
+        station->minInterval = interval;
+      if(interval > station->maxInterval)
+        station->maxInterval = interval;
+    }
+  }
+
+  station->frames++;
+  station->lastRxMicros = rxMicros;
+  station->lastRxMillis = millis();
+  station->stale = false;
+}
+
+static void restartSequence(station_t *station, uint16_t sequence) {
+  station->seqValid = true;
+  station->highestSeq = sequence;
+  station->seqWindow = 1;
+}
+
+// Sliding window over the last STATION_SEQ_WINDOW sequence numbers. A gap is
+// counted as lost when it opens, and taken back off if the frame turns up late.
+// A restart is the station saying so, or a jump of more than
+// STATION_SEQ_MAX_GAP. Anything closer behind than that but older than the
+// window can't be checked, and is dropped as a duplicate rather than sent on
+// again.
+uint8_t stationCheckSequence(station_t *station, uint16_t sequence, bool restart) {
+  if(!station->seqValid) {
+    restartSequence(station, sequence);
+    station->seqReceived++;
+    return SEQ_NEW;
+  }
+
+  int16_t diff = (int16_t)(sequence - station->highestSeq);
+
+  if(restart || (diff > STATION_SEQ_MAX_GAP) || (diff < -STATION_SEQ_MAX_GAP)) {
+    restartSequence(station, sequence);
+    station->seqRestarts++;
+    station->seqReceived++;
+    return SEQ_NEW;
+  }
+
+  if(diff <= -STATION_SEQ_WINDOW) {
+    station->seqDuplicates++;
+    return SEQ_DUPLICATE;
+  }
+
+  if(diff > 0) {
+    station->seqLost += diff - 1;
+    station->seqWindow = (diff >= STATION_SEQ_WINDOW) ? 0 : station->seqWindow << diff;
+    station->seqWindow |= 1;
+    station->highestSeq = sequence;
+    station->seqReceived++;
+    return SEQ_NEW;
+  }
+
+  uint64_t bit = 1ULL << (-diff);
+  if(station->seqWindow & bit) {
+    station->seqDuplicates++;
+    return SEQ_DUPLICATE;
+  }
+
+  station->seqWindow |= bit;
+  station->seqReordered++;
+  station->seqReceived++;
+  if(station->seqLost > 0)
+    station->seqLost--;
+
+  return SEQ_REORDERED;
+}
+
+float stationLossRate(const station_t *station) {
+  uint32_t expected = station->seqReceived + station->seqLost;
+  if(expected == 0)
+    return 0.0;
+
+  return (float)station->seqLost / expected;
+}
+
+// Replaces the old single data timer. The callback is called once for each
+// station that goes quiet, and once with NULL if nothing at all is heard after
+// boot. Runs on the network task, which owns the station table.
+void stationsCheckStale(void (*staleCallback)(const station_t *station)) {
+  uint32_t now = millis();
+
+  if(numStations == 0) {
+    if(bootMillis == 0)
+      bootMillis = now;
+
+    if(!noStationReported && (now - bootMillis > STATION_STALE_MS)) {
+      noStationReported = true;
+      staleCallback(NULL);
+    }
+    return;
+  }
+
+  for(uint8_t n=0;n<numStations;n++) {
+    station_t *station = &stations[n];
+    if(!station->stale && (now - station->lastRxMillis > STATION_STALE_MS)) {
+      station->stale = true;
+      staleCallback(station);
+    }
+  }
+}
+
+void stationMacString(const station_t *station, char *buffer) {
+  sprintf(buffer, "%02x:%02x:%02x:%02x:%02x:%02x", station->mac[0], station->mac[1], station->mac[2], station->mac[3], station->mac[4], station->mac[5]);
+}
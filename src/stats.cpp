@@ -0,0 +1,239 @@
+/**
+ *  @filename   :   stats.cpp
+ *  @brief      :   ESP32 Weather Base Station Runtime Statistics
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <Arduino.h>
+#include "Ticker.h"
+#include "weatherbase.h"
+#include "wifiwithmqtt.h"
+#include "ingestqueue.h"
+#include "stations.h"
+#include "outbox.h"
+#include "logqueue.h"
+#include "influxwriter.h"
+#include "rollup.h"
+#include "history.h"
+#include "InfluxDbQueries.h"
+#include "influxclient.h"
+#include "timekeeper.h"
+#include "pressuretrend.h"
+#include "tasks.h"
+#include "stats.h"
+
+const char *ingestStatsJson="{\"host\":\"%.32s\",\"system\":\"ingest\",\"received\":%u,\"dropped\":%u,\"depth\":%u,\"high_water\":%u,\"latency_p50_us\":%u,\"latency_p90_us\":%u,\"latency_p99_us\":%u,\"latency_max_us\":%u}";
+const char *stationStatsJson="{\"host\":\"%.32s\",\"system\":\"station\",\"mac\":\"%s\",\"topic\":\"%s\",\"frames\":%u,\"interval_mean\":%.1f,\"interval_min\":%.1f,\"interval_max\":%.1f,\"stale\":%s,\"seq_received\":%u,\"seq_lost\":%u,\"seq_duplicates\":%u,\"seq_reordered\":%u,\"seq_restarts\":%u,\"loss_rate\":%.4f}";
+const char *taskStatsJson="{\"host\":\"%.32s\",\"system\":\"task\",\"name\":\"%s\",\"loops\":%u,\"stack_free\":%u,\"latency_max_us\":%u,\"latency_mean_us\":%u,\"queue_dropped\":%u,\"queue_high_water\":%u}";
+
+const char *mqttStatsJson="{\"host\":\"%.32s\",\"system\":\"mqtt\",\"connected\":%s,\"connect_attempts\":%u,\"connect_failures\":%u,\"disconnects\":%u,\"disconnected_ms\":%u,\"backoff_ms\":%u,\"queued_messages\":%u,\"queued_bytes\":%u,\"queue_high_water\":%u,\"queue_dropped\":%u,\"publish_failed\":%u}";
+
+const char *outboxStatsJson="{\"host\":\"%.32s\",\"system\":\"outbox\",\"mounted\":%s,\"appended\":%u,\"replayed\":%u,\"segments\":%u,\"pending_bytes\":%u,\"segments_dropped\":%u,\"corrupt\":%u}";
+
+const char *logStatsJson="{\"host\":\"%.32s\",\"system\":\"logqueue\",\"queued\":%u,\"sent\":%u,\"coalesced\":%u,\"rate_limited\":%u,\"dropped\":%u,\"depth\":%u,\"high_water\":%u}";
+
+const char *influxStatsJson="{\"host\":\"%.32s\",\"system\":\"influx\",\"points\":%u,\"writes\":%u,\"failures\":%u,\"rejected\":%u,\"dropped\":%u,\"raw_bytes\":%u,\"sent_bytes\":%u,\"pending_points\":%u,\"pending_bytes\":%u}";
+
+const char *rollupStatsJson="{\"host\":\"%.32s\",\"system\":\"rollup\",\"samples\":%u,\"published\":%u,\"late\":%u,\"failed\":%u}";
+
+const char *historyStatsJson="{\"host\":\"%.32s\",\"system\":\"history\",\"samples\":%u,\"hits\":%u,\"misses\":%u,\"fill_queries\":%u,\"fill_rows\":%u,\"fill_failures\":%u,\"saves\":%u,\"rain_saves\":%u,\"clock_steps\":%u,\"covered_days\":%u}";
+
+const char *queryCacheStatsJson="{\"host\":\"%.32s\",\"system\":\"querycache\",\"hits\":%u,\"misses\":%u,\"expired\":%u,\"midnight\":%u,\"stale\":%u,\"requests\":%u,\"statements\":%u,\"prefetched\":%u,\"entries\":%u}";
+
+const char *influxClientStatsJson="{\"host\":\"%.32s\",\"system\":\"influxclient\",\"requests\":%u,\"reused\":%u,\"connects\":%u,\"resolves\":%u,\"failures\":%u,\"rtt_last_ms\":%u,\"rtt_min_ms\":%u,\"rtt_mean_ms\":%u,\"rtt_max_ms\":%u}";
+
+const char *timeStatsJson="{\"host\":\"%.32s\",\"system\":\"time\",\"synced\":%s,\"sync_ms\":%u,\"steps\":%u,\"midnights\":%u}";
+
+const char *trendStatsJson="{\"host\":\"%.32s\",\"system\":\"pressuretrend\",\"samples\":%u,\"valid\":%s,\"mean_inhg\":%.3f,\"slope_inhg_3h\":%.4f}";
+
+void statsTickerCallback(void);
+
+Ticker statsTimer(statsTickerCallback, STATS_INTERVAL_MS);
+
+static void publishIngestStats() {
+  ingest_stats_t stats;
+  ingestGetStats(&stats);
+
+  char payload[250];
+  snprintf(payload, sizeof(payload), ingestStatsJson, STATION_NAME, stats.received, stats.dropped, stats.depth, stats.highWater,
+    stats.latencyP50, stats.latencyP90, stats.latencyP99, stats.latencyMax);
+  publishStats(payload);
+}
+
+static void publishStationStats() {
+  for(uint8_t n=0;n<stationCount();n++) {
+    station_t *station = stationGet(n);
+    char mac[18];
+    stationMacString(station, mac);
+
+    char payload[400];
+    snprintf(payload, sizeof(payload), stationStatsJson, STATION_NAME, mac, station->topic, station->frames,
+      station->meanInterval, station->minInterval, station->maxInterval, (station->stale) ? "true" : "false",
+      station->seqReceived, station->seqLost, station->seqDuplicates, station->seqReordered, station->seqRestarts,
+      stationLossRate(station));
+    publishStats(payload);
+  }
+}
+
+static void publishTaskStats() {
+  for(uint8_t n=0;n<TASK_COUNT;n++) {
+    task_stats_t stats;
+    getTaskStats(n, &stats);
+
+    char payload[250];
+    snprintf(payload, sizeof(payload), taskStatsJson, STATION_NAME, stats.name, stats.loops, stats.stackFree,
+      stats.maxLatencyUs, stats.meanLatencyUs, stats.queueDropped, stats.queueHighWater);
+    publishStats(payload);
+  }
+}
+
+static void publishMQTTStats() {
+  mqtt_stats_t stats;
+  getMQTTStats(&stats);
+
+  char payload[350];
+  snprintf(payload, sizeof(payload), mqttStatsJson, STATION_NAME, (stats.connected) ? "true" : "false",
+    stats.connectAttempts, stats.connectFailures, stats.disconnects, stats.disconnectedMs, stats.backoffMs,
+    stats.queuedMessages, stats.queuedBytes, stats.queueHighWater, stats.queueDropped, stats.publishFailed);
+  publishStats(payload);
+}
+
+static void publishOutboxStats() {
+  outbox_stats_t stats;
+  getOutboxStats(&stats);
+
+  char payload[250];
+  snprintf(payload, sizeof(payload), outboxStatsJson, STATION_NAME, (stats.mounted) ? "true" : "false",
+    stats.appended, stats.replayed, stats.segments, stats.pendingBytes, stats.segmentsDropped, stats.corrupt);
+  publishStats(payload);
+}
+
+static void publishLogStats() {
+  log_stats_t stats;
+  getLogStats(&stats);
+
+  char payload[250];
+  snprintf(payload, sizeof(payload), logStatsJson, STATION_NAME, stats.queued, stats.sent, stats.coalesced,
+    stats.rateLimited, stats.dropped, stats.depth, stats.highWater);
+  publishStats(payload);
+}
+
+static void publishRollupStats() {
+  rollup_stats_t stats;
+  getRollupStats(&stats);
+
+  char payload[200];
+  snprintf(payload, sizeof(payload), rollupStatsJson, STATION_NAME, stats.samples, stats.published, stats.late, stats.failed);
+  publishStats(payload);
+}
+
+static void publishHistoryStats() {
+  history_stats_t stats;
+  getHistoryStats(&stats);
+
+  char payload[300];
+  snprintf(payload, sizeof(payload), historyStatsJson, STATION_NAME, stats.samples, stats.hits, stats.misses,
+    stats.fillQueries, stats.fillRows, stats.fillFailures, stats.saves, stats.rainSaves, stats.clockSteps, stats.coveredDays);
+  publishStats(payload);
+}
+
+static void publishQueryCacheStats() {
+  query_cache_stats_t stats;
+  getQueryCacheStats(&stats);
+
+  char payload[250];
+  snprintf(payload, sizeof(payload), queryCacheStatsJson, STATION_NAME, stats.hits, stats.misses, stats.expired,
+    stats.midnight, stats.stale, stats.requests, stats.statements, stats.prefetched, stats.entries);
+  publishStats(payload);
+}
+
+static void publishInfluxClientStats() {
+  influx_client_stats_t stats;
+  getInfluxClientStats(&stats);
+
+  char payload[250];
+  snprintf(payload, sizeof(payload), influxClientStatsJson, STATION_NAME, stats.requests, stats.reused, stats.connects,
+    stats.resolves, stats.failures, stats.rttLastMs, stats.rttMinMs, stats.rttMeanMs, stats.rttMaxMs);
+  publishStats(payload);
+}
+
+static void publishTimeStats() {
+  time_stats_t stats;
+  getTimeStats(&stats);
+
+  char payload[150];
+  snprintf(payload, sizeof(payload), timeStatsJson, STATION_NAME, timeValid() ? "true" : "false", stats.syncMs,
+    stats.steps, stats.midnights);
+  publishStats(payload);
+}
+
+static void publishTrendStats() {
+  pressure_trend_t trend;
+  bool valid = pressureTrend(&trend);
+
+  char payload[150];
+  snprintf(payload, sizeof(payload), trendStatsJson, STATION_NAME, trend.samples, valid ? "true" : "false", trend.mean,
+    trend.slope);
+  publishStats(payload);
+}
+
+#ifdef INFLUX_WRITER
+static void publishInfluxStats() {
+  influx_stats_t stats;
+  getInfluxWriterStats(&stats);
+
+  char payload[300];
+  snprintf(payload, sizeof(payload), influxStatsJson, STATION_NAME, stats.points, stats.writes, stats.failures,
+    stats.rejected, stats.dropped, stats.rawBytes, stats.sentBytes, stats.pendingPoints, stats.pendingBytes);
+  publishStats(payload);
+}
+#endif
+
+void publishAllStats() {
+  publishIngestStats();
+  publishMQTTStats();
+  publishOutboxStats();
+  publishLogStats();
+#if ROLLUP_MODE != ROLLUP_OFF
+  publishRollupStats();
+#endif
+  publishHistoryStats();
+  publishQueryCacheStats();
+  publishInfluxClientStats();
+  publishTimeStats();
+  publishTrendStats();
+#ifdef INFLUX_WRITER
+  publishInfluxStats();
+#endif
+  publishStationStats();
+  publishTaskStats();
+}
+
+void statsTickerCallback() {
+  publishAllStats();
+}
+
+void initStats() {
+  statsTimer.start();
+}
+
+void statsLoop() {
+  statsTimer.update();
+}
@@ -0,0 +1,294 @@
+/**
+ *  @filename   :   tasks.cpp
+ *  @brief      :   ESP32 Weather Base Station FreeRTOS Tasks
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <Arduino.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "weatherbase.h"
+#include "display.h"
+#include "history.h"
+#include "tasks.h"
+#include "timekeeper.h"
+
+// A job from queryPost() has no caller waiting for its result
+typedef struct query_job_t {
+  query_fn_t fn;
+  void *arg;
+  int *result;
+  TaskHandle_t caller;
+} query_job_t;
+
+typedef struct task_info_t {
+  const char *name;
+  TaskHandle_t handle;
+  uint32_t loops;
+  uint32_t maxLatencyUs;
+  uint64_t totalLatencyUs;
+  uint32_t queueDropped;
+  uint16_t queueHighWater;
+} task_info_t;
+
+static task_info_t taskInfo[TASK_COUNT] = {
+  {"network", NULL, 0, 0, 0, 0, 0},
+  {"query", NULL, 0, 0, 0, 0, 0},
+  {"display", NULL, 0, 0, 0, 0, 0}
+};
+
+static QueueHandle_t displayQueue = NULL;
+static QueueHandle_t queryQueue = NULL;
+
+static void recordLatency(task_info_t *info, int64_t start) {
+  uint32_t latency = timeMicros() - start;
+
+  info->loops++;
+  info->totalLatencyUs += latency;
+  if(latency > info->maxLatencyUs)
+    info->maxLatencyUs = latency;
+}
+
+static void recordQueueDepth(task_info_t *info, QueueHandle_t queue) {
+  uint16_t depth = uxQueueMessagesWaiting(queue);
+  if(depth > info->queueHighWater)
+    info->queueHighWater = depth;
+}
+
+static void networkStep() {
+  int64_t start = timeMicros();
+  networkLoop();
+  recordLatency(&taskInfo[TASK_NETWORK], start);
+}
+
+static void queryStep(TickType_t wait) {
+  query_job_t job;
+
+  // Work that can wait for the task to be free
+  if(xQueueReceive(queryQueue, &job, wait) != pdTRUE) {
+    historyIdle();
+    return;
+  }
+
+  int64_t start = timeMicros();
+  int result = job.fn(job.arg);
+  recordLatency(&taskInfo[TASK_QUERY], start);
+
+  if(job.caller != NULL) {
+    *job.result = result;
+    xTaskNotifyGive(job.caller);
+  }
+}
+
+static void displayStep(TickType_t wait) {
+  display_msg_t msg;
+
+  bool received = (xQueueReceive(displayQueue, &msg, wait) == pdTRUE);
+
+  int64_t start = timeMicros();
+  if(received) {
+    switch(msg.type) {
+      case DISPLAY_MSG_DATA:
+        displayData(msg.data.temperature, msg.data.pressure, msg.data.humidity, msg.data.battery_millivolts, msg.data.direction, msg.data.wind_speed, msg.data.rain, msg.roomTemp, msg.roomHum);
+        break;
+      case DISPLAY_MSG_ERROR:
+        setError(msg.error);
+        break;
+      case DISPLAY_MSG_MIDNIGHT:
+        displayMidnight();
+        break;
+      case DISPLAY_MSG_STALE:
+        displayStale(msg.error);
+        break;
+      default:
+        break;
+    }
+  }
+
+  displayLoop();
+  recordLatency(&taskInfo[TASK_DISPLAY], start);
+}
+
+#ifndef NATIVE_BUILD
+static void networkTask(void *param) {
+  for(;;) {
+    networkStep();
+    vTaskDelay(1);
+  }
+}
+
+static void queryTask(void *param) {
+  for(;;)
+    queryStep(pdMS_TO_TICKS(QUERY_IDLE_MS));
+}
+
+static void displayTask(void *param) {
+  // The timeout sets how often touch and the stale station check are polled
+  for(;;)
+    displayStep(pdMS_TO_TICKS(10));
+}
+#endif
+
+// The query task has to be running before the panels are built, since their
+// constructors query InfluxDB
+void initTasks() {
+  displayQueue = xQueueCreate(DISPLAY_QUEUE_DEPTH, sizeof(display_msg_t));
+  queryQueue = xQueueCreate(QUERY_QUEUE_DEPTH, sizeof(query_job_t));
+
+#ifndef NATIVE_BUILD
+  xTaskCreatePinnedToCore(queryTask, taskInfo[TASK_QUERY].name, QUERY_STACK, NULL, QUERY_PRIORITY, &taskInfo[TASK_QUERY].handle, QUERY_CORE);
+#endif
+}
+
+void startTasks() {
+#ifndef NATIVE_BUILD
+  xTaskCreatePinnedToCore(networkTask, taskInfo[TASK_NETWORK].name, NETWORK_STACK, NULL, NETWORK_PRIORITY, &taskInfo[TASK_NETWORK].handle, NETWORK_CORE);
+  xTaskCreatePinnedToCore(displayTask, taskInfo[TASK_DISPLAY].name, DISPLAY_STACK, NULL, DISPLAY_PRIORITY, &taskInfo[TASK_DISPLAY].handle, DISPLAY_CORE);
+#endif
+}
+
+#ifdef NATIVE_BUILD
+// There are no threads on the host build, so loop() steps each task in turn.
+// With no task handles, queries run inline on the caller.
+void runTasksOnce() {
+  networkStep();
+  queryStep(0);
+  displayStep(0);
+}
+#endif
+
+// Before the display task starts, setup() owns the display
+bool onDisplayTask() {
+  TaskHandle_t display = taskInfo[TASK_DISPLAY].handle;
+  return (display == NULL) || (display == xTaskGetCurrentTaskHandle());
+}
+
+static bool postDisplay(const display_msg_t *msg) {
+  task_info_t *info = &taskInfo[TASK_DISPLAY];
+
+  if(xQueueSend(displayQueue, msg, 0) != pdTRUE) {
+    info->queueDropped++;
+    return false;
+  }
+
+  recordQueueDepth(info, displayQueue);
+  return true;
+}
+
+bool postDisplayData(const sensor_data_t *data, float roomTemp, float roomHum) {
+  display_msg_t msg;
+  msg.type = DISPLAY_MSG_DATA;
+  memcpy(&msg.data, data, sizeof(sensor_data_t));
+  msg.roomTemp = roomTemp;
+  msg.roomHum = roomHum;
+
+  return postDisplay(&msg);
+}
+
+bool postDisplayError(const char *errStr) {
+  display_msg_t msg;
+  msg.type = DISPLAY_MSG_ERROR;
+  strncpy(msg.error, errStr, DISPLAY_ERROR_LENGTH - 1);
+  msg.error[DISPLAY_ERROR_LENGTH - 1] = '\0';
+
+  return postDisplay(&msg);
+}
+
+bool postDisplayMidnight() {
+  display_msg_t msg;
+  msg.type = DISPLAY_MSG_MIDNIGHT;
+
+  return postDisplay(&msg);
+}
+
+// mac is NULL for the primary station, or when nothing has been heard at all
+bool postDisplayStale(const char *mac) {
+  display_msg_t msg;
+  msg.type = DISPLAY_MSG_STALE;
+  strncpy(msg.error, (mac != NULL) ? mac : "", DISPLAY_ERROR_LENGTH - 1);
+  msg.error[DISPLAY_ERROR_LENGTH - 1] = '\0';
+
+  return postDisplay(&msg);
+}
+
+// Runs fn on the query task and waits for it. The wait is bounded by the
+// HTTP timeouts inside fn.
+int queryRun(query_fn_t fn, void *arg) {
+  task_info_t *info = &taskInfo[TASK_QUERY];
+
+  if((info->handle == NULL) || (info->handle == xTaskGetCurrentTaskHandle()))
+    return fn(arg);
+
+  int result = -1;
+  query_job_t job;
+  job.fn = fn;
+  job.arg = arg;
+  job.result = &result;
+  job.caller = xTaskGetCurrentTaskHandle();
+
+  if(xQueueSend(queryQueue, &job, portMAX_DELAY) != pdTRUE) {
+    info->queueDropped++;
+    return -1;
+  }
+
+  recordQueueDepth(info, queryQueue);
+  ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+  return result;
+}
+
+// Runs fn on the query task without waiting for it. fn and arg have to
+// outlive the job, and fn has to let whoever cares know it is done. Gives up
+// at once if the queue is full.
+bool queryPost(query_fn_t fn, void *arg) {
+  task_info_t *info = &taskInfo[TASK_QUERY];
+
+  if(info->handle == NULL) {
+    fn(arg);
+    return true;
+  }
+
+  query_job_t job;
+  job.fn = fn;
+  job.arg = arg;
+  job.result = NULL;
+  job.caller = NULL;
+
+  if(xQueueSend(queryQueue, &job, 0) != pdTRUE) {
+    info->queueDropped++;
+    return false;
+  }
+
+  recordQueueDepth(info, queryQueue);
+  return true;
+}
+
+void getTaskStats(uint8_t task, task_stats_t *stats) {
+  task_info_t *info = &taskInfo[task];
+
+  stats->name = info->name;
+  stats->loops = info->loops;
+  stats->maxLatencyUs = info->maxLatencyUs;
+  stats->meanLatencyUs = (info->loops == 0) ? 0 : info->totalLatencyUs / info->loops;
+  stats->stackFree = (info->handle == NULL) ? 0 : uxTaskGetStackHighWaterMark(info->handle);
+  stats->queueDropped = info->queueDropped;
+  stats->queueHighWater = info->queueHighWater;
+}
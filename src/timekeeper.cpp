@@ -0,0 +1,161 @@
+/**
+ *  @filename   :   timekeeper.cpp
+ *  @brief      :   ESP32 Weather Base Station Time Service
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <Arduino.h>
+#include <sys/time.h>
+#include "esp_timer.h"
+#include "weatherbase.h"
+#include "logqueue.h"
+#include "timekeeper.h"
+
+#define DAY_SECS 86400
+#define LOCAL_OFFSET_SECS (GMT_OFFSET_SECS + DAYLIGHT_OFFSET_SECS)
+
+// Read from every task. Once SNTP has set the clock it stays set.
+static volatile bool valid = false;
+
+// Only added to before the tasks start
+static time_handler_t midnightHandlers[TIME_HANDLERS];
+static uint8_t midnightCount = 0;
+static time_handler_t stepHandlers[TIME_HANDLERS];
+static uint8_t stepCount = 0;
+
+// Only touched by timeLoop(), on the network task
+static uint32_t loopWall = 0;
+static int64_t loopMicros = 0;
+static uint32_t loopDay = 0;
+
+static time_stats_t timeStats;
+
+void initTime() {
+  configTime(GMT_OFFSET_SECS, DAYLIGHT_OFFSET_SECS, TIME_NTP_SERVER);
+}
+
+bool timeValid() {
+  if(valid)
+    return true;
+
+  if(time(NULL) < TIME_MIN_EPOCH)
+    return false;
+
+  timeStats.syncMs = millis();
+  valid = true;
+  return true;
+}
+
+// Seconds since the epoch, 0 until SNTP has set the clock
+uint32_t timeNow() {
+  return timeValid() ? time(NULL) : 0;
+}
+
+int64_t timeMicros() {
+  return esp_timer_get_time();
+}
+
+int64_t timeEpochMicros() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (int64_t)tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+// Never waits. dt is zeroed if the clock is not set yet.
+bool timeLocal(struct tm *dt) {
+  uint32_t now = timeNow();
+  if(now == 0) {
+    memset(dt, 0, sizeof(struct tm));
+    return false;
+  }
+
+  time_t local = (time_t)now + LOCAL_OFFSET_SECS;
+  gmtime_r(&local, dt);
+  return true;
+}
+
+uint32_t timeLocalDay(uint32_t t) {
+  return (t + LOCAL_OFFSET_SECS) / DAY_SECS;
+}
+
+uint32_t timeDayStart(uint32_t day) {
+  return day * DAY_SECS - LOCAL_OFFSET_SECS;
+}
+
+// Counting the minute under way, so it is never 0. 1440, the whole day, if
+// the clock is not set yet.
+uint16_t timeMinutesToday() {
+  uint32_t now = timeNow();
+  if(now == 0)
+    return 1440;
+
+  return ((now + LOCAL_OFFSET_SECS) % DAY_SECS) / 60 + 1;
+}
+
+static bool addHandler(time_handler_t *handlers, uint8_t *count, time_handler_t handler) {
+  if(*count == TIME_HANDLERS)
+    return false;
+
+  handlers[(*count)++] = handler;
+  return true;
+}
+
+bool timeOnMidnight(time_handler_t handler) {
+  return addHandler(midnightHandlers, &midnightCount, handler);
+}
+
+bool timeOnStep(time_handler_t handler) {
+  return addHandler(stepHandlers, &stepCount, handler);
+}
+
+// A step is the wall clock moving on by more, or less, than the monotonic
+// clock since the last call. Called every loop, so one call sees all of it.
+void timeLoop() {
+  uint32_t now = timeNow();
+  if(now == 0)
+    return;
+
+  int64_t micros = timeMicros();
+  if(loopWall != 0) {
+    int32_t step = (int32_t)(now - loopWall) - (int32_t)((micros - loopMicros) / 1000000);
+    if((step > TIME_STEP_SECS) || (step < -TIME_STEP_SECS)) {
+      char warning[40];
+      snprintf(warning, sizeof(warning), "Clock stepped %d s", step);
+      LOG_WARN("time", warning);
+      timeStats.steps++;
+      for(uint8_t n=0;n<stepCount;n++)
+        stepHandlers[n](now);
+    }
+  }
+  loopWall = now;
+  loopMicros = micros;
+
+  uint32_t day = timeLocalDay(now);
+  if((loopDay != 0) && (day != loopDay)) {
+    timeStats.midnights++;
+    for(uint8_t n=0;n<midnightCount;n++)
+      midnightHandlers[n](now);
+  }
+  loopDay = day;
+}
+
+void getTimeStats(time_stats_t *stats) {
+  memcpy(stats, &timeStats, sizeof(time_stats_t));
+}
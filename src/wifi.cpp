@@ -35,6 +35,8 @@
 const char *hostname = "weatherbase";
 char mqttServer[MQTT_SERVER_LENGTH];
 char mqttTopic[MQTT_TOPIC_LENGTH];
+char primaryStation[MQTT_MAC_LENGTH];
+char mqttFormat[MQTT_FORMAT_LENGTH];
 uint16_t mqttPort;
 bool configMode = false;
 
@@ -57,6 +59,12 @@ void printMQTT() {
 
   Serial.print(F("Topic "));
   Serial.println(mqttTopic);
+
+  Serial.print(F("Primary Station "));
+  Serial.println(primaryStation);
+
+  Serial.print(F("Payload Format "));
+  Serial.println(mqttFormat);
 }
 
 // Get rid of trailing spaces that sometime appear, probably from autocomplete on the browser
@@ -79,11 +87,19 @@ void readEEPROM() {
     strncpy(mqttServer, rtrim(conf.server), MQTT_SERVER_LENGTH);
     strncpy(mqttTopic, rtrim(conf.topic), MQTT_TOPIC_LENGTH);
     mqttPort=conf.port;
+
+    // Blank, or whatever was past the end, in a config saved before there was one
+    conf.primary[MQTT_MAC_LENGTH - 1] = '\0';
+    strncpy(primaryStation, rtrim(conf.primary), MQTT_MAC_LENGTH);
+    conf.format[MQTT_FORMAT_LENGTH - 1] = '\0';
+    strncpy(mqttFormat, rtrim(conf.format), MQTT_FORMAT_LENGTH);
   }
   else {
     Serial.println("No Valid Config");
     strncpy(mqttServer,"",MQTT_SERVER_LENGTH);
     strncpy(mqttTopic,"",MQTT_TOPIC_LENGTH);
+    strncpy(primaryStation,"",MQTT_MAC_LENGTH);
+    strncpy(mqttFormat,"",MQTT_FORMAT_LENGTH);
     mqttPort = 1883;
 
     Serial.println(F("Setup WIFI Manager"));
@@ -101,12 +117,21 @@ void writeEEPROM() {
   conf.valid = 0xDEADBEEF;
   strncpy(conf.server, rtrim(mqttServer), MQTT_SERVER_LENGTH);
   strncpy(conf.topic, rtrim(mqttTopic), MQTT_TOPIC_LENGTH);
+  strncpy(conf.primary, rtrim(primaryStation), MQTT_MAC_LENGTH);
+  strncpy(conf.format, rtrim(mqttFormat), MQTT_FORMAT_LENGTH);
   conf.port = mqttPort;
 
   EEPROM.put(0,conf);
   EEPROM.commit();
 }
 
+// Keeps the primary station picked when none was configured, so it is the
+// same one after a restart
+void savePrimaryStation(const char *mac) {
+  strncpy(primaryStation, mac, MQTT_MAC_LENGTH);
+  writeEEPROM();
+}
+
 void callWFM(bool connect) {
   WiFiManager wfm;
 
@@ -118,10 +143,14 @@ void callWFM(bool connect) {
   itoa(mqttPort, port_string,10);
   WiFiManagerParameter mqtt_port("port", "MQTT port", port_string, 6);
   WiFiManagerParameter mqtt_topic("topic", "MQTT Topic", mqttTopic,MQTT_TOPIC_LENGTH);
+  WiFiManagerParameter primary_station("primary", "Primary Station MAC", primaryStation, MQTT_MAC_LENGTH);
+  WiFiManagerParameter payload_format("format", "Payload Format (json, cbor, msgpack)", mqttFormat, MQTT_FORMAT_LENGTH);
 
   wfm.addParameter(&mqtt_server);
   wfm.addParameter(&mqtt_port);
   wfm.addParameter(&mqtt_topic);
+  wfm.addParameter(&primary_station);
+  wfm.addParameter(&payload_format);
 
   if(connect) {
     if(!wfm.autoConnect()) {
@@ -140,6 +169,8 @@ void callWFM(bool connect) {
 
   strncpy(mqttServer, mqtt_server.getValue(), MQTT_SERVER_LENGTH);
   strncpy(mqttTopic, mqtt_topic.getValue(), MQTT_TOPIC_LENGTH);
+  strncpy(primaryStation, primary_station.getValue(), MQTT_MAC_LENGTH);
+  strncpy(mqttFormat, payload_format.getValue(), MQTT_FORMAT_LENGTH);
   mqttPort = atoi(mqtt_port.getValue());
 
   if(configMode) {
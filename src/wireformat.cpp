@@ -0,0 +1,200 @@
+/**
+ *  @filename   :   wireformat.cpp
+ *  @brief      :   ESP32 Weather Base Station ESP-NOW Wire Format
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <Arduino.h>
+#include <math.h>
+#include "weatherbase.h"
+#include "wireformat.h"
+
+enum WireField {F_TEMP, F_PRESS, F_HUM, F_BATT, F_DIR, F_WIND, F_RAIN, F_COUNT};
+
+static uint16_t read16(const uint8_t *p) {
+  return p[0] | (p[1] << 8);
+}
+
+static void write16(uint8_t *p, uint16_t value) {
+  p[0] = value & 0xff;
+  p[1] = value >> 8;
+}
+
+static int32_t clamp(int32_t value, int32_t min, int32_t max) {
+  if(value < min)
+    return min;
+  if(value > max)
+    return max;
+  return value;
+}
+
+static void toFixed(const sensor_data_t *sample, int32_t *fixed) {
+  fixed[F_TEMP] = clamp(lroundf(sample->temperature * WIRE_TEMP_SCALE), INT16_MIN, INT16_MAX);
+  fixed[F_PRESS] = clamp(sample->pressure - WIRE_PRESSURE_OFFSET, 0, UINT16_MAX);
+  fixed[F_HUM] = clamp(lroundf(sample->humidity * WIRE_HUM_SCALE), 0, UINT16_MAX);
+  fixed[F_BATT] = clamp(lroundf(sample->battery_millivolts), 0, UINT16_MAX);
+  fixed[F_DIR] = sample->direction;
+  fixed[F_WIND] = clamp(lroundf(sample->wind_speed * WIRE_WIND_SCALE), 0, UINT16_MAX);
+  fixed[F_RAIN] = clamp(lroundf(sample->rain * WIRE_RAIN_SCALE), 0, UINT16_MAX);
+}
+
+static void fromFixed(const int32_t *fixed, uint8_t reason, sensor_data_t *sample) {
+  sample->wakeup_reason = reason;
+  sample->temperature = fixed[F_TEMP] / WIRE_TEMP_SCALE;
+  sample->pressure = fixed[F_PRESS] + WIRE_PRESSURE_OFFSET;
+  sample->humidity = fixed[F_HUM] / WIRE_HUM_SCALE;
+  sample->battery_millivolts = fixed[F_BATT];
+  sample->direction = fixed[F_DIR];
+  sample->wind_speed = fixed[F_WIND] / WIRE_WIND_SCALE;
+  sample->rain = fixed[F_RAIN] / WIRE_RAIN_SCALE;
+}
+
+bool wireReaderInit(wire_reader_t *reader, const uint8_t *data, uint8_t len) {
+  reader->data = data;
+  reader->len = len;
+  reader->offset = 0;
+  reader->remaining = 0;
+  reader->legacy = false;
+  reader->header = NULL;
+
+  if((len >= WIRE_HEADER_LEN) && (data[0] == WIRE_MAGIC)) {
+    const wire_header_t *header = (const wire_header_t *)data;
+    if(header->version != WIRE_VERSION)
+      return false;
+
+    if((header->count == 0) || (header->count > WIRE_MAX_SAMPLES))
+      return false;
+
+    reader->header = header;
+    reader->offset = WIRE_HEADER_LEN;
+    reader->remaining = header->count;
+    return true;
+  }
+
+  if(len == sizeof(sensor_data_t)) {
+    reader->legacy = true;
+    reader->remaining = 1;
+    return true;
+  }
+
+  return false;
+}
+
+bool wireNextSample(wire_reader_t *reader, sensor_data_t *sample, uint16_t *age) {
+  if(reader->remaining == 0)
+    return false;
+
+  if(reader->legacy) {
+    memcpy(sample, reader->data, sizeof(sensor_data_t));
+    *age = 0;
+    reader->remaining = 0;
+    return true;
+  }
+
+  const uint8_t *p = &reader->data[reader->offset];
+  if(reader->offset + 3 > reader->len) {
+    reader->remaining = 0;
+    return false;
+  }
+
+  uint16_t sampleAge = read16(p);
+  uint8_t reason = p[2];
+
+  if(sampleAge & WIRE_AGE_DELTA) {
+    // The first sample has nothing to be a delta of
+    if((reader->offset == WIRE_HEADER_LEN) || (reader->offset + WIRE_DELTA_SAMPLE_LEN > reader->len)) {
+      reader->remaining = 0;
+      return false;
+    }
+
+    for(uint8_t n=0;n<F_COUNT;n++)
+      reader->prev[n] += (int8_t)p[3+n];
+
+    reader->offset += WIRE_DELTA_SAMPLE_LEN;
+  } else {
+    if(reader->offset + WIRE_SAMPLE_LEN > reader->len) {
+      reader->remaining = 0;
+      return false;
+    }
+
+    reader->prev[F_TEMP] = (int16_t)read16(&p[3]);
+    for(uint8_t n=F_PRESS;n<F_COUNT;n++)
+      reader->prev[n] = read16(&p[3+n*2]);
+
+    reader->offset += WIRE_SAMPLE_LEN;
+  }
+
+  fromFixed(reader->prev, reason, sample);
+  *age = sampleAge & ~WIRE_AGE_DELTA;
+  reader->remaining--;
+
+  return true;
+}
+
+// Used by the remote stations, and to build frames for replay. Samples must be
+// oldest first. Returns the frame length, or 0 if the samples do not fit.
+uint8_t wireEncode(uint8_t *buffer, uint16_t stationId, uint16_t sequence, const sensor_data_t *samples, const uint16_t *ages, uint8_t count, uint8_t flags, bool delta) {
+  if((count == 0) || (count > WIRE_MAX_SAMPLES))
+    return 0;
+
+  buffer[0] = WIRE_MAGIC;
+  buffer[1] = WIRE_VERSION;
+  write16(&buffer[2], stationId);
+  write16(&buffer[4], sequence);
+  buffer[6] = count;
+  buffer[7] = flags;
+
+  uint16_t offset = WIRE_HEADER_LEN;
+  int32_t prev[F_COUNT];
+  int32_t fixed[F_COUNT];
+
+  for(uint8_t s=0;s<count;s++) {
+    toFixed(&samples[s], fixed);
+    uint16_t age = (ages[s] < WIRE_AGE_DELTA) ? ages[s] : WIRE_AGE_DELTA - 1;
+
+    bool fits = delta && (s > 0);
+    for(uint8_t n=0;fits && (n<F_COUNT);n++) {
+      int32_t diff = fixed[n] - prev[n];
+      if((diff < INT8_MIN) || (diff > INT8_MAX))
+        fits = false;
+    }
+
+    uint8_t sampleLen = fits ? WIRE_DELTA_SAMPLE_LEN : WIRE_SAMPLE_LEN;
+    if(offset + sampleLen > WIRE_MAX_FRAME)
+      return 0;
+
+    uint8_t *p = &buffer[offset];
+    p[2] = samples[s].wakeup_reason;
+    if(fits) {
+      write16(p, age | WIRE_AGE_DELTA);
+      for(uint8_t n=0;n<F_COUNT;n++)
+        p[3+n] = (uint8_t)(int8_t)(fixed[n] - prev[n]);
+    } else {
+      write16(p, age);
+      for(uint8_t n=0;n<F_COUNT;n++)
+        write16(&p[3+n*2], (uint16_t)fixed[n]);
+    }
+
+    memcpy(prev, fixed, sizeof(prev));
+    offset += sampleLen;
+  }
+
+  return offset;
+}
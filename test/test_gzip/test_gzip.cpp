@@ -0,0 +1,213 @@
+/**
+ *  @filename   :   test_gzip.cpp
+ *  @brief      :   ESP32 Weather Base Station gzip encoder tests
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include "gzip.h"
+
+/*
+ * Just enough of inflate to read back what gzipCompress() writes: one final
+ * block with the fixed Huffman codes. Anything else fails the test.
+ */
+static const uint16_t lengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+  35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uint8_t lengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+  3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const uint16_t distBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+  257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const uint8_t distExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+  7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+typedef struct bit_reader_t {
+  const uint8_t *in;
+  size_t len;
+  size_t pos;                       // In bits
+} bit_reader_t;
+
+static uint32_t getBits(bit_reader_t *r, uint8_t n) {
+  uint32_t value = 0;
+  for(uint8_t i=0;i<n;i++) {
+    TEST_ASSERT_TRUE_MESSAGE(r->pos / 8 < r->len, "Ran off the end of the block");
+    value |= ((r->in[r->pos / 8] >> (r->pos % 8)) & 1) << i;
+    r->pos++;
+  }
+  return value;
+}
+
+// Huffman codes are read most significant bit first
+static uint16_t getSymbol(bit_reader_t *r) {
+  uint16_t code = 0;
+  for(uint8_t n=1;n<=9;n++) {
+    code = (code << 1) | getBits(r, 1);
+    if((n == 7) && (code <= 0x17))
+      return 256 + code;
+    if((n == 8) && (code >= 0x30) && (code <= 0xbf))
+      return code - 0x30;
+    if((n == 8) && (code >= 0xc0) && (code <= 0xc7))
+      return 280 + code - 0xc0;
+    if((n == 9) && (code >= 0x190))
+      return 144 + code - 0x190;
+  }
+
+  TEST_FAIL_MESSAGE("Bad literal/length code");
+  return 0;
+}
+
+static uint16_t getReversed(bit_reader_t *r, uint8_t n) {
+  uint16_t code = 0;
+  for(uint8_t i=0;i<n;i++)
+    code = (code << 1) | getBits(r, 1);
+  return code;
+}
+
+static uint32_t read32(const uint8_t *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Checks the header and trailer too. Returns the inflated length.
+static size_t gunzip(const uint8_t *in, size_t len, uint8_t *out, size_t outSize) {
+  TEST_ASSERT_TRUE(len >= GZIP_OVERHEAD);
+  TEST_ASSERT_EQUAL_HEX8(0x1f, in[0]);
+  TEST_ASSERT_EQUAL_HEX8(0x8b, in[1]);
+  TEST_ASSERT_EQUAL_UINT8(8, in[2]);
+  TEST_ASSERT_EQUAL_UINT8(0, in[3]);
+
+  bit_reader_t r = {&in[10], len - GZIP_OVERHEAD, 0};
+  TEST_ASSERT_EQUAL_UINT32(1, getBits(&r, 1));
+  TEST_ASSERT_EQUAL_UINT32(1, getBits(&r, 2));
+
+  size_t pos = 0;
+  for(;;) {
+    uint16_t symbol = getSymbol(&r);
+    if(symbol == 256)
+      break;
+
+    if(symbol < 256) {
+      TEST_ASSERT_TRUE(pos < outSize);
+      out[pos++] = symbol;
+      continue;
+    }
+
+    symbol -= 257;
+    TEST_ASSERT_TRUE(symbol < 29);
+    uint16_t length = lengthBase[symbol] + getBits(&r, lengthExtra[symbol]);
+    uint16_t code = getReversed(&r, 5);
+    TEST_ASSERT_TRUE(code < 30);
+    uint16_t distance = distBase[code] + getBits(&r, distExtra[code]);
+
+    TEST_ASSERT_TRUE(distance <= pos);
+    TEST_ASSERT_TRUE(pos + length <= outSize);
+    for(uint16_t n=0;n<length;n++, pos++)
+      out[pos] = out[pos - distance];
+  }
+
+  // The block ends on a byte boundary, right before the trailer
+  TEST_ASSERT_EQUAL_size_t(len - GZIP_OVERHEAD, (r.pos + 7) / 8);
+  TEST_ASSERT_EQUAL_HEX32(gzipCrc32(out, pos), read32(&in[len - 8]));
+  TEST_ASSERT_EQUAL_UINT32(pos, read32(&in[len - 4]));
+
+  return pos;
+}
+
+static uint8_t input[GZIP_MAX_INPUT + 1];
+static uint8_t compressed[GZIP_MAX_INPUT * 2];
+static uint8_t inflated[GZIP_MAX_INPUT];
+
+static size_t roundTrip(size_t len) {
+  size_t zipped = gzipCompress(input, len, compressed, sizeof(compressed));
+  TEST_ASSERT_TRUE(zipped > 0);
+
+  size_t unzipped = gunzip(compressed, zipped, inflated, sizeof(inflated));
+  TEST_ASSERT_EQUAL_size_t(len, unzipped);
+  TEST_ASSERT_EQUAL_MEMORY(input, inflated, len);
+
+  return zipped;
+}
+
+// The standard check value
+void test_crc32(void) {
+  TEST_ASSERT_EQUAL_HEX32(0xcbf43926, gzipCrc32((const uint8_t *)"123456789", 9));
+  TEST_ASSERT_EQUAL_HEX32(0, gzipCrc32(NULL, 0));
+}
+
+void test_empty(void) {
+  TEST_ASSERT_EQUAL_size_t(GZIP_OVERHEAD + 2, roundTrip(0));
+}
+
+// Every line repeats the one before, so it should shrink a lot
+void test_line_protocol(void) {
+  size_t len = 0;
+  for(uint16_t n=0;n<100;n++) {
+    len += sprintf((char *)&input[len],
+      "station,topic=weather temperature=%u.%u,humidity=%u,pressure=101%03u,rain=0 %u000000000\n",
+      18 + n % 7, n % 10, 50 + n % 13, n * 7 % 1000, 1622505600 + n * 60);
+  }
+
+  size_t zipped = roundTrip(len);
+  TEST_ASSERT_TRUE(zipped < len / 3);
+}
+
+// Nothing to match, so every byte is a literal
+void test_random(void) {
+  uint32_t seed = 12345;
+  for(size_t n=0;n<4096;n++) {
+    seed = seed * 1103515245 + 12345;
+    input[n] = seed >> 16;
+  }
+
+  roundTrip(4096);
+}
+
+// Matches at the longest length and the furthest distance
+void test_long_matches(void) {
+  for(size_t n=0;n<GZIP_MAX_INPUT;n++)
+    input[n] = (n < 1000) ? n * 31 % 251 : input[n % 1000];
+
+  roundTrip(GZIP_MAX_INPUT);
+}
+
+void test_too_big(void) {
+  TEST_ASSERT_EQUAL_size_t(0, gzipCompress(input, GZIP_MAX_INPUT + 1, compressed, sizeof(compressed)));
+}
+
+void test_output_too_small(void) {
+  for(size_t n=0;n<200;n++)
+    input[n] = n;
+
+  TEST_ASSERT_EQUAL_size_t(0, gzipCompress(input, 200, compressed, 100));
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_crc32);
+  RUN_TEST(test_empty);
+  RUN_TEST(test_line_protocol);
+  RUN_TEST(test_random);
+  RUN_TEST(test_long_matches);
+  RUN_TEST(test_too_big);
+  RUN_TEST(test_output_too_small);
+  return UNITY_END();
+}
@@ -0,0 +1,254 @@
+/**
+ *  @filename   :   test_history.cpp    
+ *  @brief      :   ESP32 Weather Base Station history tests
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <Arduino.h>
+#include <SPIFFS.h>
+#include <unity.h>
+#include "weatherbase.h"
+#include "timekeeper.h"
+#include "history.h"
+#include "native_sim.h"
+
+#define HOUR_SECS 3600
+#define DAY_SECS 86400
+#define FILL_STEPS 30               // More fill queries than a year takes
+#define RAIN_WITHIN 0.0005
+
+static history_header_t header;
+static history_bucket_t hours[HISTORY_HOURS];
+static history_bucket_t days[HISTORY_DAYS];
+
+// 10:30 local on the first day
+static uint32_t day0;
+static uint32_t savedAt;
+
+static void setRain(history_bucket_t *ring, uint16_t size, uint32_t key, float sum) {
+  history_bucket_t *bucket = &ring[key % size];
+  bucket->key = key;
+  bucket->present |= 1 << HISTORY_RAIN;
+  bucket->min[HISTORY_RAIN] = 0.0;
+  bucket->max[HISTORY_RAIN] = sum;
+  bucket->sum[HISTORY_RAIN] = sum;
+}
+
+static void writeHistory(uint32_t coveredSince) {
+  header.version = HISTORY_VERSION;
+  header.coveredSince = coveredSince;
+  header.savedAt = savedAt;
+
+  File file = SPIFFS.open(HISTORY_FILE, FILE_WRITE);
+  file.write((const uint8_t *)&header, sizeof(header));
+  file.write((const uint8_t *)hours, sizeof(hours));
+  file.write((const uint8_t *)days, sizeof(days));
+  file.close();
+}
+
+static void writeCheckpoint(uint32_t fileSavedAt, float hourSum, float daySum) {
+  history_checkpoint_t checkpoint;
+  memset(&checkpoint, 0, sizeof(checkpoint));
+  checkpoint.version = HISTORY_VERSION;
+  checkpoint.savedAt = fileSavedAt;
+  checkpoint.hours[0] = {savedAt / HOUR_SECS, hourSum, 0.0, hourSum};
+  checkpoint.days[0] = {day0, daySum, 0.0, daySum};
+
+  File file = SPIFFS.open(HISTORY_RAIN_FILE, FILE_WRITE);
+  file.write((const uint8_t *)&checkpoint, sizeof(checkpoint));
+  file.close();
+}
+
+static void readHistory() {
+  File file = SPIFFS.open(HISTORY_FILE, FILE_READ);
+  TEST_ASSERT_TRUE((bool)file);
+  file.read((uint8_t *)&header, sizeof(header));
+  file.read((uint8_t *)hours, sizeof(hours));
+  file.read((uint8_t *)days, sizeof(days));
+  file.close();
+}
+
+// Boots at now with a rain sample in hand
+static void restart(uint32_t now, float rainCounts) {
+  simSetEpoch(now);
+  initHistory();
+
+  sensor_data_t data;
+  memset(&data, 0, sizeof(data));
+  data.temperature = 20.0;
+  data.pressure = 100000;
+  data.humidity = 50.0;
+  data.rain = rainCounts;
+  historyAddSample(&data, now);
+}
+
+static void fillAll() {
+  for(uint8_t n=0;n<FILL_STEPS;n++)
+    historyIdle();
+}
+
+static void assertTotal(float expected, uint16_t numDays) {
+  float total;
+  TEST_ASSERT_TRUE(historyTotal(HISTORY_RAIN, numDays, &total));
+  TEST_ASSERT_FLOAT_WITHIN(RAIN_WITHIN, expected, total);
+}
+
+// Restarted in the hour the file was saved in. The fill brings the whole
+// hour up to the restart, which already has the saved part in it.
+void test_boot_hour_overlap(void) {
+  uint32_t hour = savedAt / HOUR_SECS;
+  setRain(hours, HISTORY_HOURS, hour, 0.004);
+  setRain(days, HISTORY_DAYS, day0, 0.004);
+  writeHistory(timeDayStart(day0) - DAY_SECS);
+
+  restart(savedAt + 600, 1.0);
+  fillAll();
+
+  // The simulated InfluxDB has 0.01 in every hour
+  float expected = 0.01 + rainInches(1.0);
+  assertTotal(expected, 0);
+  assertTotal(expected, 1);
+}
+
+// Down for over HISTORY_HOURS, so the saved hour has left the ring by the
+// time the fill reaches it, but its day still has the saved part
+void test_long_outage(void) {
+  uint32_t hour = savedAt / HOUR_SECS;
+  setRain(hours, HISTORY_HOURS, hour - 2, 0.02);
+  setRain(hours, HISTORY_HOURS, hour - 1, 0.03);
+  setRain(hours, HISTORY_HOURS, hour, 0.004);
+  setRain(days, HISTORY_DAYS, day0, 0.054);
+  writeHistory(timeDayStart(day0));
+  writeCheckpoint(savedAt, 0.006, 0.056);
+
+  restart(savedAt + 50 * HOUR_SECS, 2.0);
+  fillAll();
+
+  // 8:00 and 9:00 saved, 10:00 to midnight filled, then a day filled and
+  // 13 hours and the live sample
+  float day0Total = 0.02 + 0.03 + 14 * 0.01;
+  float today = 13 * 0.01 + rainInches(2.0);
+  assertTotal(day0Total + 24 * 0.01 + today, 3);
+  assertTotal(24 * 0.01 + rainInches(2.0), 0);
+}
+
+// Left to InfluxDB until the fill covers the day, then every sample counts
+void test_extremes(void) {
+  writeHistory(timeDayStart(day0));
+
+  restart(savedAt + 600, 0.0);
+  float high, low;
+  TEST_ASSERT_FALSE(historyExtremes(HISTORY_TEMP, 0, &high, &low));
+
+  fillAll();
+  sensor_data_t data;
+  memset(&data, 0, sizeof(data));
+  data.temperature = 60.0;
+  historyAddSample(&data, savedAt + 660);
+
+  TEST_ASSERT_TRUE(historyExtremes(HISTORY_TEMP, 0, &high, &low));
+  TEST_ASSERT_FLOAT_WITHIN(0.01, 140.0, high);
+  TEST_ASSERT_TRUE(low < high);
+  TEST_ASSERT_TRUE(historyCovers(HISTORY_TEMP, 7));
+}
+
+// The checkpoint replaces the rain of the file it was taken on top of
+void test_checkpoint_restored(void) {
+  uint32_t hour = savedAt / HOUR_SECS;
+  setRain(hours, HISTORY_HOURS, hour, 0.004);
+  setRain(days, HISTORY_DAYS, day0, 0.004);
+  writeHistory(timeDayStart(day0));
+  writeCheckpoint(savedAt, 0.006, 0.007);
+
+  // A sample in the next hour makes the next historyLoop() save the file
+  restart(savedAt + HOUR_SECS, 0.0);
+  historyLoop();
+  readHistory();
+  TEST_ASSERT_EQUAL_UINT32(hour, hours[hour % HISTORY_HOURS].key);
+  TEST_ASSERT_FLOAT_WITHIN(0.00001, 0.006, hours[hour % HISTORY_HOURS].sum[HISTORY_RAIN]);
+  TEST_ASSERT_FLOAT_WITHIN(0.00001, 0.007, days[day0 % HISTORY_DAYS].sum[HISTORY_RAIN]);
+}
+
+// One taken on top of an older file is left out
+void test_stale_checkpoint(void) {
+  uint32_t hour = savedAt / HOUR_SECS;
+  setRain(hours, HISTORY_HOURS, hour, 0.004);
+  setRain(days, HISTORY_DAYS, day0, 0.004);
+  writeHistory(timeDayStart(day0));
+  writeCheckpoint(savedAt - HOUR_SECS, 0.006, 0.007);
+
+  restart(savedAt + HOUR_SECS, 0.0);
+  historyLoop();
+  readHistory();
+  TEST_ASSERT_FLOAT_WITHIN(0.00001, 0.004, hours[hour % HISTORY_HOURS].sum[HISTORY_RAIN]);
+  TEST_ASSERT_FLOAT_WITHIN(0.00001, 0.004, days[day0 % HISTORY_DAYS].sum[HISTORY_RAIN]);
+}
+
+// Full saves and rain checkpoints are each counted once
+void test_save_counts(void) {
+  writeHistory(timeDayStart(day0));
+
+  uint32_t now = savedAt + HOUR_SECS;
+  restart(now, 1.0);
+  historyLoop();
+
+  history_stats_t stats;
+  getHistoryStats(&stats);
+  TEST_ASSERT_EQUAL_UINT32(1, stats.saves);
+  TEST_ASSERT_EQUAL_UINT32(0, stats.rainSaves);
+
+  // Still raining, but still the same hour
+  simSetEpoch(now + HISTORY_RAIN_SAVE_SECS);
+  sensor_data_t data;
+  memset(&data, 0, sizeof(data));
+  data.rain = 1.0;
+  historyAddSample(&data, now + HISTORY_RAIN_SAVE_SECS);
+  historyLoop();
+
+  getHistoryStats(&stats);
+  TEST_ASSERT_EQUAL_UINT32(1, stats.saves);
+  TEST_ASSERT_EQUAL_UINT32(1, stats.rainSaves);
+}
+
+// Every test starts from an empty file and no checkpoint
+void setUp(void) {
+  memset(&header, 0, sizeof(header));
+  memset(hours, 0, sizeof(hours));
+  memset(days, 0, sizeof(days));
+  SPIFFS.remove(HISTORY_FILE);
+  SPIFFS.remove(HISTORY_RAIN_FILE);
+}
+
+void tearDown(void) {}
+
+int main(int argc, char **argv) {
+  simSetNetworkUp(1);
+  day0 = timeLocalDay(1600000000);
+  savedAt = timeDayStart(day0) + 10 * HOUR_SECS + 1800;
+
+  UNITY_BEGIN();
+  RUN_TEST(test_boot_hour_overlap);
+  RUN_TEST(test_long_outage);
+  RUN_TEST(test_extremes);
+  RUN_TEST(test_checkpoint_restored);
+  RUN_TEST(test_stale_checkpoint);
+  RUN_TEST(test_save_counts);
+  return UNITY_END();
+}
@@ -0,0 +1,187 @@
+/**
+ *  @filename   :   test_influxqueries.cpp
+ *  @brief      :   ESP32 Weather Base Station InfluxDB query plan and cache tests
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include "InfluxDbQueries.h"
+#include "timekeeper.h"
+#include "native_sim.h"
+
+#define START_TIME 1600000000
+#define DAY_SECS 86400
+
+// What the simulated InfluxDB answers
+#define TEMP_HIGH 28.5
+#define TEMP_LOW 12.5
+#define HUM_HIGH 81.0
+#define HUM_LOW 34.0
+#define PRESS_HIGH 30.12
+#define PRESS_LOW 29.71
+#define RAIN_SUM 0.12
+
+static query_cache_stats_t stats;
+
+static uint8_t doneCalls;
+static int doneRc;
+
+static void done(void *context, int rc) {
+  doneCalls++;
+  doneRc = rc;
+  (*(uint8_t *)context)++;
+}
+
+static void assertPeek(uint8_t expected, uint8_t query, bool indoor, uint16_t period, float high, float low) {
+  float peekHigh = 0.0, peekLow = 0.0;
+  TEST_ASSERT_EQUAL_UINT8(expected, influxPeek(query, indoor, period, &peekHigh, &peekLow));
+  TEST_ASSERT_FLOAT_WITHIN(0.001, high, peekHigh);
+  TEST_ASSERT_FLOAT_WITHIN(0.001, low, peekLow);
+}
+
+// Everything added goes out as one request
+void test_plan_one_request(void) {
+  getQueryCacheStats(&stats);
+  uint32_t requests = stats.requests;
+  uint32_t statements = stats.statements;
+
+  TEST_ASSERT_TRUE(influxPlanAdd(QUERY_TEMP, false, 0));
+  TEST_ASSERT_TRUE(influxPlanAdd(QUERY_HUM, true, 0));
+  TEST_ASSERT_TRUE(influxPlanAdd(QUERY_RAIN, false, 7));
+  TEST_ASSERT_TRUE(influxPlanAdd(QUERY_TEMP, false, 0));     // Already in the plan
+  TEST_ASSERT_EQUAL_INT32(200, influxPlanRun());
+
+  getQueryCacheStats(&stats);
+  TEST_ASSERT_EQUAL_UINT32(requests + 1, stats.requests);
+  TEST_ASSERT_EQUAL_UINT32(statements + 6, stats.statements);
+
+  assertPeek(QUERY_FRESH, QUERY_TEMP, false, 0, TEMP_HIGH, TEMP_LOW);
+  assertPeek(QUERY_FRESH, QUERY_HUM, true, 0, HUM_HIGH, HUM_LOW);
+  // The week is the last 24 hours plus the days before, and brings the day
+  assertPeek(QUERY_FRESH, QUERY_RAIN, false, 7, 2 * RAIN_SUM, 2 * RAIN_SUM);
+  assertPeek(QUERY_FRESH, QUERY_RAIN, false, 1, RAIN_SUM, RAIN_SUM);
+}
+
+// A fresh answer is never asked for again
+void test_cache_hit(void) {
+  float high, low;
+  TEST_ASSERT_EQUAL_UINT8(0, influxGetDailyHighLowTemp(false, &high, &low));
+  getQueryCacheStats(&stats);
+  uint32_t requests = stats.requests;
+
+  TEST_ASSERT_EQUAL_UINT8(0, influxGetDailyHighLowTemp(false, &high, &low));
+  TEST_ASSERT_FLOAT_WITHIN(0.001, TEMP_HIGH, high);
+  TEST_ASSERT_FLOAT_WITHIN(0.001, TEMP_LOW, low);
+  TEST_ASSERT_TRUE(influxPlanAdd(QUERY_TEMP, false, 0));
+  TEST_ASSERT_EQUAL_INT32(200, influxPlanRun());
+
+  getQueryCacheStats(&stats);
+  TEST_ASSERT_EQUAL_UINT32(requests, stats.requests);
+  TEST_ASSERT_TRUE(stats.hits > 0);
+}
+
+// Past its TTL, and at midnight, an answer is stale but still given
+void test_ttl_and_midnight(void) {
+  TEST_ASSERT_EQUAL_INT32(200, (influxPlanAdd(QUERY_PRESS, false, 7), influxPlanRun()));
+
+  simAdvance((uint64_t)QUERY_TTL_DAILY_MS * 1000);
+  assertPeek(QUERY_STALE, QUERY_TEMP, false, 0, TEMP_HIGH, TEMP_LOW);
+  assertPeek(QUERY_FRESH, QUERY_PRESS, false, 7, PRESS_HIGH, PRESS_LOW);
+
+  simSetEpoch(timeDayStart(timeLocalDay(timeNow()) + 1));
+  assertPeek(QUERY_STALE, QUERY_PRESS, false, 7, PRESS_HIGH, PRESS_LOW);
+  assertPeek(QUERY_MISSING, QUERY_PRESS, false, 30, 0.0, 0.0);
+}
+
+// Called back from influxQueryLoop() once the answer is in
+void test_request_callback(void) {
+  uint8_t calls = 0;
+  doneCalls = 0;
+  TEST_ASSERT_TRUE(influxRequest(QUERY_PRESS, false, 30, done, &calls));
+  TEST_ASSERT_TRUE(influxRequest(QUERY_PRESS, false, 30, done, &calls));
+  TEST_ASSERT_EQUAL_UINT8(0, calls);
+
+  influxQueryLoop();
+  influxQueryLoop();
+  TEST_ASSERT_EQUAL_UINT8(1, calls);
+  TEST_ASSERT_EQUAL_INT32(200, doneRc);
+  assertPeek(QUERY_FRESH, QUERY_PRESS, false, 30, PRESS_HIGH, PRESS_LOW);
+}
+
+// After a failure nothing is sent for QUERY_FAIL_HOLD_MS. Two weeks is not a
+// period the prefetch asks for.
+void test_failure_hold(void) {
+  simSetNetworkUp(0);
+  influxPlanAdd(QUERY_HUM, false, 14);
+  TEST_ASSERT_TRUE(influxPlanRun() != 200);
+
+  getQueryCacheStats(&stats);
+  uint32_t requests = stats.requests;
+  influxPlanAdd(QUERY_HUM, false, 14);
+  TEST_ASSERT_TRUE(influxPlanRun() != 200);
+  getQueryCacheStats(&stats);
+  TEST_ASSERT_EQUAL_UINT32(requests, stats.requests);
+
+  simSetNetworkUp(1);
+  simAdvance((uint64_t)QUERY_FAIL_HOLD_MS * 1000);
+  influxPlanAdd(QUERY_HUM, false, 14);
+  TEST_ASSERT_EQUAL_INT32(200, influxPlanRun());
+  assertPeek(QUERY_FRESH, QUERY_HUM, false, 14, HUM_HIGH, HUM_LOW);
+}
+
+// Idle loops fetch every period a panel can be switched to
+void test_prefetch(void) {
+  simAdvance((uint64_t)QUERY_PREFETCH_MS * 1000);
+  getQueryCacheStats(&stats);
+  uint32_t prefetched = stats.prefetched;
+
+  for(uint8_t n=0;n<8;n++)
+    influxQueryLoop();
+
+  getQueryCacheStats(&stats);
+  TEST_ASSERT_TRUE(stats.prefetched > prefetched);
+  assertPeek(QUERY_FRESH, QUERY_TEMP, true, 365, TEMP_HIGH, TEMP_LOW);
+  assertPeek(QUERY_FRESH, QUERY_HUM, false, 7, HUM_HIGH, HUM_LOW);
+  assertPeek(QUERY_FRESH, QUERY_PRESS, false, 365, PRESS_HIGH, PRESS_LOW);
+
+  // Nothing more until QUERY_PREFETCH_MS has passed
+  uint32_t requests = stats.requests;
+  influxQueryLoop();
+  getQueryCacheStats(&stats);
+  TEST_ASSERT_EQUAL_UINT32(requests, stats.requests);
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+int main(int argc, char **argv) {
+  simSetNetworkUp(1);
+  simSetEpoch(START_TIME);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_plan_one_request);
+  RUN_TEST(test_cache_hit);
+  RUN_TEST(test_ttl_and_midnight);
+  RUN_TEST(test_request_callback);
+  RUN_TEST(test_failure_hold);
+  RUN_TEST(test_prefetch);
+  return UNITY_END();
+}
@@ -0,0 +1,202 @@
+/**
+ *  @filename   :   test_influxresult.cpp
+ *  @brief      :   ESP32 Weather Base Station InfluxDB result reader tests
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include "influxresult.h"
+
+// A byte at a time, the way HTTPClient::writeToStream() can hand it over
+static bool feed(InfluxResultReader *reader, const char *response) {
+  for(size_t n=0;response[n]!='\0';n++)
+    reader->write((uint8_t)response[n]);
+  return reader->finish();
+}
+
+static const char *twoStatements =
+  "{\"results\":["
+    "{\"statement_id\":0,\"series\":[{\"name\":\"station\",\"columns\":[\"time\",\"max\"],"
+      "\"values\":[[\"2021-06-01T00:00:00Z\",23.5]]}]},"
+    "{\"statement_id\":1,\"series\":[{\"name\":\"station\",\"columns\":[\"time\",\"min\"],"
+      "\"values\":[[\"2021-06-01T00:00:00Z\",-4.25]]}]}"
+  "]}";
+
+void test_json_values(void) {
+  float values[2];
+  InfluxResultReader reader(values, 2, false);
+
+  TEST_ASSERT_TRUE(feed(&reader, twoStatements));
+  TEST_ASSERT_EQUAL_UINT8(2, reader.found());
+  TEST_ASSERT_EQUAL_UINT8(0, reader.errors());
+  TEST_ASSERT_EQUAL_FLOAT(23.5, values[0]);
+  TEST_ASSERT_EQUAL_FLOAT(-4.25, values[1]);
+}
+
+void test_json_in_one_write(void) {
+  float values[2];
+  InfluxResultReader reader(values, 2, false);
+
+  reader.write((const uint8_t *)twoStatements, strlen(twoStatements));
+  TEST_ASSERT_TRUE(reader.finish());
+  TEST_ASSERT_EQUAL_FLOAT(-4.25, values[1]);
+}
+
+// No series keeps the 0 it starts with, and so does null
+void test_json_empty_statements(void) {
+  float values[3] = {9.0, 9.0, 9.0};
+  InfluxResultReader reader(values, 3, false);
+
+  TEST_ASSERT_TRUE(feed(&reader,
+    "{\"results\":[{\"statement_id\":0},"
+    "{\"statement_id\":1,\"series\":[{\"name\":\"s\",\"columns\":[\"time\",\"sum\"],\"values\":[[0,7]]}]},"
+    "{\"statement_id\":2,\"series\":[{\"name\":\"s\",\"columns\":[\"time\",\"sum\"],\"values\":[[0,null]]}]}]}"));
+  TEST_ASSERT_EQUAL_UINT8(1, reader.found());
+  TEST_ASSERT_EQUAL_FLOAT(0.0, values[0]);
+  TEST_ASSERT_EQUAL_FLOAT(7.0, values[1]);
+  TEST_ASSERT_EQUAL_FLOAT(0.0, values[2]);
+}
+
+// Only values[0][1] of the first series counts
+void test_json_ignores_the_rest(void) {
+  float values[1];
+  InfluxResultReader reader(values, 1, false);
+
+  TEST_ASSERT_TRUE(feed(&reader,
+    "{\"results\":[{\"statement_id\":0,\"series\":["
+    "{\"name\":\"s\",\"tags\":{\"values\":[1,2]},\"columns\":[\"time\",\"max\",\"x\"],\"values\":[[0,1.5,99],[60,2.5,98]]},"
+    "{\"name\":\"t\",\"columns\":[\"time\",\"max\"],\"values\":[[0,3.5]]}]}]}"));
+  TEST_ASSERT_EQUAL_UINT8(1, reader.found());
+  TEST_ASSERT_EQUAL_FLOAT(1.5, values[0]);
+}
+
+void test_json_statement_error(void) {
+  float values[2];
+  InfluxResultReader reader(values, 2, false);
+
+  TEST_ASSERT_TRUE(feed(&reader,
+    "{\"results\":[{\"statement_id\":0,\"error\":\"query timeout\"},"
+    "{\"statement_id\":1,\"series\":[{\"name\":\"s\",\"columns\":[\"time\",\"max\"],\"values\":[[0,4]]}]}]}"));
+  TEST_ASSERT_EQUAL_UINT8(1, reader.errors());
+  TEST_ASSERT_EQUAL_UINT8(1, reader.found());
+}
+
+void test_json_request_error(void) {
+  float values[1];
+  InfluxResultReader reader(values, 1, false);
+
+  TEST_ASSERT_TRUE(feed(&reader, "{\"error\":\"error parsing query: found EOF\"}"));
+  TEST_ASSERT_EQUAL_UINT8(1, reader.errors());
+  TEST_ASSERT_EQUAL_UINT8(0, reader.found());
+}
+
+// A string that only looks like an error is not one
+void test_json_error_in_a_value(void) {
+  float values[1];
+  InfluxResultReader reader(values, 1, false);
+
+  TEST_ASSERT_TRUE(feed(&reader,
+    "{\"results\":[{\"statement_id\":0,\"series\":[{\"name\":\"error\",\"columns\":[\"time\",\"error\"],\"values\":[[0,5]]}]}]}"));
+  TEST_ASSERT_EQUAL_UINT8(0, reader.errors());
+  TEST_ASSERT_EQUAL_FLOAT(5.0, values[0]);
+}
+
+void test_json_truncated(void) {
+  float values[2];
+  InfluxResultReader reader(values, 2, false);
+
+  char truncated[200];
+  strncpy(truncated, twoStatements, 120);
+  truncated[120] = '\0';
+  TEST_ASSERT_FALSE(feed(&reader, truncated));
+}
+
+void test_json_mismatched(void) {
+  float values[1];
+  InfluxResultReader reader(values, 1, false);
+
+  TEST_ASSERT_FALSE(feed(&reader, "{\"results\":[}"));
+}
+
+// Statements with no series are left out, so the rows say which they answer
+void test_csv_values(void) {
+  float values[3] = {9.0, 9.0, 9.0};
+  InfluxResultReader reader(values, 3, true);
+
+  TEST_ASSERT_TRUE(feed(&reader,
+    "name,tags,time,r0\r\nstation,,1622505600000000000,23.5\r\n\r\n"
+    "name,tags,time,r2\r\nstation,,1622505600000000000,-4.25\r\n"));
+  TEST_ASSERT_EQUAL_UINT8(2, reader.found());
+  TEST_ASSERT_EQUAL_FLOAT(23.5, values[0]);
+  TEST_ASSERT_EQUAL_FLOAT(0.0, values[1]);
+  TEST_ASSERT_EQUAL_FLOAT(-4.25, values[2]);
+}
+
+void test_csv_no_final_newline(void) {
+  float values[1];
+  InfluxResultReader reader(values, 1, true);
+
+  TEST_ASSERT_TRUE(feed(&reader, "name,tags,time,r0\nstation,,0,1.25"));
+  TEST_ASSERT_EQUAL_FLOAT(1.25, values[0]);
+}
+
+void test_csv_out_of_range(void) {
+  float values[1];
+  InfluxResultReader reader(values, 1, true);
+
+  TEST_ASSERT_TRUE(feed(&reader, "name,tags,time,r5\nstation,,0,3\n\nname,tags,time,max\nstation,,0,4\n"));
+  TEST_ASSERT_EQUAL_UINT8(0, reader.found());
+  TEST_ASSERT_EQUAL_FLOAT(0.0, values[0]);
+}
+
+void test_csv_statement_error(void) {
+  float values[2];
+  InfluxResultReader reader(values, 2, true);
+
+  TEST_ASSERT_TRUE(feed(&reader,
+    "error\n\"max-select-series limit exceeded: (1001/1000)\"\n\n"
+    "name,tags,time,r1\nstation,,0,4\n"));
+  TEST_ASSERT_EQUAL_UINT8(1, reader.errors());
+  TEST_ASSERT_EQUAL_UINT8(1, reader.found());
+  TEST_ASSERT_EQUAL_FLOAT(0.0, values[0]);
+  TEST_ASSERT_EQUAL_FLOAT(4.0, values[1]);
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_json_values);
+  RUN_TEST(test_json_in_one_write);
+  RUN_TEST(test_json_empty_statements);
+  RUN_TEST(test_json_ignores_the_rest);
+  RUN_TEST(test_json_statement_error);
+  RUN_TEST(test_json_request_error);
+  RUN_TEST(test_json_error_in_a_value);
+  RUN_TEST(test_json_truncated);
+  RUN_TEST(test_json_mismatched);
+  RUN_TEST(test_csv_values);
+  RUN_TEST(test_csv_no_final_newline);
+  RUN_TEST(test_csv_out_of_range);
+  RUN_TEST(test_csv_statement_error);
+  return UNITY_END();
+}
@@ -0,0 +1,103 @@
+/**
+ *  @filename   :   test_influxwriter.cpp
+ *  @brief      :   ESP32 Weather Base Station InfluxDB line protocol tests
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <Arduino.h>
+#include <math.h>
+#include <unity.h>
+#include "weatherbase.h"
+#include "influxwriter.h"
+
+#define SAMPLE_TIME 1600000000
+
+static char line[INFLUX_LINE_LENGTH + 1];
+
+static sensor_data_t sample() {
+  sensor_data_t data;
+  data.wakeup_reason = 4;
+  data.temperature = 18.0;
+  data.pressure = 100000;
+  data.humidity = 55.5;
+  data.battery_millivolts = 3712.0;
+  data.direction = 270;
+  data.wind_speed = 1.25;
+  data.rain = 3.0;
+  return data;
+}
+
+static void sampleLine(const char *topic, bool primary, time_t sampleTime, const sensor_data_t *data) {
+  uint16_t len = influxLineSample(line, topic, primary, sampleTime, data);
+  line[len] = '\0';
+}
+
+// The fields, names and units the bridge writes and the queries read
+void test_sample_schema(void) {
+  sensor_data_t data = sample();
+  sampleLine("weather/station", true, SAMPLE_TIME, &data);
+
+  char expected[INFLUX_LINE_LENGTH];
+  snprintf(expected, sizeof(expected), "station,topic=weather/station wakeup_reason=4,temperature=64.4,pressure=100000,"
+    "pressureHg=%.3f,humidity=55.5,battery=3712.0,direction=270,anemometer=1.25,rain=0.033 1600000000\n", seaLevelInHg(100000));
+  TEST_ASSERT_EQUAL_STRING(expected, line);
+}
+
+// Only the primary goes where the queries look
+void test_other_station(void) {
+  sensor_data_t data = sample();
+  sampleLine("weather/station/24:0a", false, SAMPLE_TIME, &data);
+
+  const char *start = INFLUX_OTHER_MEASUREMENT ",topic=weather/station/24:0a wakeup_reason=4,temperature=64.4,";
+  TEST_ASSERT_EQUAL_INT32(0, strncmp(line, start, strlen(start)));
+}
+
+void test_room_schema(void) {
+  uint16_t len = influxLineRoom(line, "weather", SAMPLE_TIME, 21.0, 40.2);
+  line[len] = '\0';
+  TEST_ASSERT_EQUAL_STRING("station,topic=weather room_temp=69.8,room_hum=40.2 1600000000\n", line);
+
+  // Out of range readings from the sensor are left out
+  TEST_ASSERT_EQUAL_UINT16(0, influxLineRoom(line, "weather", SAMPLE_TIME, 0.0, 40.0));
+}
+
+// Tags escaped, no number is left out, no time before the clock is set
+void test_escapes_and_gaps(void) {
+  sensor_data_t data = sample();
+  data.humidity = NAN;
+  sampleLine("a b,c=d", true, 1000, &data);
+
+  const char *start = "station,topic=a\\ b\\,c\\=d wakeup_reason=4,";
+  TEST_ASSERT_EQUAL_INT32(0, strncmp(line, start, strlen(start)));
+  TEST_ASSERT_NULL(strstr(line, "humidity"));
+  TEST_ASSERT_EQUAL_STRING("rain=0.033\n", strstr(line, "rain="));
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_sample_schema);
+  RUN_TEST(test_other_station);
+  RUN_TEST(test_room_schema);
+  RUN_TEST(test_escapes_and_gaps);
+  return UNITY_END();
+}
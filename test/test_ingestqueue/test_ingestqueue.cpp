@@ -0,0 +1,138 @@
+/**
+ *  @filename   :   test_ingestqueue.cpp
+ *  @brief      :   ESP32 Weather Base Station ingest ring tests
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include "ingestqueue.h"
+#include "native_sim.h"
+
+static const uint8_t mac[6] = {0x24, 0x0a, 0xc4, 0x00, 0x30, 0x01};
+
+static void drain() {
+  while(ingestPeek() != NULL)
+    ingestRelease();
+}
+
+static bool pushByte(uint8_t value, int len) {
+  uint8_t data[INGEST_MAX_FRAME + 1];
+  memset(data, value, sizeof(data));
+  return ingestPush(mac, data, len);
+}
+
+void test_empty(void) {
+  TEST_ASSERT_NULL(ingestPeek());
+  // Releasing nothing leaves it empty
+  ingestRelease();
+  TEST_ASSERT_NULL(ingestPeek());
+}
+
+void test_frame_copied(void) {
+  uint8_t data[3] = {1, 2, 3};
+  TEST_ASSERT_TRUE(ingestPush(mac, data, sizeof(data)));
+  data[0] = 9;
+
+  ingest_frame_t *frame = ingestPeek();
+  TEST_ASSERT_NOT_NULL(frame);
+  TEST_ASSERT_EQUAL_MEMORY(mac, frame->mac, 6);
+  TEST_ASSERT_EQUAL_UINT8(3, frame->len);
+  TEST_ASSERT_EQUAL_UINT8(1, frame->data[0]);
+  TEST_ASSERT_EQUAL_INT64(simEpochMicros(), frame->rxMicros);
+
+  // Peeking again hands back the same slot until it is released
+  TEST_ASSERT_EQUAL_PTR(frame, ingestPeek());
+  ingestRelease();
+  TEST_ASSERT_NULL(ingestPeek());
+}
+
+void test_fifo_order(void) {
+  for(uint8_t n=0;n<5;n++)
+    TEST_ASSERT_TRUE(pushByte(n, 1));
+
+  for(uint8_t n=0;n<5;n++) {
+    ingest_frame_t *frame = ingestPeek();
+    TEST_ASSERT_NOT_NULL(frame);
+    TEST_ASSERT_EQUAL_UINT8(n, frame->data[0]);
+    ingestRelease();
+  }
+  TEST_ASSERT_NULL(ingestPeek());
+}
+
+// A full ring drops the new frame and keeps the ones it has
+void test_full(void) {
+  ingest_stats_t before, after;
+  ingestGetStats(&before);
+
+  for(uint8_t n=0;n<INGEST_QUEUE_DEPTH;n++)
+    TEST_ASSERT_TRUE(pushByte(n, 1));
+  TEST_ASSERT_FALSE(pushByte(0xff, 1));
+
+  ingestGetStats(&after);
+  TEST_ASSERT_EQUAL_UINT32(before.received + INGEST_QUEUE_DEPTH + 1, after.received);
+  TEST_ASSERT_EQUAL_UINT32(before.dropped + 1, after.dropped);
+  TEST_ASSERT_EQUAL_UINT16(INGEST_QUEUE_DEPTH, after.depth);
+  TEST_ASSERT_EQUAL_UINT16(INGEST_QUEUE_DEPTH, after.highWater);
+  TEST_ASSERT_EQUAL_UINT8(0, ingestPeek()->data[0]);
+}
+
+void test_bad_length(void) {
+  ingest_stats_t before, after;
+  ingestGetStats(&before);
+
+  TEST_ASSERT_FALSE(pushByte(1, 0));
+  TEST_ASSERT_FALSE(pushByte(1, INGEST_MAX_FRAME + 1));
+  TEST_ASSERT_TRUE(pushByte(1, INGEST_MAX_FRAME));
+
+  ingestGetStats(&after);
+  TEST_ASSERT_EQUAL_UINT32(before.dropped + 2, after.dropped);
+  TEST_ASSERT_EQUAL_UINT8(INGEST_MAX_FRAME, ingestPeek()->len);
+}
+
+// Arrival to release, on the monotonic clock
+void test_latency(void) {
+  TEST_ASSERT_TRUE(pushByte(1, 1));
+  simAdvance(5000);
+  ingestRelease();
+
+  ingest_stats_t stats;
+  ingestGetStats(&stats);
+  TEST_ASSERT_EQUAL_UINT32(5000, stats.latencyMax);
+  TEST_ASSERT_TRUE(stats.latencyP99 <= stats.latencyMax);
+  TEST_ASSERT_EQUAL_UINT16(0, stats.depth);
+}
+
+void setUp(void) {
+  drain();
+}
+
+void tearDown(void) {}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_empty);
+  RUN_TEST(test_frame_copied);
+  RUN_TEST(test_fifo_order);
+  RUN_TEST(test_full);
+  RUN_TEST(test_bad_length);
+  RUN_TEST(test_latency);
+  return UNITY_END();
+}
@@ -0,0 +1,172 @@
+/**
+ *  @filename   :   test_jsonwriter.cpp
+ *  @brief      :   ESP32 Weather Base Station JSON writer tests
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <Arduino.h>
+#include <math.h>
+#include <float.h>
+#include <unity.h>
+#include "jsonwriter.h"
+
+static const json_field_t readingFields[] = {
+  JSON_INTEGER(reason),
+  JSON_UNSIGNED(time),
+  JSON_FIXED(temperature, 1),
+  JSON_FIXED(rain, 3),
+  JSON_TEXT(host, 16)
+};
+static const json_schema_t readingSchema = JSON_SCHEMA(readingFields);
+
+// Keeps everything it is given, and how many writes it took
+class CapturePrint : public Print {
+  public:
+    CapturePrint() : used(0), writes(0) { text[0] = '\0'; }
+
+    size_t write(uint8_t c) { return write(&c, 1); }
+    size_t write(const uint8_t *data, size_t size) {
+      memcpy(&text[used], data, size);
+      used += size;
+      text[used] = '\0';
+      writes++;
+      return size;
+    }
+
+    char text[1024];
+    size_t used;
+    uint16_t writes;
+};
+
+static void assertFixed(const char *expected, float value, uint8_t decimals) {
+  char buffer[JSON_NUMBER_LENGTH + 1];
+  uint8_t len = jsonFormatFixed(buffer, value, decimals);
+  buffer[len] = '\0';
+  TEST_ASSERT_EQUAL_STRING(expected, buffer);
+}
+
+static void assertInteger(const char *expected, int64_t value) {
+  char buffer[JSON_NUMBER_LENGTH + 1];
+  uint8_t len = jsonFormatInteger(buffer, value);
+  buffer[len] = '\0';
+  TEST_ASSERT_EQUAL_STRING(expected, buffer);
+}
+
+void test_integers(void) {
+  assertInteger("0", 0);
+  assertInteger("42", 42);
+  assertInteger("-7", -7);
+  assertInteger("4294967295", UINT32_MAX);
+  assertInteger("-9223372036854775808", INT64_MIN);
+}
+
+void test_fixed(void) {
+  assertFixed("21.46", 21.456, 2);
+  assertFixed("-3.2", -3.2, 1);
+  assertFixed("0.00", 0.004, 2);
+  assertFixed("0.00", -0.004, 2);     // No negative zero
+  assertFixed("101325", 101325.0, 0);
+  assertFixed("0.123457", 0.1234567, 9);
+  assertFixed("null", NAN, 2);
+  assertFixed("null", INFINITY, 2);
+}
+
+// Too big to scale into a uint64_t, so the exponent form
+void test_fixed_overflow(void) {
+  assertFixed("999999986991104.000", 1e15, 3);
+  assertFixed("9.99999998e+18", 1e19, 0);
+  assertFixed("-1.00000003e+16", -1e16, 3);
+  assertFixed("3.40282347e+38", FLT_MAX, 6);
+  assertFixed("-3.40282347e+38", -FLT_MAX, 6);
+}
+
+void test_object(void) {
+  json_value_t values[] = {jsonInt(-1), jsonUint(1622505600), jsonFloat(18.25), jsonFloat(0.011), jsonString("base")};
+  char buffer[128];
+
+  uint16_t len = jsonRender(buffer, sizeof(buffer), &readingSchema, values);
+  TEST_ASSERT_EQUAL_STRING("{\"reason\":-1,\"time\":1622505600,\"temperature\":18.3,\"rain\":0.011,\"host\":\"base\"}", buffer);
+  TEST_ASSERT_EQUAL_UINT16(strlen(buffer), len);
+  TEST_ASSERT_EQUAL_UINT16(len, jsonLength(&readingSchema, values));
+}
+
+void test_string_escapes(void) {
+  static const json_field_t fields[] = {JSON_TEXT(s, 40)};
+  static const json_schema_t schema = JSON_SCHEMA(fields);
+  json_value_t values[] = {jsonString("a\"b\\c\nd")};
+  char buffer[64];
+
+  jsonRender(buffer, sizeof(buffer), &schema, values);
+  TEST_ASSERT_EQUAL_STRING("{\"s\":\"a\\\"b\\\\c\\u000ad\"}", buffer);
+  TEST_ASSERT_EQUAL_UINT16(strlen(buffer), jsonLength(&schema, values));
+}
+
+// Strings stop at the schema's length, and NULL is empty
+void test_string_limits(void) {
+  static const json_field_t fields[] = {JSON_TEXT(s, 4), JSON_TEXT(t, 4)};
+  static const json_schema_t schema = JSON_SCHEMA(fields);
+  json_value_t values[] = {jsonString("abcdefgh"), jsonString(NULL)};
+  char buffer[64];
+
+  jsonRender(buffer, sizeof(buffer), &schema, values);
+  TEST_ASSERT_EQUAL_STRING("{\"s\":\"abcd\",\"t\":\"\"}", buffer);
+}
+
+void test_render_too_small(void) {
+  json_value_t values[] = {jsonInt(1), jsonUint(2), jsonFloat(3.0), jsonFloat(4.0), jsonString("x")};
+  uint16_t len = jsonLength(&readingSchema, values);
+  char buffer[128];
+
+  // Room for the terminator as well
+  TEST_ASSERT_EQUAL_UINT16(0, jsonRender(buffer, len, &readingSchema, values));
+  TEST_ASSERT_EQUAL_UINT16(len, jsonRender(buffer, len + 1, &readingSchema, values));
+}
+
+// Streamed in chunks, and exactly jsonLength() bytes
+void test_write_chunks(void) {
+  static const json_field_t fields[] = {JSON_TEXT(a, 60), JSON_TEXT(b, 60), JSON_TEXT(c, 60)};
+  static const json_schema_t schema = JSON_SCHEMA(fields);
+  const char *text = "0123456789012345678901234567890123456789012345678901234567890";
+  json_value_t values[] = {jsonString(text), jsonString(text), jsonString(text)};
+
+  CapturePrint out;
+  jsonWrite(out, &schema, values);
+
+  TEST_ASSERT_EQUAL_size_t(jsonLength(&schema, values), out.used);
+  TEST_ASSERT_TRUE(out.writes > 1);
+  TEST_ASSERT_EQUAL_UINT8('{', out.text[0]);
+  TEST_ASSERT_EQUAL_UINT8('}', out.text[out.used - 1]);
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_integers);
+  RUN_TEST(test_fixed);
+  RUN_TEST(test_fixed_overflow);
+  RUN_TEST(test_object);
+  RUN_TEST(test_string_escapes);
+  RUN_TEST(test_string_limits);
+  RUN_TEST(test_render_too_small);
+  RUN_TEST(test_write_chunks);
+  return UNITY_END();
+}
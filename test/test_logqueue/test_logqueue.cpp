@@ -0,0 +1,120 @@
+/**
+ *  @filename   :   test_logqueue.cpp  
+ *  @brief      :   ESP32 Weather Base Station log queue tests
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include "weatherbase.h"
+#include "wifiwithmqtt.h"
+#include "logqueue.h"
+#include "native_sim.h"
+
+static char published[LOG_QUEUE_DEPTH * 2][256];
+static uint8_t publishCount;
+
+static void capture(const char *topic, const uint8_t *payload, unsigned int length) {
+  if((strcmp(topic, LOG_TOPIC) != 0) || (publishCount == LOG_QUEUE_DEPTH * 2))
+    return;
+
+  snprintf(published[publishCount++], sizeof(published[0]), "%.*s", length, (const char *)payload);
+}
+
+static void drain() {
+  for(uint8_t n=0;n<LOG_QUEUE_DEPTH;n++) {
+    mqttLoop();
+    logQueueLoop();
+  }
+}
+
+void test_level_published(void) {
+  TEST_ASSERT_TRUE(logEnqueue(LOG_LEVEL_ERROR, "sensor", "BMP failed"));
+  TEST_ASSERT_TRUE(logEnqueue(LOG_LEVEL_WARN, "sensor", "Slow read"));
+  drain();
+
+  TEST_ASSERT_EQUAL_UINT8(2, publishCount);
+  TEST_ASSERT_EQUAL_STRING("{\"host\":\"" STATION_NAME "\",\"level\":\"error\",\"system\":\"sensor\",\"message\":\"BMP failed\"}", published[0]);
+  TEST_ASSERT_EQUAL_STRING("{\"host\":\"" STATION_NAME "\",\"level\":\"warn\",\"system\":\"sensor\",\"message\":\"Slow read\"}", published[1]);
+}
+
+// The same message at another level is a different message
+void test_repeats_fold(void) {
+  for(uint8_t n=0;n<3;n++)
+    TEST_ASSERT_TRUE(logEnqueue(LOG_LEVEL_INFO, "wifi", "Reconnect"));
+  TEST_ASSERT_TRUE(logEnqueue(LOG_LEVEL_WARN, "wifi", "Reconnect"));
+  drain();
+
+  TEST_ASSERT_EQUAL_UINT8(2, publishCount);
+  TEST_ASSERT_EQUAL_STRING("{\"host\":\"" STATION_NAME "\",\"level\":\"info\",\"system\":\"wifi\",\"message\":\"Reconnect\",\"repeated\":2,\"suppressed\":0}", published[0]);
+  TEST_ASSERT_NOT_NULL(strstr(published[1], "\"level\":\"warn\""));
+}
+
+// Past the burst the rest are counted, and the count goes out with the next one
+void test_rate_limited(void) {
+  char message[16];
+  for(uint8_t n=0;n<LOG_RATE_BURST + 2;n++) {
+    sprintf(message, "Event %u", n);
+    TEST_ASSERT_EQUAL_UINT8(n < LOG_RATE_BURST, logEnqueue(LOG_LEVEL_INFO, "busy", message));
+  }
+  drain();
+  TEST_ASSERT_EQUAL_UINT8(LOG_RATE_BURST, publishCount);
+
+  simAdvance(LOG_RATE_REFILL_MS * 1000ULL);
+  TEST_ASSERT_TRUE(logEnqueue(LOG_LEVEL_INFO, "busy", "Event"));
+  drain();
+  TEST_ASSERT_EQUAL_UINT8(LOG_RATE_BURST + 1, publishCount);
+  TEST_ASSERT_NOT_NULL(strstr(published[LOG_RATE_BURST], "\"suppressed\":2}"));
+}
+
+// Held in the queue while the broker is down
+void test_waits_for_mqtt(void) {
+  simSetNetworkUp(0);
+  drain();
+  TEST_ASSERT_TRUE(logEnqueue(LOG_LEVEL_DEBUG, "mqtt", "Offline"));
+  drain();
+  TEST_ASSERT_EQUAL_UINT8(0, publishCount);
+
+  simSetNetworkUp(1);
+  simAdvance(60 * 1000000ULL);
+  drain();
+  TEST_ASSERT_EQUAL_UINT8(1, publishCount);
+  TEST_ASSERT_NOT_NULL(strstr(published[0], "\"level\":\"debug\""));
+}
+
+void setUp(void) {
+  publishCount = 0;
+}
+
+void tearDown(void) {}
+
+int main(int argc, char **argv) {
+  simSetNetworkUp(1);
+  initLogQueue();
+  initMQTT();
+  simMqttPublishHook = capture;
+
+  UNITY_BEGIN();
+  RUN_TEST(test_level_published);
+  RUN_TEST(test_repeats_fold);
+  RUN_TEST(test_rate_limited);
+  RUN_TEST(test_waits_for_mqtt);
+  return UNITY_END();
+}
@@ -0,0 +1,123 @@
+/**
+ *  @filename   :   test_outbox.cpp  
+ *  @brief      :   ESP32 Weather Base Station outbox tests
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include "wifiwithmqtt.h"
+#include "outbox.h"
+#include "native_sim.h"
+
+#define TOPIC "weather/outbox"
+#define BASE_TIME 1600000000
+#define RECORDS 25
+
+static uint32_t replayed[RECORDS * 2];
+static uint16_t replayCount;
+
+static void capture(const char *topic, const uint8_t *payload, unsigned int length) {
+  if(strcmp(topic, TOPIC) != 0)
+    return;
+
+  char text[64];
+  snprintf(text, sizeof(text), "%.*s", length, (const char *)payload);
+  const char *time = strstr(text, "\"time\":");
+  if((time != NULL) && (replayCount < RECORDS * 2))
+    replayed[replayCount++] = strtoul(time + 7, NULL, 10);
+}
+
+static void append(uint32_t time) {
+  char payload[32];
+  int len = sprintf(payload, "{\"n\":%u}", time);
+  TEST_ASSERT_TRUE(outboxAppend(TOPIC, (const uint8_t *)payload, len, time));
+}
+
+// Runs batches until the outbox is empty, or gives up
+static void replayAll() {
+  for(uint16_t n=0;(n<RECORDS) && outboxPending();n++) {
+    simAdvance(OUTBOX_BATCH_INTERVAL_MS * 1000ULL);
+    mqttLoop();
+    outboxLoop();
+  }
+}
+
+// Nothing is read back while the broker is down
+void test_waits_for_mqtt(void) {
+  append(BASE_TIME);
+  simAdvance(OUTBOX_BATCH_INTERVAL_MS * 1000ULL);
+  outboxLoop();
+
+  TEST_ASSERT_TRUE(outboxPending());
+  TEST_ASSERT_EQUAL_UINT16(0, replayCount);
+
+  simSetNetworkUp(1);
+  replayAll();
+  TEST_ASSERT_FALSE(outboxPending());
+  TEST_ASSERT_EQUAL_UINT16(1, replayCount);
+}
+
+// Appended newest first, replayed oldest first across more than one batch
+void test_time_order(void) {
+  for(uint32_t n=0;n<RECORDS;n++)
+    append(BASE_TIME + (RECORDS - n) * 60);
+
+  replayAll();
+  TEST_ASSERT_FALSE(outboxPending());
+  TEST_ASSERT_EQUAL_UINT16(RECORDS, replayCount);
+  for(uint16_t n=0;n<RECORDS;n++)
+    TEST_ASSERT_EQUAL_UINT32(BASE_TIME + (n + 1) * 60, replayed[n]);
+}
+
+// Interleaved times, each sent once and the bytes all accounted for
+void test_interleaved(void) {
+  for(uint32_t n=0;n<RECORDS;n++)
+    append(BASE_TIME + ((n * 7) % RECORDS) * 60);
+
+  replayAll();
+  TEST_ASSERT_EQUAL_UINT16(RECORDS, replayCount);
+  for(uint16_t n=0;n<RECORDS;n++)
+    TEST_ASSERT_EQUAL_UINT32(BASE_TIME + n * 60, replayed[n]);
+
+  outbox_stats_t stats;
+  getOutboxStats(&stats);
+  TEST_ASSERT_EQUAL_UINT32(0, stats.pendingBytes);
+  TEST_ASSERT_EQUAL_UINT16(0, stats.segments);
+}
+
+void setUp(void) {
+  replayCount = 0;
+}
+
+void tearDown(void) {}
+
+int main(int argc, char **argv) {
+  simSetNetworkUp(0);
+  initOutbox();
+  initMQTT();
+  simMqttPublishHook = capture;
+
+  UNITY_BEGIN();
+  RUN_TEST(test_waits_for_mqtt);
+  RUN_TEST(test_time_order);
+  RUN_TEST(test_interleaved);
+  return UNITY_END();
+}
@@ -0,0 +1,274 @@
+/**
+ *  @filename   :   test_packwriter.cpp
+ *  @brief      :   ESP32 Weather Base Station CBOR and MessagePack writer tests
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include "packwriter.h"
+
+static const json_field_t twoFields[] = {
+  JSON_INTEGER(a),
+  JSON_FIXED(b, 1)
+};
+static const json_schema_t twoSchema = JSON_SCHEMA(twoFields);
+
+// Enough integer fields to reach the longer map headers
+static const json_field_t manyFields[] = {
+  JSON_INTEGER(f0), JSON_INTEGER(f1), JSON_INTEGER(f2), JSON_INTEGER(f3), JSON_INTEGER(f4),
+  JSON_INTEGER(f5), JSON_INTEGER(f6), JSON_INTEGER(f7), JSON_INTEGER(f8), JSON_INTEGER(f9),
+  JSON_INTEGER(f10), JSON_INTEGER(f11), JSON_INTEGER(f12), JSON_INTEGER(f13), JSON_INTEGER(f14),
+  JSON_INTEGER(f15), JSON_INTEGER(f16), JSON_INTEGER(f17), JSON_INTEGER(f18), JSON_INTEGER(f19),
+  JSON_INTEGER(f20), JSON_INTEGER(f21), JSON_INTEGER(f22), JSON_INTEGER(f23)
+};
+
+static json_value_t manyValues[24];
+
+// Keeps everything it is given
+class CapturePrint : public Print {
+  public:
+    CapturePrint() : used(0) {}
+
+    size_t write(uint8_t c) { return write(&c, 1); }
+    size_t write(const uint8_t *data, size_t size) {
+      memcpy(&bytes[used], data, size);
+      used += size;
+      return size;
+    }
+
+    uint8_t bytes[256];
+    size_t used;
+};
+
+// Writes the first count fields, all 1, and checks packLength() agrees
+static void writeMany(CapturePrint &out, uint8_t format, uint8_t count) {
+  json_schema_t schema = {manyFields, count};
+  packWrite(out, format, &schema, manyValues);
+  TEST_ASSERT_EQUAL_size_t(packLength(format, &schema, manyValues), out.used);
+}
+
+static const uint8_t cborTime[] = {0x64, 't', 'i', 'm', 'e', 0x1a, 0x60, 0xb5, 0x78, 0x00};
+static const uint8_t msgpackTime[] = {0xa4, 't', 'i', 'm', 'e', 0xce, 0x60, 0xb5, 0x78, 0x00};
+
+#define TEST_TIME 1622505472
+
+// Renders the first count fields, all 1, and adds the time
+static uint16_t renderWithTime(uint8_t format, uint8_t count, uint8_t *buffer, uint16_t size) {
+  json_schema_t schema = {manyFields, count};
+  uint16_t len = packRender(buffer, size, format, &schema, manyValues);
+  TEST_ASSERT_EQUAL_UINT16(packLength(format, &schema, manyValues), len);
+
+  uint16_t timed = packAddTime(buffer, len, size, TEST_TIME);
+  TEST_ASSERT_TRUE(timed > len);
+  return timed;
+}
+
+void test_cbor(void) {
+  json_value_t values[] = {jsonInt(-300), jsonFloat(1.5)};
+  CapturePrint out;
+
+  packWrite(out, PAYLOAD_CBOR, &twoSchema, values);
+  const uint8_t expected[] = {0xa2, 0x00, 0x39, 0x01, 0x2b, 0x01, 0xfa, 0x3f, 0xc0, 0x00, 0x00};
+  TEST_ASSERT_EQUAL_size_t(sizeof(expected), out.used);
+  TEST_ASSERT_EQUAL_MEMORY(expected, out.bytes, out.used);
+  TEST_ASSERT_EQUAL_UINT16(out.used, packLength(PAYLOAD_CBOR, &twoSchema, values));
+}
+
+void test_msgpack(void) {
+  json_value_t values[] = {jsonInt(-300), jsonFloat(1.5)};
+  CapturePrint out;
+
+  packWrite(out, PAYLOAD_MSGPACK, &twoSchema, values);
+  const uint8_t expected[] = {0x82, 0x00, 0xd1, 0xfe, 0xd4, 0x01, 0xca, 0x3f, 0xc0, 0x00, 0x00};
+  TEST_ASSERT_EQUAL_size_t(sizeof(expected), out.used);
+  TEST_ASSERT_EQUAL_MEMORY(expected, out.bytes, out.used);
+  TEST_ASSERT_EQUAL_UINT16(out.used, packLength(PAYLOAD_MSGPACK, &twoSchema, values));
+}
+
+// Integers take the shortest encoding that holds them
+void test_integer_sizes(void) {
+  static const json_field_t fields[] = {JSON_INTEGER(a), JSON_INTEGER(b), JSON_UNSIGNED(c)};
+  static const json_schema_t schema = JSON_SCHEMA(fields);
+  json_value_t values[] = {jsonInt(23), jsonInt(-1), jsonUint(70000)};
+
+  CapturePrint cbor;
+  packWrite(cbor, PAYLOAD_CBOR, &schema, values);
+  const uint8_t cborExpected[] = {0xa3, 0x00, 0x17, 0x01, 0x20, 0x02, 0x1a, 0x00, 0x01, 0x11, 0x70};
+  TEST_ASSERT_EQUAL_size_t(sizeof(cborExpected), cbor.used);
+  TEST_ASSERT_EQUAL_MEMORY(cborExpected, cbor.bytes, cbor.used);
+
+  CapturePrint msgpack;
+  packWrite(msgpack, PAYLOAD_MSGPACK, &schema, values);
+  const uint8_t msgpackExpected[] = {0x83, 0x00, 0x17, 0x01, 0xff, 0x02, 0xce, 0x00, 0x01, 0x11, 0x70};
+  TEST_ASSERT_EQUAL_size_t(sizeof(msgpackExpected), msgpack.used);
+  TEST_ASSERT_EQUAL_MEMORY(msgpackExpected, msgpack.bytes, msgpack.used);
+}
+
+void test_strings(void) {
+  static const json_field_t fields[] = {JSON_TEXT(s, 4)};
+  static const json_schema_t schema = JSON_SCHEMA(fields);
+  json_value_t values[] = {jsonString("ab\"cdef")};
+
+  // Truncated, not escaped
+  CapturePrint cbor;
+  packWrite(cbor, PAYLOAD_CBOR, &schema, values);
+  const uint8_t cborExpected[] = {0xa1, 0x00, 0x64, 'a', 'b', '"', 'c'};
+  TEST_ASSERT_EQUAL_size_t(sizeof(cborExpected), cbor.used);
+  TEST_ASSERT_EQUAL_MEMORY(cborExpected, cbor.bytes, cbor.used);
+
+  CapturePrint msgpack;
+  packWrite(msgpack, PAYLOAD_MSGPACK, &schema, values);
+  const uint8_t msgpackExpected[] = {0x81, 0x00, 0xa4, 'a', 'b', '"', 'c'};
+  TEST_ASSERT_EQUAL_size_t(sizeof(msgpackExpected), msgpack.used);
+  TEST_ASSERT_EQUAL_MEMORY(msgpackExpected, msgpack.bytes, msgpack.used);
+}
+
+// 23 entries is the most a CBOR head holds inline, 15 for MessagePack
+void test_map_headers(void) {
+  CapturePrint cbor23, cbor24;
+  writeMany(cbor23, PAYLOAD_CBOR, 23);
+  TEST_ASSERT_EQUAL_HEX8(0xb7, cbor23.bytes[0]);
+  writeMany(cbor24, PAYLOAD_CBOR, 24);
+  TEST_ASSERT_EQUAL_HEX8(0xb8, cbor24.bytes[0]);
+  TEST_ASSERT_EQUAL_UINT8(24, cbor24.bytes[1]);
+
+  CapturePrint msgpack15, msgpack16;
+  writeMany(msgpack15, PAYLOAD_MSGPACK, 15);
+  TEST_ASSERT_EQUAL_HEX8(0x8f, msgpack15.bytes[0]);
+  writeMany(msgpack16, PAYLOAD_MSGPACK, 16);
+  TEST_ASSERT_EQUAL_HEX8(0xde, msgpack16.bytes[0]);
+  TEST_ASSERT_EQUAL_UINT8(0, msgpack16.bytes[1]);
+  TEST_ASSERT_EQUAL_UINT8(16, msgpack16.bytes[2]);
+}
+
+// PAYLOAD_JSON is jsonwriter's output
+void test_json(void) {
+  json_value_t values[] = {jsonInt(1), jsonFloat(2.0)};
+  CapturePrint out;
+  char expected[64];
+
+  packWrite(out, PAYLOAD_JSON, &twoSchema, values);
+  uint16_t len = jsonRender(expected, sizeof(expected), &twoSchema, values);
+  TEST_ASSERT_EQUAL_size_t(len, out.used);
+  TEST_ASSERT_EQUAL_MEMORY(expected, out.bytes, len);
+}
+
+void test_render_matches_write(void) {
+  json_value_t values[] = {jsonInt(-300), jsonFloat(1.5)};
+  uint8_t buffer[32];
+
+  TEST_ASSERT_EQUAL_UINT16(0, packRender(buffer, 2, PAYLOAD_CBOR, &twoSchema, values));
+
+  uint16_t len = packRender(buffer, sizeof(buffer), PAYLOAD_CBOR, &twoSchema, values);
+  const uint8_t expected[] = {0xa2, 0x00, 0x39, 0x01, 0x2b, 0x01, 0xfa, 0x3f, 0xc0, 0x00, 0x00};
+  TEST_ASSERT_EQUAL_UINT16(sizeof(expected), len);
+  TEST_ASSERT_EQUAL_MEMORY(expected, buffer, len);
+}
+
+void test_time_json(void) {
+  json_value_t values[] = {jsonInt(1), jsonFloat(2.0)};
+  uint8_t buffer[64];
+
+  uint16_t len = packRender(buffer, sizeof(buffer), PAYLOAD_JSON, &twoSchema, values);
+  len = packAddTime(buffer, len, sizeof(buffer), TEST_TIME);
+  buffer[len] = '\0';
+  TEST_ASSERT_EQUAL_STRING("{\"a\":1,\"b\":2.0,\"time\":1622505472}", (const char *)buffer);
+}
+
+void test_time_small_maps(void) {
+  uint8_t buffer[64];
+
+  uint16_t len = renderWithTime(PAYLOAD_CBOR, 2, buffer, sizeof(buffer));
+  TEST_ASSERT_EQUAL_HEX8(0xa3, buffer[0]);
+  TEST_ASSERT_EQUAL_MEMORY(cborTime, &buffer[len - sizeof(cborTime)], sizeof(cborTime));
+
+  len = renderWithTime(PAYLOAD_MSGPACK, 2, buffer, sizeof(buffer));
+  TEST_ASSERT_EQUAL_HEX8(0x83, buffer[0]);
+  TEST_ASSERT_EQUAL_MEMORY(msgpackTime, &buffer[len - sizeof(msgpackTime)], sizeof(msgpackTime));
+}
+
+// 23 entries is the most a CBOR head holds inline, 15 for MessagePack
+void test_time_grows_header(void) {
+  uint8_t buffer[128];
+
+  uint16_t len = renderWithTime(PAYLOAD_CBOR, 23, buffer, sizeof(buffer));
+  TEST_ASSERT_EQUAL_HEX8(0xb8, buffer[0]);
+  TEST_ASSERT_EQUAL_UINT8(24, buffer[1]);
+  TEST_ASSERT_EQUAL_HEX8(0x00, buffer[2]);    // First key still follows the head
+  TEST_ASSERT_EQUAL_UINT16(2 + 23 * 2 + sizeof(cborTime), len);
+
+  len = renderWithTime(PAYLOAD_MSGPACK, 15, buffer, sizeof(buffer));
+  TEST_ASSERT_EQUAL_HEX8(0xde, buffer[0]);
+  TEST_ASSERT_EQUAL_UINT8(0, buffer[1]);
+  TEST_ASSERT_EQUAL_UINT8(16, buffer[2]);
+  TEST_ASSERT_EQUAL_HEX8(0x00, buffer[3]);
+  TEST_ASSERT_EQUAL_MEMORY(msgpackTime, &buffer[len - sizeof(msgpackTime)], sizeof(msgpackTime));
+
+  // Already the longer header
+  len = renderWithTime(PAYLOAD_CBOR, 24, buffer, sizeof(buffer));
+  TEST_ASSERT_EQUAL_UINT8(25, buffer[1]);
+  len = renderWithTime(PAYLOAD_MSGPACK, 16, buffer, sizeof(buffer));
+  TEST_ASSERT_EQUAL_UINT8(17, buffer[2]);
+}
+
+void test_time_no_room(void) {
+  json_value_t values[] = {jsonInt(1), jsonFloat(2.0)};
+  uint8_t buffer[64];
+
+  uint16_t len = packRender(buffer, sizeof(buffer), PAYLOAD_CBOR, &twoSchema, values);
+  TEST_ASSERT_EQUAL_UINT16(0, packAddTime(buffer, len, len + PACK_TIME_LENGTH - 1, TEST_TIME));
+  TEST_ASSERT_EQUAL_HEX8(0xa2, buffer[0]);
+
+  // Not a map
+  buffer[0] = 0x42;
+  TEST_ASSERT_EQUAL_UINT16(0, packAddTime(buffer, len, sizeof(buffer), TEST_TIME));
+}
+
+void test_format_names(void) {
+  TEST_ASSERT_EQUAL_INT8(PAYLOAD_JSON, packFormat("json"));
+  TEST_ASSERT_EQUAL_INT8(PAYLOAD_CBOR, packFormat("cbor"));
+  TEST_ASSERT_EQUAL_INT8(PAYLOAD_MSGPACK, packFormat("msgpack"));
+  TEST_ASSERT_EQUAL_INT8(-1, packFormat(""));
+  TEST_ASSERT_EQUAL_INT8(-1, packFormat("CBOR"));
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+int main(int argc, char **argv) {
+  for(uint8_t n=0;n<24;n++)
+    manyValues[n] = jsonInt(1);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_cbor);
+  RUN_TEST(test_msgpack);
+  RUN_TEST(test_integer_sizes);
+  RUN_TEST(test_strings);
+  RUN_TEST(test_map_headers);
+  RUN_TEST(test_json);
+  RUN_TEST(test_render_matches_write);
+  RUN_TEST(test_time_json);
+  RUN_TEST(test_time_small_maps);
+  RUN_TEST(test_time_grows_header);
+  RUN_TEST(test_time_no_room);
+  RUN_TEST(test_format_names);
+  return UNITY_END();
+}
@@ -0,0 +1,129 @@
+/**
+ *  @filename   :   test_pressuretrend.cpp
+ *  @brief      :   ESP32 Weather Base Station pressure trend tests
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include "timekeeper.h"
+#include "pressuretrend.h"
+#include "native_sim.h"
+
+#define SPACING_SECS 120
+#define PA_PER_SAMPLE 2
+#define BATCH 24
+
+static void addAt(int32_t pressure, int64_t sampleMicros) {
+  sensor_data_t data;
+  memset(&data, 0, sizeof(data));
+  data.pressure = pressure;
+  pressureTrendAdd(&data, sampleMicros);
+}
+
+// One sample now, then on to the next one
+static void addNext(int32_t pressure) {
+  addAt(pressure, timeMicros());
+  simAdvance((uint64_t)SPACING_SECS * 1000000ULL);
+}
+
+static float expectedSlope() {
+  float perWindow = (float)PA_PER_SAMPLE / SPACING_SECS * TREND_WINDOW_SECS;
+  return seaLevelInHg(100000 + perWindow) - seaLevelInHg(100000);
+}
+
+// The mean comes back before there is enough for a slope
+void test_too_short(void) {
+  uint16_t samples = TREND_MIN_SECS / SPACING_SECS - 1;
+  for(uint16_t n=0;n<samples;n++)
+    addNext(100000);
+
+  pressure_trend_t trend;
+  TEST_ASSERT_FALSE(pressureTrend(&trend));
+  TEST_ASSERT_EQUAL_UINT16(samples, trend.samples);
+  TEST_ASSERT_FLOAT_WITHIN(0.0001, seaLevelInHg(100000), trend.mean);
+}
+
+void test_rising(void) {
+  for(int32_t n=0;n<BATCH;n++)
+    addNext(100000 + n * PA_PER_SAMPLE);
+
+  pressure_trend_t trend;
+  TEST_ASSERT_TRUE(pressureTrend(&trend));
+  TEST_ASSERT_EQUAL_UINT16(BATCH, trend.samples);
+  TEST_ASSERT_FLOAT_WITHIN(expectedSlope() * 0.001, expectedSlope(), trend.slope);
+  TEST_ASSERT_FLOAT_WITHIN(0.0001, seaLevelInHg(100000 + (BATCH - 1) * PA_PER_SAMPLE / 2.0), trend.mean);
+}
+
+// One batched frame, every sample arriving at once with its own age
+void test_batch_ages(void) {
+  int64_t arrival = timeMicros();
+  for(int32_t n=0;n<BATCH;n++) {
+    int64_t ageMicros = (int64_t)(BATCH - 1 - n) * SPACING_SECS * 1000000LL;
+    addAt(100000 + n * PA_PER_SAMPLE, arrival - ageMicros);
+  }
+
+  pressure_trend_t trend;
+  TEST_ASSERT_TRUE(pressureTrend(&trend));
+  TEST_ASSERT_EQUAL_UINT16(BATCH, trend.samples);
+  TEST_ASSERT_FLOAT_WITHIN(expectedSlope() * 0.001, expectedSlope(), trend.slope);
+}
+
+// A sample older than the newest one, from a reordered frame, is left out
+void test_out_of_order(void) {
+  for(int32_t n=0;n<BATCH;n++)
+    addNext(100000 + n * PA_PER_SAMPLE);
+
+  pressure_trend_t before, after;
+  pressureTrend(&before);
+  addAt(90000, timeMicros() - 600 * 1000000LL);
+  pressureTrend(&after);
+
+  TEST_ASSERT_EQUAL_UINT16(before.samples, after.samples);
+  TEST_ASSERT_FLOAT_WITHIN(0.00001, before.slope, after.slope);
+}
+
+void test_window_expires(void) {
+  addNext(100000);
+  simAdvance((uint64_t)TREND_WINDOW_SECS * 1000000ULL);
+
+  pressure_trend_t trend;
+  TEST_ASSERT_FALSE(pressureTrend(&trend));
+  TEST_ASSERT_EQUAL_UINT16(0, trend.samples);
+}
+
+// Each test starts with an empty window
+void setUp(void) {
+  simAdvance((uint64_t)(TREND_WINDOW_SECS + 60) * 1000000ULL);
+}
+
+void tearDown(void) {}
+
+int main(int argc, char **argv) {
+  initPressureTrend();
+
+  UNITY_BEGIN();
+  RUN_TEST(test_too_short);
+  RUN_TEST(test_rising);
+  RUN_TEST(test_batch_ages);
+  RUN_TEST(test_out_of_order);
+  RUN_TEST(test_window_expires);
+  return UNITY_END();
+}
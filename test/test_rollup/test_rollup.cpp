@@ -0,0 +1,136 @@
+/**
+ *  @filename   :   test_rollup.cpp  
+ *  @brief      :   ESP32 Weather Base Station rollup tests
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include "wifiwithmqtt.h"
+#include "stations.h"
+#include "rollup.h"
+#include "native_sim.h"
+
+extern char mqttTopic[MQTT_TOPIC_LENGTH];
+
+#define WINDOW_SECS 300
+#define WINDOW_START 1600000200     // On a window boundary
+
+static char published[4][512];
+static uint8_t publishCount;
+
+static void capture(const char *topic, const uint8_t *payload, unsigned int length) {
+  if((strstr(topic, "/rollup/") == NULL) || (publishCount == 4))
+    return;
+
+  snprintf(published[publishCount++], sizeof(published[0]), "%s %.*s", topic, length, (const char *)payload);
+}
+
+static station_t *newStation(uint8_t n) {
+  uint8_t mac[6] = {0x24, 0x0a, 0xc4, 0x00, 0x40, n};
+  return stationLookup(mac, true);
+}
+
+static void add(station_t *station, uint32_t sampleTime, float temperature, float rain) {
+  sensor_data_t data;
+  memset(&data, 0, sizeof(data));
+  data.temperature = temperature;
+  data.pressure = 100000;
+  data.rain = rain;
+  rollupAdd(station, &data, sampleTime);
+}
+
+static void assertField(const char *field) {
+  TEST_ASSERT_NOT_NULL(strstr(published[0], field));
+}
+
+// A window goes out when the first sample of the next one arrives
+void test_window_published(void) {
+  station_t *station = newStation(1);
+  add(station, WINDOW_START, 18.0, 0.0);
+  add(station, WINDOW_START + 120, 20.0, 1.0);
+  add(station, WINDOW_START + 240, 16.0, 2.0);
+  TEST_ASSERT_EQUAL_UINT8(0, publishCount);
+
+  add(station, WINDOW_START + WINDOW_SECS, 15.0, 0.0);
+  TEST_ASSERT_EQUAL_UINT8(1, publishCount);
+
+  char topic[64];
+  snprintf(topic, sizeof(topic), "%s/rollup/%u {", station->topic, WINDOW_SECS);
+  TEST_ASSERT_EQUAL_INT32(0, strncmp(published[0], topic, strlen(topic)));
+  assertField("\"start\":1600000200,\"window\":300,\"count\":3,");
+  assertField("\"min_temperature\":16.0,\"max_temperature\":20.0,\"mean_temperature\":18.0,\"last_temperature\":16.0,");
+  assertField("\"sum_rain\":3.000");
+}
+
+// Samples for a window already sent are counted and left out
+void test_late_sample(void) {
+  station_t *station = newStation(2);
+  add(station, WINDOW_START, 18.0, 0.0);
+  add(station, WINDOW_START + WINDOW_SECS, 18.0, 0.0);
+
+  rollup_stats_t before, after;
+  getRollupStats(&before);
+  add(station, WINDOW_START + 60, 18.0, 0.0);
+  getRollupStats(&after);
+
+  TEST_ASSERT_EQUAL_UINT32(before.late + 1, after.late);
+  TEST_ASSERT_EQUAL_UINT8(1, publishCount);
+}
+
+// A station that stops is published once the grace period runs out
+void test_quiet_station(void) {
+  // The windows the other tests left open go first
+  simSetEpoch(WINDOW_START + 2 * WINDOW_SECS + ROLLUP_GRACE_SECS);
+  rollupLoop();
+  publishCount = 0;
+
+  station_t *station = newStation(3);
+  add(station, WINDOW_START + 2 * WINDOW_SECS, 18.0, 0.0);
+
+  simSetEpoch(WINDOW_START + 3 * WINDOW_SECS + ROLLUP_GRACE_SECS - 1);
+  rollupLoop();
+  TEST_ASSERT_EQUAL_UINT8(0, publishCount);
+
+  simSetEpoch(WINDOW_START + 3 * WINDOW_SECS + ROLLUP_GRACE_SECS);
+  rollupLoop();
+  TEST_ASSERT_EQUAL_UINT8(1, publishCount);
+  assertField("\"start\":1600000800,\"window\":300,\"count\":1,");
+}
+
+void setUp(void) {
+  publishCount = 0;
+}
+
+void tearDown(void) {}
+
+int main(int argc, char **argv) {
+  strcpy(mqttTopic, "weather");
+  simSetNetworkUp(1);
+  initMQTT();
+  mqttLoop();
+  simMqttPublishHook = capture;
+
+  UNITY_BEGIN();
+  RUN_TEST(test_window_published);
+  RUN_TEST(test_late_sample);
+  RUN_TEST(test_quiet_station);
+  return UNITY_END();
+}
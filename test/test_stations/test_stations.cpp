@@ -0,0 +1,168 @@
+/**
+ *  @filename   :   test_stations.cpp
+ *  @brief      :   ESP32 Weather Base Station station table tests
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include "wifiwithmqtt.h"
+#include "stations.h"
+
+extern char mqttTopic[MQTT_TOPIC_LENGTH];
+extern char primaryStation[MQTT_MAC_LENGTH];
+
+// The table keeps every station for the life of the program, so each test
+// has its own MAC
+static station_t *newStation(uint8_t n) {
+  uint8_t mac[6] = {0x24, 0x0a, 0xc4, 0x00, 0x20, n};
+  TEST_ASSERT_NULL(stationLookup(mac, false));
+  station_t *station = stationLookup(mac, true);
+  TEST_ASSERT_NOT_NULL(station);
+  return station;
+}
+
+void test_lookup(void) {
+  uint8_t mac[6] = {0x24, 0x0a, 0xc4, 0x00, 0x20, 0x01};
+  station_t *station = newStation(0x01);
+
+  TEST_ASSERT_EQUAL_PTR(station, stationLookup(mac, false));
+  TEST_ASSERT_EQUAL_PTR(station, stationGet(station->index));
+  TEST_ASSERT_EQUAL_MEMORY(mac, station->mac, 6);
+}
+
+// The configured MAC gets the bare topic, the rest <topic>/<mac3>
+void test_configured_primary(void) {
+  station_t *other = newStation(0x02);
+  station_t *primary = newStation(0x10);
+
+  TEST_ASSERT_TRUE(primary->primary);
+  TEST_ASSERT_EQUAL_STRING("weather", primary->topic);
+  TEST_ASSERT_FALSE(other->primary);
+  TEST_ASSERT_EQUAL_STRING("weather/002002", other->topic);
+
+  // Configured, so nothing else is adopted
+  TEST_ASSERT_FALSE(stationAdoptPrimary(other));
+  TEST_ASSERT_FALSE(other->primary);
+}
+
+void test_in_order(void) {
+  station_t *station = newStation(0x03);
+
+  for(uint16_t seq=100;seq<110;seq++)
+    TEST_ASSERT_EQUAL_UINT8(SEQ_NEW, stationCheckSequence(station, seq, false));
+
+  TEST_ASSERT_EQUAL_UINT32(10, station->seqReceived);
+  TEST_ASSERT_EQUAL_UINT32(0, station->seqLost);
+  TEST_ASSERT_EQUAL_UINT32(0, station->seqRestarts);
+}
+
+void test_duplicate(void) {
+  station_t *station = newStation(0x04);
+
+  stationCheckSequence(station, 5, false);
+  stationCheckSequence(station, 6, false);
+  TEST_ASSERT_EQUAL_UINT8(SEQ_DUPLICATE, stationCheckSequence(station, 6, false));
+  TEST_ASSERT_EQUAL_UINT8(SEQ_DUPLICATE, stationCheckSequence(station, 5, false));
+  TEST_ASSERT_EQUAL_UINT32(2, station->seqDuplicates);
+  TEST_ASSERT_EQUAL_UINT32(2, station->seqReceived);
+}
+
+// A gap is lost until the frames turn up
+void test_gap_and_reorder(void) {
+  station_t *station = newStation(0x05);
+
+  stationCheckSequence(station, 10, false);
+  TEST_ASSERT_EQUAL_UINT8(SEQ_NEW, stationCheckSequence(station, 14, false));
+  TEST_ASSERT_EQUAL_UINT32(3, station->seqLost);
+
+  TEST_ASSERT_EQUAL_UINT8(SEQ_REORDERED, stationCheckSequence(station, 12, false));
+  TEST_ASSERT_EQUAL_UINT32(2, station->seqLost);
+  TEST_ASSERT_EQUAL_UINT32(1, station->seqReordered);
+  TEST_ASSERT_EQUAL_UINT8(SEQ_DUPLICATE, stationCheckSequence(station, 12, false));
+  TEST_ASSERT_FLOAT_WITHIN(0.001, 2.0 / 5.0, stationLossRate(station));
+}
+
+void test_wraparound(void) {
+  station_t *station = newStation(0x06);
+
+  stationCheckSequence(station, 65534, false);
+  TEST_ASSERT_EQUAL_UINT8(SEQ_NEW, stationCheckSequence(station, 65535, false));
+  TEST_ASSERT_EQUAL_UINT8(SEQ_NEW, stationCheckSequence(station, 0, false));
+  TEST_ASSERT_EQUAL_UINT8(SEQ_DUPLICATE, stationCheckSequence(station, 65535, false));
+  TEST_ASSERT_EQUAL_UINT32(0, station->seqLost);
+  TEST_ASSERT_EQUAL_UINT32(0, station->seqRestarts);
+}
+
+void test_restart_flag(void) {
+  station_t *station = newStation(0x07);
+
+  stationCheckSequence(station, 500, false);
+  stationCheckSequence(station, 501, false);
+  TEST_ASSERT_EQUAL_UINT8(SEQ_NEW, stationCheckSequence(station, 0, true));
+  TEST_ASSERT_EQUAL_UINT32(1, station->seqRestarts);
+  TEST_ASSERT_EQUAL_UINT8(SEQ_NEW, stationCheckSequence(station, 1, false));
+  TEST_ASSERT_EQUAL_UINT32(0, station->seqLost);
+}
+
+void test_large_gap_restarts(void) {
+  station_t *station = newStation(0x08);
+
+  stationCheckSequence(station, 1000, false);
+  TEST_ASSERT_EQUAL_UINT8(SEQ_NEW, stationCheckSequence(station, 1000 + STATION_SEQ_MAX_GAP + 1, false));
+  TEST_ASSERT_EQUAL_UINT32(1, station->seqRestarts);
+  TEST_ASSERT_EQUAL_UINT32(0, station->seqLost);
+}
+
+// Behind the window but not far enough to be a restart, so it can't be told
+// from a duplicate and is dropped
+void test_older_than_window(void) {
+  station_t *station = newStation(0x09);
+
+  for(uint16_t seq=0;seq<=STATION_SEQ_WINDOW + 10;seq++)
+    stationCheckSequence(station, seq, false);
+
+  uint32_t received = station->seqReceived;
+  TEST_ASSERT_EQUAL_UINT8(SEQ_DUPLICATE, stationCheckSequence(station, 2, false));
+  TEST_ASSERT_EQUAL_UINT32(0, station->seqRestarts);
+  TEST_ASSERT_EQUAL_UINT32(received, station->seqReceived);
+  TEST_ASSERT_EQUAL_UINT32(0, station->seqLost);
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+int main(int argc, char **argv) {
+  // Before the first lookup, which reads the config
+  strcpy(mqttTopic, "weather");
+  strcpy(primaryStation, "24:0a:c4:00:20:10");
+
+  UNITY_BEGIN();
+  RUN_TEST(test_lookup);
+  RUN_TEST(test_configured_primary);
+  RUN_TEST(test_in_order);
+  RUN_TEST(test_duplicate);
+  RUN_TEST(test_gap_and_reorder);
+  RUN_TEST(test_wraparound);
+  RUN_TEST(test_restart_flag);
+  RUN_TEST(test_large_gap_restarts);
+  RUN_TEST(test_older_than_window);
+  return UNITY_END();
+}
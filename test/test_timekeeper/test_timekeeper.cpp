@@ -0,0 +1,171 @@
+/**
+ *  @filename   :   test_timekeeper.cpp
+ *  @brief      :   ESP32 Weather Base Station timekeeper tests
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include "timekeeper.h"
+#include "native_sim.h"
+
+#define START_TIME 1600000000       // 2020-09-13 08:26:40 local
+#define DAY_SECS 86400
+
+static uint8_t midnights;
+static uint8_t steps;
+static uint32_t handlerNow;
+
+static void onMidnight(uint32_t now) {
+  midnights++;
+  handlerNow = now;
+}
+
+static void onStep(uint32_t now) {
+  steps++;
+  handlerNow = now;
+}
+
+static void noop(uint32_t now) {}
+
+// Puts the wall clock at t, and lets timeLoop() take the jump before the test
+static void setClock(uint32_t t) {
+  simSetEpoch(t - simMicros() / 1000000);
+  timeLoop();
+  midnights = 0;
+  steps = 0;
+  handlerNow = 0;
+}
+
+// Before SNTP nothing waits, and nothing claims to know the time
+void test_not_set(void) {
+  simSetEpoch(0);
+
+  TEST_ASSERT_FALSE(timeValid());
+  TEST_ASSERT_EQUAL_UINT32(0, timeNow());
+
+  struct tm dt;
+  memset(&dt, 0xff, sizeof(dt));
+  TEST_ASSERT_FALSE(timeLocal(&dt));
+  TEST_ASSERT_EQUAL_INT32(0, dt.tm_hour);
+  TEST_ASSERT_EQUAL_UINT16(1440, timeMinutesToday());
+
+  timeLoop();
+  time_stats_t stats;
+  getTimeStats(&stats);
+  TEST_ASSERT_EQUAL_UINT32(0, stats.steps);
+  TEST_ASSERT_EQUAL_UINT32(0, stats.midnights);
+}
+
+void test_set(void) {
+  setClock(START_TIME);
+
+  TEST_ASSERT_TRUE(timeValid());
+  TEST_ASSERT_EQUAL_UINT32(START_TIME, timeNow());
+
+  struct tm dt;
+  TEST_ASSERT_TRUE(timeLocal(&dt));
+  TEST_ASSERT_EQUAL_INT32(8, dt.tm_hour);
+  TEST_ASSERT_EQUAL_INT32(26, dt.tm_min);
+  TEST_ASSERT_EQUAL_UINT16(8 * 60 + 26 + 1, timeMinutesToday());
+}
+
+void test_day_boundaries(void) {
+  uint32_t day = timeLocalDay(START_TIME);
+  uint32_t start = timeDayStart(day);
+
+  TEST_ASSERT_TRUE(start <= START_TIME);
+  TEST_ASSERT_TRUE(START_TIME < timeDayStart(day + 1));
+  TEST_ASSERT_EQUAL_UINT32(DAY_SECS, timeDayStart(day + 1) - start);
+  TEST_ASSERT_EQUAL_UINT32(day, timeLocalDay(start));
+  TEST_ASSERT_EQUAL_UINT32(day - 1, timeLocalDay(start - 1));
+}
+
+// The handlers run once, on the first loop of the new local day
+void test_midnight(void) {
+  uint32_t midnight = timeDayStart(timeLocalDay(START_TIME) + 1);
+  setClock(midnight - 30);
+
+  simAdvance(20 * 1000000ULL);
+  timeLoop();
+  TEST_ASSERT_EQUAL_UINT8(0, midnights);
+
+  time_stats_t before, after;
+  getTimeStats(&before);
+  simAdvance(20 * 1000000ULL);
+  timeLoop();
+  timeLoop();
+  getTimeStats(&after);
+
+  TEST_ASSERT_EQUAL_UINT8(1, midnights);
+  TEST_ASSERT_EQUAL_UINT32(midnight + 10, handlerNow);
+  TEST_ASSERT_EQUAL_UINT32(before.midnights + 1, after.midnights);
+  TEST_ASSERT_EQUAL_UINT32(before.steps, after.steps);
+  TEST_ASSERT_EQUAL_UINT8(0, steps);
+}
+
+// Only a jump of more than TIME_STEP_SECS against the monotonic clock is a step
+void test_step(void) {
+  setClock(START_TIME);
+
+  simAdvance(600 * 1000000ULL);
+  timeLoop();
+  simStepClock(TIME_STEP_SECS);
+  timeLoop();
+  TEST_ASSERT_EQUAL_UINT8(0, steps);
+
+  time_stats_t before, after;
+  getTimeStats(&before);
+  simStepClock(-(TIME_STEP_SECS + 1));
+  timeLoop();
+  getTimeStats(&after);
+
+  TEST_ASSERT_EQUAL_UINT8(1, steps);
+  TEST_ASSERT_EQUAL_UINT32(timeNow(), handlerNow);
+  TEST_ASSERT_EQUAL_UINT32(before.steps + 1, after.steps);
+}
+
+// Runs last, it fills the handler tables
+void test_handler_limit(void) {
+  for(uint8_t n=1;n<TIME_HANDLERS;n++) {
+    TEST_ASSERT_TRUE(timeOnMidnight(noop));
+    TEST_ASSERT_TRUE(timeOnStep(noop));
+  }
+  TEST_ASSERT_FALSE(timeOnMidnight(noop));
+  TEST_ASSERT_FALSE(timeOnStep(noop));
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+int main(int argc, char **argv) {
+  timeOnMidnight(onMidnight);
+  timeOnStep(onStep);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_not_set);
+  RUN_TEST(test_set);
+  RUN_TEST(test_day_boundaries);
+  RUN_TEST(test_midnight);
+  RUN_TEST(test_step);
+  RUN_TEST(test_handler_limit);
+  return UNITY_END();
+}
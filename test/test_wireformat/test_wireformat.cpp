@@ -0,0 +1,229 @@
+/**
+ *  @filename   :   test_wireformat.cpp
+ *  @brief      :   ESP32 Weather Base Station wire format tests
+ *
+ *  @author     :   Kevin Kessler
+ *
+ * Copyright (C) 2021 Kevin Kessler
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include "weatherbase.h"
+#include "wireformat.h"
+
+static void makeSample(sensor_data_t *sample, uint8_t n) {
+  sample->wakeup_reason = 4;
+  sample->temperature = 21.37 + n * 0.11;
+  sample->pressure = 101325 - n * 7;
+  sample->humidity = 55.25 + n * 0.5;
+  sample->battery_millivolts = 4012 - n;
+  sample->direction = (n * 3) % 16;
+  sample->wind_speed = 3.4 + n * 0.05;
+  sample->rain = 0.011 * n;
+}
+
+static void assertSample(const sensor_data_t *expected, const sensor_data_t *actual) {
+  TEST_ASSERT_EQUAL_UINT8(expected->wakeup_reason, actual->wakeup_reason);
+  TEST_ASSERT_FLOAT_WITHIN(0.005, expected->temperature, actual->temperature);
+  TEST_ASSERT_EQUAL_INT32(expected->pressure, actual->pressure);
+  TEST_ASSERT_FLOAT_WITHIN(0.005, expected->humidity, actual->humidity);
+  TEST_ASSERT_FLOAT_WITHIN(0.5, expected->battery_millivolts, actual->battery_millivolts);
+  TEST_ASSERT_EQUAL_UINT16(expected->direction, actual->direction);
+  TEST_ASSERT_FLOAT_WITHIN(0.005, expected->wind_speed, actual->wind_speed);
+  TEST_ASSERT_FLOAT_WITHIN(0.0005, expected->rain, actual->rain);
+}
+
+static void roundTrip(uint8_t count, bool delta, uint8_t expectedLen) {
+  sensor_data_t samples[WIRE_MAX_SAMPLES];
+  uint16_t ages[WIRE_MAX_SAMPLES];
+  uint8_t frame[WIRE_MAX_FRAME];
+
+  for(uint8_t n=0;n<count;n++) {
+    makeSample(&samples[n], n);
+    ages[n] = (count - 1 - n) * 60;
+  }
+
+  uint8_t len = wireEncode(frame, 7, 513, samples, ages, count, 0, delta);
+  TEST_ASSERT_EQUAL_UINT8(expectedLen, len);
+
+  wire_reader_t reader;
+  TEST_ASSERT_TRUE(wireReaderInit(&reader, frame, len));
+  TEST_ASSERT_FALSE(reader.legacy);
+  TEST_ASSERT_NOT_NULL(reader.header);
+  TEST_ASSERT_EQUAL_UINT16(7, reader.header->stationId);
+  TEST_ASSERT_EQUAL_UINT16(513, reader.header->sequence);
+  TEST_ASSERT_EQUAL_UINT8(count, reader.header->count);
+
+  sensor_data_t decoded;
+  uint16_t age;
+  for(uint8_t n=0;n<count;n++) {
+    TEST_ASSERT_TRUE(wireNextSample(&reader, &decoded, &age));
+    TEST_ASSERT_EQUAL_UINT16(ages[n], age);
+    assertSample(&samples[n], &decoded);
+  }
+  TEST_ASSERT_FALSE(wireNextSample(&reader, &decoded, &age));
+}
+
+void test_single_sample(void) {
+  roundTrip(1, false, WIRE_HEADER_LEN + WIRE_SAMPLE_LEN);
+}
+
+void test_full_batch(void) {
+  roundTrip(4, false, WIRE_HEADER_LEN + 4 * WIRE_SAMPLE_LEN);
+}
+
+// Only the first sample is full size, which leaves room for one less than
+// WIRE_MAX_SAMPLES
+void test_delta_batch(void) {
+  roundTrip(WIRE_MAX_SAMPLES - 1, true, WIRE_HEADER_LEN + WIRE_SAMPLE_LEN + (WIRE_MAX_SAMPLES - 2) * WIRE_DELTA_SAMPLE_LEN);
+}
+
+// A change too big for a signed byte falls back to a full sample
+void test_delta_falls_back(void) {
+  sensor_data_t samples[2];
+  uint16_t ages[2] = {60, 0};
+  uint8_t frame[WIRE_MAX_FRAME];
+
+  makeSample(&samples[0], 0);
+  makeSample(&samples[1], 1);
+  samples[1].pressure += 500;
+
+  uint8_t len = wireEncode(frame, 1, 1, samples, ages, 2, 0, true);
+  TEST_ASSERT_EQUAL_UINT8(WIRE_HEADER_LEN + 2 * WIRE_SAMPLE_LEN, len);
+
+  wire_reader_t reader;
+  sensor_data_t decoded;
+  uint16_t age;
+  TEST_ASSERT_TRUE(wireReaderInit(&reader, frame, len));
+  TEST_ASSERT_TRUE(wireNextSample(&reader, &decoded, &age));
+  TEST_ASSERT_TRUE(wireNextSample(&reader, &decoded, &age));
+  assertSample(&samples[1], &decoded);
+}
+
+void test_flags(void) {
+  sensor_data_t sample;
+  uint16_t age = 0;
+  uint8_t frame[WIRE_MAX_FRAME];
+
+  makeSample(&sample, 0);
+  uint8_t len = wireEncode(frame, 1, 0, &sample, &age, 1, WIRE_FLAG_RESTART, false);
+
+  wire_reader_t reader;
+  TEST_ASSERT_TRUE(wireReaderInit(&reader, frame, len));
+  TEST_ASSERT_EQUAL_UINT8(WIRE_FLAG_RESTART, reader.header->flags);
+}
+
+void test_legacy_frame(void) {
+  sensor_data_t sample;
+  makeSample(&sample, 3);
+  sample.wakeup_reason = 2;
+
+  wire_reader_t reader;
+  TEST_ASSERT_TRUE(wireReaderInit(&reader, (const uint8_t *)&sample, sizeof(sample)));
+  TEST_ASSERT_TRUE(reader.legacy);
+  TEST_ASSERT_NULL(reader.header);
+
+  sensor_data_t decoded;
+  uint16_t age = 99;
+  TEST_ASSERT_TRUE(wireNextSample(&reader, &decoded, &age));
+  TEST_ASSERT_EQUAL_UINT16(0, age);
+  TEST_ASSERT_EQUAL_MEMORY(&sample, &decoded, sizeof(sensor_data_t));
+  TEST_ASSERT_FALSE(wireNextSample(&reader, &decoded, &age));
+}
+
+void test_rejects_bad_frames(void) {
+  sensor_data_t sample;
+  uint16_t age = 0;
+  uint8_t frame[WIRE_MAX_FRAME];
+  wire_reader_t reader;
+
+  makeSample(&sample, 0);
+  uint8_t len = wireEncode(frame, 1, 0, &sample, &age, 1, 0, false);
+
+  frame[1] = WIRE_VERSION + 1;
+  TEST_ASSERT_FALSE(wireReaderInit(&reader, frame, len));
+  frame[1] = WIRE_VERSION;
+
+  frame[6] = 0;
+  TEST_ASSERT_FALSE(wireReaderInit(&reader, frame, len));
+  frame[6] = 1;
+
+  TEST_ASSERT_FALSE(wireReaderInit(&reader, frame, 5));
+
+  // The header says more samples than the frame holds
+  frame[6] = 2;
+  TEST_ASSERT_TRUE(wireReaderInit(&reader, frame, len));
+  sensor_data_t decoded;
+  TEST_ASSERT_TRUE(wireNextSample(&reader, &decoded, &age));
+  TEST_ASSERT_FALSE(wireNextSample(&reader, &decoded, &age));
+}
+
+void test_encode_limits(void) {
+  sensor_data_t samples[WIRE_MAX_SAMPLES + 1];
+  uint16_t ages[WIRE_MAX_SAMPLES + 1];
+  uint8_t frame[WIRE_MAX_FRAME];
+
+  for(uint8_t n=0;n<=WIRE_MAX_SAMPLES;n++) {
+    makeSample(&samples[n], n);
+    ages[n] = 0;
+  }
+
+  TEST_ASSERT_EQUAL_UINT8(0, wireEncode(frame, 1, 0, samples, ages, 0, 0, false));
+  TEST_ASSERT_EQUAL_UINT8(0, wireEncode(frame, 1, 0, samples, ages, WIRE_MAX_SAMPLES + 1, 0, true));
+  // Full samples run out of room well before WIRE_MAX_SAMPLES
+  TEST_ASSERT_EQUAL_UINT8(0, wireEncode(frame, 1, 0, samples, ages, WIRE_MAX_SAMPLES, 0, false));
+}
+
+// Out of range values are clamped rather than wrapped
+void test_clamps(void) {
+  sensor_data_t sample;
+  uint16_t age = 0;
+  uint8_t frame[WIRE_MAX_FRAME];
+
+  makeSample(&sample, 0);
+  sample.temperature = 400.0;
+  sample.humidity = -5.0;
+  sample.pressure = 10000;
+
+  uint8_t len = wireEncode(frame, 1, 0, &sample, &age, 1, 0, false);
+
+  wire_reader_t reader;
+  sensor_data_t decoded;
+  TEST_ASSERT_TRUE(wireReaderInit(&reader, frame, len));
+  TEST_ASSERT_TRUE(wireNextSample(&reader, &decoded, &age));
+  TEST_ASSERT_FLOAT_WITHIN(0.005, INT16_MAX / WIRE_TEMP_SCALE, decoded.temperature);
+  TEST_ASSERT_FLOAT_WITHIN(0.005, 0.0, decoded.humidity);
+  TEST_ASSERT_EQUAL_INT32(WIRE_PRESSURE_OFFSET, decoded.pressure);
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_single_sample);
+  RUN_TEST(test_full_batch);
+  RUN_TEST(test_delta_batch);
+  RUN_TEST(test_delta_falls_back);
+  RUN_TEST(test_flags);
+  RUN_TEST(test_legacy_frame);
+  RUN_TEST(test_rejects_bad_frames);
+  RUN_TEST(test_encode_limits);
+  RUN_TEST(test_clamps);
+  return UNITY_END();
+}